@@ -0,0 +1,74 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <stdint.h>
+
+//CPU profiler. Zones opened with BKK_ZONE("name") record their begin and end time when the scope closes, into a buffer owned by
+//the calling thread, so recording never takes a lock. Zones are only recorded while a capture is in progress, otherwise they cost a
+//load of an atomic flag. The captured frames are written as a chrome://tracing / Perfetto JSON file.
+//Zone names must be string literals or otherwise outlive the capture.
+//Define BKK_CPU_PROFILER to compile the zones in. Without it BKK_ZONE expands to nothing.
+//Per frame:
+//  profiler::frameMark on the main thread, at the beginning of the frame (application_t::loop does it)
+
+namespace bkk
+{
+  namespace core
+  {
+    namespace profiler
+    {
+      //Records zones during the next frameCount frames and writes them to file when the last one ends
+      void captureFrames(uint32_t frameCount, const char* file);
+      bool isCapturing();
+
+      void frameMark();
+
+      //Name of the calling thread in the trace. Threads without a name are shown as "Thread N"
+      void setThreadName(const char* name);
+
+      struct zone_t
+      {
+        zone_t(const char* name);
+        ~zone_t();
+
+        const char* name_;   //nullptr if no capture was in progress when the zone was opened
+        uint64_t begin_;
+      };
+    }
+  }
+}
+
+#ifdef BKK_CPU_PROFILER
+  #define BKK_ZONE_CONCAT_(a,b) a##b
+  #define BKK_ZONE_CONCAT(a,b) BKK_ZONE_CONCAT_(a,b)
+  #define BKK_ZONE(name) bkk::core::profiler::zone_t BKK_ZONE_CONCAT(bkkZone, __LINE__)(name)
+#else
+  #define BKK_ZONE(name)
+#endif
+
+#endif  /*  CPU_PROFILER_H  */
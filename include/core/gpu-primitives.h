@@ -0,0 +1,155 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef GPU_PRIMITIVES_H
+#define GPU_PRIMITIVES_H
+
+#include "core/render-types.h"
+
+//Parallel building blocks (scan, compaction, sort and histogram) running on the GPU.
+//All of them operate on buffers of uint elements. The number of elements to process is read by the kernels from
+//the first uint of an elementCount buffer, so it can be produced on the GPU (e.g an alive list counter).
+//Primitives are recorded into compute command buffers and wait for previous compute shader writes in the same command buffer
+
+namespace bkk
+{
+  namespace core
+  {
+    namespace render
+    {
+      struct prefix_sum_t
+      {
+        enum type {
+          EXCLUSIVE = 0,
+          INCLUSIVE = 1
+        };
+
+        type type_;
+        uint32_t maxElementCount_;
+        uint32_t workGroupCount_;
+
+        gpu_buffer_t blockSums_;
+
+        descriptor_pool_t descriptorPool_;
+        descriptor_set_layout_t descriptorSetLayout_;
+        descriptor_set_t descriptorSet_;
+        pipeline_layout_t pipelineLayout_;
+
+        shader_t reduceShader_;
+        shader_t scanShader_;
+        shader_t downsweepShader_;
+        compute_pipeline_t reducePipeline_;
+        compute_pipeline_t scanPipeline_;
+        compute_pipeline_t downsweepPipeline_;
+      };
+
+      //Writes to outputCount the number of elements with a non zero flag and to output those elements, preserving their order
+      struct stream_compaction_t
+      {
+        uint32_t maxElementCount_;
+
+        gpu_buffer_t scannedFlags_;
+        prefix_sum_t prefixSum_;
+
+        descriptor_pool_t descriptorPool_;
+        descriptor_set_layout_t descriptorSetLayout_;
+        descriptor_set_t descriptorSet_;
+        pipeline_layout_t pipelineLayout_;
+
+        shader_t scatterShader_;
+        compute_pipeline_t scatterPipeline_;
+      };
+
+      //Key-value radix sort (4 bits per pass). Sorts in ascending key order and is stable. 64-bit keys are stored as two uints, low word first.
+      //Keys and values are sorted in place
+      struct radix_sort_t
+      {
+        enum key_size {
+          KEY_32BIT = 1,
+          KEY_64BIT = 2
+        };
+
+        key_size keySize_;
+        uint32_t maxElementCount_;
+        uint32_t workGroupCount_;
+
+        gpu_buffer_t histogram_;
+        gpu_buffer_t tempKeys_;
+        gpu_buffer_t tempValues_;
+
+        descriptor_pool_t descriptorPool_;
+        descriptor_set_layout_t descriptorSetLayout_;
+        descriptor_set_t descriptorSet_[2];
+        pipeline_layout_t pipelineLayout_;
+
+        shader_t histogramShader_;
+        shader_t scanShader_;
+        shader_t scatterShader_;
+        compute_pipeline_t histogramPipeline_;
+        compute_pipeline_t scanPipeline_;
+        compute_pipeline_t scatterPipeline_;
+      };
+
+      //Counts how many elements fall in each bin. Values greater or equal than binCount are counted in the last bin
+      struct histogram_t
+      {
+        uint32_t maxElementCount_;
+        uint32_t binCount_;
+
+        descriptor_pool_t descriptorPool_;
+        descriptor_set_layout_t descriptorSetLayout_;
+        descriptor_set_t descriptorSet_;
+        pipeline_layout_t pipelineLayout_;
+
+        shader_t clearShader_;
+        shader_t accumulateShader_;
+        compute_pipeline_t clearPipeline_;
+        compute_pipeline_t accumulatePipeline_;
+      };
+
+      //Prefix sum. Input and output can be the same buffer
+      void prefixSumCreate(const context_t& context, prefix_sum_t::type type, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& input, const gpu_buffer_t& output, prefix_sum_t* prefixSum);
+      void prefixSumDestroy(const context_t& context, prefix_sum_t* prefixSum);
+      void prefixSum(command_buffer_t commandBuffer, const prefix_sum_t& prefixSum);
+
+      //Stream compaction
+      void streamCompactionCreate(const context_t& context, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& input, const gpu_buffer_t& flags, const gpu_buffer_t& output, const gpu_buffer_t& outputCount, stream_compaction_t* compaction);
+      void streamCompactionDestroy(const context_t& context, stream_compaction_t* compaction);
+      void streamCompaction(command_buffer_t commandBuffer, const stream_compaction_t& compaction);
+
+      //Radix sort
+      void radixSortCreate(const context_t& context, radix_sort_t::key_size keySize, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& keys, const gpu_buffer_t& values, radix_sort_t* sort);
+      void radixSortDestroy(const context_t& context, radix_sort_t* sort);
+      void radixSort(command_buffer_t commandBuffer, const radix_sort_t& sort);
+
+      //Histogram
+      void histogramCreate(const context_t& context, uint32_t binCount, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& input, const gpu_buffer_t& histogram, histogram_t* result);
+      void histogramDestroy(const context_t& context, histogram_t* histogram);
+      void histogram(command_buffer_t commandBuffer, const histogram_t& histogram);
+
+    } //render namespace
+  }//core namespace
+}//bkk namespace
+
+#endif // GPU_PRIMITIVES_H
@@ -0,0 +1,144 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "core/render-types.h"
+
+//GPU profiler. Measures the GPU time of named markers with timestamp queries and, if the device supports them, pipeline statistics.
+//Each frame in flight has its own queries. The results of a frame are read when its queries are about to be reused, frameCount frames
+//later, without waiting for them: if they are not available yet the frame is dropped.
+//Per frame:
+//  gpuProfilerBeginFrame
+//  gpuProfilerResetQueries in the first command buffer submitted in the frame, outside a render pass
+//  Markers in command buffers submitted to the graphics queue after that one. Markers can be nested but not written inside render passes with a view mask.
+//  Markers collecting pipeline statistics can't be nested with each other and must begin and end in the same subpass if they begin inside a render pass
+//  gpuProfilerEndFrame
+
+namespace bkk
+{
+  namespace core
+  {
+    namespace render
+    {
+      struct gpu_profiler_t
+      {
+        static const uint32_t HISTORY_SIZE = 128u;     //Frames used for averages and percentiles
+        static const uint32_t MAX_NAME_LENGTH = 32u;
+
+        enum statistic_e
+        {
+          INPUT_VERTICES = 0,
+          INPUT_PRIMITIVES,
+          VERTEX_SHADER_INVOCATIONS,
+          CLIPPING_PRIMITIVES,
+          FRAGMENT_SHADER_INVOCATIONS,
+          COMPUTE_SHADER_INVOCATIONS,
+          STATISTIC_COUNT
+        };
+
+        struct marker_t
+        {
+          char name_[MAX_NAME_LENGTH];
+          uint32_t depth_;                        //Nesting level
+          int32_t statisticsQuery_;               //-1 if the marker doesn't collect pipeline statistics
+          float begin_;                           //Milliseconds from the first timestamp of the frame
+          float end_;
+          uint64_t statistics_[STATISTIC_COUNT];
+        };
+
+        //Time per frame of all the markers with the same name
+        struct history_t
+        {
+          char name_[MAX_NAME_LENGTH];
+          float time_[HISTORY_SIZE];  //Milliseconds. Circular buffer
+          uint32_t count_;
+          uint32_t next_;
+        };
+
+        struct frame_t
+        {
+          std::vector<marker_t> markers_;
+          std::vector<uint32_t> openMarkers_;
+          uint32_t statisticsCount_;
+          bool reset_;
+        };
+
+        VkQueryPool timestampPool_;
+        VkQueryPool statisticsPool_;  //VK_NULL_HANDLE if the device doesn't support pipeline statistics queries
+        uint32_t maxMarkers_;         //Per frame
+        uint64_t timestampMask_;
+        float timestampPeriod_;
+
+        uint32_t frame_;
+        std::vector<frame_t> frames_;
+
+        std::vector<marker_t> results_; //Markers of the last frame read
+        float frameTime_;               //Milliseconds from the first to the last timestamp of the last frame read
+        std::vector<history_t> history_;
+      };
+
+      //Timestamps are not supported if the graphics queue has no valid timestamp bits. The profiler is created anyway and markers are ignored
+      void gpuProfilerCreate(const context_t& context, uint32_t frameCount, uint32_t maxMarkersPerFrame, gpu_profiler_t* profiler);
+      void gpuProfilerDestroy(const context_t& context, gpu_profiler_t* profiler);
+
+      //Reads the results of the frame that used the queries of the new one. Returns true if there were results and they were available
+      bool gpuProfilerBeginFrame(const context_t& context, gpu_profiler_t* profiler);
+      void gpuProfilerEndFrame(gpu_profiler_t* profiler);
+
+      //Does nothing if the queries have already been reset in the frame
+      void gpuProfilerResetQueries(command_buffer_t commandBuffer, gpu_profiler_t* profiler);
+
+      void gpuProfilerBeginMarker(command_buffer_t commandBuffer, const char* name, bool pipelineStatistics, gpu_profiler_t* profiler);
+      void gpuProfilerEndMarker(command_buffer_t commandBuffer, gpu_profiler_t* profiler);
+
+      //Rolling average and percentiles, in milliseconds, of the markers with the given name. Returns false if there are no results for it
+      bool gpuProfilerGetTimings(const gpu_profiler_t& profiler, const char* name, float* average, float* p50, float* p95, float* p99);
+
+      //Marker that ends when it goes out of scope
+      struct gpu_profiler_scope_t
+      {
+        gpu_profiler_scope_t(command_buffer_t commandBuffer, const char* name, gpu_profiler_t* profiler, bool pipelineStatistics = false)
+        :commandBuffer_(commandBuffer),
+         profiler_(profiler)
+        {
+          gpuProfilerBeginMarker(commandBuffer_, name, pipelineStatistics, profiler_);
+        }
+
+        ~gpu_profiler_scope_t()
+        {
+          gpuProfilerEndMarker(commandBuffer_, profiler_);
+        }
+
+        command_buffer_t commandBuffer_;
+        gpu_profiler_t* profiler_;
+      };
+
+    } //render namespace
+  }//core namespace
+}//bkk namespace
+
+#endif // GPU_PROFILER_H
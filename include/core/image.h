@@ -46,6 +46,9 @@ namespace bkk
 
       bool load(const char* path, bool flipVertical, image2D_t* image);
       void unload(image2D_t* image);
+
+      //Writes the image as PNG or OpenEXR, depending on the extension of the path. Images with float components are clamped to [0,1] in PNG files
+      bool save(const char* path, const image2D_t& image);
     } //image namespace
   }//core namespace
 }//bkk namespace
@@ -139,11 +139,16 @@ namespace bkk
 
       void draw(render::command_buffer_t commandBuffer, const mesh_t& mesh);
       void drawInstanced(render::command_buffer_t commandBuffer, u32 instanceCount, render::gpu_buffer_t* instanceBuffer, u32 instancedAttributesCount, const mesh_t& mesh);
+      
+      //Draw arguments are read from a VkDrawIndexedIndirectCommand in 'indirectBuffer' at the given offset
+      void drawIndirect(render::command_buffer_t commandBuffer, const render::gpu_buffer_t& indirectBuffer, VkDeviceSize offset, const mesh_t& mesh);
       void destroy(const render::context_t& context, mesh_t* mesh, render::gpu_memory_allocator_t* allocator = nullptr);
+      void destroyDeferred(render::context_t* context, mesh_t* mesh, render::gpu_memory_allocator_t* allocator = nullptr); //GPU buffers are destroyed once the frames in flight have finished
 
       //Animator
       void animatorCreate(const render::context_t& context, const mesh_t& mesh, u32 animationIndex, float speedFactor, skeletal_animator_t* animator);
       void animatorUpdate(const render::context_t& context, f32 deltaTimeInMs, skeletal_animator_t* animator);
+      void animatorSample(f32 deltaTimeInMs, skeletal_animator_t* animator);  //Advances the animation and computes the bone transforms without uploading them
       void animatorDestroy(const render::context_t& context, skeletal_animator_t* animator);
 
       mesh_t fullScreenQuad(const render::context_t& context);
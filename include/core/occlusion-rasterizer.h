@@ -0,0 +1,101 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef OCCLUSION_RASTERIZER_H
+#define OCCLUSION_RASTERIZER_H
+
+#include "core/maths.h"
+
+#include <vector>
+
+//Software occlusion culling.
+//Occluder triangles are rasterized on the CPU into a small depth buffer split in tiles, and bounding boxes are tested against it.
+//Usage per frame:
+//  occlusion::begin(viewProjection, &depthBuffer);
+//  occlusion::addOccluder(occluder, worldTransform, &depthBuffer);  //For every occluder
+//  occlusion::rasterize(&depthBuffer);                              //Or occlusion::rasterizeTile for every tile from a job system
+//  occlusion::isVisible(aabbMin, aabbMax, worldTransform, depthBuffer);
+//Depth follows the Vulkan convention ( 0 <= z <= w ), the buffer holds the closest occluder depth for each pixel center.
+//Occluders must be fully contained in the geometry they stand for, otherwise visible objects may be culled
+
+namespace bkk
+{
+  namespace core
+  {
+    namespace occlusion
+    {
+      static const uint32_t TILE_WIDTH = 32u;   //Multiple of the SIMD width
+      static const uint32_t TILE_HEIGHT = 16u;
+
+      //Simplified geometry used as occluder (positions in object space)
+      struct occluder_t
+      {
+        std::vector<maths::vec3> vertices_;
+        std::vector<uint32_t> indices_;
+      };
+
+      struct triangle_t
+      {
+        float x_[3];
+        float y_[3];
+        float z_[3];
+      };
+
+      struct depth_buffer_t
+      {
+        uint32_t width_ = 0u;
+        uint32_t height_ = 0u;
+        uint32_t tileCountX_ = 0u;
+        uint32_t tileCountY_ = 0u;
+
+        maths::mat4 viewProjection_;
+        std::vector<float> depth_;                   //Row major
+        std::vector<triangle_t> triangles_;          //Screen space triangles added since begin
+        std::vector<std::vector<uint32_t> > bins_;   //Triangles overlapping each tile
+        std::vector<maths::vec4> clipVertices_;      //Scratch memory for addOccluder
+      };
+
+      //Size is rounded up to a multiple of the tile size
+      void depthBufferCreate(uint32_t width, uint32_t height, depth_buffer_t* depthBuffer);
+
+      void begin(const maths::mat4& viewProjection, depth_buffer_t* depthBuffer);
+
+      //Transforms, clips against the near plane and bins the occluder triangles
+      void addOccluder(const occluder_t& occluder, const maths::mat4& transform, depth_buffer_t* depthBuffer);
+
+      //Clears the tile and rasterizes the triangles binned to it. Tiles are independent and can be processed concurrently
+      void rasterizeTile(uint32_t tile, depth_buffer_t* depthBuffer);
+
+      //Rasterizes all the tiles using 'threadCount' threads, the calling one included. If 0, uses as many threads as hardware threads
+      //Extra threads come from a pool of workers kept alive between calls, created the first time they are needed
+      void rasterize(depth_buffer_t* depthBuffer, uint32_t threadCount = 0u);
+
+      //Returns false if the box is outside the view frustum or behind the occluders. Box is in object space
+      bool isVisible(const maths::vec3& aabbMin, const maths::vec3& aabbMax, const maths::mat4& transform, const depth_buffer_t& depthBuffer);
+
+    }//occlusion namespace
+  }//core namespace
+}//bkk namespace
+
+#endif // OCCLUSION_RASTERIZER_H
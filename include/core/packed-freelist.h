@@ -35,8 +35,8 @@ namespace bkk
   {
     struct handle_t
     {
-      uint16_t index_;
-      uint16_t generation_;
+      uint32_t index_;
+      uint32_t generation_;
 
       bool operator==(const handle_t& handle) const
       {
@@ -49,7 +49,7 @@ namespace bkk
       }
 
     };
-    static const handle_t NULL_HANDLE = { 65535u,65535u };
+    static const handle_t NULL_HANDLE = { 0xFFFFFFFFu,0xFFFFFFFFu };
 
     template <typename T> struct packed_freelist_iterator_t;
 
@@ -65,10 +65,10 @@ namespace bkk
        */
       handle_t add(const T& data)
       {
-        assert(elementCount_ < 65535u);
+        assert(elementCount_ < 0xFFFFFFFFu);
 
         //1. Add the new data to the data_ vector
-        uint16_t size = (uint16_t)data_.size();
+        uint32_t size = (uint32_t)data_.size();
         if (elementCount_ == size)
         {
           //Make room for one more data element
@@ -83,11 +83,11 @@ namespace bkk
         {
           //Make room for one more id in the freelist
           freeList_.resize(size + 1);
-          freeList_[size] = { uint16_t(size + 1u), 0u };
+          freeList_[size] = { size + 1u, 0u };
         }
 
         //Update the free list
-        uint16_t index = headFreeList_;
+        uint32_t index = headFreeList_;
         headFreeList_ = freeList_[headFreeList_].index_;
         freeList_[index].index_ = elementCount_;
 
@@ -232,11 +232,11 @@ namespace bkk
     private:
 
       std::vector<handle_t> freeList_;  ///< Free list of IDs (vector with holes)
-      uint16_t headFreeList_;           ///< Head of the free list (fist free element in freeList_)
+      uint32_t headFreeList_;           ///< Head of the free list (fist free element in freeList_)
 
       std::vector<T> data_;             ///< Packed data
       std::vector<handle_t> id_;        ///< Id of each packed element (Needed to go from index to ID)
-      uint16_t elementCount_;           ///< Number of packed elements
+      uint32_t elementCount_;           ///< Number of packed elements
     };
 
     template <typename T>
@@ -41,6 +41,12 @@ namespace bkk
         HOST_VISIBLE_COHERENT = HOST_VISIBLE | HOST_COHERENT
       };
 
+      //Formats for HDR render targets. R11G11B10 has no alpha channel and falls back to RGBA16F if the device can't render to it
+      enum hdr_format_e {
+        HDR_FORMAT_R11G11B10 = 0,
+        HDR_FORMAT_R16G16B16A16 = 1
+      };
+
       struct gpu_memory_t
       {
         VkDeviceMemory handle_;
@@ -80,6 +86,18 @@ namespace bkk
         VkSurfaceTransformFlagBitsKHR preTransform_;
       };
 
+      //Commands of the command buffers submitted since the last call to statsReset (see render::statsGet)
+      struct render_stats_t
+      {
+        uint64_t drawCount_;
+        uint64_t dispatchCount_;
+        uint64_t pipelineBindCount_;
+        uint64_t descriptorSetBindCount_;
+        uint64_t submitCount_;
+        VkDeviceSize gpuMemory_;        //Bytes currently allocated with gpuMemoryAllocate
+        VkDeviceSize gpuMemoryPeak_;    //Since the last reset
+      };
+
       struct command_buffer_t
       {
         enum type {
@@ -97,6 +115,8 @@ namespace bkk
         uint32_t signalSemaphoreCount_;
         VkSemaphore* signalSemaphore_;
         VkFence fence_;
+
+        render_stats_t* recordedStats_ = nullptr;   //Commands recorded since the command buffer began. Shared by all the copies
       };
 
       struct swapchain_t
@@ -109,11 +129,13 @@ namespace bkk
         uint32_t imageHeight_;
 
         std::vector<VkImage> image_;
+        std::vector<gpu_memory_t> imageMemory_;   //Only in headless contexts, where the images are not owned by a swapchain
         std::vector<VkImageView> imageView_;
         depth_stencil_buffer_t depthStencil_;
 
         std::vector<VkFramebuffer> frameBuffer_;
         std::vector<command_buffer_t> commandBuffer_;
+        std::vector<uint64_t> fenceFrame_;        //Frame count of the context when the fence of each command buffer was submitted
 
         VkRenderPass renderPass_;
 
@@ -121,6 +143,24 @@ namespace bkk
         VkSemaphore renderingComplete_;
       };
 
+      //Vulkan objects released while frames using them may still be in flight. They are destroyed once the fence of the frame
+      //in which they were released has signaled (see destroyDeferred). Handles left as VK_NULL_HANDLE are ignored
+      struct deferred_destruction_t
+      {
+        uint64_t frame_;                //Set by destroyDeferred
+        VkBuffer buffer_;
+        VkImage image_;
+        VkImageView imageView_;
+        VkSampler sampler_;
+        VkFramebuffer frameBuffer_;
+        VkRenderPass renderPass_;
+        VkSwapchainKHR swapChain_;
+        VkDescriptorSet descriptorSet_;
+        VkDescriptorPool descriptorPool_;       //Pool of descriptorSet_
+        gpu_memory_t memory_;
+        gpu_memory_allocator_t* allocator_;     //Allocator of memory_. nullptr if it was allocated on its own
+      };
+
       struct context_t
       {
         VkInstance instance_;
@@ -133,6 +173,15 @@ namespace bkk
         surface_t surface_;
         swapchain_t swapChain_;
         VkDebugReportCallbackEXT debugCallback_;
+        bool headless_;                                         //No window. Presentation images are offscreen images and there is no surface or swapchain
+        uint64_t frameCount_;                                   //Frames presented
+        uint64_t completedFrameCount_;                          //Frames whose fence has signaled
+        std::vector<deferred_destruction_t> deferredDestructions_;
+
+        uint32_t apiVersion_;                                   //Vulkan version used by the context (Minimum of instance and device versions)
+        VkPhysicalDeviceSubgroupProperties subgroupProperties_; //Zeroed if the device doesn't support Vulkan 1.1
+        VkPhysicalDeviceFeatures features_;                     //Features enabled in the device
+        VkPhysicalDeviceMultiviewFeatures multiviewFeatures_;   //Features enabled in the device. Zeroed if the device doesn't support Vulkan 1.1
 
         //Imported functions
         PFN_vkGetPhysicalDeviceSurfaceSupportKHR vkGetPhysicalDeviceSurfaceSupportKHR;
@@ -183,6 +232,9 @@ namespace bkk
         wrap_mode wrapU_ = wrap_mode::MIRRORED_REPEAT;
         wrap_mode wrapV_ = wrap_mode::MIRRORED_REPEAT;
         wrap_mode wrapW_ = wrap_mode::MIRRORED_REPEAT;
+
+        //Enables depth comparison (LESS_OR_EQUAL) so the texture can be sampled with a shadow sampler
+        bool depthCompare_ = false;
       };
 
       struct gpu_buffer_t
@@ -298,6 +350,12 @@ namespace bkk
         type type_;
       };
 
+      struct specialization_constants_t
+      {
+        std::vector<uint32_t> id_;
+        std::vector<uint32_t> value_; //32-bit values. Floats and bools are stored by their bit pattern
+      };
+
       struct pipeline_t
       {
         VkPipeline handle_;
@@ -316,6 +374,7 @@ namespace bkk
           VkCompareOp depthTestFunction_;
           shader_t vertexShader_;
           shader_t fragmentShader_;
+          specialization_constants_t specialization_; //Used in both vertex and fragment stages
           //@TODO Stencil
           //@TODO Multisampling
         };
@@ -327,6 +386,7 @@ namespace bkk
       struct compute_pipeline_t : pipeline_t
       {         
         shader_t computeShader_;
+        specialization_constants_t specialization_;
       };
 
 
@@ -394,12 +454,14 @@ namespace bkk
           std::vector<uint32_t> colorAttachmentIndex_;
           std::vector<uint32_t> inputAttachmentIndex_;
           int32_t depthStencilAttachmentIndex_ = -1;
+          uint32_t viewMask_ = 0u;  //Views rendered by the subpass (bit i renders to layer i of the attachments). Requires multiview support
         };
 
         VkRenderPass handle_;
 
         uint32_t attachmentCount_;
         attachment_t* attachment_;
+        uint32_t viewMask_;         //View mask of the first subpass
       };
 
       struct frame_buffer_t
@@ -44,6 +44,9 @@ namespace bkk
     {
       //Context
       void contextCreate(const char* applicationName, const char* engineName, const window::window_t& window, uint32_t swapChainImageCount, context_t* context);
+
+      //Context without a window, surface or swapchain. It renders to offscreen images which can be read with presentationImageRead
+      void contextCreateHeadless(const char* applicationName, const char* engineName, uint32_t width, uint32_t height, uint32_t swapChainImageCount, context_t* context);
       void contextDestroy(context_t* context);
       void contextFlush(const context_t& context);
       void swapchainResize(context_t* context, uint32_t width, uint32_t height);
@@ -54,12 +57,33 @@ namespace bkk
       void endPresentationCommandBuffer(const context_t& context, uint32_t index);
       void presentFrame(context_t* context, VkSemaphore* waitSemaphore = nullptr, uint32_t waitSemaphoreCount = 0u);
 
+      //Queues objects that may be in use by frames in flight. presentFrame destroys them once the fence of the current frame
+      //has signaled, so resources can be released or reallocated without waiting for the device to be idle
+      void destroyDeferred(context_t* context, const deferred_destruction_t& objects);
+
+      //Destroys all the queued objects without waiting. Only safe when the device is idle
+      void deferredDestructionFlush(context_t* context);
+
+      //Copies the last presented image (Only in headless contexts) to an RGBA8 image
+      bool presentationImageRead(const context_t& context, image::image2D_t* image);
+
       //Shaders
       bool shaderCreateFromSPIRV(const context_t& context, shader_t::type type, const char* file, shader_t* shader);
       bool shaderCreateFromGLSL(const context_t& context, shader_t::type type, const char* file, shader_t* shader);
       bool shaderCreateFromGLSLSource(const context_t& context, shader_t::type type, const char* glslSource, shader_t* shader);
       void shaderDestroy(const context_t& context, shader_t* shader);
 
+      //GLSL code to insert right after the #version directive of a compute shader. Defines SUBGROUP_ADD, SUBGROUP_INCLUSIVE_ADD, SUBGROUP_EXCLUSIVE_ADD
+      //and ATOMIC_ADD_AGGREGATED(type, memory, value, result), which does one atomic per subgroup instead of one per invocation.
+      //If the device doesn't support subgroup arithmetic and ballot operations in compute shaders every invocation is treated as a subgroup of size one
+      const char* getSubgroupHelpersGLSL(const context_t& context);
+      bool subgroupOperationsSupported(const context_t& context);
+
+      //GLSL code to insert right after the #version directive of shaders used in render passes with a view mask. Defines VIEW_INDEX as gl_ViewIndex,
+      //the index of the view being rendered. If the device doesn't support multiview VIEW_INDEX is always 0 and each view has to be rendered in its own pass
+      const char* getMultiviewHelpersGLSL(const context_t& context);
+      bool multiviewSupported(const context_t& context);
+
       //GPU memory
       gpu_memory_t gpuMemoryAllocate(const context_t& context, VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypes, uint32_t flags, gpu_memory_allocator_t* allocator = nullptr);
       void gpuMemoryDeallocate(const context_t& context, gpu_memory_allocator_t* allocator, gpu_memory_t memory);
@@ -73,8 +97,13 @@ namespace bkk
       void texture2DCreate(const context_t& context, const image::image2D_t* images, uint32_t mipLevels, texture_sampler_t sampler, texture_t* texture);
       void texture2DCreateAndGenerateMipmaps(const context_t& context, const image::image2D_t& image, texture_sampler_t sampler, texture_t* texture);
       void texture2DCreate(const context_t& context, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usageFlags, texture_sampler_t sampler, texture_t* texture);
+      //Image view covers all the layers. Layout changes must give a subresource range with all of them
+      void texture2DArrayCreate(const context_t& context, uint32_t width, uint32_t height, uint32_t layerCount, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usageFlags, texture_sampler_t sampler, texture_t* texture);
 
       void textureDestroy(const context_t& context, texture_t* texture);
+      void textureDestroyDeferred(context_t* context, texture_t* texture);
+
+      VkFormat getHDRFormat(const context_t& context, hdr_format_e format);
 
       void textureCopy(const command_buffer_t& commandBuffer, texture_t* srcTexture, texture_t* dstTexture,
         uint32_t width, uint32_t height, uint32_t dstMipmap = 0, uint32_t dstLayer = 0, uint32_t srcMipmap = 0, uint32_t srcLayer = 0);
@@ -86,6 +115,10 @@ namespace bkk
       void textureChangeLayoutNow(const context_t& context, VkImageLayout layout, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkImageSubresourceRange subResourceRange, texture_t* texture);
       void textureChangeLayoutNow(const context_t& context, VkImageLayout layout, texture_t* texture);
 
+      //Copies the first mipmap of the texture to the image and waits for the copy to finish. RGBA8 textures are read as 8 bit images, half and float textures as float images.
+      //The texture must have been created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT. Returns false if the format is not supported
+      bool textureRead(const context_t& context, texture_t* texture, image::image2D_t* image);
+
       void textureCubemapCreate(const context_t& context, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, texture_sampler_t sampler, texture_t* texture);
       void textureCubemapCreate(const context_t& context, const image::image2D_t* images, uint32_t mipLevels, texture_sampler_t sampler, texture_t* texture);
       void textureCubemapCreateFromEquirectangularImage(const context_t& context, const image::image2D_t& image, uint32_t size, bool generateMipmaps, texture_t* cubemap);
@@ -95,6 +128,7 @@ namespace bkk
       void gpuBufferCreate(const context_t& context, uint32_t usage, uint32_t memoryType, void* data, size_t size, gpu_memory_allocator_t* allocator, gpu_buffer_t* buffer);
       void gpuBufferCreate(const context_t& context, uint32_t usage, void* data, size_t size, gpu_memory_allocator_t* allocator, gpu_buffer_t* buffer);
       void gpuBufferDestroy(const context_t& context, gpu_memory_allocator_t* allocator, gpu_buffer_t* buffer);
+      void gpuBufferDestroyDeferred(context_t* context, gpu_memory_allocator_t* allocator, gpu_buffer_t* buffer);
       void gpuBufferUpdate(const context_t& context, void* data, size_t offset, size_t size, gpu_buffer_t* buffer);
       void* gpuBufferMap(const context_t& context, const gpu_buffer_t& buffer);
       void gpuBufferUnmap(const context_t& context, const gpu_buffer_t& buffer);
@@ -109,15 +143,23 @@ namespace bkk
 
       void descriptorSetCreate(const context_t& context, const descriptor_pool_t& descriptorPool, const descriptor_set_layout_t& descriptorSetLayout, descriptor_t* descriptors, descriptor_set_t* descriptorSet);
       void descriptorSetDestroy(const context_t& context, descriptor_set_t* descriptorSet);
+      void descriptorSetDestroyDeferred(context_t* context, descriptor_set_t* descriptorSet);
       void descriptorSetUpdate(const context_t& context, const descriptor_set_layout_t& descriptorSetLayout, descriptor_set_t* descriptorSet);
       void descriptorSetBind(command_buffer_t commandBuffer, const pipeline_layout_t& pipelineLayout, uint32_t firstSet, descriptor_set_t* descriptorSets, uint32_t descriptorSetCount);
+      void descriptorSetBind(command_buffer_t commandBuffer, VkPipelineBindPoint bindPoint, const pipeline_layout_t& pipelineLayout, uint32_t firstSet, descriptor_set_t* descriptorSets, uint32_t descriptorSetCount); //Compute work in graphics command buffers
       void descriptorSetLayoutCreate(const context_t& context, descriptor_binding_t* bindings, uint32_t bindingCount, descriptor_set_layout_t* desriptorSetLayout);
       void descriptorSetLayoutDestroy(const context_t& context, descriptor_set_layout_t* desriptorSetLayout);
 
       descriptor_t getDescriptor(const gpu_buffer_t& buffer);
       descriptor_t getDescriptor(const texture_t& texture);
+      descriptor_t getDescriptor(const depth_stencil_buffer_t& depthStencilBuffer);  //Depth aspect, for reading depth in shaders
 
       //Pipelines
+      void specializationConstantSet(uint32_t id, int32_t value, specialization_constants_t* constants);
+      void specializationConstantSet(uint32_t id, uint32_t value, specialization_constants_t* constants);
+      void specializationConstantSet(uint32_t id, float value, specialization_constants_t* constants);
+      void specializationConstantSet(uint32_t id, bool value, specialization_constants_t* constants);
+
       void pipelineLayoutCreate(const context_t& context,
         descriptor_set_layout_t* descriptorSetLayouts, uint32_t descriptorSetLayoutCount,
         push_constant_range_t* pushConstantRanges, uint32_t pushConstantRangeCount,
@@ -134,6 +176,7 @@ namespace bkk
       void graphicsPipelineBind(command_buffer_t commandBuffer, const graphics_pipeline_t& pipeline);
 
       void computePipelineCreate(const context_t& context, const pipeline_layout_t& pipelineLayout, const render::shader_t& computeShader, compute_pipeline_t* pipeline);
+      void computePipelineCreate(const context_t& context, const pipeline_layout_t& pipelineLayout, const render::shader_t& computeShader, const specialization_constants_t& specialization, compute_pipeline_t* pipeline);
       void computePipelineDestroy(const context_t& context, compute_pipeline_t* pipeline);
       void computePipelineBind(command_buffer_t commandBuffer, const compute_pipeline_t& pipeline);
       void computeDispatch(command_buffer_t commandBuffer, uint32_t groupSizeX, uint32_t groupSizeY, uint32_t groupSizeZ);
@@ -182,6 +225,7 @@ namespace bkk
       void frameBufferDestroy(const context_t& context, frame_buffer_t* frameBuffer);
       void depthStencilBufferCreate(const context_t& context, uint32_t width, uint32_t height, depth_stencil_buffer_t* depthStencilBuffer);
       void depthStencilBufferDestroy(const context_t& context, depth_stencil_buffer_t* depthStencilBuffer);
+      void depthStencilBufferDestroyDeferred(context_t* context, depth_stencil_buffer_t* depthStencilBuffer);
 
       //Utility functions    
       void diffuseConvolution(const context_t& context, texture_t environmentMap, uint32_t size, texture_t* irradiance);
@@ -189,6 +233,12 @@ namespace bkk
       void brdfConvolution(const context_t& context, uint32_t size, texture_t* brdfConvolution);
       void waitForAllCommandBuffersToFinish(const context_t& context);
 
+      //Statistics. Draws, dispatches and binds are counted per command buffer when they are recorded and added to the totals each time
+      //the command buffer is submitted, so command buffers recorded once and submitted every frame are counted every frame
+      void statsGet(render_stats_t* stats);
+      void statsReset();
+      void statsAddDraws(const command_buffer_t& commandBuffer, uint32_t drawCount);  //For draws recorded outside render.cpp
+
     } //render namespace
   }//core namespace
 }//bkk namespace
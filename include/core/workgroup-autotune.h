@@ -0,0 +1,70 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef WORKGROUP_AUTOTUNE_H
+#define WORKGROUP_AUTOTUNE_H
+
+#include "core/render-types.h"
+
+//Work group size autotuning for compute kernels.
+//Kernels declare their local size with specialization constants:
+//  layout(local_size_x_id = 0, local_size_y_id = 1, local_size_z_id = 2) in;
+//The first time a kernel is created on a device it is benchmarked with the GPU profiler across a set of candidate sizes
+//for the given problem size. The fastest one is stored in a cache file so later runs skip the benchmark.
+//Specialization constant ids 0 to 2 are reserved for the local size, kernels' own constants should use ids from 3 onwards
+
+namespace bkk
+{
+  namespace core
+  {
+    namespace render
+    {
+      struct compute_kernel_t
+      {
+        compute_pipeline_t pipeline_;
+        uint32_t workGroupSize_[3];
+      };
+
+      //Cache file used to persist the tuned sizes. Defaults to "workgroup-sizes.cache" in the working directory
+      void workGroupSizeCacheSetFile(const char* file);
+
+      //Creates the kernel pipeline with the best work group size for the given number of invocations.
+      //If the size is not cached, candidates are benchmarked on the graphics queue, where the GPU profiler writes its timestamps, with descriptorSets bound from set 0.
+      //Benchmark dispatches write to the bound resources, so kernels must tolerate extra invocations before their first real use
+      void computeKernelCreate(const context_t& context, const pipeline_layout_t& layout, const shader_t& computeShader,
+                               const specialization_constants_t& specialization, const char* name,
+                               uint32_t invocationCountX, uint32_t invocationCountY, uint32_t invocationCountZ,
+                               descriptor_set_t* descriptorSets, uint32_t descriptorSetCount,
+                               compute_kernel_t* kernel);
+
+      void computeKernelDestroy(const context_t& context, compute_kernel_t* kernel);
+
+      //Dispatches enough work groups to cover the given number of invocations. The kernel pipeline must be bound
+      void computeDispatch(command_buffer_t commandBuffer, const compute_kernel_t& kernel, uint32_t invocationCountX, uint32_t invocationCountY, uint32_t invocationCountZ);
+
+    } //render namespace
+  }//core namespace
+}//bkk namespace
+
+#endif // WORKGROUP_AUTOTUNE_H
@@ -12,6 +12,7 @@ namespace bkk
     typedef core::handle_t transform_handle_t;
     typedef core::handle_t material_handle_t;
     typedef core::handle_t actor_handle_t;
+    typedef core::handle_t occluder_handle_t;
 
     class renderer_t;
 
@@ -34,9 +35,11 @@ namespace bkk
       mesh_handle_t mesh_;
       transform_handle_t transform_;
       material_handle_t material_;
+      occluder_handle_t occluder_;  //Optional geometry for software occlusion culling (see camera_t::cull)
 
       core::render::gpu_buffer_t uniformBuffer_;
       core::render::descriptor_set_t descriptorSet_;
+      core::render::gpu_memory_allocator_t* allocator_;  //Block of the renderer the uniform buffer is sub-allocated from
     };
   }
 }
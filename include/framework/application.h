@@ -27,6 +27,7 @@
 #define APPLICATION_H
 
 #include "core/maths.h"
+#include "core/timer.h"
 #include "core/window.h"
 
 #include "framework/gui.h"
@@ -39,10 +40,21 @@ namespace bkk
     class application_t
     {
       public:
-        application_t(const char* title, u32 width, u32 height, u32 imageCount);
+        application_t(const char* title, u32 width, u32 height, u32 imageCount, core::render::hdr_format_e hdrFormat = core::render::HDR_FORMAT_R11G11B10);
         ~application_t();
 
+        //Options for the applications created after the call:
+        //  --headless <frames>  Renders the given number of frames without a window, using a headless context, and quits
+        //  --timestep <ms>      Fixed time step between frames. Headless applications use 16.6ms by default
+        //  --output <file>      Saves the last frame to a PNG or EXR file (Headless only)
+        //  --seed <n>           Seed of the C random number generator, set before the application is created
+        //  --bench <file>       Drives the camera along a scripted path and writes frame time, memory and command statistics
+        //                       to a JSON file when the application quits (Headless only)
+        static void parseCommandLine(int argc, char** argv);
+
         void loop();
+        bool isHeadless() const { return headless_; }
+        uint32_t getSeed() const { return seed_; }
 
         renderer_t& getRenderer();
         core::render::context_t& getRenderContext();
@@ -73,7 +85,16 @@ namespace bkk
         framework::renderer_t renderer_;
 
     private:
+        void saveFrame(const char* file);
+        void scriptedInput(uint32_t frame);
+
         core::window::window_t window_;
+        bool headless_;
+        uint32_t frameCount_;       //Frames to render before quitting if headless
+        float fixedTimeStep_;       //Milliseconds. 0 to use the time between frames
+        const char* outputFile_;
+        uint32_t seed_;
+        core::timer::time_point_t startTime_;
         float timeDelta_;
         core::maths::vec2 mouseCurrentPos_;
         core::maths::vec2 mousePrevPos_;
@@ -82,6 +103,9 @@ namespace bkk
         struct frame_counter_t;
         frame_counter_t* frameCounter_;
 
+        struct benchmark_t;
+        benchmark_t* benchmark_;
+
         application_t();
     };
   }
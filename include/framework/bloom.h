@@ -0,0 +1,86 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdint.h>
+
+#include "core/maths.h"
+#include "core/render.h"
+
+#include "framework/render-target.h"
+
+namespace bkk
+{
+  namespace framework
+  {
+    class renderer_t;
+
+    //Compute bloom. Bright pixels of the source are downsampled to a chain of LEVEL_COUNT levels in a single dispatch
+    //(each workgroup reduces a 64x64 block of the source in shared memory), the lower levels are blurred with a separable
+    //gaussian and the chain is upsampled back accumulating every level into the first one, which is half the size of the source.
+    //All the passes are recorded in the command buffer of the composite pass (see command_buffer_t::blit), which reads the
+    //result with getBloomTexture().
+    class bloom_t
+    {
+      public:
+        static const uint32_t LEVEL_COUNT = 6u;
+
+        bloom_t();
+
+        void initialize(renderer_t* renderer, render_target_handle_t source);
+        void destroy(renderer_t* renderer);
+
+        void setThreshold(float threshold) { threshold_ = threshold; }
+        float getThreshold() const { return threshold_; }
+
+        const core::render::texture_t& getBloomTexture() const { return levels_[0]; }
+
+        //Bytes of GPU memory used by the intermediate textures
+        uint32_t getMemoryUsage() const { return memoryUsage_; }
+
+        //Records the compute passes. Leaves the bloom texture ready to be read by fragment shaders
+        void execute(core::render::command_buffer_t commandBuffer, renderer_t* renderer);
+
+      private:
+        struct push_constants_t
+        {
+          uint32_t srcSize_[2];  //Rendered region of the textures, smaller than the textures with dynamic resolution
+          uint32_t dstSize_[2];
+          float direction_[2];
+          float threshold_;
+          float weight_;
+        };
+
+        void dispatch(core::render::command_buffer_t commandBuffer, const core::render::compute_pipeline_t& pipeline, const core::render::pipeline_layout_t& layout,
+                      core::render::descriptor_set_t* descriptorSet, uint32_t width, uint32_t height, uint32_t groupSize);
+
+        float threshold_;
+        uint32_t width_;    //Size of the source
+        uint32_t height_;
+        uint32_t memoryUsage_;
+
+        core::render::texture_t levels_[LEVEL_COUNT];
+        core::render::texture_t blurTemp_;  //Sized for level 1, reused by the blur of every level
+
+        core::render::descriptor_set_layout_t downsampleDescriptorSetLayout_;
+        core::render::descriptor_set_layout_t filterDescriptorSetLayout_;
+        core::render::pipeline_layout_t downsamplePipelineLayout_;
+        core::render::pipeline_layout_t filterPipelineLayout_;
+
+        core::render::descriptor_set_t downsampleDescriptorSet_;
+        core::render::descriptor_set_t blurHorizontalDescriptorSets_[LEVEL_COUNT];
+        core::render::descriptor_set_t blurVerticalDescriptorSets_[LEVEL_COUNT];
+        core::render::descriptor_set_t upsampleDescriptorSets_[LEVEL_COUNT];
+
+        core::render::shader_t downsampleShader_;
+        core::render::shader_t blurShader_;
+        core::render::shader_t upsampleShader_;
+        core::render::compute_pipeline_t downsamplePipeline_;
+        core::render::compute_pipeline_t blurPipeline_;
+        core::render::compute_pipeline_t upsamplePipeline_;
+
+        push_constants_t pushConstants_;
+    };
+  }
+}
+
+#endif
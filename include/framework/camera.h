@@ -28,6 +28,7 @@
 #include "core/maths.h"
 #include "core/render.h"
 #include "core/packed-freelist.h"
+#include "core/occlusion-rasterizer.h"
 
 namespace bkk
 {
@@ -49,7 +50,7 @@ namespace bkk
       camera_t(projection_mode_e projectionMode, float fov, float aspect, float nearPlane, float farPlane);
 
       void update(renderer_t* renderer);
-      void cull(actor_t* actors, uint32_t actorCount);
+      void cull(renderer_t* renderer, actor_t* actors, uint32_t actorCount);
       void destroy(renderer_t* renderer);
 
       
@@ -59,6 +60,8 @@ namespace bkk
         core::maths::mat4 viewToWorld_;
         core::maths::mat4 projection_;
         core::maths::mat4 projectionInverse_;
+        core::maths::vec4 imageSize_;
+        core::maths::vec4 resolutionScale_;   //Fraction of the offscreen render targets being rendered (see dynamic_resolution_t)
       };
       uniforms_t uniforms_;
       core::render::gpu_buffer_t uniformBuffer_ = {};
@@ -69,6 +72,11 @@ namespace bkk
       float aspect_;
       float nearPlane_;
       float farPlane_;
+
+      //Software occlusion culling. Actors with an occluder are rasterized into the depth buffer and
+      //the bounding box of every actor is tested against it
+      bool occlusionCulling_ = false;
+      core::occlusion::depth_buffer_t occlusionBuffer_;
       
 
       uint32_t visibleActorsCount_ = 0u;
@@ -6,6 +6,8 @@
 #include "core/render.h"
 #include "framework/frame-buffer.h"
 #include "framework/material.h"
+#include "framework/occlusion-culling.h"
+#include "framework/bloom.h"
 
 namespace bkk
 {
@@ -30,6 +32,9 @@ namespace bkk
         
         void render(actor_t* actors, uint32_t actorCount, const char* passName );
         void blit(render_target_handle_t renderTarget, material_handle_t materialHandle = core::NULL_HANDLE, const char* pass = nullptr);
+
+        //Records the bloom compute passes followed by the blit, so the composite needs no extra command buffers
+        void blit(render_target_handle_t renderTarget, bloom_t* bloom, material_handle_t materialHandle, const char* pass = nullptr);
         
         void submit();
         void release();
@@ -38,7 +43,14 @@ namespace bkk
         VkSemaphore* getSemaphore();
 
       private:
-        void beginCommandBuffer();
+        void beginCommandBuffer(const char* marker);
+        void beginRenderPass(bool clear);
+        void endCommandBuffer();
+        void blitPass(render_target_handle_t renderTarget, material_handle_t materialHandle, const char* pass);
+
+        //Draws are indirect if occlusion culling is given, reading the arguments from the selected draw list
+        void drawActors(actor_t* actors, uint32_t actorCount, const char* passName, bool depthOnly,
+                        const occlusion_culling_t* occlusionCulling = nullptr, occlusion_culling_t::draw_list_e drawList = occlusion_culling_t::ALL_DRAWS);
         command_buffer_t();
 
         renderer_t* renderer_;
@@ -0,0 +1,47 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <stdint.h>
+
+namespace bkk
+{
+  namespace framework
+  {
+    //Adjusts the fraction of the offscreen render targets being rendered to hold a target frame time. Targets keep their
+    //size: offscreen passes render to the top left sub-rectangle and blits read it back scaled (see resolutionScale in the generated GLSL).
+    //Frame times come from the GPU profiler of the renderer: from the first to the last marker of a frame
+    class dynamic_resolution_t
+    {
+      public:
+        dynamic_resolution_t();
+
+        void setEnabled(bool enabled);
+        void setTargetFrameTime(float milliseconds) { targetFrameTime_ = milliseconds; }
+        void setScaleRange(float minScale, float maxScale);
+
+        bool isEnabled() const { return enabled_; }
+        float getScale() const { return enabled_ ? scale_ : 1.0f; }
+        float getFrameTime() const { return frameTime_; }  //Milliseconds
+
+        //Updates the scale with the GPU time, in milliseconds, of the last frame read by the profiler. Called before recording
+        void update(float frameTime);
+
+      private:
+
+        bool enabled_;
+        float targetFrameTime_;
+        float minScale_;
+        float maxScale_;
+        float scale_;
+        float frameTime_;
+
+        //PID controller state. Errors are relative to the target frame time
+        float kp_;
+        float ki_;
+        float kd_;
+        float error_[2];
+    };
+  }
+}
+
+#endif
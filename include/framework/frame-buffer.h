@@ -24,6 +24,8 @@ namespace bkk
         uint32_t getWidth() const { return width_; }
         uint32_t getHeight() const { return height_; }
         uint32_t getTargetCount() const { return targetCount_; }
+        bool hasDepthBuffer() const { return hasDepthBuffer_; }
+        core::render::depth_stencil_buffer_t getDepthBuffer() const { return depthBuffer_; }
         core::render::render_pass_t getRenderPass() { return renderPass_; }
         core::render::render_pass_t getRenderPassNoClear() { return renderPassNoClear_; }
         core::render::frame_buffer_t getFrameBuffer() { return frameBuffer_; }
@@ -36,6 +38,8 @@ namespace bkk
         uint32_t width_;
         uint32_t height_;
         uint32_t targetCount_;
+        bool hasDepthBuffer_;
+        core::render::depth_stencil_buffer_t depthBuffer_;
 
         render_target_handle_t* renderTargets_;
       };
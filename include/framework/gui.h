@@ -26,6 +26,7 @@
 #define GUI_H
 
 #include "core/render.h"
+#include "core/gpu-profiler.h"
 #include "../external/imgui/imgui.h"
 
 namespace bkk
@@ -39,7 +40,11 @@ namespace bkk
 
       void beginFrame(const core::render::context_t& context);
       void endFrame();
-      void draw(const core::render::context_t& context, core::render::command_buffer_t commandBuffer);
+      void draw(core::render::context_t& context, core::render::command_buffer_t commandBuffer);
+
+      //Window with the timeline of the last frame measured by the profiler and a table with the timings and pipeline statistics of its markers.
+      //Must be called between beginFrame and endFrame
+      void drawGpuProfiler(const core::render::gpu_profiler_t& profiler);
 
       void updateMousePosition(float x, float y);
       void updateMouseButton(uint32_t button, bool pressed);
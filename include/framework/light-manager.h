@@ -0,0 +1,76 @@
+#ifndef LIGHT_MANAGER_H
+#define LIGHT_MANAGER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "core/maths.h"
+#include "core/render.h"
+#include "core/packed-freelist.h"
+
+namespace bkk
+{
+  namespace framework
+  {
+    class renderer_t;
+    struct camera_t;
+
+    typedef bkk::core::handle_t light_handle_t;
+
+    //Point light. Layout matches the light_t struct in the generated GLSL
+    struct light_t
+    {
+      core::maths::vec4 position_;  //World space
+      core::maths::vec3 color_;
+      float radius_;
+    };
+
+    //Owns the scene lights and assigns them to the froxels (clusters) of the camera being rendered.
+    //Lights, per cluster light ranges and the light index list are bound in the globals descriptor set, and
+    //shaders iterate only over the lights in the cluster of the fragment (see getLightRange in the generated GLSL)
+    class light_manager_t
+    {
+      public:
+        static const uint32_t CLUSTER_COUNT_X = 16u;
+        static const uint32_t CLUSTER_COUNT_Y = 9u;
+        static const uint32_t CLUSTER_COUNT_Z = 24u;  //Exponential depth slices between the near and far planes
+        static const uint32_t MAX_LIGHT_COUNT = 1024u;
+        static const uint32_t MAX_LIGHT_INDEX_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z * 32u;
+
+        light_manager_t();
+
+        void initialize(renderer_t* renderer);
+        void destroy(renderer_t* renderer);
+
+        light_handle_t lightCreate(const core::maths::vec3& position, const core::maths::vec3& color, float radius);
+        light_t* getLight(light_handle_t handle);
+        void lightDestroy(light_handle_t handle);
+
+        //Assigns lights to the clusters of the camera and uploads the result
+        void update(const camera_t& camera, renderer_t* renderer);
+
+        const core::render::gpu_buffer_t& getLightBuffer() const { return lightBuffer_; }
+        const core::render::gpu_buffer_t& getClusterBuffer() const { return clusterBuffer_; }
+        const core::render::gpu_buffer_t& getLightIndexBuffer() const { return lightIndexBuffer_; }
+
+      private:
+        core::packed_freelist_t<light_t> lights_;
+
+        //View space lights in SoA layout
+        std::vector<float> lightX_;
+        std::vector<float> lightY_;
+        std::vector<float> lightZ_;
+        std::vector<float> lightRadius_;
+        std::vector<uint32_t> sliceLights_;
+
+        std::vector<uint32_t> clusterRanges_;  //Offset and count per cluster
+        std::vector<uint32_t> lightIndices_;
+
+        core::render::gpu_buffer_t lightBuffer_;
+        core::render::gpu_buffer_t clusterBuffer_;
+        core::render::gpu_buffer_t lightIndexBuffer_;
+    };
+  }
+}
+
+#endif
@@ -34,11 +34,19 @@ namespace bkk
         
         bool setBuffer(const char* property, core::render::gpu_buffer_t buffer);
         bool setTexture(const char* property, core::render::texture_t texture );
+
+        //Selects the pipeline variant compiled with the given specialization constant value
+        bool setSpecializationConstant(const char* name, int32_t value);
+        bool setSpecializationConstant(const char* name, uint32_t value);
+        bool setSpecializationConstant(const char* name, float value);
+        bool setSpecializationConstant(const char* name, bool value);
         
 
+        //Vulkan objects are destroyed once the frames in flight have finished
         void destroy(renderer_t* renderer);
 
         core::render::graphics_pipeline_t getPipeline(const char* name, frame_buffer_handle_t framebuffer, renderer_t* renderer);
+        core::render::graphics_pipeline_t getDepthOnlyPipeline(const char* name, frame_buffer_handle_t framebuffer, renderer_t* renderer);
         core::render::descriptor_set_t getDescriptorSet(const char* pass = nullptr);
 
 
@@ -51,6 +59,8 @@ namespace bkk
         std::vector<core::render::gpu_buffer_t> uniformBuffers_;
         std::vector<bool> uniformBufferUpdate_;
 
+        std::vector<uint32_t> specialization_;
+
         std::vector<core::render::descriptor_t> descriptors_;
 
         std::vector<core::render::descriptor_set_t> descriptorSet_;
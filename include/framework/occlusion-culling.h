@@ -0,0 +1,103 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <stdint.h>
+
+#include "core/maths.h"
+#include "core/render.h"
+
+#include "framework/frame-buffer.h"
+
+namespace bkk
+{
+  namespace framework
+  {
+    class renderer_t;
+    struct actor_t;
+
+    //Depth pre-pass and two-phase hierarchical-Z occlusion culling for the actors rendered into a frame buffer.
+    //First phase tests actor bounds against the Hi-Z pyramid of the previous frame, visible actors are drawn and the pyramid
+    //is rebuilt from their depth. Second phase tests the actors rejected by the first one against the new pyramid to catch newly
+    //visible actors. Results are written as indirect draw arguments (instance count 0 or 1 per actor) so the draw list
+    //is decided on the GPU without read-backs
+    class occlusion_culling_t
+    {
+      public:
+        enum draw_list_e
+        {
+          EARLY_DRAWS = 0,  //Visible in the first phase
+          LATE_DRAWS = 1,   //Rejected in the first phase and visible in the second one
+          ALL_DRAWS = 2     //Visible in any of the phases
+        };
+
+        occlusion_culling_t();
+
+        void initialize(renderer_t* renderer);
+        void destroy(renderer_t* renderer);
+
+        //Culling and depth pre-pass only apply to actors rendered into this frame buffer. It needs a depth buffer
+        void setFrameBuffer(frame_buffer_handle_t frameBuffer, renderer_t* renderer);
+        void setOcclusionCulling(bool enabled) { cullingEnabled_ = enabled; }
+        void setDepthPrepass(bool enabled) { depthPrepassEnabled_ = enabled; }
+
+        bool isOcclusionCullingEnabled(frame_buffer_handle_t frameBuffer) const { return cullingEnabled_ && frameBuffer == frameBuffer_; }
+        bool isDepthPrepassEnabled(frame_buffer_handle_t frameBuffer) const { return depthPrepassEnabled_ && frameBuffer == frameBuffer_; }
+
+        //Recorded by command_buffer_t::render outside of the render pass
+        void cullFirstPhase(core::render::command_buffer_t commandBuffer, actor_t* actors, uint32_t actorCount, renderer_t* renderer);
+        void buildHiZ(core::render::command_buffer_t commandBuffer, renderer_t* renderer);
+        void cullSecondPhase(core::render::command_buffer_t commandBuffer);
+
+        const core::render::gpu_buffer_t& getDrawCommands() const { return drawCommands_; }
+        VkDeviceSize getDrawCommandOffset(draw_list_e list, uint32_t actor) const { return (list * actorCapacity_ + actor) * sizeof(VkDrawIndexedIndirectCommand); }
+
+      private:
+        struct uniforms_t
+        {
+          core::maths::mat4 viewProjection_;
+          core::maths::mat4 prevViewProjection_;
+          core::maths::uvec4 hiZSize_;      //Rendered size and Hi-Z level count of the current frame
+          core::maths::uvec4 prevHiZSize_;  //Same for the pyramid built on the previous frame. Level count is 0 if there is none
+        };
+
+        struct push_constants_t
+        {
+          uint32_t srcOffset_;
+          uint32_t dstOffset_;
+          uint32_t srcSize_[2];
+          uint32_t dstSize_[2];
+          uint32_t actorCount_;
+          uint32_t phase_;
+        };
+
+        void reserve(uint32_t actorCount, renderer_t* renderer);
+        void updateDescriptorSet(renderer_t* renderer);
+
+        bool cullingEnabled_;
+        bool depthPrepassEnabled_;
+        frame_buffer_handle_t frameBuffer_;
+
+        uniforms_t uniforms_;
+        push_constants_t pushConstants_;
+        uint32_t actorCapacity_;
+
+        core::render::gpu_buffer_t uniformBuffer_;
+        core::render::gpu_buffer_t hiZBuffer_;        //All the levels of the pyramid, packed. Level 0 is half the rendered size
+        core::render::gpu_buffer_t actorBuffer_;      //World space bounds and index count of each actor
+        core::render::gpu_buffer_t drawCommands_;     //One VkDrawIndexedIndirectCommand per actor and draw list
+        core::render::gpu_buffer_t visibilityBuffer_; //First phase results
+
+        core::render::descriptor_set_layout_t descriptorSetLayout_;
+        core::render::descriptor_set_t descriptorSet_;
+        core::render::pipeline_layout_t pipelineLayout_;
+        core::render::shader_t hiZFirstLevelShader_;
+        core::render::shader_t hiZDownsampleShader_;
+        core::render::shader_t cullShader_;
+        core::render::compute_pipeline_t hiZFirstLevelPipeline_;
+        core::render::compute_pipeline_t hiZDownsamplePipeline_;
+        core::render::compute_pipeline_t cullPipeline_;
+    };
+  }
+}
+
+#endif
@@ -23,6 +23,7 @@ namespace bkk
                       bool depthBuffer,                      
                       renderer_t* renderer);
 
+      //Vulkan objects are destroyed once the frames in flight have finished
       void destroy(renderer_t* renderer);
 
       
@@ -7,6 +7,8 @@
 #include "core/transform-manager.h"
 
 #include "core/mesh.h"
+#include "core/occlusion-rasterizer.h"
+#include "core/gpu-profiler.h"
 
 #include "framework/shader.h"
 #include "framework/material.h"
@@ -14,6 +16,9 @@
 #include "framework/frame-buffer.h"
 #include "framework/actor.h"
 #include "framework/camera.h"
+#include "framework/light-manager.h"
+#include "framework/dynamic-resolution.h"
+#include "framework/occlusion-culling.h"
 
 namespace bkk
 {
@@ -35,28 +40,38 @@ namespace bkk
         renderer_t();
         ~renderer_t();
         
-        void initialize(const char* title, uint32_t imageCount, const core::window::window_t& window);
+        void initialize(const char* title, uint32_t imageCount, const core::window::window_t& window, core::render::hdr_format_e hdrFormat = core::render::HDR_FORMAT_R11G11B10);
+        void initializeHeadless(const char* title, uint32_t imageCount, uint32_t width, uint32_t height, core::render::hdr_format_e hdrFormat = core::render::HDR_FORMAT_R11G11B10);
         core::render::context_t& getContext();
+        VkFormat getHDRFormat() const { return hdrFormat_; }  //Format for HDR render targets
 
         shader_handle_t shaderCreate(const char* file);
         shader_t* getShader(shader_handle_t handle);
 
         material_handle_t materialCreate(shader_handle_t shader);
         material_t* getMaterial(material_handle_t handle);
+        void materialDestroy(material_handle_t handle);
 
         render_target_handle_t renderTargetCreate(uint32_t width, uint32_t height,VkFormat format,bool depthBuffer);
         render_target_t* getRenderTarget(render_target_handle_t handle);
+        void renderTargetDestroy(render_target_handle_t handle);
 
         frame_buffer_handle_t frameBufferCreate(render_target_handle_t* renderTargets, uint32_t targetCount,VkImageLayout* initialLayouts = nullptr, VkImageLayout* finalLayouts = nullptr);
         frame_buffer_t* getFrameBuffer(frame_buffer_handle_t handle);
 
         mesh_handle_t addMesh(const core::mesh::mesh_t& mesh);
         core::mesh::mesh_t* getMesh(mesh_handle_t handle);
+        void meshDestroy(mesh_handle_t handle);
+
+        occluder_handle_t addOccluder(const core::occlusion::occluder_t& occluder);
+        core::occlusion::occluder_t* getOccluder(occluder_handle_t handle);
 
         actor_handle_t actorCreate(const char* name, mesh_handle_t mesh, material_handle_t material, core::maths::mat4 transform = core::maths::mat4() );
         actor_t* getActor(actor_handle_t handle);        
         void actorSetParent(actor_handle_t actor, actor_handle_t parent);
         void actorSetTransform(actor_handle_t actor, const core::maths::mat4& newTransform);
+        void actorSetOccluder(actor_handle_t actor, occluder_handle_t occluder);
+        core::maths::mat4* getWorldTransform(transform_handle_t transform);
         actor_handle_t getRootActor() { return rootActor_; }
 
         camera_handle_t addCamera(const camera_t& camera);
@@ -65,12 +80,22 @@ namespace bkk
         bool setupCamera(camera_handle_t camera);
         int getVisibleActors(camera_handle_t camera, actor_t** actors);
 
+        light_manager_t* getLightManager() { return &lightManager_; }
+        dynamic_resolution_t* getDynamicResolution() { return &dynamicResolution_; }
+        occlusion_culling_t* getOcclusionCulling() { return &occlusionCulling_; }
+        core::render::gpu_profiler_t* getGpuProfiler() { return &gpuProfiler_; }
+
         frame_buffer_handle_t getBackBuffer();
         VkSemaphore* getRenderCompleteSemaphore();
         core::render::descriptor_set_layout_t getGlobalsDescriptorSetLayout();
         core::render::descriptor_set_layout_t getObjectDescriptorSetLayout();
         core::render::descriptor_pool_t getDescriptorPool();
 
+        //Memory and descriptor pool for the uniform buffer and descriptor set of a new actor. Actors are sub-allocated
+        //in blocks of ACTOR_BLOCK_SIZE so their count is not bounded by the device allocation limit or the global pool
+        core::render::gpu_memory_allocator_t* getActorAllocator();
+        core::render::descriptor_pool_t getActorDescriptorPool();
+
         void presentFrame();
         void update();
 
@@ -79,6 +104,7 @@ namespace bkk
         void releaseCommandBuffer(const command_buffer_t* cmdBuffer);
 
       private:
+        void initializeResources(core::render::hdr_format_e hdrFormat);
         void createTextureBlitResources();
         void buildPresentationCommandBuffers();
 
@@ -88,6 +114,7 @@ namespace bkk
         core::packed_freelist_t<actor_t> actors_;
         core::packed_freelist_t<camera_t> cameras_;
         core::packed_freelist_t<core::mesh::mesh_t> meshes_;        
+        core::packed_freelist_t<core::occlusion::occluder_t> occluders_;
         core::packed_freelist_t<material_t> materials_;
         core::packed_freelist_t<shader_t> shaders_;
         core::packed_freelist_t<render_target_t> renderTargets_;
@@ -95,12 +122,22 @@ namespace bkk
         
         frame_buffer_handle_t backBuffer_;
         camera_handle_t activeCamera_;
+        VkFormat hdrFormat_;
+        light_manager_t lightManager_;
+        dynamic_resolution_t dynamicResolution_;
+        occlusion_culling_t occlusionCulling_;
+        core::render::gpu_profiler_t gpuProfiler_;
         actor_handle_t rootActor_;
 
         core::render::descriptor_set_layout_t globalsDescriptorSetLayout_;
         core::render::descriptor_set_layout_t objectDescriptorSetLayout_;
         core::render::descriptor_pool_t globalDescriptorPool_;
 
+        static const uint32_t ACTOR_BLOCK_SIZE = 4096u;  //Actors per uniform buffer memory block and per descriptor pool
+        std::vector<core::render::gpu_memory_allocator_t*> actorAllocators_;
+        std::vector<core::render::descriptor_pool_t> actorDescriptorPools_;
+        uint32_t actorDescriptorSetCount_;  //Sets allocated from the last pool
+
         core::transform_manager_t transformManager_;
 
         //Presentation pass resources
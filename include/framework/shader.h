@@ -71,6 +71,22 @@ namespace bkk
       bool shared_;
       std::vector<field_desc_t> fields_;
     };
+
+    struct specialization_constant_desc_t
+    {
+      enum type_e {
+        INT,
+        UINT,
+        FLOAT,
+        BOOL,
+        TYPE_COUNT
+      };
+
+      std::string name_;
+      type_e type_;
+      uint32_t id_;
+      uint32_t defaultValue_; //Bit pattern of the value
+    };
     
     class shader_t
     {
@@ -84,19 +100,45 @@ namespace bkk
 
         core::render::graphics_pipeline_t getPipeline(const char* name, frame_buffer_handle_t framebuffer, renderer_t* renderer);
         core::render::graphics_pipeline_t getPipeline(uint32_t pass, frame_buffer_handle_t, renderer_t* renderer);
+
+        //Pipelines specialized with the given constant values (one per specialization constant, in declaration order)
+        core::render::graphics_pipeline_t getPipeline(const char* name, frame_buffer_handle_t framebuffer, const std::vector<uint32_t>& specialization, renderer_t* renderer);
+        core::render::graphics_pipeline_t getPipeline(uint32_t pass, frame_buffer_handle_t framebuffer, const std::vector<uint32_t>& specialization, renderer_t* renderer);
+
+        //Depth only variant of a pass, used for depth pre-passes. Same vertex shader with an empty fragment shader and no color writes.
+        //Null pipeline if the pass doesn't write depth or opts out with <DepthPrepass Value="Off"/>
+        core::render::graphics_pipeline_t getDepthOnlyPipeline(const char* name, frame_buffer_handle_t framebuffer, const std::vector<uint32_t>& specialization, renderer_t* renderer);
         
         core::render::descriptor_set_layout_t getDescriptorSetLayout();
         const std::vector<texture_desc_t>& getTextureDescriptions() const;
         const std::vector<buffer_desc_t>& getBufferDescriptions() const;
+        const std::vector<specialization_constant_desc_t>& getSpecializationConstantDescriptions() const;
+        std::vector<uint32_t> getDefaultSpecialization() const;
+        int32_t getSpecializationConstantIndexFromName(const char* name) const;
 
         uint32_t getPassCount() const{return (uint32_t)pass_.size();}
         uint32_t getPassIndexFromName(const char* pass) const;
 
       private:
+        struct pipeline_key_t
+        {
+          frame_buffer_handle_t frameBuffer_;
+          std::vector<uint32_t> specialization_;
+
+          bool operator==(const pipeline_key_t& key) const
+          {
+            return frameBuffer_ == key.frameBuffer_ && specialization_ == key.specialization_;
+          }
+        };
+
+        //Pipelines for every pass followed by their depth only variants
+        std::vector<core::render::graphics_pipeline_t>& getPipelines(frame_buffer_handle_t framebuffer, const std::vector<uint32_t>& specialization, renderer_t* renderer);
+
         std::string name_;
 
         std::vector<texture_desc_t> textures_;
         std::vector<buffer_desc_t> buffers_;
+        std::vector<specialization_constant_desc_t> specializationConstants_;
         core::render::descriptor_set_layout_t descriptorSetLayout_;
 
         //Pass data
@@ -106,10 +148,12 @@ namespace bkk
         std::vector<core::render::vertex_format_t> vertexFormats_;
         std::vector<core::render::pipeline_layout_t> pipelineLayouts_;
         std::vector<core::render::graphics_pipeline_t::description_t> graphicsPipelineDescriptions_;
+        std::vector<bool> depthOnlyVariant_;
+        core::render::shader_t depthOnlyFragmentShader_;
         //std::vector<core::render::shader_t> computeShaders_;
         //std::vector<core::render::compute_pipeline_t> computePipelines_;
 
-        core::hash_table_t<frame_buffer_handle_t, std::vector<core::render::graphics_pipeline_t> > graphicsPipelines_;
+        core::hash_table_t<pipeline_key_t, std::vector<core::render::graphics_pipeline_t> > graphicsPipelines_;
     };
   }
 }
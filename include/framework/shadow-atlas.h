@@ -0,0 +1,116 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "core/maths.h"
+#include "core/render.h"
+#include "core/packed-freelist.h"
+
+namespace bkk
+{
+  namespace framework
+  {
+    typedef bkk::core::handle_t shadow_handle_t;
+
+    //Shadow map of a spot light or a face of a point light. Layout matches the GPU tile buffer
+    struct shadow_tile_t
+    {
+      core::maths::mat4 worldToClip_;
+      core::maths::vec4 rect_;          //Offset (xy) and size (zw) of the tile in atlas texture coordinates. Size is 0 if the tile couldn't be allocated
+    };
+
+    //Shadow maps of many lights packed in a single depth texture.
+    //Tile size of each light depends on its screen space size and tiles are re-rendered on a budget:
+    //tiles that have been (re)allocated are always rendered, invalidated tiles go first and the rest are refreshed round-robin.
+    //Point lights use six consecutive tiles (+X,-X,+Y,-Y,+Z,-Z), spot lights one.
+    class shadow_atlas_t
+    {
+      public:
+        enum light_type_e
+        {
+          SPOT_LIGHT = 0,
+          POINT_LIGHT = 1
+        };
+
+        static const uint32_t MAX_SHADOW_COUNT = 64u;
+        static const uint32_t MAX_TILE_COUNT = MAX_SHADOW_COUNT * 6u;
+
+        shadow_atlas_t();
+
+        void initialize(const core::render::context_t& context, uint32_t size, uint32_t minTileSize, uint32_t maxTileSize, uint32_t tileUpdateBudget);
+        void destroy(const core::render::context_t& context);
+
+        shadow_handle_t spotShadowCreate(const core::maths::vec3& position, const core::maths::vec3& direction, float angle, float range);
+        shadow_handle_t pointShadowCreate(const core::maths::vec3& position, float range);
+        void shadowDestroy(shadow_handle_t handle);
+
+        //Moving the light or the casters in its range invalidates its tiles
+        void shadowSetTransform(shadow_handle_t handle, const core::maths::vec3& position, const core::maths::vec3& direction);
+        void shadowInvalidate(shadow_handle_t handle);
+
+        //Index of the first tile of the light in the tile buffer
+        uint32_t getFirstTile(shadow_handle_t handle);
+
+        //Resizes and packs the tiles if needed, selects the tiles to render this frame and uploads the tile buffer
+        void update(const core::render::context_t& context, const core::maths::mat4& worldToView, const core::maths::mat4& projection, uint32_t viewportHeight);
+
+        uint32_t getTilesToRender(const uint32_t** tiles) const;
+        const shadow_tile_t& getTile(uint32_t tile) const { return tiles_[tile]; }
+
+        //Conservative test of a world space bounding box against the range of the light owning the tile
+        bool isInTileRange(uint32_t tile, const core::maths::vec3& aabbMin, const core::maths::vec3& aabbMax);
+
+        //Render pass is depth only. Casters must be drawn after setTile and with the tile matrix
+        void renderPassBegin(const core::render::context_t& context, core::render::command_buffer_t commandBuffer);
+        void setTile(core::render::command_buffer_t commandBuffer, uint32_t tile);
+        void renderPassEnd(core::render::command_buffer_t commandBuffer);
+
+        const core::render::render_pass_t& getRenderPass() const { return renderPass_; }
+        const core::render::texture_t& getTexture() const { return texture_; }
+        const core::render::gpu_buffer_t& getTileBuffer() const { return tileBuffer_; }
+
+      private:
+        struct shadow_t
+        {
+          light_type_e type_;
+          core::maths::vec3 position_;
+          core::maths::vec3 direction_;
+          float angle_;
+          float range_;
+          uint32_t firstTile_;
+          uint32_t tileCount_;
+          uint32_t tileSize_;       //Current tile size in texels
+        };
+
+        shadow_handle_t shadowCreate(const shadow_t& shadow);
+        void pack();
+        void updateTileMatrix(const shadow_t& shadow, uint32_t face);
+
+        uint32_t size_;
+        uint32_t minTileSize_;
+        uint32_t maxTileSize_;
+        uint32_t tileUpdateBudget_;
+        bool packingChanged_;
+
+        core::packed_freelist_t<shadow_t> shadows_;
+        std::vector<uint32_t> freeSlots_;
+
+        //Per tile state
+        std::vector<shadow_tile_t> tiles_;
+        std::vector<core::maths::uvec4> tileViewport_;  //Texels
+        std::vector<shadow_handle_t> tileShadow_;
+        std::vector<uint8_t> tileInvalid_;
+        std::vector<uint32_t> tilesToRender_;
+        uint32_t roundRobinTile_;
+
+        core::render::texture_t texture_;
+        core::render::render_pass_t renderPass_;
+        core::render::frame_buffer_t frameBuffer_;
+        core::render::gpu_buffer_t tileBuffer_;
+    };
+  }
+}
+
+#endif
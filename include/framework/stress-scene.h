@@ -0,0 +1,80 @@
+#ifndef STRESS_SCENE_H
+#define STRESS_SCENE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "core/maths.h"
+
+#include "framework/actor.h"
+#include "framework/light-manager.h"
+#include "framework/shader.h"
+
+namespace bkk
+{
+  namespace framework
+  {
+    class renderer_t;
+
+    //Parameters of a procedural stress scene
+    struct stress_scene_desc_t
+    {
+      stress_scene_desc_t();
+
+      uint32_t actorCount_;
+      uint32_t meshCount_;        //Spheres of increasing tessellation
+      uint32_t materialCount_;
+      uint32_t hierarchyDepth_;   //Actors in each parent chain. 1 for a flat scene
+      uint32_t lightCount_;       //Clamped to light_manager_t::MAX_LIGHT_COUNT
+      float dynamicFraction_;     //Fraction of the actors whose transform changes every frame
+      float extent_;              //Half size of the square the roots of the chains are laid out on
+      uint32_t seed_;
+    };
+
+    //Scene for scale testing, generated only through the public renderer_t API. Actors are grouped in chains of
+    //hierarchyDepth_ actors, each one parented to the previous one, with the roots of the chains on a grid.
+    //Meshes and materials are picked at random, dynamic actors spin around their local Y axis and lights orbit
+    //around the point where they were created
+    class stress_scene_t
+    {
+      public:
+        stress_scene_t();
+
+        //Creates the meshes, materials, actors and lights. Materials are created from 'shader' and set the
+        //"globals.diffuseColor", "globals.specularColor" and "globals.shininess" properties when the shader has them
+        void create(const stress_scene_desc_t& desc, shader_handle_t shader, renderer_t* renderer);
+
+        //Animates the dynamic actors and the lights. Time in seconds
+        void update(float time, renderer_t* renderer);
+
+        const stress_scene_desc_t& getDesc() const { return desc_; }
+        uint32_t getDynamicActorCount() const { return (uint32_t)dynamicActors_.size(); }
+        uint32_t getLightCount() const { return (uint32_t)lights_.size(); }
+        uint64_t getTriangleCount() const { return triangleCount_; }  //Sum of the triangles of all the actors
+
+      private:
+        struct dynamic_actor_t
+        {
+          actor_handle_t actor_;
+          core::maths::vec3 position_;  //Local position
+          float angle_;
+          float speed_;                 //Radians per second
+        };
+
+        struct moving_light_t
+        {
+          light_handle_t light_;
+          core::maths::vec3 center_;
+          float orbitRadius_;
+          float speed_;
+        };
+
+        stress_scene_desc_t desc_;
+        std::vector<dynamic_actor_t> dynamicActors_;
+        std::vector<moving_light_t> lights_;
+        uint64_t triangleCount_;
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,380 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+//Frame benchmark over the samples. Runs each sample headless for a fixed number of frames with the same seed
+//(see application_t::parseCommandLine), collects the JSON files they write in a single results file and compares
+//the results with a baseline, which is a results file of a previous run. Returns 1 if any metric is worse than
+//the baseline by more than its tolerance
+//
+//Usage: bkk-bench [options]
+//  --frames <n>                  Frames rendered by each sample. 300 by default
+//  --seed <n>                    Seed given to the samples. 1 by default
+//  --samples <a,b,...>           Samples to run. All by default
+//  --output <file>               Results file. bench-results.json by default
+//  --baseline <file>             Baseline to compare the results with
+//  --tolerance <percent>         Tolerance of every metric
+//  --tolerance <metric>=<percent> Tolerance of a metric ("cpuFrameTime.p95") or group of metrics ("cpuFrameTime")
+
+static const char* gSamples[] = { "scene", "deferred-shading", "pbr-renderer", "particles", "fluid-simulation", "txaa", "global-illumination" };
+static const uint32_t gSampleCount = sizeof(gSamples) / sizeof(gSamples[0]);
+
+//Default tolerances, in percent. Timings are noisy, memory changes a little between drivers and command counts should be exact
+struct tolerance_t
+{
+  const char* metric_;
+  double percent_;
+};
+
+static const tolerance_t gDefaultTolerances[] = {
+  { "startupTime", 25.0 },
+  { "cpuFrameTime", 10.0 },
+  { "gpuFrameTime", 10.0 },
+  { "gpuMemoryPeak", 5.0 },
+  { "processMemoryPeak", 5.0 },
+  { "drawCount", 0.0 },
+  { "dispatchCount", 0.0 },
+  { "pipelineBindCount", 0.0 },
+  { "descriptorSetBindCount", 0.0 },
+  { "submitCount", 0.0 }
+};
+
+//Values of the JSON files are stored flattened, with the keys of the enclosing objects separated by dots ("scene.cpuFrameTime.p95")
+typedef std::map<std::string, double> values_t;
+
+static void skipSpaces(const char** c)
+{
+  while (**c == ' ' || **c == '\t' || **c == '\n' || **c == '\r')
+    ++*c;
+}
+
+static bool parseString(const char** c, std::string* result)
+{
+  if (**c != '"')
+    return false;
+
+  const char* begin = ++*c;
+  while (**c != '"' && **c != '\0')
+    ++*c;
+
+  if (**c != '"')
+    return false;
+
+  result->assign(begin, *c - begin);
+  ++*c;
+  return true;
+}
+
+//Only objects, numbers and strings. Strings are skipped
+static bool parseValue(const char** c, const std::string& key, values_t* values)
+{
+  skipSpaces(c);
+  if (**c == '"')
+  {
+    std::string ignored;
+    return parseString(c, &ignored);
+  }
+
+  if (**c != '{')
+  {
+    char* end = nullptr;
+    double value = strtod(*c, &end);
+    if (end == *c)
+      return false;
+
+    (*values)[key] = value;
+    *c = end;
+    return true;
+  }
+
+  ++*c;
+  skipSpaces(c);
+  while (**c != '}')
+  {
+    std::string name;
+    if (!parseString(c, &name))
+      return false;
+
+    skipSpaces(c);
+    if (**c != ':')
+      return false;
+
+    ++*c;
+    if (!parseValue(c, key.empty() ? name : key + "." + name, values))
+      return false;
+
+    skipSpaces(c);
+    if (**c == ',')
+    {
+      ++*c;
+      skipSpaces(c);
+    }
+    else if (**c != '}')
+    {
+      return false;
+    }
+  }
+
+  ++*c;
+  return true;
+}
+
+static bool readFile(const char* fileName, std::string* contents)
+{
+  FILE* file = fopen(fileName, "rb");
+  if (!file)
+    return false;
+
+  char buffer[4096];
+  size_t size = 0u;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0u)
+    contents->append(buffer, size);
+
+  fclose(file);
+  return true;
+}
+
+static bool readValues(const char* fileName, values_t* values)
+{
+  std::string contents;
+  if (!readFile(fileName, &contents))
+    return false;
+
+  const char* c = contents.c_str();
+  return parseValue(&c, "", values);
+}
+
+static double getTolerance(const std::string& metric, const std::map<std::string, double>& tolerances, double defaultTolerance)
+{
+  //The most specific of the metric or its group
+  std::map<std::string, double>::const_iterator it = tolerances.find(metric);
+  if (it != tolerances.end())
+    return it->second;
+
+  std::string group = metric.substr(0, metric.find('.'));
+  it = tolerances.find(group);
+  if (it != tolerances.end())
+    return it->second;
+
+  if (defaultTolerance >= 0.0)
+    return defaultTolerance;
+
+  for (uint32_t i(0); i < sizeof(gDefaultTolerances) / sizeof(gDefaultTolerances[0]); ++i)
+  {
+    if (group == gDefaultTolerances[i].metric_)
+      return gDefaultTolerances[i].percent_;
+  }
+
+  return -1.0;  //Not compared
+}
+
+static bool runSample(const char* sample, uint32_t frames, uint32_t seed, const std::string& output)
+{
+  char command[512];
+#ifdef WIN32
+  snprintf(command, sizeof(command), "%s.exe --headless %u --seed %u --bench %s", sample, frames, seed, output.c_str());
+#else
+  snprintf(command, sizeof(command), "./%s --headless %u --seed %u --bench %s", sample, frames, seed, output.c_str());
+#endif
+
+  printf("Running %s\n", command);
+  fflush(stdout);
+  remove(output.c_str());
+  return system(command) == 0;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t frames = 300u;
+  uint32_t seed = 1u;
+  const char* outputFile = "bench-results.json";
+  const char* baselineFile = nullptr;
+  double defaultTolerance = -1.0;
+  std::map<std::string, double> tolerances;
+  std::vector<std::string> samples(gSamples, gSamples + gSampleCount);
+
+  for (int i(1); i < argc; ++i)
+  {
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "Missing value of option %s\n", argv[i]);
+      return 2;
+    }
+
+    if (strcmp(argv[i], "--frames") == 0)
+    {
+      frames = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--seed") == 0)
+    {
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--output") == 0)
+    {
+      outputFile = argv[++i];
+    }
+    else if (strcmp(argv[i], "--baseline") == 0)
+    {
+      baselineFile = argv[++i];
+    }
+    else if (strcmp(argv[i], "--samples") == 0)
+    {
+      samples.clear();
+      std::string list = argv[++i];
+      size_t begin = 0u;
+      while (begin <= list.size())
+      {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos)
+          end = list.size();
+        if (end > begin)
+          samples.push_back(list.substr(begin, end - begin));
+        begin = end + 1;
+      }
+    }
+    else if (strcmp(argv[i], "--tolerance") == 0)
+    {
+      std::string tolerance = argv[++i];
+      size_t separator = tolerance.find('=');
+      if (separator == std::string::npos)
+        defaultTolerance = atof(tolerance.c_str());
+      else
+        tolerances[tolerance.substr(0, separator)] = atof(tolerance.c_str() + separator + 1);
+    }
+    else
+    {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  if (frames < 2u)
+  {
+    fprintf(stderr, "At least two frames are needed\n");
+    return 2;
+  }
+
+  //Run the samples and collect their results
+  std::string results = "{\n";
+  values_t values;
+  bool failed = false;
+  for (uint32_t i(0); i < samples.size(); ++i)
+  {
+    std::string sampleOutput = "bench-" + samples[i] + ".json";
+    std::string contents;
+    values_t sampleValues;
+    if (!runSample(samples[i].c_str(), frames, seed, sampleOutput) || !readFile(sampleOutput.c_str(), &contents))
+    {
+      fprintf(stderr, "%s failed\n", samples[i].c_str());
+      failed = true;
+      continue;
+    }
+
+    const char* c = contents.c_str();
+    if (!parseValue(&c, samples[i], &values))
+    {
+      fprintf(stderr, "Unable to parse %s\n", sampleOutput.c_str());
+      failed = true;
+      continue;
+    }
+
+    while (!contents.empty() && (contents.back() == '\n' || contents.back() == '\r'))
+      contents.pop_back();
+
+    if (results.size() > 2u)
+      results += ",\n";
+    results += "\"" + samples[i] + "\": " + contents;
+    remove(sampleOutput.c_str());
+  }
+  results += "\n}\n";
+
+  FILE* file = fopen(outputFile, "w");
+  if (!file)
+  {
+    fprintf(stderr, "Unable to write %s\n", outputFile);
+    return 2;
+  }
+  fputs(results.c_str(), file);
+  fclose(file);
+  printf("Results written to %s\n", outputFile);
+
+  if (!baselineFile)
+    return failed ? 2 : 0;
+
+  values_t baseline;
+  if (!readValues(baselineFile, &baseline))
+  {
+    fprintf(stderr, "Unable to read the baseline %s\n", baselineFile);
+    return 2;
+  }
+
+  //Lower is better for every metric
+  uint32_t regressionCount = 0u;
+  printf("\n%-20s %-34s %14s %14s %9s\n", "Sample", "Metric", "Baseline", "Current", "Change");
+  for (values_t::const_iterator it = baseline.begin(); it != baseline.end(); ++it)
+  {
+    size_t separator = it->first.find('.');
+    std::string sample = it->first.substr(0, separator);
+    std::string metric = it->first.substr(separator + 1);
+    if (separator == std::string::npos || metric == "frames" || metric == "seed")
+      continue;
+
+    values_t::const_iterator current = values.find(it->first);
+    if (current == values.end())
+      continue;
+
+    double tolerance = getTolerance(metric, tolerances, defaultTolerance);
+    if (tolerance < 0.0)
+      continue;
+
+    double change = it->second != 0.0 ? 100.0 * (current->second - it->second) / it->second : (current->second != 0.0 ? 100.0 : 0.0);
+    bool regression = current->second > it->second * (1.0 + tolerance / 100.0) + 1e-6;
+    if (regression)
+      ++regressionCount;
+
+    printf("%-20s %-34s %14.3f %14.3f %+8.1f%%%s\n", sample.c_str(), metric.c_str(), it->second, current->second, change, regression ? "  REGRESSION" : "");
+  }
+
+  //Samples don't measure their first frame
+  for (uint32_t i(0); i < samples.size(); ++i)
+  {
+    values_t::const_iterator it = baseline.find(samples[i] + ".frames");
+    if (it != baseline.end() && (uint32_t)it->second != frames - 1u)
+      printf("Warning: the baseline of %s was recorded with a different number of frames\n", samples[i].c_str());
+  }
+
+  printf("\n%u regressions\n", regressionCount);
+  if (failed)
+    return 2;
+
+  return regressionCount > 0u ? 1 : 0;
+}
@@ -0,0 +1,1611 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "core/dynamic-array.h"
+#include "core/gpu-primitives.h"
+#include "core/gpu-profiler.h"
+#include "core/hash-table.h"
+#include "core/image.h"
+#include "core/maths.h"
+#include "core/mesh.h"
+#include "core/occlusion-rasterizer.h"
+#include "core/packed-freelist.h"
+#include "core/render.h"
+#include "core/timer.h"
+#include "core/transform-manager.h"
+
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/Importer.hpp>
+
+using namespace bkk::core;
+using namespace bkk::core::maths;
+
+//Microbenchmarks of the core containers, maths, transform manager, animator, occlusion rasterizer, image loading and GPU primitives.
+//Each benchmark is calibrated to run for at least --min-time milliseconds per repetition and is repeated --repetitions times.
+//The result is the median time per item over the repetitions, with the spread (median absolute deviation) as a measure of noise.
+//Inputs are generated with a fixed seed so runs are comparable between builds.
+//Before the benchmarks, checks compare optimized code against a straightforward reference. If any of them fails the program returns 1.
+//GPU checks and benchmarks run on a headless context, so they work with a software driver (lavapipe) on machines without a display.
+//GPU benchmarks measure the GPU time of the work with the GPU profiler, or the time to submit and wait for it if the device has no timestamps
+//
+//Usage: bkk-microbench [options]
+//  --filter <text>       Runs only the checks and benchmarks whose name contains the text
+//  --repetitions <n>     10 by default
+//  --min-time <ms>       10 by default
+//  --json <file>         Writes the results to a JSON file
+//  --image <file>        Image used by the image::load benchmark. A generated 512x512 PNG by default
+//  --occluders <file>    Scene used by the occlusion benchmarks, every mesh is an occluder. ../resources/sponza/sponza.obj by default
+//  --no-gpu              Skips the checks and benchmarks that need a Vulkan device. They are skipped anyway if there isn't one
+
+//Timed region of a benchmark. Benchmarks run 'iterations_' times the work they measure, timing only the work with start and stop
+struct state_t
+{
+  void start() { start_ = timer::getCurrent(); }
+  void stop() { elapsed_ += timer::getDifference(start_, timer::getCurrent()); }
+
+  uint64_t iterations_;
+  double elapsed_;        //Milliseconds
+  timer::time_point_t start_;
+};
+
+typedef void(*benchmark_function_t)(state_t& state, uint32_t size);
+
+struct benchmark_t
+{
+  std::string name_;
+  benchmark_function_t function_;
+  uint32_t size_;       //Passed to the function
+  uint32_t itemCount_;  //Items processed per iteration
+};
+
+typedef bool(*check_function_t)();
+
+struct check_t
+{
+  std::string name_;
+  check_function_t function_;
+};
+
+struct result_t
+{
+  std::string name_;
+  double median_;       //Nanoseconds per item
+  double min_;
+  double spread_;       //Percentage of the median
+  uint64_t iterations_;
+};
+
+//Keeps the compiler from removing the work whose result is not used
+static volatile uint64_t gSink = 0u;
+template <typename T> static void doNotOptimize(const T& value)
+{
+  gSink += *(const uint8_t*)&value;
+}
+
+//Deterministic pseudo-random numbers (xorshift)
+static uint32_t gRandomState = 1u;
+static uint32_t random32()
+{
+  gRandomState ^= gRandomState << 13;
+  gRandomState ^= gRandomState >> 17;
+  gRandomState ^= gRandomState << 5;
+  return gRandomState;
+}
+
+static float randomFloat(float min, float max)
+{
+  return min + (max - min) * (random32() & 0xFFFFFF) / float(0xFFFFFF);
+}
+
+static quat randomQuat()
+{
+  return quaternionFromAxisAngle(normalize(vec3(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(0.1f, 1.0f))), randomFloat(-3.0f, 3.0f));
+}
+
+static mat4 randomTransform()
+{
+  return createTransform(vec3(randomFloat(-10.0f, 10.0f), randomFloat(-10.0f, 10.0f), randomFloat(-10.0f, 10.0f)), vec3(1.0f, 1.0f, 1.0f), randomQuat());
+}
+
+static std::string gImageFile;
+static std::string gOccluderFile = "../resources/sponza/sponza.obj";
+
+//contextCreateHeadless can't report errors, so before using it the GPU checks look for a device it would accept:
+//one with graphics and compute queues
+static bool vulkanDeviceAvailable()
+{
+  VkApplicationInfo appInfo = {};
+  appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  appInfo.pApplicationName = "bkk-microbench";
+  appInfo.apiVersion = VK_API_VERSION_1_0;
+
+  VkInstanceCreateInfo instanceCreateInfo = {};
+  instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instanceCreateInfo.pApplicationInfo = &appInfo;
+  VkInstance instance = VK_NULL_HANDLE;
+  if (vkCreateInstance(&instanceCreateInfo, nullptr, &instance) != VK_SUCCESS)
+    return false;
+
+  uint32_t deviceCount = 0u;
+  vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+  std::vector<VkPhysicalDevice> devices(deviceCount);
+  vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+  bool found = false;
+  for (uint32_t i(0); i < deviceCount && !found; ++i)
+  {
+    uint32_t queueFamilyCount = 0u;
+    vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &queueFamilyCount, queueFamilies.data());
+
+    VkQueueFlags queueFlags = 0u;
+    for (uint32_t j(0); j < queueFamilyCount; ++j)
+      queueFlags |= queueFamilies[j].queueFlags;
+
+    found = (queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFlags & VK_QUEUE_COMPUTE_BIT);
+  }
+
+  vkDestroyInstance(instance, nullptr);
+  return found;
+}
+
+//Headless context shared by the GPU checks and benchmarks. Created the first time one of them runs
+static render::context_t gContext;
+static bool gContextCreated = false;
+
+static render::context_t& gpuContext()
+{
+  if (!gContextCreated)
+  {
+    render::contextCreateHeadless("bkk-microbench", "", 64u, 64u, 3u, &gContext);
+    gContextCreated = true;
+  }
+
+  return gContext;
+}
+
+//Host visible and coherent, so results can be read as soon as the command buffer has finished
+static void storageBufferCreate(const void* data, size_t size, render::gpu_buffer_t* buffer)
+{
+  render::gpuBufferCreate(gpuContext(), render::gpu_buffer_t::usage::STORAGE_BUFFER, render::HOST_VISIBLE_COHERENT, (void*)data, size, nullptr, buffer);
+}
+
+static void storageBufferRead(const render::gpu_buffer_t& buffer, void* data, size_t size)
+{
+  memcpy(data, render::gpuBufferMap(gpuContext(), buffer), size);
+  render::gpuBufferUnmap(gpuContext(), buffer);
+}
+
+//Benchmarks use graphics command buffers, the queue the GPU profiler writes timestamps in
+static void computeBegin(render::command_buffer_t::type type, render::command_buffer_t* commandBuffer)
+{
+  render::commandBufferCreate(gpuContext(), VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, type, commandBuffer);
+  render::commandBufferBegin(gpuContext(), *commandBuffer);
+}
+
+//Makes the compute shader writes visible to the host, submits and waits for the command buffer to finish
+static void computeSubmit(render::command_buffer_t* commandBuffer)
+{
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer->handle_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1u, &barrier, 0u, nullptr, 0u, nullptr);
+  render::commandBufferEnd(*commandBuffer);
+  render::commandBufferSubmit(gpuContext(), *commandBuffer);
+  vkWaitForFences(gpuContext().device_, 1u, &commandBuffer->fence_, VK_TRUE, UINT64_MAX);
+  render::commandBufferDestroy(gpuContext(), commandBuffer);
+}
+
+//Device local buffer with the data copied from a staging buffer
+static void deviceBufferCreate(const void* data, size_t size, render::gpu_buffer_t* buffer)
+{
+  render::gpu_buffer_t staging;
+  render::gpuBufferCreate(gpuContext(), render::gpu_buffer_t::usage::TRANSFER_SRC, render::HOST_VISIBLE_COHERENT, (void*)data, size, nullptr, &staging);
+  render::gpuBufferCreate(gpuContext(), render::gpu_buffer_t::usage::STORAGE_BUFFER | render::gpu_buffer_t::usage::TRANSFER_SRC | render::gpu_buffer_t::usage::TRANSFER_DST,
+                          render::DEVICE_LOCAL, nullptr, size, nullptr, buffer);
+
+  render::command_buffer_t commandBuffer = {};
+  computeBegin(render::command_buffer_t::COMPUTE, &commandBuffer);
+  VkBufferCopy region = { 0u, 0u, size };
+  vkCmdCopyBuffer(commandBuffer.handle_, staging.handle_, buffer->handle_, 1u, &region);
+  computeSubmit(&commandBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &staging);
+}
+
+//Restores a buffer modified in place by the benchmarked work
+static void bufferCopy(render::command_buffer_t commandBuffer, const render::gpu_buffer_t& source, const render::gpu_buffer_t& destination, size_t size)
+{
+  VkBufferCopy region = { 0u, 0u, size };
+  vkCmdCopyBuffer(commandBuffer.handle_, source.handle_, destination.handle_, 1u, &region);
+
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer.handle_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1u, &barrier, 0u, nullptr, 0u, nullptr);
+}
+
+//Records 'prepare' and 'work' in a command buffer per iteration. Only 'work' is timed
+template <typename PREPARE, typename WORK>
+static void gpuBenchmark(state_t& state, PREPARE prepare, WORK work)
+{
+  render::gpu_profiler_t profiler;
+  render::gpuProfilerCreate(gpuContext(), 1u, 1u, &profiler);
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    render::gpuProfilerBeginFrame(gpuContext(), &profiler);
+    render::command_buffer_t commandBuffer = {};
+    computeBegin(render::command_buffer_t::GRAPHICS, &commandBuffer);
+    render::gpuProfilerResetQueries(commandBuffer, &profiler);
+    prepare(commandBuffer);
+    render::gpuProfilerBeginMarker(commandBuffer, "Benchmark", false, &profiler);
+    work(commandBuffer);
+    render::gpuProfilerEndMarker(commandBuffer, &profiler);
+
+    timer::time_point_t submitted = timer::getCurrent();
+    computeSubmit(&commandBuffer);
+    double submitTime = timer::getDifference(submitted, timer::getCurrent());
+
+    //The profiler has a single frame so beginning the next one reads the results of this one
+    render::gpuProfilerEndFrame(&profiler);
+    state.elapsed_ += render::gpuProfilerBeginFrame(gpuContext(), &profiler) ? profiler.frameTime_ : submitTime;
+  }
+
+  render::gpuProfilerDestroy(gpuContext(), &profiler);
+}
+
+
+//packed_freelist_t
+static void packedFreelistAdd(state_t& state, uint32_t size)
+{
+  mat4 value = randomTransform();
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    packed_freelist_t<mat4> freelist;
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      doNotOptimize(freelist.add(value));
+    state.stop();
+  }
+}
+
+static void packedFreelistRemove(state_t& state, uint32_t size)
+{
+  mat4 value = randomTransform();
+  std::vector<handle_t> handles(size);
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    gRandomState = 1u;
+    packed_freelist_t<mat4> freelist;
+    for (uint32_t j(0); j < size; ++j)
+      handles[j] = freelist.add(value);
+
+    for (uint32_t j(size - 1); j > 0; --j)
+      std::swap(handles[j], handles[random32() % (j + 1)]);
+
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      doNotOptimize(freelist.remove(handles[j]));
+    state.stop();
+  }
+}
+
+static void packedFreelistGet(state_t& state, uint32_t size)
+{
+  packed_freelist_t<mat4> freelist;
+  std::vector<handle_t> handles(size);
+  for (uint32_t j(0); j < size; ++j)
+    handles[j] = freelist.add(randomTransform());
+
+  //Remove some elements so the packed order is not the order of the handles
+  for (uint32_t j(0); j < size; j += 4)
+    freelist.remove(handles[j]);
+  for (uint32_t j(0); j < size; j += 4)
+    handles[j] = freelist.add(randomTransform());
+
+  for (uint32_t j(size - 1); j > 0; --j)
+    std::swap(handles[j], handles[random32() % (j + 1)]);
+
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      doNotOptimize(freelist.get(handles[j])->data[12]);
+    state.stop();
+  }
+}
+
+static void packedFreelistIterate(state_t& state, uint32_t size)
+{
+  packed_freelist_t<mat4> freelist;
+  for (uint32_t j(0); j < size; ++j)
+    freelist.add(randomTransform());
+
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    float sum = 0.0f;
+    state.start();
+    for (packed_freelist_iterator_t<mat4> it = freelist.begin(); it != freelist.end(); ++it)
+      sum += it.get().data[12];
+    state.stop();
+    doNotOptimize(sum);
+  }
+}
+
+//hash_table_t
+static void hashTableGet(state_t& state, uint32_t size)
+{
+  hash_table_t<uint32_t, uint32_t> table;
+  std::vector<uint32_t> keys(size);
+  for (uint32_t j(0); j < size; ++j)
+  {
+    keys[j] = random32();
+    table.add(keys[j], j);
+  }
+
+  for (uint32_t j(size - 1); j > 0; --j)
+    std::swap(keys[j], keys[random32() % (j + 1)]);
+
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      doNotOptimize(*table.get(keys[j]));
+    state.stop();
+  }
+}
+
+//dynamic_array_t
+static void dynamicArrayPush(state_t& state, uint32_t size)
+{
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    dynamic_array_t<uint32_t> array;
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      array.push_back(j);
+    state.stop();
+    doNotOptimize(array[size - 1]);
+  }
+}
+
+static void dynamicArraySort(state_t& state, uint32_t size)
+{
+  std::vector<uint32_t> values(size);
+  for (uint32_t j(0); j < size; ++j)
+    values[j] = random32();
+
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    dynamic_array_t<uint32_t> array(size);
+    memcpy(array.data(), values.data(), size * sizeof(uint32_t));
+    state.start();
+    array.sort();
+    state.stop();
+    doNotOptimize(array[0]);
+  }
+}
+
+//maths
+static void mat4Multiply(state_t& state, uint32_t size)
+{
+  std::vector<mat4> matrices(size + 1);
+  for (uint32_t j(0); j <= size; ++j)
+    matrices[j] = randomTransform();
+
+  std::vector<mat4> results(size);
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      results[j] = matrices[j] * matrices[j + 1];
+    state.stop();
+    doNotOptimize(results[size - 1].data[0]);
+  }
+}
+
+static void mat4Invert(state_t& state, uint32_t size)
+{
+  std::vector<mat4> matrices(size);
+  for (uint32_t j(0); j < size; ++j)
+    matrices[j] = randomTransform();
+
+  std::vector<mat4> results(size);
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      invertMatrix(matrices[j], results[j]);
+    state.stop();
+    doNotOptimize(results[size - 1].data[0]);
+  }
+}
+
+static void mat4InvertTransform(state_t& state, uint32_t size)
+{
+  std::vector<mat4> matrices(size);
+  for (uint32_t j(0); j < size; ++j)
+    matrices[j] = randomTransform();
+
+  std::vector<mat4> results(size);
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      results[j] = invertTransform(matrices[j]);
+    state.stop();
+    doNotOptimize(results[size - 1].data[0]);
+  }
+}
+
+static void quatSlerp(state_t& state, uint32_t size)
+{
+  std::vector<quat> quaternions(size + 1);
+  std::vector<float> t(size);
+  for (uint32_t j(0); j <= size; ++j)
+    quaternions[j] = randomQuat();
+  for (uint32_t j(0); j < size; ++j)
+    t[j] = randomFloat(0.0f, 1.0f);
+
+  std::vector<quat> results(size);
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    for (uint32_t j(0); j < size; ++j)
+      results[j] = slerp(quaternions[j], quaternions[j + 1], t[j]);
+    state.stop();
+    doNotOptimize(results[size - 1].x);
+  }
+}
+
+//transform_manager_t. Hierarchy shapes
+enum hierarchy_e
+{
+  HIERARCHY_FLAT = 0,   //No parents
+  HIERARCHY_CHAIN,      //Each transform is the child of the previous one
+  HIERARCHY_TREE,       //Four children per transform
+  HIERARCHY_SHUFFLED    //Tree with the transforms created in random order
+};
+
+static void createHierarchy(hierarchy_e shape, uint32_t size, transform_manager_t* txManager, std::vector<handle_t>* handles)
+{
+  handles->resize(size);
+  std::vector<uint32_t> order(size);
+  for (uint32_t j(0); j < size; ++j)
+    order[j] = j;
+
+  if (shape == HIERARCHY_SHUFFLED)
+  {
+    for (uint32_t j(size - 1); j > 0; --j)
+      std::swap(order[j], order[random32() % (j + 1)]);
+  }
+
+  for (uint32_t j(0); j < size; ++j)
+    (*handles)[order[j]] = txManager->createTransform(randomTransform());
+
+  for (uint32_t j(1); j < size; ++j)
+  {
+    if (shape == HIERARCHY_CHAIN)
+      txManager->setParent((*handles)[j], (*handles)[j - 1]);
+    else if (shape != HIERARCHY_FLAT)
+      txManager->setParent((*handles)[j], (*handles)[(j - 1) / 4]);
+  }
+
+  //Sorts the hierarchy
+  txManager->update();
+}
+
+template <hierarchy_e SHAPE>
+static void transformManagerUpdate(state_t& state, uint32_t size)
+{
+  transform_manager_t txManager;
+  std::vector<handle_t> handles;
+  createHierarchy(SHAPE, size, &txManager, &handles);
+
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    txManager.update();
+    state.stop();
+    doNotOptimize(txManager.getWorldMatrix(handles[size - 1])->data[12]);
+  }
+}
+
+//Hierarchy changed since the last update, so transforms are sorted again
+static void transformManagerUpdateAndSort(state_t& state, uint32_t size)
+{
+  transform_manager_t txManager;
+  std::vector<handle_t> handles;
+  createHierarchy(HIERARCHY_SHUFFLED, size, &txManager, &handles);
+
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    txManager.setParent(handles[size - 1], handles[(size - 2) / 4]);
+    state.start();
+    txManager.update();
+    state.stop();
+    doNotOptimize(txManager.getWorldMatrix(handles[size - 1])->data[12]);
+  }
+}
+
+//mesh::animatorSample. Synthetic skeleton of 'size' bones with a four children per bone hierarchy and a 60 frames animation
+static void animatorSample(state_t& state, uint32_t size)
+{
+  const uint32_t frameCount = 60u;
+
+  mesh::skeleton_t skeleton;
+  std::vector<handle_t> nodes;
+  createHierarchy(HIERARCHY_TREE, size, &skeleton.txManager_, &nodes);
+  std::vector<mat4> bindPose(size);
+  for (uint32_t j(0); j < size; ++j)
+    bindPose[j] = randomTransform();
+
+  skeleton.bones_ = nodes.data();
+  skeleton.bindPose_ = bindPose.data();
+  skeleton.rootBoneInverseTransform_ = mat4();
+  skeleton.boneCount_ = size;
+  skeleton.nodeCount_ = size;
+
+  std::vector<mesh::bone_transform_t> data(frameCount * size);
+  for (uint32_t j(0); j < data.size(); ++j)
+  {
+    data[j].position_ = vec3(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f));
+    data[j].scale_ = vec3(1.0f, 1.0f, 1.0f);
+    data[j].orientation_ = randomQuat();
+  }
+
+  mesh::skeletal_animation_t animation;
+  animation.frameCount_ = frameCount;
+  animation.nodeCount_ = size;
+  animation.duration_ = 2000.0f;
+  animation.nodes_ = nodes.data();
+  animation.data_ = data.data();
+
+  std::vector<mat4> boneTransforms(size);
+  mesh::skeletal_animator_t animator = {};
+  animator.speed_ = 1.0f;
+  animator.skeleton_ = &skeleton;
+  animator.animation_ = &animation;
+  animator.boneTransform_ = boneTransforms.data();
+
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    mesh::animatorSample(16.6f, &animator);
+    state.stop();
+    doNotOptimize(boneTransforms[size - 1].data[12]);
+  }
+}
+
+//occlusion checks. Unit cubes with random transforms seen from a camera placed among them, so some cross the near plane
+static const float gOcclusionDepthTolerance = 1e-6f;
+
+static void createOcclusionScene(uint32_t occluderCount, occlusion::depth_buffer_t* depthBuffer, occlusion::occluder_t* occluder)
+{
+  occluder->vertices_.clear();
+  for (uint32_t i(0); i < 8; ++i)
+    occluder->vertices_.push_back(vec3((i & 1u) ? 1.0f : -1.0f, (i & 2u) ? 1.0f : -1.0f, (i & 4u) ? 1.0f : -1.0f));
+
+  occluder->indices_ = { 0,2,1, 1,2,3, 4,5,6, 5,7,6, 0,1,4, 1,5,4, 2,6,3, 3,6,7, 0,4,2, 2,4,6, 1,3,5, 3,7,5 };
+
+  mat4 view = lookAtMatrix(vec3(0.0f, 2.0f, 12.0f), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+  mat4 projection = perspectiveProjectionMatrix(1.2f, 2.0f, 0.1f, 100.0f);
+  occlusion::depthBufferCreate(256u, 128u, depthBuffer);
+  occlusion::begin(view * projection, depthBuffer);
+  for (uint32_t i(0); i < occluderCount; ++i)
+    occlusion::addOccluder(*occluder, randomTransform(), depthBuffer);
+}
+
+//Scalar version of rasterizeTile. Every pixel center is tested against every triangle, without tiles, bins or SIMD
+static void occlusionRasterizeReference(const occlusion::depth_buffer_t& depthBuffer, std::vector<float>* depth)
+{
+  depth->assign(depthBuffer.width_ * depthBuffer.height_, 1.0f);
+  for (uint32_t t(0); t < depthBuffer.triangles_.size(); ++t)
+  {
+    const occlusion::triangle_t& triangle = depthBuffer.triangles_[t];
+    uint32_t i1 = 1u, i2 = 2u;
+    float area = (triangle.x_[1] - triangle.x_[0]) * (triangle.y_[2] - triangle.y_[0]) - (triangle.y_[1] - triangle.y_[0]) * (triangle.x_[2] - triangle.x_[0]);
+    if (area < 0.0f)
+    {
+      i1 = 2u;
+      i2 = 1u;
+      area = -area;
+    }
+
+    float x[3] = { triangle.x_[0], triangle.x_[i1], triangle.x_[i2] };
+    float y[3] = { triangle.y_[0], triangle.y_[i1], triangle.y_[i2] };
+    float z[3] = { triangle.z_[0], triangle.z_[i1], triangle.z_[i2] };
+    float a[3], b[3], c[3];
+    for (uint32_t k(0); k < 3; ++k)
+    {
+      uint32_t j0 = (k + 1) % 3;
+      uint32_t j1 = (k + 2) % 3;
+      a[k] = y[j0] - y[j1];
+      b[k] = x[j1] - x[j0];
+      c[k] = x[j0] * y[j1] - y[j0] * x[j1];
+    }
+
+    float invArea = 1.0f / area;
+    float za = (a[0] * z[0] + a[1] * z[1] + a[2] * z[2]) * invArea;
+    float zb = (b[0] * z[0] + b[1] * z[1] + b[2] * z[2]) * invArea;
+    float zc = (c[0] * z[0] + c[1] * z[1] + c[2] * z[2]) * invArea;
+    for (uint32_t py(0); py < depthBuffer.height_; ++py)
+    {
+      float centerY = py + 0.5f;
+      for (uint32_t px(0); px < depthBuffer.width_; ++px)
+      {
+        float centerX = px + 0.5f;
+        bool inside = true;
+        for (uint32_t k(0); k < 3; ++k)
+          inside = inside && (a[k] * centerX + (b[k] * centerY + c[k])) >= 0.0f;
+
+        float& pixel = (*depth)[py * depthBuffer.width_ + px];
+        if (inside)
+          pixel = std::min(pixel, za * centerX + (zb * centerY + zc));
+      }
+    }
+  }
+}
+
+//Scalar version of isVisible. Tests every pixel the screen space bounds of the box touch
+static bool occlusionIsVisibleReference(const vec3& aabbMin, const vec3& aabbMax, const mat4& transform, const occlusion::depth_buffer_t& depthBuffer)
+{
+  mat4 modelViewProjection = transform * depthBuffer.viewProjection_;
+  vec4 corners[8];
+  bool crossesNearPlane = false;
+  uint32_t outsideCount[6] = {};
+  for (uint32_t i(0); i < 8; ++i)
+  {
+    corners[i] = vec4((i & 1u) ? aabbMax.x : aabbMin.x, (i & 2u) ? aabbMax.y : aabbMin.y, (i & 4u) ? aabbMax.z : aabbMin.z, 1.0f) * modelViewProjection;
+    const vec4& v = corners[i];
+    outsideCount[0] += v.x < -v.w ? 1u : 0u;
+    outsideCount[1] += v.x > v.w ? 1u : 0u;
+    outsideCount[2] += v.y < -v.w ? 1u : 0u;
+    outsideCount[3] += v.y > v.w ? 1u : 0u;
+    outsideCount[4] += v.z < 0.0f ? 1u : 0u;
+    outsideCount[5] += v.z > v.w ? 1u : 0u;
+    crossesNearPlane = crossesNearPlane || v.z < 0.0f;
+  }
+
+  for (uint32_t i(0); i < 6; ++i)
+  {
+    if (outsideCount[i] == 8u)
+      return false;
+  }
+
+  if (crossesNearPlane)
+    return true;
+
+  float minX = (float)depthBuffer.width_, maxX = 0.0f, minY = (float)depthBuffer.height_, maxY = 0.0f, minZ = 1.0f;
+  for (uint32_t i(0); i < 8; ++i)
+  {
+    float invW = 1.0f / corners[i].w;
+    minX = std::min(minX, (corners[i].x * invW * 0.5f + 0.5f) * depthBuffer.width_);
+    maxX = std::max(maxX, (corners[i].x * invW * 0.5f + 0.5f) * depthBuffer.width_);
+    minY = std::min(minY, (corners[i].y * invW * 0.5f + 0.5f) * depthBuffer.height_);
+    maxY = std::max(maxY, (corners[i].y * invW * 0.5f + 0.5f) * depthBuffer.height_);
+    minZ = std::min(minZ, corners[i].z * invW);
+  }
+
+  for (int32_t y(0); y < (int32_t)depthBuffer.height_; ++y)
+  {
+    for (int32_t x(0); x < (int32_t)depthBuffer.width_; ++x)
+    {
+      if (x + 1 > minX && x <= maxX && y + 1 > minY && y <= maxY && depthBuffer.depth_[y * depthBuffer.width_ + x] >= minZ)
+        return true;
+    }
+  }
+
+  return false;
+}
+
+static bool occlusionRasterizeCheck()
+{
+  occlusion::depth_buffer_t depthBuffer;
+  occlusion::occluder_t occluder;
+  createOcclusionScene(64u, &depthBuffer, &occluder);
+
+  std::vector<float> reference;
+  occlusionRasterizeReference(depthBuffer, &reference);
+
+  //Single threaded, then with the worker pool. Helpers are reused by later calls, including calls needing fewer of them
+  for (uint32_t threadCount : { 1u, 4u, 4u, 2u, 0u })
+  {
+    occlusion::rasterize(&depthBuffer, threadCount);
+    uint32_t mismatches = 0u;
+    for (uint32_t i(0); i < reference.size(); ++i)
+    {
+      if (fabsf(depthBuffer.depth_[i] - reference[i]) > gOcclusionDepthTolerance)
+        mismatches++;
+    }
+
+    if (mismatches > 0u)
+    {
+      fprintf(stderr, "occlusion::rasterize with %u threads: %u of %u pixels differ from the reference\n", threadCount, mismatches, (uint32_t)reference.size());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool occlusionIsVisibleCheck()
+{
+  occlusion::depth_buffer_t depthBuffer;
+  occlusion::occluder_t occluder;
+  createOcclusionScene(64u, &depthBuffer, &occluder);
+  occlusion::rasterize(&depthBuffer);
+
+  uint32_t mismatches = 0u;
+  uint32_t visibleCount = 0u;
+  const uint32_t boxCount = 4096u;
+  for (uint32_t i(0); i < boxCount; ++i)
+  {
+    vec3 extent(randomFloat(0.05f, 2.0f), randomFloat(0.05f, 2.0f), randomFloat(0.05f, 2.0f));
+    mat4 transform = randomTransform();
+    bool visible = occlusion::isVisible(extent * -1.0f, extent, transform, depthBuffer);
+    visibleCount += visible ? 1u : 0u;
+    if (visible != occlusionIsVisibleReference(extent * -1.0f, extent, transform, depthBuffer))
+      mismatches++;
+  }
+
+  if (mismatches > 0u)
+  {
+    fprintf(stderr, "occlusion::isVisible: %u of %u boxes differ from the reference\n", mismatches, boxCount);
+    return false;
+  }
+
+  //Both outcomes have to be exercised for the comparison to mean something
+  if (visibleCount == 0u || visibleCount == boxCount)
+  {
+    fprintf(stderr, "occlusion::isVisible: %u of %u boxes visible, scene does not test occlusion\n", visibleCount, boxCount);
+    return false;
+  }
+
+  return true;
+}
+
+//Occlusion benchmarks scene. Every mesh of the file is an occluder and its bounding box is tested for visibility, as with
+//actors in camera_t::cull. The camera stands a quarter of the way along the longest horizontal axis of the scene, at a tenth of
+//its height, looking down that axis. In sponza about 40% of the meshes are visible from there
+struct occlusion_scene_t
+{
+  std::vector<occlusion::occluder_t> occluders_;
+  std::vector<vec3> aabbMin_;
+  std::vector<vec3> aabbMax_;
+  mat4 viewProjection_;
+  uint32_t triangleCount_;
+};
+
+static occlusion_scene_t gOcclusionScene;
+
+static bool loadOcclusionScene(const char* file, occlusion_scene_t* scene)
+{
+  Assimp::Importer importer;
+  const aiScene* model = importer.ReadFile(file, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+  if (!model || model->mNumMeshes == 0u)
+    return false;
+
+  vec3 sceneMin(FLT_MAX, FLT_MAX, FLT_MAX);
+  vec3 sceneMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  scene->triangleCount_ = 0u;
+  for (uint32_t i(0); i < model->mNumMeshes; ++i)
+  {
+    const aiMesh* mesh = model->mMeshes[i];
+    occlusion::occluder_t occluder;
+    vec3 aabbMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    vec3 aabbMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (uint32_t j(0); j < mesh->mNumVertices; ++j)
+    {
+      vec3 position(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z);
+      occluder.vertices_.push_back(position);
+      for (uint32_t k(0); k < 3; ++k)
+      {
+        aabbMin[k] = std::min(aabbMin[k], position[k]);
+        aabbMax[k] = std::max(aabbMax[k], position[k]);
+      }
+    }
+
+    //Points and lines are not triangulated
+    for (uint32_t j(0); j < mesh->mNumFaces; ++j)
+    {
+      if (mesh->mFaces[j].mNumIndices == 3u)
+        occluder.indices_.insert(occluder.indices_.end(), mesh->mFaces[j].mIndices, mesh->mFaces[j].mIndices + 3);
+    }
+
+    if (occluder.indices_.empty())
+      continue;
+
+    for (uint32_t k(0); k < 3; ++k)
+    {
+      sceneMin[k] = std::min(sceneMin[k], aabbMin[k]);
+      sceneMax[k] = std::max(sceneMax[k], aabbMax[k]);
+    }
+
+    scene->triangleCount_ += (uint32_t)occluder.indices_.size() / 3u;
+    scene->occluders_.push_back(occluder);
+    scene->aabbMin_.push_back(aabbMin);
+    scene->aabbMax_.push_back(aabbMax);
+  }
+
+  if (scene->occluders_.empty())
+    return false;
+
+  vec3 size = sceneMax - sceneMin;
+  vec3 center = (sceneMin + sceneMax) * 0.5f;
+  uint32_t axis = size.x >= size.z ? 0u : 2u;
+  vec3 eye = center;
+  eye[axis] = sceneMin[axis] + 0.25f * size[axis];
+  eye.y = sceneMin.y + 0.1f * size.y;
+  vec3 target = eye;
+  target[axis] = sceneMax[axis];
+  float diagonal = length(size);
+  scene->viewProjection_ = lookAtMatrix(eye, target, vec3(0.0f, 1.0f, 0.0f)) * perspectiveProjectionMatrix(1.2f, 2.0f, 0.001f * diagonal, 2.0f * diagonal);
+  return true;
+}
+
+static void occlusionSceneBegin(const occlusion_scene_t& scene, occlusion::depth_buffer_t* depthBuffer)
+{
+  occlusion::begin(scene.viewProjection_, depthBuffer);
+  for (uint32_t j(0); j < scene.occluders_.size(); ++j)
+    occlusion::addOccluder(scene.occluders_[j], mat4(), depthBuffer);
+}
+
+//Time per frame of transforming, clipping and binning the occluders
+static void occlusionAddOccluders(state_t& state, uint32_t)
+{
+  occlusion::depth_buffer_t depthBuffer;
+  occlusion::depthBufferCreate(256u, 128u, &depthBuffer);
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    occlusionSceneBegin(gOcclusionScene, &depthBuffer);
+    state.stop();
+    doNotOptimize(depthBuffer.triangles_.size());
+  }
+}
+
+//Time per frame. Tiles are rasterized again every iteration from the same bins
+template <uint32_t THREAD_COUNT>
+static void occlusionRasterize(state_t& state, uint32_t)
+{
+  occlusion::depth_buffer_t depthBuffer;
+  occlusion::depthBufferCreate(256u, 128u, &depthBuffer);
+  occlusionSceneBegin(gOcclusionScene, &depthBuffer);
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    state.start();
+    occlusion::rasterize(&depthBuffer, THREAD_COUNT);
+    state.stop();
+    doNotOptimize(depthBuffer.depth_[0]);
+  }
+}
+
+//Time per box
+static void occlusionIsVisible(state_t& state, uint32_t)
+{
+  occlusion::depth_buffer_t depthBuffer;
+  occlusion::depthBufferCreate(256u, 128u, &depthBuffer);
+  occlusionSceneBegin(gOcclusionScene, &depthBuffer);
+  occlusion::rasterize(&depthBuffer);
+
+  const occlusion_scene_t& scene = gOcclusionScene;
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    uint32_t visibleCount = 0u;
+    state.start();
+    for (uint32_t j(0); j < scene.occluders_.size(); ++j)
+      visibleCount += occlusion::isVisible(scene.aabbMin_[j], scene.aabbMax_[j], mat4(), depthBuffer) ? 1u : 0u;
+    state.stop();
+    doNotOptimize(visibleCount);
+  }
+}
+
+//render::radixSort. Sorts the first elements of the buffers, as when sorting an alive list, with the original index as value.
+//Every fourth key is small so there are plenty of duplicates
+static bool radixSortCheck()
+{
+  const uint32_t maxCount = 100000u;
+  const uint32_t count = maxCount - 1234u;
+  std::vector<uint32_t> keys(maxCount);
+  std::vector<uint32_t> values(maxCount);
+  for (uint32_t j(0); j < maxCount; ++j)
+  {
+    keys[j] = (j % 4u == 0u) ? random32() % 64u : random32();
+    values[j] = j;
+  }
+
+  render::gpu_buffer_t elementCountBuffer, keyBuffer, valueBuffer;
+  storageBufferCreate(&count, sizeof(uint32_t), &elementCountBuffer);
+  storageBufferCreate(keys.data(), sizeof(uint32_t) * maxCount, &keyBuffer);
+  storageBufferCreate(values.data(), sizeof(uint32_t) * maxCount, &valueBuffer);
+
+  render::radix_sort_t sort;
+  render::radixSortCreate(gpuContext(), render::radix_sort_t::KEY_32BIT, maxCount, elementCountBuffer, keyBuffer, valueBuffer, &sort);
+  render::command_buffer_t commandBuffer = {};
+  computeBegin(render::command_buffer_t::COMPUTE, &commandBuffer);
+  render::radixSort(commandBuffer, sort);
+  computeSubmit(&commandBuffer);
+
+  std::vector<uint32_t> sortedKeys(maxCount);
+  std::vector<uint32_t> sortedValues(maxCount);
+  storageBufferRead(keyBuffer, sortedKeys.data(), sizeof(uint32_t) * maxCount);
+  storageBufferRead(valueBuffer, sortedValues.data(), sizeof(uint32_t) * maxCount);
+  render::radixSortDestroy(gpuContext(), &sort);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &keyBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &valueBuffer);
+
+  std::vector<uint32_t> expected(keys.begin(), keys.begin() + count);
+  std::sort(expected.begin(), expected.end());
+  std::vector<bool> seen(count, false);
+  for (uint32_t j(0); j < count; ++j)
+  {
+    if (sortedKeys[j] != expected[j])
+    {
+      fprintf(stderr, "render::radixSort: key %u is %u, std::sort gives %u\n", j, sortedKeys[j], expected[j]);
+      return false;
+    }
+
+    //Values move with their keys
+    uint32_t value = sortedValues[j];
+    if (value >= count || seen[value] || keys[value] != sortedKeys[j])
+    {
+      fprintf(stderr, "render::radixSort: value %u does not belong to key %u\n", value, sortedKeys[j]);
+      return false;
+    }
+    seen[value] = true;
+  }
+
+  //Elements past the element count are not touched
+  for (uint32_t j(count); j < maxCount; ++j)
+  {
+    if (sortedKeys[j] != keys[j] || sortedValues[j] != values[j])
+    {
+      fprintf(stderr, "render::radixSort: element %u is past the element count but was modified\n", j);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//render::radixSort with 32 and 64-bit keys. The sort is stable, so keys and values have to match std::stable_sort exactly
+template <render::radix_sort_t::key_size KEY_SIZE>
+static bool radixSortStableCheck()
+{
+  const uint32_t count = 50000u;
+  std::vector<uint32_t> keys(count * KEY_SIZE);
+  std::vector<uint32_t> values(count);
+  for (uint32_t j(0); j < count; ++j)
+  {
+    //Few distinct keys with the high word used, so stability and the high word passes are both tested
+    for (uint32_t k(0); k < KEY_SIZE; ++k)
+      keys[j * KEY_SIZE + k] = random32() % 512u;
+    values[j] = j;
+  }
+
+  render::gpu_buffer_t elementCountBuffer, keyBuffer, valueBuffer;
+  storageBufferCreate(&count, sizeof(uint32_t), &elementCountBuffer);
+  storageBufferCreate(keys.data(), sizeof(uint32_t) * keys.size(), &keyBuffer);
+  storageBufferCreate(values.data(), sizeof(uint32_t) * count, &valueBuffer);
+
+  render::radix_sort_t sort;
+  render::radixSortCreate(gpuContext(), KEY_SIZE, count, elementCountBuffer, keyBuffer, valueBuffer, &sort);
+  render::command_buffer_t commandBuffer = {};
+  computeBegin(render::command_buffer_t::COMPUTE, &commandBuffer);
+  render::radixSort(commandBuffer, sort);
+  computeSubmit(&commandBuffer);
+
+  std::vector<uint32_t> sortedKeys(keys.size());
+  std::vector<uint32_t> sortedValues(count);
+  storageBufferRead(keyBuffer, sortedKeys.data(), sizeof(uint32_t) * keys.size());
+  storageBufferRead(valueBuffer, sortedValues.data(), sizeof(uint32_t) * count);
+  render::radixSortDestroy(gpuContext(), &sort);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &keyBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &valueBuffer);
+
+  //Low word first
+  std::vector<uint64_t> expectedKeys(count);
+  for (uint32_t j(0); j < count; ++j)
+    expectedKeys[j] = KEY_SIZE == render::radix_sort_t::KEY_64BIT ? ((uint64_t)keys[j * 2 + 1] << 32) | keys[j * 2] : keys[j];
+
+  std::vector<uint32_t> expectedValues(values);
+  std::stable_sort(expectedValues.begin(), expectedValues.end(), [&expectedKeys](uint32_t a, uint32_t b) { return expectedKeys[a] < expectedKeys[b]; });
+  for (uint32_t j(0); j < count; ++j)
+  {
+    bool keyMatches = true;
+    for (uint32_t k(0); k < KEY_SIZE; ++k)
+      keyMatches = keyMatches && sortedKeys[j * KEY_SIZE + k] == keys[expectedValues[j] * KEY_SIZE + k];
+
+    if (!keyMatches || sortedValues[j] != expectedValues[j])
+    {
+      fprintf(stderr, "render::radixSort %u-bit: element %u has value %u, std::stable_sort gives %u\n", 32u * KEY_SIZE, j, sortedValues[j], expectedValues[j]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//render::prefixSum. The element count is not a multiple of the elements per workgroup.
+//The exclusive scan writes to another buffer and the inclusive one works in place
+static bool prefixSumCheck()
+{
+  const uint32_t count = 300000u - 77u;
+  std::vector<uint32_t> input(count);
+  for (uint32_t j(0); j < count; ++j)
+    input[j] = random32() % 16u;
+
+  render::gpu_buffer_t elementCountBuffer, inputBuffer, exclusiveBuffer;
+  storageBufferCreate(&count, sizeof(uint32_t), &elementCountBuffer);
+  storageBufferCreate(input.data(), sizeof(uint32_t) * count, &inputBuffer);
+  storageBufferCreate(nullptr, sizeof(uint32_t) * count, &exclusiveBuffer);
+
+  render::prefix_sum_t exclusiveSum, inclusiveSum;
+  render::prefixSumCreate(gpuContext(), render::prefix_sum_t::EXCLUSIVE, count, elementCountBuffer, inputBuffer, exclusiveBuffer, &exclusiveSum);
+  render::prefixSumCreate(gpuContext(), render::prefix_sum_t::INCLUSIVE, count, elementCountBuffer, inputBuffer, inputBuffer, &inclusiveSum);
+  render::command_buffer_t commandBuffer = {};
+  computeBegin(render::command_buffer_t::COMPUTE, &commandBuffer);
+  render::prefixSum(commandBuffer, exclusiveSum);
+  render::prefixSum(commandBuffer, inclusiveSum);
+  computeSubmit(&commandBuffer);
+
+  std::vector<uint32_t> exclusive(count);
+  std::vector<uint32_t> inclusive(count);
+  storageBufferRead(exclusiveBuffer, exclusive.data(), sizeof(uint32_t) * count);
+  storageBufferRead(inputBuffer, inclusive.data(), sizeof(uint32_t) * count);
+  render::prefixSumDestroy(gpuContext(), &exclusiveSum);
+  render::prefixSumDestroy(gpuContext(), &inclusiveSum);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &inputBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &exclusiveBuffer);
+
+  //std::exclusive_scan needs C++17. The exclusive scan is the inclusive one shifted by one element
+  std::vector<uint32_t> expected(count);
+  std::partial_sum(input.begin(), input.end(), expected.begin());
+  for (uint32_t j(0); j < count; ++j)
+  {
+    uint32_t expectedExclusive = j > 0u ? expected[j - 1] : 0u;
+    if (exclusive[j] != expectedExclusive || inclusive[j] != expected[j])
+    {
+      fprintf(stderr, "render::prefixSum: element %u is %u (exclusive) and %u (inclusive), expected %u and %u\n", j, exclusive[j], inclusive[j], expectedExclusive, expected[j]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//render::streamCompaction. Any non zero flag keeps the element
+static bool streamCompactionCheck()
+{
+  const uint32_t count = 200000u - 33u;
+  std::vector<uint32_t> input(count);
+  std::vector<uint32_t> flags(count);
+  for (uint32_t j(0); j < count; ++j)
+  {
+    input[j] = random32();
+    flags[j] = (random32() % 3u == 0u) ? random32() | 1u : 0u;
+  }
+
+  const uint32_t garbage = 0xFFFFFFFFu;
+  render::gpu_buffer_t elementCountBuffer, inputBuffer, flagsBuffer, outputBuffer, outputCountBuffer;
+  storageBufferCreate(&count, sizeof(uint32_t), &elementCountBuffer);
+  storageBufferCreate(input.data(), sizeof(uint32_t) * count, &inputBuffer);
+  storageBufferCreate(flags.data(), sizeof(uint32_t) * count, &flagsBuffer);
+  storageBufferCreate(nullptr, sizeof(uint32_t) * count, &outputBuffer);
+  storageBufferCreate(&garbage, sizeof(uint32_t), &outputCountBuffer);
+
+  render::stream_compaction_t compaction;
+  render::streamCompactionCreate(gpuContext(), count, elementCountBuffer, inputBuffer, flagsBuffer, outputBuffer, outputCountBuffer, &compaction);
+  render::command_buffer_t commandBuffer = {};
+  computeBegin(render::command_buffer_t::COMPUTE, &commandBuffer);
+  render::streamCompaction(commandBuffer, compaction);
+  computeSubmit(&commandBuffer);
+
+  uint32_t outputCount = 0u;
+  std::vector<uint32_t> output(count);
+  storageBufferRead(outputCountBuffer, &outputCount, sizeof(uint32_t));
+  storageBufferRead(outputBuffer, output.data(), sizeof(uint32_t) * count);
+  render::streamCompactionDestroy(gpuContext(), &compaction);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &inputBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &flagsBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &outputBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &outputCountBuffer);
+
+  //Indices of the elements kept
+  std::vector<uint32_t> indices(count);
+  std::iota(indices.begin(), indices.end(), 0u);
+  std::vector<uint32_t> expected;
+  std::copy_if(indices.begin(), indices.end(), std::back_inserter(expected), [&flags](uint32_t index) { return flags[index] != 0u; });
+  if (outputCount != expected.size())
+  {
+    fprintf(stderr, "render::streamCompaction: %u elements kept, std::copy_if keeps %u\n", outputCount, (uint32_t)expected.size());
+    return false;
+  }
+
+  for (uint32_t j(0); j < outputCount; ++j)
+  {
+    if (output[j] != input[expected[j]])
+    {
+      fprintf(stderr, "render::streamCompaction: element %u is %u, std::copy_if gives %u\n", j, output[j], input[expected[j]]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//render::histogram. Some values are past the last bin and the histogram buffer starts with garbage, which the primitive clears
+static bool histogramCheck()
+{
+  const uint32_t count = 250000u - 5u;
+  const uint32_t binCount = 100u;
+  std::vector<uint32_t> input(count);
+  for (uint32_t j(0); j < count; ++j)
+    input[j] = random32() % 128u;
+
+  std::vector<uint32_t> bins(binCount, 0xFFFFFFFFu);
+  render::gpu_buffer_t elementCountBuffer, inputBuffer, histogramBuffer;
+  storageBufferCreate(&count, sizeof(uint32_t), &elementCountBuffer);
+  storageBufferCreate(input.data(), sizeof(uint32_t) * count, &inputBuffer);
+  storageBufferCreate(bins.data(), sizeof(uint32_t) * binCount, &histogramBuffer);
+
+  render::histogram_t histogram;
+  render::histogramCreate(gpuContext(), binCount, count, elementCountBuffer, inputBuffer, histogramBuffer, &histogram);
+  render::command_buffer_t commandBuffer = {};
+  computeBegin(render::command_buffer_t::COMPUTE, &commandBuffer);
+  render::histogram(commandBuffer, histogram);
+  computeSubmit(&commandBuffer);
+
+  storageBufferRead(histogramBuffer, bins.data(), sizeof(uint32_t) * binCount);
+  render::histogramDestroy(gpuContext(), &histogram);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &inputBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &histogramBuffer);
+
+  std::vector<uint32_t> expected(binCount, 0u);
+  for (uint32_t j(0); j < count; ++j)
+    expected[std::min(input[j], binCount - 1)]++;
+
+  for (uint32_t j(0); j < binCount; ++j)
+  {
+    if (bins[j] != expected[j])
+    {
+      fprintf(stderr, "render::histogram: bin %u has %u elements, expected %u\n", j, bins[j], expected[j]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//GPU primitives throughput. Buffers are device local
+static void gpuPrefixSum(state_t& state, uint32_t size)
+{
+  std::vector<uint32_t> input(size);
+  for (uint32_t j(0); j < size; ++j)
+    input[j] = random32() % 16u;
+
+  render::gpu_buffer_t elementCountBuffer, inputBuffer, outputBuffer;
+  deviceBufferCreate(&size, sizeof(uint32_t), &elementCountBuffer);
+  deviceBufferCreate(input.data(), sizeof(uint32_t) * size, &inputBuffer);
+  deviceBufferCreate(input.data(), sizeof(uint32_t) * size, &outputBuffer);
+
+  render::prefix_sum_t prefixSum;
+  render::prefixSumCreate(gpuContext(), render::prefix_sum_t::EXCLUSIVE, size, elementCountBuffer, inputBuffer, outputBuffer, &prefixSum);
+  gpuBenchmark(state, [](render::command_buffer_t) {}, [&prefixSum](render::command_buffer_t commandBuffer) { render::prefixSum(commandBuffer, prefixSum); });
+
+  render::prefixSumDestroy(gpuContext(), &prefixSum);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &inputBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &outputBuffer);
+}
+
+static void gpuStreamCompaction(state_t& state, uint32_t size)
+{
+  std::vector<uint32_t> input(size);
+  std::vector<uint32_t> flags(size);
+  for (uint32_t j(0); j < size; ++j)
+  {
+    input[j] = random32();
+    flags[j] = random32() & 1u;
+  }
+
+  render::gpu_buffer_t elementCountBuffer, inputBuffer, flagsBuffer, outputBuffer, outputCountBuffer;
+  deviceBufferCreate(&size, sizeof(uint32_t), &elementCountBuffer);
+  deviceBufferCreate(input.data(), sizeof(uint32_t) * size, &inputBuffer);
+  deviceBufferCreate(flags.data(), sizeof(uint32_t) * size, &flagsBuffer);
+  deviceBufferCreate(input.data(), sizeof(uint32_t) * size, &outputBuffer);
+  deviceBufferCreate(&size, sizeof(uint32_t), &outputCountBuffer);
+
+  render::stream_compaction_t compaction;
+  render::streamCompactionCreate(gpuContext(), size, elementCountBuffer, inputBuffer, flagsBuffer, outputBuffer, outputCountBuffer, &compaction);
+  gpuBenchmark(state, [](render::command_buffer_t) {}, [&compaction](render::command_buffer_t commandBuffer) { render::streamCompaction(commandBuffer, compaction); });
+
+  render::streamCompactionDestroy(gpuContext(), &compaction);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &inputBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &flagsBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &outputBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &outputCountBuffer);
+}
+
+//Keys and values are restored before every sort, so each iteration sorts random keys
+template <render::radix_sort_t::key_size KEY_SIZE>
+static void gpuRadixSort(state_t& state, uint32_t size)
+{
+  std::vector<uint32_t> keys(size * KEY_SIZE);
+  std::vector<uint32_t> values(size);
+  for (uint32_t j(0); j < size; ++j)
+  {
+    for (uint32_t k(0); k < KEY_SIZE; ++k)
+      keys[j * KEY_SIZE + k] = random32();
+    values[j] = j;
+  }
+
+  render::gpu_buffer_t elementCountBuffer, initialKeys, initialValues, keyBuffer, valueBuffer;
+  deviceBufferCreate(&size, sizeof(uint32_t), &elementCountBuffer);
+  deviceBufferCreate(keys.data(), sizeof(uint32_t) * keys.size(), &initialKeys);
+  deviceBufferCreate(values.data(), sizeof(uint32_t) * size, &initialValues);
+  deviceBufferCreate(keys.data(), sizeof(uint32_t) * keys.size(), &keyBuffer);
+  deviceBufferCreate(values.data(), sizeof(uint32_t) * size, &valueBuffer);
+
+  render::radix_sort_t sort;
+  render::radixSortCreate(gpuContext(), KEY_SIZE, size, elementCountBuffer, keyBuffer, valueBuffer, &sort);
+  gpuBenchmark(state,
+    [&](render::command_buffer_t commandBuffer)
+    {
+      bufferCopy(commandBuffer, initialKeys, keyBuffer, sizeof(uint32_t) * keys.size());
+      bufferCopy(commandBuffer, initialValues, valueBuffer, sizeof(uint32_t) * size);
+    },
+    [&sort](render::command_buffer_t commandBuffer) { render::radixSort(commandBuffer, sort); });
+
+  render::radixSortDestroy(gpuContext(), &sort);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &initialKeys);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &initialValues);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &keyBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &valueBuffer);
+}
+
+static void gpuHistogram(state_t& state, uint32_t size)
+{
+  const uint32_t binCount = 256u;
+  std::vector<uint32_t> input(size);
+  for (uint32_t j(0); j < size; ++j)
+    input[j] = random32() % binCount;
+
+  std::vector<uint32_t> bins(binCount, 0u);
+  render::gpu_buffer_t elementCountBuffer, inputBuffer, histogramBuffer;
+  deviceBufferCreate(&size, sizeof(uint32_t), &elementCountBuffer);
+  deviceBufferCreate(input.data(), sizeof(uint32_t) * size, &inputBuffer);
+  deviceBufferCreate(bins.data(), sizeof(uint32_t) * binCount, &histogramBuffer);
+
+  render::histogram_t histogram;
+  render::histogramCreate(gpuContext(), binCount, size, elementCountBuffer, inputBuffer, histogramBuffer, &histogram);
+  gpuBenchmark(state, [](render::command_buffer_t) {}, [&histogram](render::command_buffer_t commandBuffer) { render::histogram(commandBuffer, histogram); });
+
+  render::histogramDestroy(gpuContext(), &histogram);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &elementCountBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &inputBuffer);
+  render::gpuBufferDestroy(gpuContext(), nullptr, &histogramBuffer);
+}
+
+//image::load
+static void imageLoad(state_t& state, uint32_t)
+{
+  for (uint64_t i(0); i < state.iterations_; ++i)
+  {
+    image::image2D_t image = {};
+    state.start();
+    bool loaded = image::load(gImageFile.c_str(), false, &image);
+    state.stop();
+    doNotOptimize(loaded);
+    image::unload(&image);
+  }
+}
+
+static bool createTestImage(const char* file)
+{
+  const uint32_t size = 512u;
+  std::vector<uint8_t> data(size * size * 4u);
+  for (uint32_t y(0); y < size; ++y)
+  {
+    for (uint32_t x(0); x < size; ++x)
+    {
+      uint8_t* pixel = &data[(y * size + x) * 4u];
+      pixel[0] = (uint8_t)x;
+      pixel[1] = (uint8_t)y;
+      pixel[2] = (uint8_t)(random32() & 0x3F);
+      pixel[3] = 255u;
+    }
+  }
+
+  image::image2D_t image = { size, size, 4u, 1u, (uint32_t)data.size(), data.data() };
+  return image::save(file, image);
+}
+
+
+static result_t run(const benchmark_t& benchmark, uint32_t repetitions, double minTime)
+{
+  //Find the number of iterations needed to run for minTime
+  state_t state = {};
+  state.iterations_ = 1u;
+  while (true)
+  {
+    gRandomState = 1u;
+    state.elapsed_ = 0.0;
+    benchmark.function_(state, benchmark.size_);
+    if (state.elapsed_ >= minTime || state.iterations_ >= (1ull << 40))
+      break;
+
+    //Aim a bit over minTime, growing at most 10x per step
+    double factor = state.elapsed_ > 0.0 ? 1.2 * minTime / state.elapsed_ : 10.0;
+    state.iterations_ = (uint64_t)(state.iterations_ * std::min(std::max(factor, 1.5), 10.0));
+  }
+
+  std::vector<double> times(repetitions);
+  for (uint32_t i(0); i < repetitions; ++i)
+  {
+    gRandomState = 1u;
+    state.elapsed_ = 0.0;
+    benchmark.function_(state, benchmark.size_);
+    times[i] = state.elapsed_ * 1000000.0 / (double(state.iterations_) * benchmark.itemCount_);
+  }
+
+  std::sort(times.begin(), times.end());
+  result_t result;
+  result.name_ = benchmark.name_;
+  result.median_ = times[repetitions / 2];
+  result.min_ = times[0];
+  result.iterations_ = state.iterations_;
+
+  std::vector<double> deviations(repetitions);
+  for (uint32_t i(0); i < repetitions; ++i)
+    deviations[i] = fabs(times[i] - result.median_);
+  std::sort(deviations.begin(), deviations.end());
+  result.spread_ = result.median_ > 0.0 ? 100.0 * deviations[repetitions / 2] / result.median_ : 0.0;
+  return result;
+}
+
+static void addCheck(const char* name, check_function_t function, std::vector<check_t>* checks)
+{
+  checks->push_back({ name, function });
+}
+
+static void addBenchmark(const char* name, benchmark_function_t function, uint32_t size, uint32_t itemCount, std::vector<benchmark_t>* benchmarks)
+{
+  //The size is part of the name of benchmarks with several sizes
+  char fullName[128];
+  if (size > 0u)
+    snprintf(fullName, sizeof(fullName), "%s/%u", name, size);
+  else
+    snprintf(fullName, sizeof(fullName), "%s", name);
+  benchmarks->push_back({ fullName, function, size, itemCount });
+}
+
+int main(int argc, char** argv)
+{
+  const char* filter = nullptr;
+  const char* jsonFile = nullptr;
+  bool gpu = true;
+  uint32_t repetitions = 10u;
+  double minTime = 10.0;
+  for (int i(1); i < argc; ++i)
+  {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--no-gpu") == 0)
+      gpu = false;
+    else if (hasValue && strcmp(argv[i], "--filter") == 0)
+      filter = argv[++i];
+    else if (hasValue && strcmp(argv[i], "--repetitions") == 0)
+      repetitions = std::max(1u, (uint32_t)atoi(argv[++i]));
+    else if (hasValue && strcmp(argv[i], "--min-time") == 0)
+      minTime = atof(argv[++i]);
+    else if (hasValue && strcmp(argv[i], "--json") == 0)
+      jsonFile = argv[++i];
+    else if (hasValue && strcmp(argv[i], "--image") == 0)
+      gImageFile = argv[++i];
+    else if (hasValue && strcmp(argv[i], "--occluders") == 0)
+      gOccluderFile = argv[++i];
+    else
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+  }
+
+  if (gpu && !vulkanDeviceAvailable())
+  {
+    fprintf(stderr, "No Vulkan device with graphics and compute queues, GPU checks and benchmarks skipped\n");
+    gpu = false;
+  }
+
+  std::vector<check_t> checks;
+  addCheck("occlusion::rasterize", occlusionRasterizeCheck, &checks);
+  addCheck("occlusion::isVisible", occlusionIsVisibleCheck, &checks);
+  if (gpu)
+  {
+    addCheck("render::radixSort", radixSortCheck, &checks);
+    addCheck("render::radixSort 32-bit stable", radixSortStableCheck<render::radix_sort_t::KEY_32BIT>, &checks);
+    addCheck("render::radixSort 64-bit stable", radixSortStableCheck<render::radix_sort_t::KEY_64BIT>, &checks);
+    addCheck("render::prefixSum", prefixSumCheck, &checks);
+    addCheck("render::streamCompaction", streamCompactionCheck, &checks);
+    addCheck("render::histogram", histogramCheck, &checks);
+  }
+
+  bool checksPassed = true;
+  for (uint32_t i(0); i < checks.size(); ++i)
+  {
+    if (filter && checks[i].name_.find(filter) == std::string::npos)
+      continue;
+
+    gRandomState = 1u;
+    bool passed = checks[i].function_();
+    printf("Check %-40s %s\n", checks[i].name_.c_str(), passed ? "passed" : "FAILED");
+    fflush(stdout);
+    checksPassed = checksPassed && passed;
+  }
+
+  std::vector<benchmark_t> benchmarks;
+  for (uint32_t size : { 1000u, 10000u })
+  {
+    addBenchmark("packed_freelist_t::add", packedFreelistAdd, size, size, &benchmarks);
+    addBenchmark("packed_freelist_t::remove", packedFreelistRemove, size, size, &benchmarks);
+    addBenchmark("packed_freelist_t::get", packedFreelistGet, size, size, &benchmarks);
+    addBenchmark("packed_freelist_t::iterate", packedFreelistIterate, size, size, &benchmarks);
+  }
+
+  for (uint32_t size : { 16u, 256u, 4096u })
+    addBenchmark("hash_table_t::get", hashTableGet, size, size, &benchmarks);
+
+  for (uint32_t size : { 1000u, 100000u })
+  {
+    addBenchmark("dynamic_array_t::push_back", dynamicArrayPush, size, size, &benchmarks);
+    addBenchmark("dynamic_array_t::sort", dynamicArraySort, size, size, &benchmarks);
+  }
+
+  addBenchmark("maths::mat4 multiply", mat4Multiply, 1024u, 1024u, &benchmarks);
+  addBenchmark("maths::invertMatrix", mat4Invert, 1024u, 1024u, &benchmarks);
+  addBenchmark("maths::invertTransform", mat4InvertTransform, 1024u, 1024u, &benchmarks);
+  addBenchmark("maths::slerp", quatSlerp, 1024u, 1024u, &benchmarks);
+
+  for (uint32_t size : { 100u, 10000u })
+  {
+    addBenchmark("transform_manager_t::update flat", transformManagerUpdate<HIERARCHY_FLAT>, size, size, &benchmarks);
+    addBenchmark("transform_manager_t::update chain", transformManagerUpdate<HIERARCHY_CHAIN>, size, size, &benchmarks);
+    addBenchmark("transform_manager_t::update tree", transformManagerUpdate<HIERARCHY_TREE>, size, size, &benchmarks);
+    addBenchmark("transform_manager_t::update shuffled", transformManagerUpdate<HIERARCHY_SHUFFLED>, size, size, &benchmarks);
+    addBenchmark("transform_manager_t::update reparented", transformManagerUpdateAndSort, size, size, &benchmarks);
+  }
+
+  for (uint32_t size : { 32u, 128u })
+    addBenchmark("mesh::animatorSample", animatorSample, size, size, &benchmarks);
+
+  const char* occlusionBenchmarks[] = { "occlusion::addOccluder", "occlusion::rasterize", "occlusion::rasterize single thread", "occlusion::isVisible" };
+  bool occlusionSelected = false;
+  for (const char* name : occlusionBenchmarks)
+    occlusionSelected = occlusionSelected || !filter || strstr(name, filter);
+
+  if (occlusionSelected)
+  {
+    if (loadOcclusionScene(gOccluderFile.c_str(), &gOcclusionScene))
+    {
+      printf("Occlusion scene %s: %u occluders, %u triangles\n", gOccluderFile.c_str(), (uint32_t)gOcclusionScene.occluders_.size(), gOcclusionScene.triangleCount_);
+      addBenchmark(occlusionBenchmarks[0], occlusionAddOccluders, 0u, 1u, &benchmarks);
+      addBenchmark(occlusionBenchmarks[1], occlusionRasterize<0u>, 0u, 1u, &benchmarks);
+      addBenchmark(occlusionBenchmarks[2], occlusionRasterize<1u>, 0u, 1u, &benchmarks);
+      addBenchmark(occlusionBenchmarks[3], occlusionIsVisible, 0u, (uint32_t)gOcclusionScene.occluders_.size(), &benchmarks);
+    }
+    else
+    {
+      fprintf(stderr, "Unable to load %s, occlusion benchmarks skipped\n", gOccluderFile.c_str());
+    }
+  }
+
+  if (gpu)
+  {
+    for (uint32_t size : { 65536u, 1048576u })
+    {
+      addBenchmark("render::prefixSum", gpuPrefixSum, size, size, &benchmarks);
+      addBenchmark("render::streamCompaction", gpuStreamCompaction, size, size, &benchmarks);
+      addBenchmark("render::radixSort 32-bit", gpuRadixSort<render::radix_sort_t::KEY_32BIT>, size, size, &benchmarks);
+      addBenchmark("render::radixSort 64-bit", gpuRadixSort<render::radix_sort_t::KEY_64BIT>, size, size, &benchmarks);
+      addBenchmark("render::histogram", gpuHistogram, size, size, &benchmarks);
+    }
+  }
+
+  //Time per image
+  std::string generatedImage;
+  if (!filter || strstr("image::load", filter))
+  {
+    if (gImageFile.empty())
+    {
+      generatedImage = "bkk-microbench.png";
+      if (createTestImage(generatedImage.c_str()))
+        gImageFile = generatedImage;
+      else
+        fprintf(stderr, "Unable to create the test image\n");
+    }
+
+    if (!gImageFile.empty())
+      addBenchmark("image::load", imageLoad, 0u, 1u, &benchmarks);
+  }
+
+  printf("%-46s %14s %14s %8s %12s\n", "Benchmark", "Median ns/item", "Min ns/item", "Spread", "Iterations");
+  std::vector<result_t> results;
+  for (uint32_t i(0); i < benchmarks.size(); ++i)
+  {
+    if (filter && benchmarks[i].name_.find(filter) == std::string::npos)
+      continue;
+
+    result_t result = run(benchmarks[i], repetitions, minTime);
+    printf("%-46s %14.3f %14.3f %7.1f%% %12llu\n", result.name_.c_str(), result.median_, result.min_, result.spread_, (unsigned long long)result.iterations_);
+    fflush(stdout);
+    results.push_back(result);
+  }
+
+  if (!generatedImage.empty())
+    remove(generatedImage.c_str());
+
+  if (gContextCreated)
+    render::contextDestroy(&gContext);
+
+  if (jsonFile)
+  {
+    FILE* file = fopen(jsonFile, "w");
+    if (!file)
+    {
+      fprintf(stderr, "Unable to write %s\n", jsonFile);
+      return 1;
+    }
+
+    fprintf(file, "{\n");
+    for (uint32_t i(0); i < results.size(); ++i)
+    {
+      fprintf(file, "  \"%s\": { \"median\": %.4f, \"min\": %.4f, \"spread\": %.2f, \"iterations\": %llu }%s\n", results[i].name_.c_str(),
+              results[i].median_, results[i].min_, results[i].spread_, (unsigned long long)results[i].iterations_, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "}\n");
+    fclose(file);
+  }
+
+  return checksPassed ? 0 : 1;
+}
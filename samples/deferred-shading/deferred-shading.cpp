@@ -81,23 +81,45 @@ static const char* gGeometryPassFragmentShaderSource = R"(
   }material;
 
   layout(location = 0) out vec4 RT0;
-  layout(location = 1) out vec4 RT1;
+  layout(location = 1) out vec2 RT1;
   layout(location = 2) out vec4 RT2;
 
   layout(location = 0) in vec3 normalViewSpace;
 
+  //Octahedral normal encoding
+  vec2 OctWrap(vec2 v)
+  {
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+  }
+
+  vec2 EncodeNormal(vec3 n)
+  {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+  }
+
   void main(void)
   {
-    RT0 = vec4(material.albedo, material.roughness);
-    RT1 = vec4(normalize(normalViewSpace), gl_FragCoord.z );
-    RT2 = vec4(material.F0, material.metallic);
+    RT0 = vec4(material.albedo, material.metallic);
+    RT1 = EncodeNormal(normalize(normalViewSpace));
+    RT2 = vec4(material.F0, material.roughness);
   }
 )";
 
-static const char* gLightPassVertexShaderSource = R"(
+//Assigns lights to clusters. Screen is divided in tiles of TILE_SIZE pixels and SLICE_COUNT exponential depth slices.
+//Each work group tests all the lights against the view space bounding box of one cluster
+static const char* gLightBinningComputeShaderSource = R"(
   #version 440 core
+  #define LIGHTS_SET 1
+  #define CLUSTER_ACCESS writeonly
 
-  layout(location = 0) in vec3 aPosition;
+  layout(local_size_x = 64) in;
+
+  layout(constant_id = 0) const uint TILE_SIZE = 64;
+  layout(constant_id = 1) const uint SLICE_COUNT = 24;
+  layout(constant_id = 2) const uint MAX_LIGHTS_PER_CLUSTER = 256;
+  layout(constant_id = 3) const float Z_NEAR = 0.1;
+  layout(constant_id = 4) const float Z_FAR = 100.0;
 
   layout(set = 0, binding = 0) uniform SCENE
   {
@@ -107,28 +129,114 @@ static const char* gLightPassVertexShaderSource = R"(
     vec4 imageSize;
   }scene;
 
-  layout (set = 2, binding = 0) uniform LIGHT
+  struct Light
   {
     vec4 position;
     vec3 color;
     float radius;
-  }light;
+  };
+
+  layout(std430, set = LIGHTS_SET, binding = 0) readonly buffer LIGHTS
+  {
+    uint count;
+    Light data[];
+  }lights;
 
-  layout(location = 0) out vec3 lightPositionVS;
+  layout(std430, set = LIGHTS_SET, binding = 1) CLUSTER_ACCESS buffer CLUSTER_LIGHT_COUNT
+  {
+    uint data[];
+  }clusterLightCount;
+
+  layout(std430, set = LIGHTS_SET, binding = 2) CLUSTER_ACCESS buffer CLUSTER_LIGHT_INDEX
+  {
+    uint data[];
+  }clusterLightIndex;
+
+  uvec2 ClusterCount()
+  {
+    return (uvec2(scene.imageSize.xy) + TILE_SIZE - 1u) / TILE_SIZE;
+  }
+
+  shared uint sharedLightCount;
+
+  float SliceDepth(uint slice)
+  {
+    return Z_NEAR * pow(Z_FAR / Z_NEAR, float(slice) / float(SLICE_COUNT));
+  }
+
+  //View space direction through a pixel, scaled so its z is -1
+  vec3 ViewRay(vec2 pixel)
+  {
+    vec4 p = scene.projectionInverse * vec4(pixel * scene.imageSize.zw * 2.0 - 1.0, 1.0, 1.0);
+    p.xyz /= p.w;
+    return p.xyz / -p.z;
+  }
 
   void main(void)
   {
-    mat4 viewProjection = scene.projection * scene.view;
-    vec4 vertexPosition =  vec4( aPosition*light.radius+light.position.xyz, 1.0 );
-    gl_Position = viewProjection * vertexPosition;
-    lightPositionVS = (scene.view * light.position).xyz;
+    if(gl_LocalInvocationIndex == 0)
+      sharedLightCount = 0;
+
+    barrier();
+
+    uvec3 cluster = gl_WorkGroupID;
+    uvec2 clusterCount = ClusterCount();
+    uint clusterIndex = cluster.x + cluster.y * clusterCount.x + cluster.z * clusterCount.x * clusterCount.y;
+
+    //Cluster bounding box in view space
+    vec2 tileMin = vec2(cluster.xy * TILE_SIZE);
+    vec2 tileMax = min(vec2((cluster.xy + 1u) * TILE_SIZE), scene.imageSize.xy);
+    vec3 rays[4] = vec3[](ViewRay(tileMin), ViewRay(vec2(tileMax.x, tileMin.y)), ViewRay(vec2(tileMin.x, tileMax.y)), ViewRay(tileMax));
+    float sliceNear = SliceDepth(cluster.z);
+    float sliceFar = SliceDepth(cluster.z + 1u);
+    vec3 aabbMin = vec3(1e30);
+    vec3 aabbMax = vec3(-1e30);
+    for(int i = 0; i<4; ++i)
+    {
+      aabbMin = min(aabbMin, min(rays[i] * sliceNear, rays[i] * sliceFar));
+      aabbMax = max(aabbMax, max(rays[i] * sliceNear, rays[i] * sliceFar));
+    }
+
+    for(uint i = gl_LocalInvocationIndex; i < lights.count; i += gl_WorkGroupSize.x)
+    {
+      vec3 center = (scene.view * vec4(lights.data[i].position.xyz, 1.0)).xyz;
+      vec3 d = center - clamp(center, aabbMin, aabbMax);
+      float radius = lights.data[i].radius;
+      if(dot(d, d) <= radius * radius)
+      {
+        uint slot = atomicAdd(sharedLightCount, 1u);
+        if(slot < MAX_LIGHTS_PER_CLUSTER)
+          clusterLightIndex.data[clusterIndex * MAX_LIGHTS_PER_CLUSTER + slot] = i;
+      }
+    }
+
+    barrier();
+
+    if(gl_LocalInvocationIndex == 0)
+      clusterLightCount.data[clusterIndex] = min(sharedLightCount, MAX_LIGHTS_PER_CLUSTER);
   }
 )";
 
-
-static const char* gLightPassFragmentShaderSource = R"(
+static const char* gLightPassVertexShaderSource = R"(
   #version 440 core
 
+  layout(location = 0) in vec3 aPosition;
+
+  void main(void)
+  {
+    gl_Position = vec4(aPosition,1.0);
+  }
+)";
+
+//Clustered lighting shared by the light pass and the visibility buffer resolve pass. Each pixel is only lit by the lights
+//assigned to its cluster. The #version and the LIGHTS_SET/CLUSTER_ACCESS defines are prepended by the host code
+static const char* gClusteredShadingSource = R"(
+  layout(constant_id = 0) const uint TILE_SIZE = 64;
+  layout(constant_id = 1) const uint SLICE_COUNT = 24;
+  layout(constant_id = 2) const uint MAX_LIGHTS_PER_CLUSTER = 256;
+  layout(constant_id = 3) const float Z_NEAR = 0.1;
+  layout(constant_id = 4) const float Z_FAR = 100.0;
+
   layout(set = 0, binding = 0) uniform SCENE
   {
     mat4 view;
@@ -137,20 +245,33 @@ static const char* gLightPassFragmentShaderSource = R"(
     vec4 imageSize;
   }scene;
 
-  layout (set = 2, binding = 0) uniform LIGHT
+  struct Light
   {
     vec4 position;
     vec3 color;
     float radius;
-  }light;
+  };
 
-  layout(set = 1, binding = 0) uniform sampler2D RT0;
-  layout(set = 1, binding = 1) uniform sampler2D RT1;
-  layout(set = 1, binding = 2) uniform sampler2D RT2;
+  layout(std430, set = LIGHTS_SET, binding = 0) readonly buffer LIGHTS
+  {
+    uint count;
+    Light data[];
+  }lights;
 
-  layout(location = 0) in vec3 lightPositionVS;
-  
-  layout(location = 0) out vec4 result;
+  layout(std430, set = LIGHTS_SET, binding = 1) CLUSTER_ACCESS buffer CLUSTER_LIGHT_COUNT
+  {
+    uint data[];
+  }clusterLightCount;
+
+  layout(std430, set = LIGHTS_SET, binding = 2) CLUSTER_ACCESS buffer CLUSTER_LIGHT_INDEX
+  {
+    uint data[];
+  }clusterLightIndex;
+
+  uvec2 ClusterCount()
+  {
+    return (uvec2(scene.imageSize.xy) + TILE_SIZE - 1u) / TILE_SIZE;
+  }
 
   const float PI = 3.14159265359;
   vec3 ViewSpacePositionFromDepth(vec2 uv, float depth)
@@ -195,39 +316,209 @@ static const char* gLightPassFragmentShaderSource = R"(
     return ggx1 * ggx2;
   }
 
+  vec3 Shade(vec3 positionVS, vec3 N, vec3 albedo, float metallic, vec3 F0, float roughness)
+  {
+    vec3 V = -normalize(positionVS);
+
+    //Find the cluster
+    uvec2 clusterCount = ClusterCount();
+    uvec2 tile = uvec2(gl_FragCoord.xy) / TILE_SIZE;
+    float slice = floor(log(-positionVS.z / Z_NEAR) / log(Z_FAR / Z_NEAR) * float(SLICE_COUNT));
+    uint clusterIndex = tile.x + tile.y * clusterCount.x + uint(clamp(slice, 0.0, float(SLICE_COUNT - 1))) * clusterCount.x * clusterCount.y;
+
+    vec3 color = vec3(0.0);
+    uint lightCount = clusterLightCount.data[clusterIndex];
+    for(uint i = 0; i<lightCount; ++i)
+    {
+      Light light = lights.data[clusterLightIndex.data[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]];
+      vec3 lightPositionVS = (scene.view * vec4(light.position.xyz, 1.0)).xyz;
+      vec3 L = normalize( lightPositionVS-positionVS );
+      vec3 H = normalize(V + L);
+      vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+      float NDF = DistributionGGX(N, H, roughness);
+      float G = GeometrySmith(N, V, L, roughness);
+      vec3 kS = F;
+      vec3 kD = vec3(1.0) - kS;
+      kD *= 1.0 - metallic;
+      vec3 nominator = NDF * G * F;
+      float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001;
+      vec3 specular = nominator / denominator;
+      float lightDistance    = length(lightPositionVS - positionVS);
+      float attenuation = 1.0 - clamp( lightDistance / light.radius, 0.0, 1.0);
+      attenuation *= attenuation;
+      float NdotL =  max( 0.0, dot( N, L ) );
+      color += (kD * albedo / PI + specular) * (light.color*attenuation) * NdotL;
+    }
+
+    return color;
+  }
+)";
+
+//Full-screen pass. Reads the material and normal from the GBuffer
+static const char* gLightPassFragmentShaderSource = R"(
+  layout(set = 1, binding = 0) uniform sampler2D RT0;
+  layout(set = 1, binding = 1) uniform sampler2D RT1;
+  layout(set = 1, binding = 2) uniform sampler2D RT2;
+  layout(set = 1, binding = 3) uniform sampler2D depthBuffer;
+
+  layout(location = 0) out vec4 result;
+
+  vec3 DecodeNormal(vec2 f)
+  {
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+  }
+
   void main(void)
   {
     vec2 uv = gl_FragCoord.xy * scene.imageSize.zw;
+    float depth = texture(depthBuffer, uv).r;
+    if(depth == 1.0)
+    {
+      //No geometry
+      result = vec4(0.0, 0.0, 0.0, 1.0);
+      return;
+    }
+
     vec4 RT0Value = texture(RT0, uv);
-    vec3 albedo = RT0Value.xyz;
-    float roughness = RT0Value.w;
-    vec4 RT1Value = texture(RT1, uv);
-    vec3 N = normalize(RT1Value.xyz); 
-    float depth = RT1Value.w;
     vec4 RT2Value = texture(RT2, uv);
+    vec3 N = DecodeNormal(texture(RT1, uv).xy);
     vec3 positionVS = ViewSpacePositionFromDepth( uv,depth );
-    vec3 L = normalize( lightPositionVS-positionVS );
-    vec3 F0 = RT2Value.xyz;
-    float metallic = RT2Value.w;
-    vec3 V = -normalize(positionVS);
-    vec3 H = normalize(V + L);
-    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
-    float NDF = DistributionGGX(N, H, roughness);
-    float G = GeometrySmith(N, V, L, roughness);
-    vec3 kS = F;
-    vec3 kD = vec3(1.0) - kS;
-    kD *= 1.0 - metallic;
-    vec3 nominator = NDF * G * F;
-    float denominator = 4 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001;
-    vec3 specular = nominator / denominator;
-    float lightDistance    = length(lightPositionVS - positionVS);
-    float attenuation = 1.0 - clamp( lightDistance / light.radius, 0.0, 1.0);
-    attenuation *= attenuation;
-    float NdotL =  max( 0.0, dot( N, L ) );
-    result = vec4( (kD * albedo / PI + specular) * (light.color*attenuation) * NdotL, 1.0 );
+    result = vec4(Shade(positionVS, N, RT0Value.xyz, RT0Value.w, RT2Value.xyz, RT2Value.w), 1.0);
+  }
+)";
+
+//Visibility buffer geometry pass. Only writes the triangle and the object that cover each pixel
+static const char* gVisibilityPassVertexShaderSource = R"(
+  #version 440 core
+
+  layout(location = 0) in vec3 aPosition;
+
+  layout (set = 0, binding = 0) uniform SCENE
+  {
+    mat4 view;
+    mat4 projection;
+    mat4 projectionInverse;
+    vec4 imageSize;
+  }scene;
+
+  layout(set = 1, binding = 0) uniform MODEL
+  {
+    mat4 transform;
+  }model;
+
+  void main(void)
+  {
+    gl_Position = scene.projection * scene.view * model.transform * vec4(aPosition,1.0);
   }
 )";
 
+static const char* gVisibilityPassFragmentShaderSource = R"(
+  #version 440 core
+
+  layout(constant_id = 0) const uint TRIANGLE_ID_BITS = 24;
+
+  layout(push_constant) uniform OBJECT
+  {
+    uint index;
+  }object;
+
+  layout(location = 0) out uint id;
+
+  void main(void)
+  {
+    id = (object.index << TRIANGLE_ID_BITS) | uint(gl_PrimitiveID);
+  }
+)";
+
+//Visibility buffer resolve pass. Fetches the vertices of the triangle covering the pixel from the scene geometry buffers,
+//intersects the view ray with it to get perspective correct barycentrics and shades the pixel once
+static const char* gVisibilityResolveFragmentShaderSource = R"(
+  layout(constant_id = 5) const uint TRIANGLE_ID_BITS = 24;
+
+  layout(set = 1, binding = 0) uniform usampler2D visibilityBuffer;
+  layout(set = 1, binding = 1) uniform sampler2D depthBuffer;
+
+  struct Object
+  {
+    mat4 transform;
+    uint firstIndex;
+    uint vertexOffset;
+    uvec2 padding;
+    vec3 albedo;
+    float metallic;
+    vec3 F0;
+    float roughness;
+  };
+
+  //Position and normal of every vertex in the scene
+  layout(std430, set = 3, binding = 0) readonly buffer VERTICES
+  {
+    float data[];
+  }vertices;
+
+  layout(std430, set = 3, binding = 1) readonly buffer INDICES
+  {
+    uint data[];
+  }indices;
+
+  layout(std430, set = 3, binding = 2) readonly buffer OBJECTS
+  {
+    Object data[];
+  }objects;
+
+  layout(location = 0) out vec4 result;
+
+  vec3 VertexAttribute(uint vertex, uint offset)
+  {
+    uint i = vertex * 6u + offset;
+    return vec3(vertices.data[i], vertices.data[i + 1u], vertices.data[i + 2u]);
+  }
+
+  void main(void)
+  {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if(texelFetch(depthBuffer, pixel, 0).r == 1.0)
+    {
+      //No geometry
+      result = vec4(0.0, 0.0, 0.0, 1.0);
+      return;
+    }
+
+    uint id = texelFetch(visibilityBuffer, pixel, 0).r;
+    Object object = objects.data[id >> TRIANGLE_ID_BITS];
+    uint firstIndex = object.firstIndex + (id & ((1u << TRIANGLE_ID_BITS) - 1u)) * 3u;
+    uvec3 vertex = object.vertexOffset + uvec3(indices.data[firstIndex], indices.data[firstIndex + 1u], indices.data[firstIndex + 2u]);
+
+    mat4 modelView = scene.view * object.transform;
+    vec3 p0 = (modelView * vec4(VertexAttribute(vertex.x, 0u), 1.0)).xyz;
+    vec3 p1 = (modelView * vec4(VertexAttribute(vertex.y, 0u), 1.0)).xyz;
+    vec3 p2 = (modelView * vec4(VertexAttribute(vertex.z, 0u), 1.0)).xyz;
+
+    //Ray-triangle intersection in view space (the ray starts at the camera)
+    vec3 rayDirection = ViewSpacePositionFromDepth(gl_FragCoord.xy * scene.imageSize.zw, 1.0);
+    vec3 e1 = p1 - p0;
+    vec3 e2 = p2 - p0;
+    vec3 p = cross(rayDirection, e2);
+    vec3 q = cross(-p0, e1);
+    float invDet = 1.0 / dot(e1, p);
+    vec2 barycentrics = vec2(dot(-p0, p), dot(rayDirection, q)) * invDet;
+    vec3 positionVS = rayDirection * (dot(e2, q) * invDet);
+
+    vec3 normal = VertexAttribute(vertex.x, 3u) * (1.0 - barycentrics.x - barycentrics.y) +
+                  VertexAttribute(vertex.y, 3u) * barycentrics.x +
+                  VertexAttribute(vertex.z, 3u) * barycentrics.y;
+    vec3 N = normalize(transpose(inverse(mat3(modelView))) * normal);
+
+    result = vec4(Shade(positionVS, N, object.albedo, object.metallic, object.F0, object.roughness), 1.0);
+  }
+)";
+
+//Prepended to the clustered shading source when building the light pass and visibility buffer resolve pass shaders
+static const char* gLightPassShaderHeader = "#version 440 core\n#define LIGHTS_SET 2\n#define CLUSTER_ACCESS readonly\n";
+
 static const char* gPresentationVertexShaderSource = R"(
   #version 440 core
 
@@ -259,20 +550,41 @@ static const char* gPresentationFragmentShaderSource = R"(
   }
 )";
 
+static const uint32_t gMaxLightCount = 4096u;
+static const uint32_t gClusterTileSize = 64u;        //In pixels
+static const uint32_t gClusterSliceCount = 24u;
+static const uint32_t gMaxLightsPerCluster = 256u;
+static const f32 gZNear = 0.1f;
+static const f32 gZFar = 100.0f;
+static const uint32_t gTriangleIdBits = 24u;         //Bits of the visibility buffer used for the triangle, the rest identify the object
+static const uint32_t gMaxObjectCount = 1u << (32u - gTriangleIdBits);
+
+//Format of the octahedral encoded normals. Color attachment support for R16G16_SNORM is optional, R16G16_SFLOAT is
+//mandatory and can store the same [-1,1] encoding
+static VkFormat getNormalFormat(const render::context_t& context)
+{
+  const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(context.physicalDevice_, VK_FORMAT_R16G16_SNORM, &formatProperties);
+  if ((formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures)
+    return VK_FORMAT_R16G16_SNORM;
+
+  return VK_FORMAT_R16G16_SFLOAT;
+}
+
 struct deferred_shading_sample_t : public framework::application_t
 {
   struct light_t
   {
-    struct uniforms_t
+    struct gpu_data_t
     {
       maths::vec4 position_;
       maths::vec3 color_;
       float radius_;
     };
 
-    uniforms_t uniforms_;
-    render::gpu_buffer_t ubo_;
-    render::descriptor_set_t descriptorSet_;
+    gpu_data_t data_;
+    maths::vec3 offset_;  //Offset from the animation path
   };
 
   struct material_t
@@ -299,6 +611,22 @@ struct deferred_shading_sample_t : public framework::application_t
     render::descriptor_set_t descriptorSet_;
   };
 
+  //Per object data read by the visibility buffer resolve pass
+  struct object_data_t
+  {
+    mat4 transform_;
+    uint32_t firstIndex_;     //Offsets of the mesh in the scene geometry buffers
+    uint32_t vertexOffset_;
+    uint32_t padding_[2];
+    material_t::uniforms_t material_;
+  };
+
+  struct mesh_geometry_t
+  {
+    uint32_t firstIndex_;
+    uint32_t vertexOffset_;
+  };
+
   struct scene_uniforms_t
   {
     mat4 viewMatrix_;
@@ -311,7 +639,9 @@ struct deferred_shading_sample_t : public framework::application_t
   :application_t("Deferred shading", 1200u, 800u, 3u),
    currentPresentationDescriptorSet_(0u),
    camera_( vec3(0.0f, 2.5f, 8.5f), vec2(0.0f,0.0f), 1.0f, 0.01f),
-   bAnimateLights_( true )
+   bAnimateLights_( true ),
+   bVisibilityBuffer_( false ),
+   bSceneGeometryReady_( false )
   {
     render::context_t& context = getRenderContext();
     uvec2 size = getWindowSize();
@@ -323,7 +653,7 @@ struct deferred_shading_sample_t : public framework::application_t
     render::descriptorPoolCreate(context, 1000u,
       render::combined_image_sampler_count(1000u),
       render::uniform_buffer_count(1000u),
-      render::storage_buffer_count(0u),
+      render::storage_buffer_count(9u),
       render::storage_image_count(0u),
       &descriptorPool_);
 
@@ -332,31 +662,30 @@ struct deferred_shading_sample_t : public framework::application_t
     render::vertex_attribute_t attributes[2] = { { render::vertex_attribute_t::format::VEC3, 0, vertexSize, false },{ render::vertex_attribute_t::format::VEC3, sizeof(maths::vec3), vertexSize, false } };
     render::vertexFormatCreate(attributes, 2u, &vertexFormat_);
 
-    //Load full-screen quad and sphere meshes
+    //Load full-screen quad
     fullScreenQuad_ = mesh::fullScreenQuad(context);
-    mesh::createFromFile(context, "../resources/sphere.obj", mesh::EXPORT_POSITION_ONLY, nullptr, 0u, &sphereMesh_);
 
     //Create globals uniform buffer    
-    sceneUniforms_.projectionMatrix_ = perspectiveProjectionMatrix(1.2f, (f32)size.x / (f32)size.y, 0.1f, 100.0f);
+    sceneUniforms_.projectionMatrix_ = perspectiveProjectionMatrix(1.2f, (f32)size.x / (f32)size.y, gZNear, gZFar);
     invertMatrix(sceneUniforms_.projectionMatrix_, sceneUniforms_.projectionInverseMatrix_);
     sceneUniforms_.viewMatrix_ = camera_.view_;
     sceneUniforms_.imageSize_ = vec4((f32)size.x, (f32)size.y, 1.0f / (f32)size.x, 1.0f / (f32)size.y);
     render::gpuBufferCreate(context, render::gpu_buffer_t::usage::UNIFORM_BUFFER, (void*)&sceneUniforms_, sizeof(scene_uniforms_t), &allocator_, &globalsUbo_);
 
     //Create global descriptor set (Scene uniforms)   
-    render::descriptor_binding_t binding = { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT };
+    render::descriptor_binding_t binding = { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT | render::descriptor_t::stage::COMPUTE };
     render::descriptorSetLayoutCreate(context, &binding, 1u, &globalsDescriptorSetLayout_);
     render::descriptor_t descriptor = render::getDescriptor(globalsUbo_);
     render::descriptorSetCreate(context, descriptorPool_, globalsDescriptorSetLayout_, &descriptor, &globalsDescriptorSet_);
 
-    //Create render targets 
-    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &gBufferRT0_);
+    //Create render targets. Positions are reconstructed from the depth buffer
+    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &gBufferRT0_);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &gBufferRT0_);
-    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &gBufferRT1_);
+    render::texture2DCreate(context, size.x, size.y, 1u, getNormalFormat(context), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &gBufferRT1_);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &gBufferRT1_);
-    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &gBufferRT2_);
+    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &gBufferRT2_);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &gBufferRT2_);
-    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &finalImage_);
+    render::texture2DCreate(context, size.x, size.y, 1u, getRenderer().getHDRFormat(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &finalImage_);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &finalImage_);
     render::depthStencilBufferCreate(context, size.x, size.y, &depthStencilBuffer_);
 
@@ -416,14 +745,14 @@ struct deferred_shading_sample_t : public framework::application_t
 
     mesh::mesh_t mesh;
     mesh::create( getRenderContext(), indices, sizeof(indices), (const void*)vertices, sizeof(vertices), attributes, 2, &allocator_, &mesh );
-    return mesh_.add( mesh );
+    return addSceneMesh( mesh );
   }
 
   core::handle_t addMesh(const char* url )
   {
     mesh::mesh_t mesh;
     mesh::createFromFile( getRenderContext(), url, mesh::EXPORT_NORMALS, &allocator_, 0u, &mesh);
-    return mesh_.add( mesh );
+    return addSceneMesh( mesh );
   }
 
   core::handle_t addMaterial( const vec3& albedo, float metallic, const vec3& F0, float roughness )
@@ -447,6 +776,9 @@ struct deferred_shading_sample_t : public framework::application_t
 
   core::handle_t addObject( core::handle_t meshId, core::handle_t materialId, const maths::mat4& transform )
   {
+    if (object_.getElementCount() >= gMaxObjectCount)
+      return core::NULL_HANDLE;
+
     render::context_t& context = getRenderContext();
 
     core::handle_t transformId = transformManager_.createTransform( transform );
@@ -463,30 +795,23 @@ struct deferred_shading_sample_t : public framework::application_t
     return object_.add( object );
   }
 
+  //Position is used as an offset from the animation path while lights are animated
   core::handle_t addLight(const maths::vec3& position,float radius, const maths::vec3& color )
   {
-    render::context_t& context = getRenderContext();
+    if (light_.getElementCount() >= gMaxLightCount)
+      return core::NULL_HANDLE;
 
     light_t light;
-
-    light.uniforms_.position_ = maths::vec4(position,1.0);
-    light.uniforms_.color_ = color;    
-    light.uniforms_.radius_ = radius;
-
-    //Create uniform buffer and descriptor set
-    render::gpuBufferCreate(context, render::gpu_buffer_t::usage::UNIFORM_BUFFER,
-      &light.uniforms_, sizeof(light_t::uniforms_t),
-      &allocator_, &light.ubo_);
-
-    
-    render::descriptor_t descriptor = render::getDescriptor(light.ubo_);
-    render::descriptorSetCreate(context, descriptorPool_, lightDescriptorSetLayout_, &descriptor, &light.descriptorSet_);
+    light.data_.position_ = maths::vec4(position,1.0);
+    light.data_.color_ = color;    
+    light.data_.radius_ = radius;
+    light.offset_ = position;
     return light_.add(light);
   }
 
   void onResize( uint32_t width, uint32_t height )
   {
-    sceneUniforms_.projectionMatrix_ = perspectiveProjectionMatrix( 1.2f, (f32)width / (f32)height,0.1f,100.0f );
+    sceneUniforms_.projectionMatrix_ = perspectiveProjectionMatrix( 1.2f, (f32)width / (f32)height, gZNear, gZFar );
     buildPresentationCommandBuffers();
   }
 
@@ -500,21 +825,35 @@ struct deferred_shading_sample_t : public framework::application_t
     sceneUniforms_.viewMatrix_ = camera_.view_;
     render::gpuBufferUpdate(context, (void*)&sceneUniforms_, 0u, sizeof(scene_uniforms_t), &globalsUbo_);
 
-    //Update modelview matrices
+    if (!bSceneGeometryReady_)
+      createSceneGeometryBuffers();
+
+    //Update modelview matrices and the object data of the visibility buffer resolve pass
     object_t* objects;
     uint32_t objectCount = object_.getData(&objects);    
     for (u32 i(0); i < objectCount; ++i)
     {
       render::gpuBufferUpdate(context, transformManager_.getWorldMatrix(objects[i].transform_), 0, sizeof(mat4), &objects[i].ubo_ );
+
+      const mesh_geometry_t& geometry = meshGeometry_[objects[i].mesh_.index_];
+      objectData_[i].transform_ = *transformManager_.getWorldMatrix(objects[i].transform_);
+      objectData_[i].firstIndex_ = geometry.firstIndex_;
+      objectData_[i].vertexOffset_ = geometry.vertexOffset_;
+      objectData_[i].material_ = material_.get(objects[i].material_)->uniforms_;
     }
+    if (objectCount > 0)
+      render::gpuBufferUpdate(context, objectData_.data(), 0, objectCount * sizeof(object_data_t), &objectDataBuffer_);
 
-    //Update lights position
+    //Update light buffer
     light_t* lights;
     uint32_t lightCount = light_.getData(&lights);
     for (u32 i(0); i<lightCount; ++i)
     {
-      render::gpuBufferUpdate(context, &lights[i].uniforms_.position_, 0, sizeof(vec4), &lights[i].ubo_);
+      lightData_[i] = lights[i].data_;
     }
+    render::gpuBufferUpdate(context, &lightCount, 0, sizeof(uint32_t), &lightBuffer_);
+    if (lightCount > 0)
+      render::gpuBufferUpdate(context, lightData_.data(), sizeof(vec4), lightCount * sizeof(light_t::gpu_data_t), &lightBuffer_);
     
     buildPresentationCommandBuffers();
     buildAndSubmitCommandBuffer();        
@@ -612,29 +951,50 @@ struct deferred_shading_sample_t : public framework::application_t
     }
 
     //Destroy lights resources
-    packed_freelist_iterator_t<light_t> lightIter = light_.begin();
-    while (lightIter != light_.end())
+    render::gpuBufferDestroy(context, &allocator_, &lightBuffer_);
+    render::gpuBufferDestroy(context, nullptr, &clusterLightCountBuffer_);
+    render::gpuBufferDestroy(context, nullptr, &clusterLightIndexBuffer_);
+    render::descriptorSetDestroy(context, &lightsDescriptorSet_);
+
+    //Destroy visibility buffer resources
+    if (bSceneGeometryReady_)
     {
-      render::gpuBufferDestroy(context, &allocator_, &lightIter.get().ubo_);
-      render::descriptorSetDestroy(context, &lightIter.get().descriptorSet_);
-      ++lightIter;
+      render::gpuBufferDestroy(context, nullptr, &sceneVertexBuffer_);
+      render::gpuBufferDestroy(context, nullptr, &sceneIndexBuffer_);
+      render::descriptorSetDestroy(context, &sceneGeometryDescriptorSet_);
     }
-
+    render::gpuBufferDestroy(context, &allocator_, &objectDataBuffer_);
+    render::descriptorSetDestroy(context, &visibilityResolveTexturesDescriptorSet_);
+    render::shaderDestroy(context, &visibilityVertexShader_);
+    render::shaderDestroy(context, &visibilityFragmentShader_);
+    render::shaderDestroy(context, &visibilityResolveFragmentShader_);
+    render::graphicsPipelineDestroy(context, &visibilityPipeline_);
+    render::graphicsPipelineDestroy(context, &visibilityResolvePipeline_);
+    render::pipelineLayoutDestroy(context, &visibilityPipelineLayout_);
+    render::pipelineLayoutDestroy(context, &visibilityResolvePipelineLayout_);
+    render::descriptorSetLayoutDestroy(context, &visibilityResolveTexturesDescriptorSetLayout_);
+    render::descriptorSetLayoutDestroy(context, &sceneGeometryDescriptorSetLayout_);
+    render::textureDestroy(context, &visibilityBuffer_);
+    render::frameBufferDestroy(context, &visibilityFrameBuffer_);
+    render::renderPassDestroy(context, &visibilityRenderPass_);
     
     render::shaderDestroy(context, &gBuffervertexShader_);
     render::shaderDestroy(context, &gBufferfragmentShader_);
     render::shaderDestroy(context, &lightVertexShader_);
     render::shaderDestroy(context, &lightFragmentShader_);
+    render::shaderDestroy(context, &lightBinningShader_);
     render::shaderDestroy(context, &presentationVertexShader_);
     render::shaderDestroy(context, &presentationFragmentShader_);
     
     render::graphicsPipelineDestroy(context, &gBufferPipeline_);
     render::graphicsPipelineDestroy(context, &lightPipeline_);
+    render::computePipelineDestroy(context, &lightBinningPipeline_);
     render::graphicsPipelineDestroy(context, &presentationPipeline_);
 
     render::pipelineLayoutDestroy(context, &presentationPipelineLayout_);
     render::pipelineLayoutDestroy(context, &gBufferPipelineLayout_);
     render::pipelineLayoutDestroy(context, &lightPipelineLayout_);
+    render::pipelineLayoutDestroy(context, &lightBinningPipelineLayout_);
     
     render::descriptorSetDestroy(context, &globalsDescriptorSet_);
     render::descriptorSetDestroy(context, &lightPassTexturesDescriptorSet_);
@@ -645,7 +1005,7 @@ struct deferred_shading_sample_t : public framework::application_t
     render::descriptorSetLayoutDestroy(context, &globalsDescriptorSetLayout_);
     render::descriptorSetLayoutDestroy(context, &materialDescriptorSetLayout_);
     render::descriptorSetLayoutDestroy(context, &objectDescriptorSetLayout_);
-    render::descriptorSetLayoutDestroy(context, &lightDescriptorSetLayout_);
+    render::descriptorSetLayoutDestroy(context, &lightsDescriptorSetLayout_);
     render::descriptorSetLayoutDestroy(context, &lightPassTexturesDescriptorSetLayout_);
     render::descriptorSetLayoutDestroy(context, &presentationDescriptorSetLayout_);
 
@@ -656,7 +1016,6 @@ struct deferred_shading_sample_t : public framework::application_t
     render::depthStencilBufferDestroy(context, &depthStencilBuffer_);
     
     mesh::destroy(context, &fullScreenQuad_);
-    mesh::destroy(context, &sphereMesh_);
 
     render::frameBufferDestroy(context, &frameBuffer_);
     render::commandBufferDestroy(context, &commandBuffer_);
@@ -722,15 +1081,16 @@ private:
     subpasses[1].inputAttachmentIndex_.push_back(0);
     subpasses[1].inputAttachmentIndex_.push_back(1);
     subpasses[1].inputAttachmentIndex_.push_back(2);
+    subpasses[1].inputAttachmentIndex_.push_back(4);
     subpasses[1].colorAttachmentIndex_.push_back(3);
 
     //Dependency chain for layout transitions
     render::render_pass_t::subpass_dependency_t dependency;    
     dependency.srcSubpass = 0;
     dependency.dstSubpass = 1;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
     dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;    
 
     render::renderPassCreate(context, attachments, 5u, subpasses, 2u, &dependency, 1u, &renderPass_);
@@ -772,47 +1132,247 @@ private:
     render::graphicsPipelineCreate(context, renderPass_.handle_, 0u, vertexFormat_, gBufferPipelineLayout_, pipelineDesc, &gBufferPipeline_);
 
     //Create light pass descriptorSet layouts
-    render::descriptor_binding_t bindings[3];
+    render::descriptor_binding_t bindings[4];
     bindings[0] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, render::descriptor_t::stage::FRAGMENT };
     bindings[1] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 1, render::descriptor_t::stage::FRAGMENT };
     bindings[2] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 2, render::descriptor_t::stage::FRAGMENT };
-    render::descriptorSetLayoutCreate(context, bindings, 3u, &lightPassTexturesDescriptorSetLayout_);
-
-    binding = { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT };
-    render::descriptorSetLayoutCreate(context, &binding, 1u, &lightDescriptorSetLayout_);
+    bindings[3] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 3, render::descriptor_t::stage::FRAGMENT };
+    render::descriptorSetLayoutCreate(context, bindings, 4u, &lightPassTexturesDescriptorSetLayout_);
+
+    //Light buffer and per cluster light lists
+    lightData_.resize(gMaxLightCount);
+    render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER,
+      nullptr, sizeof(vec4) + gMaxLightCount * sizeof(light_t::gpu_data_t),
+      &allocator_, &lightBuffer_);
+
+    clusterCount_ = uvec3((size.x + gClusterTileSize - 1) / gClusterTileSize, (size.y + gClusterTileSize - 1) / gClusterTileSize, gClusterSliceCount);
+    uint32_t clusterCount = clusterCount_.x * clusterCount_.y * clusterCount_.z;
+    render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::gpu_memory_type_e::DEVICE_LOCAL,
+      nullptr, clusterCount * sizeof(uint32_t), nullptr, &clusterLightCountBuffer_);
+    render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::gpu_memory_type_e::DEVICE_LOCAL,
+      nullptr, clusterCount * gMaxLightsPerCluster * sizeof(uint32_t), nullptr, &clusterLightIndexBuffer_);
+
+    bindings[0] = { render::descriptor_t::type::STORAGE_BUFFER, 0, render::descriptor_t::stage::FRAGMENT | render::descriptor_t::stage::COMPUTE };
+    bindings[1] = { render::descriptor_t::type::STORAGE_BUFFER, 1, render::descriptor_t::stage::FRAGMENT | render::descriptor_t::stage::COMPUTE };
+    bindings[2] = { render::descriptor_t::type::STORAGE_BUFFER, 2, render::descriptor_t::stage::FRAGMENT | render::descriptor_t::stage::COMPUTE };
+    render::descriptorSetLayoutCreate(context, bindings, 3u, &lightsDescriptorSetLayout_);
+
+    render::descriptor_t lightDescriptors[3] = { render::getDescriptor(lightBuffer_), render::getDescriptor(clusterLightCountBuffer_), render::getDescriptor(clusterLightIndexBuffer_) };
+    render::descriptorSetCreate(context, descriptorPool_, lightsDescriptorSetLayout_, lightDescriptors, &lightsDescriptorSet_);
+
+    //Cluster configuration is baked into the light binning and light pass shaders
+    render::specialization_constants_t clusterConstants;
+    render::specializationConstantSet(0u, gClusterTileSize, &clusterConstants);
+    render::specializationConstantSet(1u, gClusterSliceCount, &clusterConstants);
+    render::specializationConstantSet(2u, gMaxLightsPerCluster, &clusterConstants);
+    render::specializationConstantSet(3u, gZNear, &clusterConstants);
+    render::specializationConstantSet(4u, gZFar, &clusterConstants);
+
+    //Create light binning pipeline
+    render::descriptor_set_layout_t lightBinningDescriptorSetLayouts[2] = { globalsDescriptorSetLayout_, lightsDescriptorSetLayout_ };
+    render::pipelineLayoutCreate(context, lightBinningDescriptorSetLayouts, 2u, nullptr, 0u, &lightBinningPipelineLayout_);
+    render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, gLightBinningComputeShaderSource, &lightBinningShader_);
+    render::computePipelineCreate(context, lightBinningPipelineLayout_, lightBinningShader_, clusterConstants, &lightBinningPipeline_);
 
     //Create descriptor sets for light pass (GBuffer textures)
-    render::descriptor_t descriptors[3];
+    render::descriptor_t descriptors[4];
     descriptors[0] = render::getDescriptor(gBufferRT0_);
     descriptors[1] = render::getDescriptor(gBufferRT1_);
     descriptors[2] = render::getDescriptor(gBufferRT2_);
+    descriptors[3] = render::getDescriptor(depthStencilBuffer_);
     render::descriptorSetCreate(context, descriptorPool_, lightPassTexturesDescriptorSetLayout_, descriptors, &lightPassTexturesDescriptorSet_);
 
     //Create light pass pipeline layout
-    render::descriptor_set_layout_t lightPassDescriptorSetLayouts[3] = { globalsDescriptorSetLayout_, lightPassTexturesDescriptorSetLayout_, lightDescriptorSetLayout_ };
+    render::descriptor_set_layout_t lightPassDescriptorSetLayouts[3] = { globalsDescriptorSetLayout_, lightPassTexturesDescriptorSetLayout_, lightsDescriptorSetLayout_ };
     render::pipelineLayoutCreate(context, lightPassDescriptorSetLayouts, 3u, nullptr, 0u, &lightPipelineLayout_);
 
     //Create light pass pipeline
     render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, gLightPassVertexShaderSource, &lightVertexShader_);
-    render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, gLightPassFragmentShaderSource, &lightFragmentShader_);
+    std::string lightPassSource = std::string(gLightPassShaderHeader) + gClusteredShadingSource + gLightPassFragmentShaderSource;
+    render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, lightPassSource.c_str(), &lightFragmentShader_);
     render::graphics_pipeline_t::description_t lightPipelineDesc = {};
     lightPipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)context.swapChain_.imageWidth_, (float)context.swapChain_.imageHeight_, 0.0f, 1.0f };
     lightPipelineDesc.scissorRect_ = { { 0,0 },{ context.swapChain_.imageWidth_,context.swapChain_.imageHeight_ } };
     lightPipelineDesc.blendState_.resize(1);
     lightPipelineDesc.blendState_[0].colorWriteMask = 0xF;
-    lightPipelineDesc.blendState_[0].blendEnable = VK_TRUE;
-    lightPipelineDesc.blendState_[0].colorBlendOp = VK_BLEND_OP_ADD;
-    lightPipelineDesc.blendState_[0].alphaBlendOp = VK_BLEND_OP_ADD;
-    lightPipelineDesc.blendState_[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    lightPipelineDesc.blendState_[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    lightPipelineDesc.blendState_[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    lightPipelineDesc.blendState_[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    lightPipelineDesc.cullMode_ = VK_CULL_MODE_FRONT_BIT;
+    lightPipelineDesc.blendState_[0].blendEnable = VK_FALSE;
+    lightPipelineDesc.cullMode_ = VK_CULL_MODE_BACK_BIT;
     lightPipelineDesc.depthTestEnabled_ = false;
     lightPipelineDesc.depthWriteEnabled_ = false;
     lightPipelineDesc.vertexShader_ = lightVertexShader_;
     lightPipelineDesc.fragmentShader_ = lightFragmentShader_;
-    render::graphicsPipelineCreate(context, renderPass_.handle_, 1u, sphereMesh_.vertexFormat_, lightPipelineLayout_, lightPipelineDesc, &lightPipeline_);
+    lightPipelineDesc.specialization_ = clusterConstants;
+    render::graphicsPipelineCreate(context, renderPass_.handle_, 1u, fullScreenQuad_.vertexFormat_, lightPipelineLayout_, lightPipelineDesc, &lightPipeline_);
+
+    initializeVisibilityPass(context, size, clusterConstants);
+  }
+
+  void initializeVisibilityPass(render::context_t& context, const uvec2& size, const render::specialization_constants_t& clusterConstants)
+  {
+    //Visibility buffer. Integer format so it is only read with texelFetch
+    render::texture_sampler_t sampler;
+    sampler.minification_ = render::texture_sampler_t::filter_mode::NEAREST;
+    sampler.magnification_ = render::texture_sampler_t::filter_mode::NEAREST;
+    sampler.mipmap_ = render::texture_sampler_t::filter_mode::NEAREST;
+    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32_UINT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, sampler, &visibilityBuffer_);
+    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &visibilityBuffer_);
+
+    //Create visibility render pass (visibility + resolve subpasses)
+    visibilityRenderPass_ = {};
+    render::render_pass_t::attachment_t attachments[3];
+    attachments[0].format_ = visibilityBuffer_.format_;
+    attachments[0].initialLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[0].finallLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[0].storeOp_ = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].loadOp_ = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].samples_ = VK_SAMPLE_COUNT_1_BIT;
+
+    attachments[1].format_ = finalImage_.format_;
+    attachments[1].initialLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[1].finallLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[1].storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[1].loadOp_ = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].samples_ = VK_SAMPLE_COUNT_1_BIT;
+
+    attachments[2].format_ = depthStencilBuffer_.format_;
+    attachments[2].initialLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[2].finallLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[2].storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[2].loadOp_ = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[2].samples_ = VK_SAMPLE_COUNT_1_BIT;
+
+    render::render_pass_t::subpass_t subpasses[2];
+    subpasses[0].colorAttachmentIndex_.push_back(0);
+    subpasses[0].depthStencilAttachmentIndex_ = 2;
+
+    subpasses[1].inputAttachmentIndex_.push_back(0);
+    subpasses[1].inputAttachmentIndex_.push_back(2);
+    subpasses[1].colorAttachmentIndex_.push_back(1);
+
+    render::render_pass_t::subpass_dependency_t dependency;
+    dependency.srcSubpass = 0;
+    dependency.dstSubpass = 1;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+
+    render::renderPassCreate(context, attachments, 3u, subpasses, 2u, &dependency, 1u, &visibilityRenderPass_);
+
+    VkImageView fbAttachment[3] = { visibilityBuffer_.imageView_, finalImage_.imageView_, depthStencilBuffer_.imageView_ };
+    render::frameBufferCreate(context, size.x, size.y, visibilityRenderPass_, fbAttachment, &visibilityFrameBuffer_);
+
+    //Create visibility pass pipeline. The index of the object is passed as a push constant
+    render::descriptor_set_layout_t visibilityDescriptorSetLayouts[2] = { globalsDescriptorSetLayout_, objectDescriptorSetLayout_ };
+    render::push_constant_range_t pushConstantRange = { VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(uint32_t), 0u };
+    render::pipelineLayoutCreate(context, visibilityDescriptorSetLayouts, 2u, &pushConstantRange, 1u, &visibilityPipelineLayout_);
+
+    render::specialization_constants_t visibilityConstants;
+    render::specializationConstantSet(0u, gTriangleIdBits, &visibilityConstants);
+
+    render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, gVisibilityPassVertexShaderSource, &visibilityVertexShader_);
+    render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, gVisibilityPassFragmentShaderSource, &visibilityFragmentShader_);
+    render::graphics_pipeline_t::description_t pipelineDesc = {};
+    pipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)context.swapChain_.imageWidth_, (float)context.swapChain_.imageHeight_, 0.0f, 1.0f };
+    pipelineDesc.scissorRect_ = { { 0,0 },{ context.swapChain_.imageWidth_,context.swapChain_.imageHeight_ } };
+    pipelineDesc.blendState_.resize(1);
+    pipelineDesc.blendState_[0].colorWriteMask = 0x1;
+    pipelineDesc.blendState_[0].blendEnable = VK_FALSE;
+    pipelineDesc.cullMode_ = VK_CULL_MODE_BACK_BIT;
+    pipelineDesc.depthTestEnabled_ = true;
+    pipelineDesc.depthWriteEnabled_ = true;
+    pipelineDesc.depthTestFunction_ = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipelineDesc.vertexShader_ = visibilityVertexShader_;
+    pipelineDesc.fragmentShader_ = visibilityFragmentShader_;
+    pipelineDesc.specialization_ = visibilityConstants;
+    render::graphicsPipelineCreate(context, visibilityRenderPass_.handle_, 0u, vertexFormat_, visibilityPipelineLayout_, pipelineDesc, &visibilityPipeline_);
+
+    //Create resolve pass descriptor set layouts
+    render::descriptor_binding_t bindings[3];
+    bindings[0] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, render::descriptor_t::stage::FRAGMENT };
+    bindings[1] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 1, render::descriptor_t::stage::FRAGMENT };
+    render::descriptorSetLayoutCreate(context, bindings, 2u, &visibilityResolveTexturesDescriptorSetLayout_);
+
+    bindings[0] = { render::descriptor_t::type::STORAGE_BUFFER, 0, render::descriptor_t::stage::FRAGMENT };
+    bindings[1] = { render::descriptor_t::type::STORAGE_BUFFER, 1, render::descriptor_t::stage::FRAGMENT };
+    bindings[2] = { render::descriptor_t::type::STORAGE_BUFFER, 2, render::descriptor_t::stage::FRAGMENT };
+    render::descriptorSetLayoutCreate(context, bindings, 3u, &sceneGeometryDescriptorSetLayout_);
+
+    render::descriptor_t descriptors[2] = { render::getDescriptor(visibilityBuffer_), render::getDescriptor(depthStencilBuffer_) };
+    render::descriptorSetCreate(context, descriptorPool_, visibilityResolveTexturesDescriptorSetLayout_, descriptors, &visibilityResolveTexturesDescriptorSet_);
+
+    //Object data. Written every frame, the scene geometry buffers are created once all the meshes have been added
+    objectData_.resize(gMaxObjectCount);
+    render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER,
+      nullptr, gMaxObjectCount * sizeof(object_data_t),
+      &allocator_, &objectDataBuffer_);
+
+    //Create resolve pass pipeline
+    render::descriptor_set_layout_t resolveDescriptorSetLayouts[4] = { globalsDescriptorSetLayout_, visibilityResolveTexturesDescriptorSetLayout_, lightsDescriptorSetLayout_, sceneGeometryDescriptorSetLayout_ };
+    render::pipelineLayoutCreate(context, resolveDescriptorSetLayouts, 4u, nullptr, 0u, &visibilityResolvePipelineLayout_);
+
+    render::specialization_constants_t resolveConstants = clusterConstants;
+    render::specializationConstantSet(5u, gTriangleIdBits, &resolveConstants);
+
+    std::string resolveSource = std::string(gLightPassShaderHeader) + gClusteredShadingSource + gVisibilityResolveFragmentShaderSource;
+    render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, resolveSource.c_str(), &visibilityResolveFragmentShader_);
+    render::graphics_pipeline_t::description_t resolvePipelineDesc = {};
+    resolvePipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)context.swapChain_.imageWidth_, (float)context.swapChain_.imageHeight_, 0.0f, 1.0f };
+    resolvePipelineDesc.scissorRect_ = { { 0,0 },{ context.swapChain_.imageWidth_,context.swapChain_.imageHeight_ } };
+    resolvePipelineDesc.blendState_.resize(1);
+    resolvePipelineDesc.blendState_[0].colorWriteMask = 0xF;
+    resolvePipelineDesc.blendState_[0].blendEnable = VK_FALSE;
+    resolvePipelineDesc.cullMode_ = VK_CULL_MODE_BACK_BIT;
+    resolvePipelineDesc.depthTestEnabled_ = false;
+    resolvePipelineDesc.depthWriteEnabled_ = false;
+    resolvePipelineDesc.vertexShader_ = lightVertexShader_;
+    resolvePipelineDesc.fragmentShader_ = visibilityResolveFragmentShader_;
+    resolvePipelineDesc.specialization_ = resolveConstants;
+    render::graphicsPipelineCreate(context, visibilityRenderPass_.handle_, 1u, fullScreenQuad_.vertexFormat_, visibilityResolvePipelineLayout_, resolvePipelineDesc, &visibilityResolvePipeline_);
+  }
+
+  //Adds the mesh and appends its vertices and indices to the scene geometry read by the visibility buffer resolve pass.
+  //There is no shared vertex buffer for all the meshes so the data is copied back from the mesh buffers (host visible)
+  core::handle_t addSceneMesh(const mesh::mesh_t& mesh)
+  {
+    render::context_t& context = getRenderContext();
+    assert(mesh.vertexFormat_.vertexSize_ == 6 * sizeof(float));
+
+    mesh_geometry_t geometry = { (uint32_t)sceneIndices_.size(), (uint32_t)(sceneVertices_.size() / 6) };
+
+    const uint32_t* indices = (const uint32_t*)render::gpuMemoryMap(context, mesh.indexBuffer_.memory_);
+    sceneIndices_.insert(sceneIndices_.end(), indices, indices + mesh.indexCount_);
+    render::gpuMemoryUnmap(context, mesh.indexBuffer_.memory_);
+
+    const float* vertices = (const float*)render::gpuMemoryMap(context, mesh.vertexBuffer_.memory_);
+    sceneVertices_.insert(sceneVertices_.end(), vertices, vertices + mesh.vertexCount_ * 6u);
+    render::gpuMemoryUnmap(context, mesh.vertexBuffer_.memory_);
+
+    //Meshes are never removed so the index of the handle identifies the mesh
+    core::handle_t handle = mesh_.add(mesh);
+    if (meshGeometry_.size() <= handle.index_)
+      meshGeometry_.resize(handle.index_ + 1);
+
+    meshGeometry_[handle.index_] = geometry;
+    return handle;
+  }
+
+  void createSceneGeometryBuffers()
+  {
+    render::context_t& context = getRenderContext();
+
+    render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::gpu_memory_type_e::HOST_VISIBLE_COHERENT,
+      sceneVertices_.data(), sceneVertices_.size() * sizeof(float), nullptr, &sceneVertexBuffer_);
+    render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::gpu_memory_type_e::HOST_VISIBLE_COHERENT,
+      sceneIndices_.data(), sceneIndices_.size() * sizeof(uint32_t), nullptr, &sceneIndexBuffer_);
+
+    render::descriptor_t descriptors[3] = { render::getDescriptor(sceneVertexBuffer_), render::getDescriptor(sceneIndexBuffer_), render::getDescriptor(objectDataBuffer_) };
+    render::descriptorSetCreate(context, descriptorPool_, sceneGeometryDescriptorSetLayout_, descriptors, &sceneGeometryDescriptorSet_);
+
+    //CPU copies are no longer needed
+    std::vector<float>().swap(sceneVertices_);
+    std::vector<uint32_t>().swap(sceneIndices_);
+    bSceneGeometryReady_ = true;
   }
 
   void buildAndSubmitCommandBuffer()
@@ -833,38 +1393,77 @@ private:
 
     render::commandBufferBegin(context, commandBuffer_);
     {
-      render::commandBufferRenderPassBegin(context, &frameBuffer_, clearValues, 5u, commandBuffer_);
-
-      //GBuffer pass
-      render::graphicsPipelineBind(commandBuffer_, gBufferPipeline_);
-      render::descriptor_set_t descriptorSets[3];
+      //Assign lights to clusters
+      render::descriptor_set_t lightBinningDescriptorSets[2] = { globalsDescriptorSet_, lightsDescriptorSet_ };
+      render::computePipelineBind(commandBuffer_, lightBinningPipeline_);
+      render::descriptorSetBind(commandBuffer_, VK_PIPELINE_BIND_POINT_COMPUTE, lightBinningPipelineLayout_, 0u, lightBinningDescriptorSets, 2u);
+      render::computeDispatch(commandBuffer_, clusterCount_.x, clusterCount_.y, clusterCount_.z);
+
+      VkMemoryBarrier barrier = {};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      vkCmdPipelineBarrier(commandBuffer_.handle_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1u, &barrier, 0u, nullptr, 0u, nullptr);
+
+      render::descriptor_set_t descriptorSets[4];
       descriptorSets[0] = globalsDescriptorSet_;
-      packed_freelist_iterator_t<object_t> objectIter = object_.begin();
-      while (objectIter != object_.end())
+      if (bVisibilityBuffer_)
       {
-        descriptorSets[1] = objectIter.get().descriptorSet_;
-        descriptorSets[2] = material_.get(objectIter.get().material_)->descriptorSet_;
-        render::descriptorSetBind(commandBuffer_, gBufferPipelineLayout_, 0, descriptorSets, 3u);
-        mesh::mesh_t* mesh = mesh_.get(objectIter.get().mesh_);
-        mesh::draw(commandBuffer_, *mesh);
-        ++objectIter;
+        //Visibility buffer, final image and depth use the last three clear values
+        render::commandBufferRenderPassBegin(context, &visibilityFrameBuffer_, &clearValues[2], 3u, commandBuffer_);
+
+        //Visibility pass
+        render::graphicsPipelineBind(commandBuffer_, visibilityPipeline_);
+        object_t* objects;
+        uint32_t objectCount = object_.getData(&objects);
+        for (uint32_t i(0); i < objectCount; ++i)
+        {
+          descriptorSets[1] = objects[i].descriptorSet_;
+          render::descriptorSetBind(commandBuffer_, visibilityPipelineLayout_, 0u, descriptorSets, 2u);
+          render::pushConstants(commandBuffer_, visibilityPipelineLayout_, 0u, &i);
+          mesh::draw(commandBuffer_, *mesh_.get(objects[i].mesh_));
+        }
+
+        render::commandBufferNextSubpass(commandBuffer_);
+
+        //Resolve pass
+        render::graphicsPipelineBind(commandBuffer_, visibilityResolvePipeline_);
+        descriptorSets[1] = visibilityResolveTexturesDescriptorSet_;
+        descriptorSets[2] = lightsDescriptorSet_;
+        descriptorSets[3] = sceneGeometryDescriptorSet_;
+        render::descriptorSetBind(commandBuffer_, visibilityResolvePipelineLayout_, 0u, descriptorSets, 4u);
+        mesh::draw(commandBuffer_, fullScreenQuad_);
+
+        render::commandBufferRenderPassEnd(commandBuffer_);
       }
-
-      render::commandBufferNextSubpass(commandBuffer_);
-            
-      //Light pass      
-      render::graphicsPipelineBind(commandBuffer_, lightPipeline_);
-      descriptorSets[1] = lightPassTexturesDescriptorSet_;
-      packed_freelist_iterator_t<light_t> lightIter = light_.begin();
-      while (lightIter != light_.end())
+      else
       {
-        descriptorSets[2] = lightIter.get().descriptorSet_;
+        render::commandBufferRenderPassBegin(context, &frameBuffer_, clearValues, 5u, commandBuffer_);
+
+        //GBuffer pass
+        render::graphicsPipelineBind(commandBuffer_, gBufferPipeline_);
+        packed_freelist_iterator_t<object_t> objectIter = object_.begin();
+        while (objectIter != object_.end())
+        {
+          descriptorSets[1] = objectIter.get().descriptorSet_;
+          descriptorSets[2] = material_.get(objectIter.get().material_)->descriptorSet_;
+          render::descriptorSetBind(commandBuffer_, gBufferPipelineLayout_, 0, descriptorSets, 3u);
+          mesh::mesh_t* mesh = mesh_.get(objectIter.get().mesh_);
+          mesh::draw(commandBuffer_, *mesh);
+          ++objectIter;
+        }
+
+        render::commandBufferNextSubpass(commandBuffer_);
+            
+        //Light pass      
+        render::graphicsPipelineBind(commandBuffer_, lightPipeline_);
+        descriptorSets[1] = lightPassTexturesDescriptorSet_;
+        descriptorSets[2] = lightsDescriptorSet_;
         render::descriptorSetBind(commandBuffer_, lightPipelineLayout_, 0u, descriptorSets, 3u);
-        mesh::draw(commandBuffer_, sphereMesh_);
-        ++lightIter;
-      }
+        mesh::draw(commandBuffer_, fullScreenQuad_);
 
-      render::commandBufferRenderPassEnd(commandBuffer_);
+        render::commandBufferRenderPassEnd(commandBuffer_);
+      }
     }
     
     render::commandBufferEnd(commandBuffer_);
@@ -919,7 +1518,7 @@ private:
       vec3 p2 = light_path[(baseFrame + 2) % 5];
       vec3 p3 = light_path[(baseFrame + 3) % 5];
 
-      lights[i].uniforms_.position_ = vec4(maths::cubicInterpolation(p0, p1, p2, p3, f), 1.0);
+      lights[i].data_.position_ = vec4(maths::cubicInterpolation(p0, p1, p2, p3, f) + lights[i].offset_, 1.0);
     }
   }
 
@@ -927,6 +1526,8 @@ private:
   {
     ImGui::Begin("Controls");
     ImGui::Checkbox("Animate Lights", &bAnimateLights_);
+    ImGui::Checkbox("Visibility buffer", &bVisibilityBuffer_);
+    ImGui::Text("Lights: %u", light_.getElementCount());
     ImGui::End();
   }
 
@@ -944,7 +1545,7 @@ private:
   render::descriptor_set_layout_t globalsDescriptorSetLayout_;
   render::descriptor_set_layout_t materialDescriptorSetLayout_;
   render::descriptor_set_layout_t objectDescriptorSetLayout_;
-  render::descriptor_set_layout_t lightDescriptorSetLayout_;
+  render::descriptor_set_layout_t lightsDescriptorSetLayout_;
   render::descriptor_set_layout_t lightPassTexturesDescriptorSetLayout_;
   render::descriptor_set_layout_t presentationDescriptorSetLayout_;
   
@@ -952,6 +1553,7 @@ private:
   render::descriptor_set_t presentationDescriptorSet_[4];
   render::descriptor_set_t globalsDescriptorSet_;
   render::descriptor_set_t lightPassTexturesDescriptorSet_;
+  render::descriptor_set_t lightsDescriptorSet_;
 
   render::vertex_format_t vertexFormat_;
   
@@ -959,6 +1561,8 @@ private:
   render::graphics_pipeline_t gBufferPipeline_;
   render::pipeline_layout_t lightPipelineLayout_;
   render::graphics_pipeline_t lightPipeline_;
+  render::pipeline_layout_t lightBinningPipelineLayout_;
+  render::compute_pipeline_t lightBinningPipeline_;
 
   render::pipeline_layout_t presentationPipelineLayout_;
   render::graphics_pipeline_t presentationPipeline_;
@@ -970,30 +1574,65 @@ private:
   scene_uniforms_t sceneUniforms_;  
   render::gpu_buffer_t globalsUbo_;
 
+  std::vector<light_t::gpu_data_t> lightData_;
+  render::gpu_buffer_t lightBuffer_;               //Light count followed by the lights
+  uvec3 clusterCount_;
+  render::gpu_buffer_t clusterLightCountBuffer_;
+  render::gpu_buffer_t clusterLightIndexBuffer_;   //gMaxLightsPerCluster entries per cluster
+
   render::frame_buffer_t frameBuffer_;
-  render::texture_t gBufferRT0_;  //Albedo + roughness
-  render::texture_t gBufferRT1_;  //Normal + Depth
-  render::texture_t gBufferRT2_;  //F0 + metallic
+  render::texture_t gBufferRT0_;  //Albedo + metallic (RGBA8 sRGB)
+  render::texture_t gBufferRT1_;  //Octahedral encoded view space normal (RG16 SNORM, or SFLOAT if not renderable)
+  render::texture_t gBufferRT2_;  //F0 + roughness (RGBA8)
   render::texture_t finalImage_;
   render::depth_stencil_buffer_t depthStencilBuffer_;
+
+  //Visibility buffer path. The geometry pass only writes the object and triangle covering each pixel and
+  //the resolve pass fetches the triangle from the scene geometry buffers to shade it
+  render::render_pass_t visibilityRenderPass_;
+  render::frame_buffer_t visibilityFrameBuffer_;
+  render::texture_t visibilityBuffer_;  //Object index in the high bits, triangle index in the low gTriangleIdBits (R32_UINT)
+  render::descriptor_set_layout_t visibilityResolveTexturesDescriptorSetLayout_;
+  render::descriptor_set_layout_t sceneGeometryDescriptorSetLayout_;
+  render::descriptor_set_t visibilityResolveTexturesDescriptorSet_;
+  render::descriptor_set_t sceneGeometryDescriptorSet_;
+  render::pipeline_layout_t visibilityPipelineLayout_;
+  render::graphics_pipeline_t visibilityPipeline_;
+  render::pipeline_layout_t visibilityResolvePipelineLayout_;
+  render::graphics_pipeline_t visibilityResolvePipeline_;
+  render::shader_t visibilityVertexShader_;
+  render::shader_t visibilityFragmentShader_;
+  render::shader_t visibilityResolveFragmentShader_;
+
+  std::vector<float> sceneVertices_;          //Position and normal of all the meshes. Released once the buffers are created
+  std::vector<uint32_t> sceneIndices_;
+  std::vector<mesh_geometry_t> meshGeometry_; //Indexed by the index of the mesh handle
+  render::gpu_buffer_t sceneVertexBuffer_;
+  render::gpu_buffer_t sceneIndexBuffer_;
+  std::vector<object_data_t> objectData_;
+  render::gpu_buffer_t objectDataBuffer_;
   
   render::shader_t gBuffervertexShader_;
   render::shader_t gBufferfragmentShader_;
   render::shader_t lightVertexShader_;
   render::shader_t lightFragmentShader_;
+  render::shader_t lightBinningShader_;
   render::shader_t presentationVertexShader_;
   render::shader_t presentationFragmentShader_;
 
-  mesh::mesh_t sphereMesh_;
   mesh::mesh_t fullScreenQuad_;
   
   framework::free_camera_t camera_;
   bool bAnimateLights_;
+  bool bVisibilityBuffer_;
+  bool bSceneGeometryReady_;
 };
 
 
-int main()
+int main(int argc, char** argv)
 {
+  framework::application_t::parseCommandLine(argc, argv);
+
   deferred_shading_sample_t scene;
   
   //Materials  
@@ -1034,6 +1673,14 @@ int main()
   scene.addLight(vec3(0.0f, 0.0f, 0.0f), 10.0f, vec3(1.5f, 0.0f, 0.0f));
   scene.addLight(vec3(0.0f, 0.0f, 0.0f), 10.0f, vec3(0.0f, 1.5f, 0.0f));
   scene.addLight(vec3(0.0f, 0.0f, 0.0f), 10.0f, vec3(0.0f, 0.0f, 1.5f));
+
+  //Small lights scattered around the animation path
+  for (uint32_t i(6); i < gMaxLightCount; ++i)
+  {
+    vec3 offset = vec3(random(-2.5f, 2.5f), random(-2.5f, 0.5f), random(-2.5f, 2.5f));
+    vec3 color = vec3(random(0.0f, 0.3f), random(0.0f, 0.3f), random(0.0f, 0.3f));
+    scene.addLight(offset, 0.75f, color);
+  }
   
   scene.loop();
   return 0;
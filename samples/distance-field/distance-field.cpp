@@ -30,6 +30,7 @@
 #include "core/window.h"
 #include "core/image.h"
 #include "core/mesh.h"
+#include "core/workgroup-autotune.h"
 
 using namespace bkk;
 using namespace bkk::core;
@@ -83,6 +84,7 @@ struct buffer_data_t
 
 static render::context_t gContext;
 static window::window_t gWindow;
+static u32 gHeadlessFrames = 0u;  //Frames to render without a window before quitting. 0 if there is a window
 static render::texture_t gTexture;
 static mesh::mesh_t gFSQuad;
 
@@ -97,7 +99,7 @@ static render::graphics_pipeline_t gPipeline;
 static render::pipeline_layout_t gComputePipelineLayout;
 static render::descriptor_set_layout_t gComputeDescriptorSetLayout;
 static render::descriptor_set_t gComputeDescriptorSet;
-static render::compute_pipeline_t gComputePipeline;
+static render::compute_kernel_t gComputeKernel;
 static render::gpu_buffer_t gUbo;
 static render::gpu_buffer_t gDistanceField;
 
@@ -416,7 +418,8 @@ void createComputePipeline()
 
   //Create pipeline
   render::shaderCreateFromGLSL(gContext, render::shader_t::COMPUTE_SHADER, "../distance-field/distance-field.comp", &gComputeShader);  
-  render::computePipelineCreate(gContext, gComputePipelineLayout, gComputeShader, &gComputePipeline);
+  render::computeKernelCreate(gContext, gComputePipelineLayout, gComputeShader, render::specialization_constants_t(), "distance-field",
+    gImageSize.x, gImageSize.y, 1u, &gComputeDescriptorSet, 1u, &gComputeKernel);
 }
 
 void createPipelines()
@@ -445,9 +448,9 @@ void buildComputeCommandBuffer()
   render::commandBufferCreate(gContext, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, render::command_buffer_t::COMPUTE, &gComputeCommandBuffer);
 
   render::commandBufferBegin(gContext, gComputeCommandBuffer);
-  render::computePipelineBind(gComputeCommandBuffer, gComputePipeline);
+  render::computePipelineBind(gComputeCommandBuffer, gComputeKernel.pipeline_);
   render::descriptorSetBind(gComputeCommandBuffer, gComputePipelineLayout, 0, &gComputeDescriptorSet, 1u);
-  render::computeDispatch(gComputeCommandBuffer, gImageSize.x / 16, gImageSize.y / 16, 1);
+  render::computeDispatch(gComputeCommandBuffer, gComputeKernel, gImageSize.x, gImageSize.y, 1u);
   render::commandBufferEnd(gComputeCommandBuffer);
 }
 
@@ -473,7 +476,7 @@ void exit()
   render::descriptorSetDestroy(gContext, &gDescriptorSet);
   render::pipelineLayoutDestroy(gContext, &gPipelineLayout);
 
-  render::computePipelineDestroy(gContext, &gComputePipeline);
+  render::computeKernelDestroy(gContext, &gComputeKernel);
   render::descriptorSetLayoutDestroy(gContext, &gComputeDescriptorSetLayout);
   render::descriptorSetDestroy(gContext, &gComputeDescriptorSet);
   render::pipelineLayoutDestroy(gContext, &gComputePipelineLayout);
@@ -483,7 +486,8 @@ void exit()
   render::contextDestroy(&gContext);
 
   //Close window
-  window::destroy(&gWindow);
+  if (gHeadlessFrames == 0u)
+    window::destroy(&gWindow);
 }
 
 void renderFrame()
@@ -562,13 +566,30 @@ void onMouseMove(uint32_t x, uint32_t y)
   gMousePosition.y = (f32)y;
 }
 
-int main()
+int main(int argc, char** argv)
 {
-  //Create a window
-  window::create("Distance Field", gImageSize.x, gImageSize.y, &gWindow);
+  //--headless <frames> renders the given number of frames without a window, --output <file> saves the last one
+  const char* output = nullptr;
+  for (int i(1); i + 1 < argc; ++i)
+  {
+    if (strcmp(argv[i], "--headless") == 0)
+      gHeadlessFrames = (u32)atoi(argv[++i]);
+    else if (strcmp(argv[i], "--output") == 0)
+      output = argv[++i];
+  }
+
+  if (gHeadlessFrames > 0u)
+  {
+    render::contextCreateHeadless("Distance Field", "", gImageSize.x, gImageSize.y, 3, &gContext);
+  }
+  else
+  {
+    //Create a window
+    window::create("Distance Field", gImageSize.x, gImageSize.y, &gWindow);
 
-  //Initialize gContext
-  render::contextCreate("Distance Field", "", gWindow, 3, &gContext);
+    //Initialize gContext
+    render::contextCreate("Distance Field", "", gWindow, 3, &gContext);
+  }
   
   gFSQuad = mesh::fullScreenQuad(gContext);
   gCamera.position_ = vec3(0.0f, 0.0f, 5.0f);
@@ -585,11 +606,12 @@ int main()
   buildCommandBuffers();
   buildComputeCommandBuffer();
 
+  u32 frame = 0u;
   bool quit = false;
   while (!quit)
   {
     window::event_t* event = nullptr;
-    while ((event = window::getNextEvent(&gWindow)))
+    while (gHeadlessFrames == 0u && (event = window::getNextEvent(&gWindow)))
     {
       switch (event->type_)
       {
@@ -629,8 +651,19 @@ int main()
     }
 
     renderFrame();
+    if (gHeadlessFrames > 0u && ++frame == gHeadlessFrames)
+      quit = true;
   }
 
+  //Save the last frame
+  if (output)
+  {
+    image::image2D_t image = {};
+    if (render::presentationImageRead(gContext, &image))
+      image::save(output, image);
+
+    image::unload(&image);
+  }
 
   exit();
 
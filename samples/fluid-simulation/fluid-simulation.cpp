@@ -34,6 +34,8 @@
 #include "core/transform-manager.h"
 #include "core/packed-freelist.h"
 
+#include <string>
+
 using namespace bkk;
 using namespace bkk::core;
 using namespace bkk::core::maths;
@@ -163,6 +165,9 @@ static const char* gComputeDensityShaderSource = R"(
     vec2 particleMassRange;
   }globals;
   
+  //Neighbours are read in tiles of 64 particles, loaded once per workgroup. xyz is the position and w is 1 if the particle is alive
+  shared vec4 neighbours[64];
+
   void main()
   {    
     float h = globals.smoothingRadius; //smoothing radius parameter
@@ -171,35 +176,44 @@ static const char* gComputeDensityShaderSource = R"(
     float poly6Coefficient = (315.0f / (64.0f * PI * h9));
     
 
-    uint particleIndex = gl_GlobalInvocationID.x;    
-    if( particleIndex > globals.maxParticleCount )
-    {
-      return;      
-    }
-    
-    particlesState.data[particleIndex].density = 0;
-    for( int i = 0; i<globals.maxParticleCount; ++i )
+    //Every invocation takes part in loading the tiles, even the ones past the last particle
+    uint particleIndex = gl_GlobalInvocationID.x;
+    bool valid = particleIndex < globals.maxParticleCount;
+    vec3 position = valid ? particles.data[particleIndex].position : vec3(0.0);
+
+    //Kernel sum is accumulated in a register and written once
+    float W = 0.0;
+    for( uint tile = 0; tile < globals.maxParticleCount; tile += 64 )
     {
-      if( particlesState.data[i].age != -1 )
+      uint neighbour = tile + gl_LocalInvocationIndex;
+      bool alive = neighbour < globals.maxParticleCount && particlesState.data[neighbour].age != -1;
+      neighbours[gl_LocalInvocationIndex] = alive ? vec4(particles.data[neighbour].position, 1.0) : vec4(0.0);
+      barrier();
+
+      for( uint i = 0; i < 64; ++i )
       {
-        vec3 diff = particles.data[particleIndex].position - particles.data[i].position;
+        vec3 diff = position - neighbours[i].xyz;
         float r2 = dot(diff, diff);
-        if(r2 < h2)
+        if( neighbours[i].w != 0.0 && r2 < h2 )
         {
-          const float W = poly6Coefficient * pow(h2 - r2, 3);
-          particlesState.data[particleIndex].density += particlesState.data[particleIndex].mass * W;
+          W += poly6Coefficient * pow(h2 - r2, 3);
         }
       }
+      barrier();
     }
 
-    particlesState.data[particleIndex].density = max(globals.referenceDensity, particlesState.data[particleIndex].density);
-    particlesState.data[particleIndex].pressure = globals.pressureCoefficient * (particlesState.data[particleIndex].density - globals.referenceDensity);
+    if( valid )
+    {
+      float density = max(globals.referenceDensity, particlesState.data[particleIndex].mass * W);
+      particlesState.data[particleIndex].density = density;
+      particlesState.data[particleIndex].pressure = globals.pressureCoefficient * (density - globals.referenceDensity);
+    }
   }
 )";
 
 //Updates position and velocity of each particle
+//Version directive and subgroup helpers are added when the shader is created
 static const char* gUpdateParticlesShaderSource = R"(
-  #version 440 core
   #extension GL_ARB_separate_shader_objects : enable
   #extension GL_ARB_shading_language_420pack : enable
   layout (local_size_x = 64, local_size_y = 1) in;
@@ -294,7 +308,9 @@ static const char* gUpdateParticlesShaderSource = R"(
     if( particlesState.data[particleIndex].age < 0 )
     {      
       //Emit if required
-      if( atomicAdd( globals.particlesToEmit, -1 ) > 0 )
+      int particlesToEmit;
+      ATOMIC_ADD_AGGREGATED( int, globals.particlesToEmit, -1, particlesToEmit );
+      if( particlesToEmit > 0 )
       {
         //Initialize particle
         particles.data[particleIndex].scale = mix( globals.scale.x, globals.scale.y, rand() );
@@ -697,7 +713,8 @@ public:
     render::commandBufferEnd(computeDensityCommandBuffer_);
 
     //Create updateParticle pipeline
-    render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, gUpdateParticlesShaderSource, &updateParticlesShader_);
+    std::string updateParticlesShaderSource = std::string("#version 440 core\n") + render::getSubgroupHelpersGLSL(context) + gUpdateParticlesShaderSource;
+    render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, updateParticlesShaderSource.c_str(), &updateParticlesShader_);
     render::computePipelineCreate(context, computePipelineLayout_, updateParticlesShader_, &updateParticlesComputePipeline_);
 
     //Build updateParticle command buffer
@@ -758,8 +775,10 @@ private:
 };
 
 //Entry point
-int main()
+int main(int argc, char** argv)
 {
+  framework::application_t::parseCommandLine(argc, argv);
+
   fluid_simulation_sample_t sample;
   sample.loop();
   return 0;
@@ -32,7 +32,7 @@
             layout(location = 0) out vec4 color;
             void main()
             {
-                vec3 c = texture(MainTexture, uv).rgb + texture(bloomBlur, uv).rgb;
+                vec3 c = texture(MainTexture, scaledUV(uv)).rgb + texture(bloomBlur, scaledUV(uv)).rgb;
                 c = vec3(1.0) - exp(-c * globals.exposure);
                 color = vec4( pow(c,vec3(1.0 / 2.2)), 1.0);
             }			
@@ -61,7 +61,7 @@
             layout(location = 0) out vec4 color;
             void main()
             {
-                vec3 c = texture(MainTexture, uv).rgb;
+                vec3 c = texture(MainTexture, scaledUV(uv)).rgb;
                 c = vec3(1.0) - exp(-c * globals.exposure);
                 color = vec4( pow(c,vec3(1.0 / 2.2)), 1.0);
             }			
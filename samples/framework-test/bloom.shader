@@ -10,6 +10,11 @@
         <Resource Name="MainTexture" Type="texture2D" />		
     </Resources>
 
+    <Specialization>
+        <!-- Number of taps on each side of the blur kernel (including the center one). At most 5 -->
+        <Constant Name="BLUR_TAPS" Type="int" Value="5" />
+    </Specialization>
+
 
     <Pass Name="extractBrightPixels">
         <ZWrite Value="Off" />
@@ -32,7 +37,7 @@
             layout(location = 0) out vec4 color;
             void main()
             {
-                vec4 imageColor = texture(MainTexture, uv);
+                vec4 imageColor = texture(MainTexture, scaledUV(uv));
                 float brightness = dot(imageColor.rgb, vec3(0.2126, 0.7152, 0.0722));
                 if(brightness &gt; globals.bloomTreshold )
                     color = vec4(imageColor.rgb, 1.0);
@@ -67,11 +72,11 @@
             {			
                 vec3 finalColor = vec3(0,0,0);
                 vec2 tex_offset = 1.0 / textureSize(MainTexture, 0);
-                finalColor = texture(MainTexture, uv).rgb * weight[0];
-                for (int i=1; i &lt; 5; i++) 
+                finalColor = texture(MainTexture, scaledUV(uv)).rgb * weight[0];
+                for (int i=1; i &lt; BLUR_TAPS; i++) 
                 {
-                  finalColor += texture(MainTexture, uv + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-                  finalColor += texture(MainTexture, uv - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
+                  finalColor += texture(MainTexture, scaledUV(uv) + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
+                  finalColor += texture(MainTexture, scaledUV(uv) - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
                 }
                 
                 color = vec4(finalColor,1.0);
@@ -104,11 +109,11 @@
             {			
                 vec3 finalColor = vec3(0,0,0);
                 vec2 tex_offset = 1.0 / textureSize(MainTexture, 0);
-                finalColor = texture(MainTexture, uv).rgb * weight[0];
-                for (int i=1; i &lt; 5; i++) 
+                finalColor = texture(MainTexture, scaledUV(uv)).rgb * weight[0];
+                for (int i=1; i &lt; BLUR_TAPS; i++) 
                 {
-                  finalColor += texture(MainTexture, uv + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-                  finalColor += texture(MainTexture, uv - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
+                  finalColor += texture(MainTexture, scaledUV(uv) + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
+                  finalColor += texture(MainTexture, scaledUV(uv) - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
                 }
                 
                 color = vec4(finalColor,1.0);
@@ -25,6 +25,7 @@
 #include "core/mesh.h"
 #include "core/maths.h"
 #include "core/image.h"
+#include "core/cpu-profiler.h"
 
 #include "framework/application.h"
 #include "framework/camera.h"
@@ -35,31 +36,30 @@ using namespace bkk::framework;
 
 class framework_test_t : public application_t
 {
-private:
-  struct light_t
-  {
-    maths::vec4 position;
-    maths::vec3 color;
-    float radius;
-  };
-
 public:
   framework_test_t()
   :application_t("Framework test", 1200u, 800u, 3u),
    cameraController_(maths::vec3(0.0f, 4.0f, 12.0f), maths::vec2(0.1f, 0.0f), 1.0f, 0.01f),
    bloomEnabled_(true),
+   computeBloom_(true),
    bloomTreshold_(1.0f),
    lightIntensity_(1.0f),
-   exposure_(1.5f)
+   exposure_(1.5f),
+   targetFrameTime_(16.6f),
+   depthPrepass_(false),
+   occlusionCulling_(false),
+   showGpuProfiler_(false)
   {
     maths::uvec2 imageSize(1200u, 800u);
 
     //create scene framebuffer
-    sceneRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, VK_FORMAT_R32G32B32A32_SFLOAT, true);
+    sceneRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, renderer_.getHDRFormat(), true);
     sceneFBO_ = renderer_.frameBufferCreate(&sceneRT_, 1u);
+    renderer_.getOcclusionCulling()->setFrameBuffer(sceneFBO_, &renderer_);
 
-    //create light buffer
-    lightBuffer_ = createLightBuffer();
+    //create lights
+    lights_[0] = renderer_.getLightManager()->lightCreate(maths::vec3(-7.0f, 5.0f, 0.0f), maths::vec3(1.0f, 1.0f, 1.0f), 13.0f);
+    lights_[1] = renderer_.getLightManager()->lightCreate(maths::vec3(7.0f, 5.0f, 0.0f), maths::vec3(1.0f, 1.0f, 1.0f), 13.0f);
 
     //Load environment map
     image::image2D_t cubemapImage = {};
@@ -90,7 +90,6 @@ public:
     materialPtr->setTexture("irradianceMap", irradianceMap_);
     materialPtr->setTexture("specularMap", specularMap_);
     materialPtr->setTexture("brdfLUT", brdfLut_);
-    materialPtr->setBuffer("lights", lightBuffer_);
 
     material_handle_t material1 = renderer_.materialCreate(shader);
     materialPtr = renderer_.getMaterial(material1);
@@ -101,7 +100,6 @@ public:
     materialPtr->setTexture("irradianceMap", irradianceMap_);
     materialPtr->setTexture("specularMap", specularMap_);
     materialPtr->setTexture("brdfLUT", brdfLut_);
-    materialPtr->setBuffer("lights", lightBuffer_);
 
     material_handle_t material2 = renderer_.materialCreate(shader);
     materialPtr = renderer_.getMaterial(material2);
@@ -112,7 +110,6 @@ public:
     materialPtr->setTexture("irradianceMap", irradianceMap_);
     materialPtr->setTexture("specularMap", specularMap_);
     materialPtr->setTexture("brdfLUT", brdfLut_);
-    materialPtr->setBuffer("lights", lightBuffer_);
 
     //create actors
     maths::mat4 transform = maths::createTransform(maths::vec3(-5.0f, -1.0f, 0.0f), maths::VEC3_ONE, maths::quaternionFromAxisAngle(maths::vec3(0.0f, 1.0f, 0.0f), maths::degreeToRadian(30.0f)));
@@ -125,11 +122,11 @@ public:
     renderer_.actorCreate("plane", plane, material2, transform);
     
     //Bloom resources
-    brightPixelsRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, VK_FORMAT_R32G32B32A32_SFLOAT, false);
+    brightPixelsRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, renderer_.getHDRFormat(), false);
     brightPixelsFBO_ = renderer_.frameBufferCreate(&brightPixelsRT_, 1u);
-    blurVerticalRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, VK_FORMAT_R32G32B32A32_SFLOAT, false);
+    blurVerticalRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, renderer_.getHDRFormat(), false);
     blurVerticalFBO_ = renderer_.frameBufferCreate(&blurVerticalRT_, 1u);
-    bloomRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, VK_FORMAT_R32G32B32A32_SFLOAT, false);
+    bloomRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, renderer_.getHDRFormat(), false);
     bloomFBO_ = renderer_.frameBufferCreate(&bloomRT_, 1u);
     shader_handle_t bloomShader = renderer_.shaderCreate("../framework-test/bloom.shader");
     bloomMaterial_ = renderer_.materialCreate(bloomShader);
@@ -137,38 +134,13 @@ public:
     blendMaterial_ = renderer_.materialCreate(blendShader);
     material_t* blendMaterial = renderer_.getMaterial(blendMaterial_);
     blendMaterial->setTexture("bloomBlur", renderer_.getRenderTarget(bloomRT_)->getColorBuffer());
+    bloom_.initialize(&renderer_, sceneRT_);
 
     //create camera
     camera_ = renderer_.addCamera(camera_t(camera_t::PERSPECTIVE_PROJECTION, 1.2f, imageSize.x/(float)imageSize.y, 0.1f, 100.0f));
     cameraController_.setCameraHandle(camera_, &renderer_);
   }
   
-  render::gpu_buffer_t createLightBuffer()
-  {    
-    int lightCount = 2;
-    std::vector<light_t> lights(lightCount);
-    lights[0].position = maths::vec4(-7.0f, 5.0f, 0.0f, 1.0f);
-    lights[0].color = maths::vec3(1.0f, 1.0f, 1.0f);
-    lights[0].radius = 13.0f;
-    lights[1].position = maths::vec4(7.0f, 5.0f, 0.0f, 1.0f);
-    lights[1].color = maths::vec3(1.0f, 1.0f, 1.0f);
-    lights[1].radius = 13.0f;
-
-    //Create buffer
-    render::gpu_buffer_t lightBuffer = {};
-    render::context_t& context = getRenderContext();
-    render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER,
-      render::gpu_memory_type_e::HOST_VISIBLE_COHERENT, 
-      nullptr, sizeof(light_t)*lightCount + sizeof(maths::vec4), nullptr,
-      &lightBuffer );
-    
-    render::gpuBufferUpdate(context, &lightCount, 0u, sizeof(int), &lightBuffer);
-    render::gpuBufferUpdate(context, &lightIntensity_, sizeof(int), sizeof(float), &lightBuffer);
-    render::gpuBufferUpdate(context, lights.data(), sizeof(maths::vec4), lightCount * sizeof(light_t), &lightBuffer);
-
-    return lightBuffer;
-  }
-
   void onKeyEvent(u32 key, bool pressed)
   {
     if (pressed)
@@ -210,7 +182,7 @@ public:
 
   void onQuit() 
   {
-    render::gpuBufferDestroy(getRenderContext(), nullptr, &lightBuffer_);
+    bloom_.destroy(&renderer_);
     render::textureDestroy(getRenderContext(), &skybox_);
     render::textureDestroy(getRenderContext(), &irradianceMap_);
     render::textureDestroy(getRenderContext(), &specularMap_);
@@ -238,7 +210,19 @@ public:
     renderSkyboxCmd.submit();
     renderSkyboxCmd.release();
     
-    if (bloomEnabled_)
+    material_t* blendMaterial = renderer_.getMaterial(blendMaterial_);
+    if (bloomEnabled_ && computeBloom_)
+    {
+      //Bloom compute passes, tonemapping and composite in a single command buffer
+      bloom_.setThreshold(bloomTreshold_);
+      blendMaterial->setTexture("bloomBlur", bloom_.getBloomTexture());
+      command_buffer_t blitToBackbufferCmd = command_buffer_t(&renderer_, bkk::core::NULL_HANDLE, &renderSkyboxCmd);
+      blitToBackbufferCmd.clearRenderTargets(maths::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+      blitToBackbufferCmd.blit(sceneRT_, &bloom_, blendMaterial_, "blend");
+      blitToBackbufferCmd.submit();
+      blitToBackbufferCmd.release();
+    }
+    else if (bloomEnabled_)
     {
       material_t* bloomMaterial = renderer_.getMaterial(bloomMaterial_);
       bloomMaterial->setProperty("globals.bloomTreshold", bloomTreshold_);
@@ -265,6 +249,7 @@ public:
       blurHorizontalCmd.release();
 
       //Blend bloom and scene render targets
+      blendMaterial->setTexture("bloomBlur", renderer_.getRenderTarget(bloomRT_)->getColorBuffer());
       command_buffer_t blitToBackbufferCmd = command_buffer_t(&renderer_, bkk::core::NULL_HANDLE, &blurHorizontalCmd);
       blitToBackbufferCmd.clearRenderTargets(maths::vec4(0.0f, 0.0f, 0.0f, 1.0f));
       blitToBackbufferCmd.blit(sceneRT_, blendMaterial_, "blend" );
@@ -295,18 +280,61 @@ public:
 
     ImGui::LabelText("", "Bloom Settings");
     ImGui::Checkbox("Enable", &bloomEnabled_);
+    ImGui::Checkbox("Compute", &computeBloom_);
     ImGui::SliderFloat("Bloom Treshold", &bloomTreshold_, 0.0f, 10.0f);
+    if (computeBloom_)
+    {
+      ImGui::LabelText("", "Memory: %.2f MB", bloom_.getMemoryUsage() / (1024.0f * 1024.0f));
+    }
+    else
+    {
+      //Bright pixels, vertical blur and bloom targets
+      render_target_t* target = renderer_.getRenderTarget(bloomRT_);
+      uint32_t bytesPerPixel = target->getFormat() == VK_FORMAT_R16G16B16A16_SFLOAT ? 8u : 4u;
+      ImGui::LabelText("", "Memory: %.2f MB", 3u * target->getWidth() * target->getHeight() * bytesPerPixel / (1024.0f * 1024.0f));
+    }
+
+    ImGui::Separator();
+
+    dynamic_resolution_t* dynamicResolution = renderer_.getDynamicResolution();
+    ImGui::LabelText("", "Dynamic Resolution");
+    bool dynamicResolutionEnabled = dynamicResolution->isEnabled();
+    if (ImGui::Checkbox("Enable##DynamicResolution", &dynamicResolutionEnabled))
+      dynamicResolution->setEnabled(dynamicResolutionEnabled);
+    ImGui::SliderFloat("Target frame time (ms)", &targetFrameTime_, 4.0f, 33.3f);
+    dynamicResolution->setTargetFrameTime(targetFrameTime_);
+    ImGui::LabelText("", "GPU frame time: %.2f ms", dynamicResolution->getFrameTime());
+    ImGui::LabelText("", "Resolution scale: %.2f", dynamicResolution->getScale());
+
+    ImGui::Separator();
+
+    ImGui::LabelText("", "Visibility");
+    ImGui::Checkbox("Depth pre-pass", &depthPrepass_);
+    ImGui::Checkbox("Occlusion culling", &occlusionCulling_);
+    renderer_.getOcclusionCulling()->setDepthPrepass(depthPrepass_);
+    renderer_.getOcclusionCulling()->setOcclusionCulling(occlusionCulling_);
+    ImGui::Checkbox("Software occlusion culling", &renderer_.getCamera(camera_)->occlusionCulling_);
+
+    ImGui::Separator();
+
+    ImGui::Checkbox("GPU profiler", &showGpuProfiler_);
+    if (ImGui::Button("Capture CPU trace") && !profiler::isCapturing())
+      profiler::captureFrames(10u, "cpu-trace.json");
     ImGui::End();
 
+    if (showGpuProfiler_)
+      gui::drawGpuProfiler(*renderer_.getGpuProfiler());
+
     //Set properties
     renderer_.getMaterial(blendMaterial_)->setProperty("globals.exposure", exposure_);
-    render::gpuBufferUpdate(getRenderContext(), &lightIntensity_, sizeof(int), sizeof(float), &lightBuffer_);
+    for (uint32_t i(0); i < 2; ++i)
+      renderer_.getLightManager()->getLight(lights_[i])->color_ = maths::vec3(lightIntensity_, lightIntensity_, lightIntensity_);
   }
 
 private:
   frame_buffer_handle_t sceneFBO_;
   render_target_handle_t sceneRT_;  
-  render::gpu_buffer_t lightBuffer_;
+  light_handle_t lights_[2];
   material_handle_t skyboxMaterial_;
   render::texture_t skybox_;
   render::texture_t irradianceMap_;
@@ -314,6 +342,8 @@ private:
   render::texture_t brdfLut_;
 
   bool bloomEnabled_;
+  bool computeBloom_;
+  bloom_t bloom_;
   material_handle_t bloomMaterial_;
   material_handle_t blendMaterial_;
   frame_buffer_handle_t bloomFBO_;
@@ -329,10 +359,16 @@ private:
 
   float lightIntensity_;
   float exposure_;
+  float targetFrameTime_;
+  bool depthPrepass_;
+  bool occlusionCulling_;
+  bool showGpuProfiler_;
 };
 
-int main()
+int main(int argc, char** argv)
 {
+  application_t::parseCommandLine(argc, argv);
+
   framework_test_t test;
   test.loop();
 
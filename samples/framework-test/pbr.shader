@@ -9,15 +9,6 @@
             <Field Name="F0" Type="vec3" />
             <Field Name="roughness" Type="float" />
         </Resource>
-        <Resource Name="lights" Type="storage_buffer" Shared="yes"> 			
-            <Field Name="count" Type="int" />
-            <Field Name="intensity" Type="float" />
-            <Field Name="data" Type="compound_type" Count="">
-                <Field Name="position" Type="vec4" />
-                <Field Name="color" Type="vec3" />
-                <Field Name="radius" Type="float" />
-            </Field>
-        </Resource>
         
         <Resource Name="irradianceMap" Type="textureCube" />
         <Resource Name="specularMap" Type="textureCube" />
@@ -128,10 +119,12 @@
                 
                 
                 vec3 c = vec3(0,0,0);                
-                for( int i = 0; i &lt; lights.count; ++i )
+                uvec2 lightRange = getLightRange(positionVS.xyz);
+                for( uint i = lightRange.x; i &lt; lightRange.x + lightRange.y; ++i )
                 {
-                    vec4 lightVS = camera.worldToView * lights.data[i].position;
-                    c += applyLight( positionVS, N, V, globals.albedo, F, kD, globals.roughness, lightVS, lights.data[i].color, lights.data[i].radius ) * lights.intensity;
+                    light_t light = lights.data[lightIndices.data[i]];
+                    vec4 lightVS = camera.worldToView * light.position;
+                    c += applyLight( positionVS, N, V, globals.albedo, F, kD, globals.roughness, lightVS, light.color, light.radius );
                 }
                 
                 //Image based lighting
@@ -8,15 +8,6 @@
             <Field Name="specularColor" Type="vec4" />
             <Field Name="shininess" Type="float" />
         </Resource>
-        <Resource Name="lights" Type="storage_buffer" Shared="yes"> 			
-            <Field Name="count" Type="int" />
-            <Field Name="intensity" Type="float" />
-            <Field Name="data" Type="compound_type" Count="">
-                <Field Name="position" Type="vec4" />
-                <Field Name="color" Type="vec3" />
-                <Field Name="radius" Type="float" />
-            </Field>
-        </Resource>
     </Resources>
 
 
@@ -72,10 +63,12 @@
             {
                 vec3 V = normalize(-positionVS.xyz);
                 vec3 c = vec3(0,0,0);
-                for( int i = 0; i &lt; lights.count; ++i )
+                uvec2 lightRange = getLightRange(positionVS.xyz);
+                for( uint i = lightRange.x; i &lt; lightRange.x + lightRange.y; ++i )
                 {
-                    vec4 lightVS = camera.worldToView * lights.data[i].position;
-                    c += applyLight( positionVS, normalVS, V, globals.diffuseColor.rgb, globals.specularColor.rgb, globals.shininess, lightVS, lights.data[i].color, lights.data[i].radius ) * lights.intensity;
+                    light_t light = lights.data[lightIndices.data[i]];
+                    vec4 lightVS = camera.worldToView * light.position;
+                    c += applyLight( positionVS, normalVS, V, globals.diffuseColor.rgb, globals.specularColor.rgb, globals.shininess, lightVS, light.color, light.radius );
                 }
                 
                 color = vec4( c, 1.0);
@@ -24,13 +24,17 @@
 
 /* Reflective shadow map sample.
 *    - Press 1-7 to see diferent Render Target contents (1-Final image, 2-4 GBuffer, 5-7 Reflective shadow map)
-*    - Press 'G' to enable disable Global illumination
+*    - Press 'G' to cycle Global illumination modes (Disabled, full resolution, reduced resolution)
+*    - Reduced resolution mode evaluates a sixteenth of the samples per pixel at half or quarter resolution using
+*      interleaved sampling, followed by a geometry aware blur, optional temporal accumulation and bilateral upsampling
 */
 
 #include "framework/application.h"
+#include "framework/gui.h"
 #include "framework/camera.h"
 
 #include "core/render.h"
+#include "core/gpu-profiler.h"
 #include "core/window.h"
 #include "core/mesh.h"
 #include "core/maths.h"
@@ -530,6 +534,257 @@ static const char* gDirectionalLightPassGIFragmentShaderSource = R"(
   }
 )";
 
+//Reduced resolution GI. Each pixel of a 4x4 group evaluates one sixteenth of the RSM samples. Indirect light is stored
+//with the linear depth of the pixel so it can be filtered and upsampled without leaking across depth discontinuities
+static const char* gReducedGISampleComputeShaderSource = R"(
+  #version 440 core
+  layout(local_size_x = 8, local_size_y = 8) in;
+
+  layout (set = 0, binding = 0) uniform SCENE
+  {
+    mat4 worldToView;
+    mat4 viewToWorld;
+    mat4 projection;
+    mat4 projectionInverse;
+    vec4 imageSize;
+  }scene;
+
+  layout (set = 0, binding = 1) uniform LIGHT
+  {
+    vec4 direction;
+    vec4 color;
+    mat4 worldToLightClipSpace;
+    vec4 shadowMapSize;
+    vec3 padding;
+    float sampleCount;
+    vec4 samples[400];
+  }light;
+
+  layout(set = 0, binding = 2) uniform sampler2D RT1;
+  layout(set = 0, binding = 3) uniform sampler2D shadowMapRT0;
+  layout(set = 0, binding = 4) uniform sampler2D shadowMapRT1;
+  layout(set = 0, binding = 5) uniform sampler2D shadowMapRT2;
+  layout(set = 0, binding = 6, rgba16f) uniform writeonly image2D giRaw;
+
+  layout(push_constant) uniform PushConstants
+  {
+    mat4 prevWorldToClip;
+    uvec4 params;   //Downsample factor, frame index, temporal accumulation enabled
+  }pushConstants;
+
+  vec3 ViewSpacePositionFromDepth(in vec2 uv, in float depth)
+  {
+    vec3 clipSpacePosition = vec3(uv* 2.0 - 1.0, depth);
+    vec4 viewSpacePosition = scene.projectionInverse * vec4(clipSpacePosition,1.0);
+    return(viewSpacePosition.xyz / viewSpacePosition.w);
+  }
+
+  void main(void)
+  {
+    int downsample = int(pushConstants.params.x);
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 lowResSize = (ivec2(scene.imageSize.xy) + downsample - 1) / downsample;
+    if(any(greaterThanEqual(pixel, lowResSize)))
+      return;
+
+    ivec2 fullResPixel = min(pixel * downsample + downsample / 2, ivec2(scene.imageSize.xy) - 1);
+    vec4 RT1Value = texelFetch(RT1, fullResPixel, 0);
+    if(dot(RT1Value.xyz, RT1Value.xyz) == 0.0)
+    {
+      imageStore(giRaw, pixel, vec4(0.0));
+      return;
+    }
+
+    vec2 uv = (vec2(fullResPixel) + 0.5) * scene.imageSize.zw;
+    vec3 positionVS = ViewSpacePositionFromDepth(uv, RT1Value.w);
+    vec3 positionWS = (scene.viewToWorld * vec4(positionVS, 1.0)).xyz;
+    vec3 normalWS = normalize((scene.viewToWorld * vec4(normalize(RT1Value.xyz), 0.0)).xyz);
+    vec4 postionInLigthClipSpace = light.worldToLightClipSpace * vec4(positionWS, 1.0);
+    postionInLigthClipSpace.xy = 0.5 * (postionInLigthClipSpace.xy / postionInLigthClipSpace.w) + 0.5;
+    ivec2 shadowMapUV = ivec2(postionInLigthClipSpace.xy * light.shadowMapSize.xy);
+
+    //Sample subset of this pixel. With temporal accumulation subsets rotate every frame
+    uint subset = uint(pixel.x & 3) + 4u * uint(pixel.y & 3);
+    if(pushConstants.params.z != 0u)
+      subset = (subset + pushConstants.params.y) & 15u;
+
+    vec3 indirectRadiance = vec3(0.0);
+    float count = 0.0;
+    for(uint i = subset; i < uint(light.sampleCount); i += 16u)
+    {
+      ivec2 pixelCoord = clamp(ivec2(shadowMapUV + light.samples[i].xy), ivec2(0), ivec2(light.shadowMapSize.x, light.shadowMapSize.y));
+      vec3 vplNormal = normalize(texelFetch(shadowMapRT0, pixelCoord, 0).yzw);
+      vec3 vplPosition = texelFetch(shadowMapRT1, pixelCoord, 0).xyz;
+      vec3 vplRadiance = texelFetch(shadowMapRT2, pixelCoord, 0).xyz;
+      vec3 L = vplPosition - positionWS;
+      float distance = length(L);
+      L /= distance;
+      float G = max(0.0, dot(normalWS, L)) * max(0.0, dot(vplNormal, -L)) / distance*distance;
+      indirectRadiance += G * vplRadiance * light.samples[i].z;
+      count += 1.0;
+    }
+
+    imageStore(giRaw, pixel, vec4(indirectRadiance / max(count, 1.0), -positionVS.z));
+  }
+)";
+
+//Geometry aware 4x4 blur that gathers all the sample subsets, followed by optional temporal accumulation
+static const char* gReducedGIFilterComputeShaderSource = R"(
+  #version 440 core
+  layout(local_size_x = 8, local_size_y = 8) in;
+
+  layout (set = 0, binding = 0) uniform SCENE
+  {
+    mat4 worldToView;
+    mat4 viewToWorld;
+    mat4 projection;
+    mat4 projectionInverse;
+    vec4 imageSize;
+  }scene;
+
+  layout(set = 0, binding = 2) uniform sampler2D RT1;
+  layout(set = 0, binding = 6, rgba16f) uniform readonly image2D giRaw;
+  layout(set = 0, binding = 7) uniform sampler2D giHistory;
+  layout(set = 0, binding = 8, rgba16f) uniform writeonly image2D giResult;
+
+  layout(push_constant) uniform PushConstants
+  {
+    mat4 prevWorldToClip;
+    uvec4 params;   //Downsample factor, frame index, temporal accumulation enabled
+  }pushConstants;
+
+  vec3 ViewSpacePositionFromDepth(in vec2 uv, in float depth)
+  {
+    vec3 clipSpacePosition = vec3(uv* 2.0 - 1.0, depth);
+    vec4 viewSpacePosition = scene.projectionInverse * vec4(clipSpacePosition,1.0);
+    return(viewSpacePosition.xyz / viewSpacePosition.w);
+  }
+
+  void main(void)
+  {
+    int downsample = int(pushConstants.params.x);
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 lowResSize = (ivec2(scene.imageSize.xy) + downsample - 1) / downsample;
+    if(any(greaterThanEqual(pixel, lowResSize)))
+      return;
+
+    vec4 center = imageLoad(giRaw, pixel);
+    if(center.w == 0.0)
+    {
+      imageStore(giResult, pixel, vec4(0.0));
+      return;
+    }
+
+    ivec2 fullResPixel = min(pixel * downsample + downsample / 2, ivec2(scene.imageSize.xy) - 1);
+    vec4 RT1Value = texelFetch(RT1, fullResPixel, 0);
+    vec3 normal = normalize(RT1Value.xyz);
+
+    //Any 4x4 window contains one pixel of every sample subset
+    vec3 indirectRadiance = vec3(0.0);
+    float weightSum = 0.0;
+    for(int y = -1; y <= 2; ++y)
+    {
+      for(int x = -1; x <= 2; ++x)
+      {
+        ivec2 samplePixel = clamp(pixel + ivec2(x, y), ivec2(0), lowResSize - 1);
+        vec4 value = imageLoad(giRaw, samplePixel);
+        vec3 sampleNormal = texelFetch(RT1, min(samplePixel * downsample + downsample / 2, ivec2(scene.imageSize.xy) - 1), 0).xyz;
+        float depthWeight = max(0.0, 1.0 - abs(value.w - center.w) / (0.1 * center.w));
+        float normalWeight = pow(max(0.0, dot(normal, sampleNormal)), 8.0);
+        float weight = depthWeight * normalWeight;
+        indirectRadiance += value.rgb * weight;
+        weightSum += weight;
+      }
+    }
+    indirectRadiance = weightSum > 0.0 ? indirectRadiance / weightSum : center.rgb;
+
+    //Reproject and blend with the history if it belongs to the same surface
+    if(pushConstants.params.z != 0u)
+    {
+      vec2 uv = (vec2(fullResPixel) + 0.5) * scene.imageSize.zw;
+      vec3 positionWS = (scene.viewToWorld * vec4(ViewSpacePositionFromDepth(uv, RT1Value.w), 1.0)).xyz;
+      vec4 prevClip = pushConstants.prevWorldToClip * vec4(positionWS, 1.0);
+      vec2 prevUV = 0.5 * (prevClip.xy / prevClip.w) + 0.5;
+      if(all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0))))
+      {
+        vec2 historyTexel = (prevUV * scene.imageSize.xy - float(downsample / 2) - 0.5) / float(downsample) + 0.5;
+        vec4 history = textureLod(giHistory, historyTexel / vec2(textureSize(giHistory, 0)), 0.0);
+        if(abs(history.w - prevClip.w) < 0.1 * prevClip.w)
+          indirectRadiance = mix(history.rgb, indirectRadiance, 0.2);
+      }
+    }
+
+    imageStore(giResult, pixel, vec4(indirectRadiance, center.w));
+  }
+)";
+
+//Depth aware bilinear upsampling. Indirect light is added to the lit image
+static const char* gReducedGIUpsampleComputeShaderSource = R"(
+  #version 440 core
+  layout(local_size_x = 8, local_size_y = 8) in;
+
+  layout (set = 0, binding = 0) uniform SCENE
+  {
+    mat4 worldToView;
+    mat4 viewToWorld;
+    mat4 projection;
+    mat4 projectionInverse;
+    vec4 imageSize;
+  }scene;
+
+  layout(set = 0, binding = 2) uniform sampler2D RT1;
+  layout(set = 0, binding = 8, rgba16f) uniform readonly image2D giResult;
+  layout(set = 0, binding = 9, rgba16f) uniform image2D finalImage;
+
+  layout(push_constant) uniform PushConstants
+  {
+    mat4 prevWorldToClip;
+    uvec4 params;   //Downsample factor, frame index, temporal accumulation enabled
+  }pushConstants;
+
+  vec3 ViewSpacePositionFromDepth(in vec2 uv, in float depth)
+  {
+    vec3 clipSpacePosition = vec3(uv* 2.0 - 1.0, depth);
+    vec4 viewSpacePosition = scene.projectionInverse * vec4(clipSpacePosition,1.0);
+    return(viewSpacePosition.xyz / viewSpacePosition.w);
+  }
+
+  void main(void)
+  {
+    int downsample = int(pushConstants.params.x);
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if(any(greaterThanEqual(pixel, ivec2(scene.imageSize.xy))))
+      return;
+
+    vec4 RT1Value = texelFetch(RT1, pixel, 0);
+    if(dot(RT1Value.xyz, RT1Value.xyz) == 0.0)
+      return;
+
+    vec2 uv = (vec2(pixel) + 0.5) * scene.imageSize.zw;
+    float depth = -ViewSpacePositionFromDepth(uv, RT1Value.w).z;
+
+    ivec2 lowResSize = (ivec2(scene.imageSize.xy) + downsample - 1) / downsample;
+    vec2 lowResPosition = (vec2(pixel) - float(downsample / 2)) / float(downsample);
+    ivec2 base = ivec2(floor(lowResPosition));
+    vec2 f = lowResPosition - vec2(base);
+
+    vec3 indirectRadiance = vec3(0.0);
+    float weightSum = 0.0;
+    for(int i = 0; i < 4; ++i)
+    {
+      ivec2 offset = ivec2(i & 1, i >> 1);
+      vec4 value = imageLoad(giResult, clamp(base + offset, ivec2(0), lowResSize - 1));
+      float bilinearWeight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+      float depthWeight = max(0.001, 1.0 - abs(value.w - depth) / (0.1 * depth));
+      indirectRadiance += value.rgb * bilinearWeight * depthWeight;
+      weightSum += bilinearWeight * depthWeight;
+    }
+
+    vec4 color = imageLoad(finalImage, pixel);
+    imageStore(finalImage, pixel, vec4(color.rgb + indirectRadiance / max(weightSum, 0.0001), color.a));
+  }
+)";
+
 static const char* gShadowPassVertexShaderSource = R"(
   #version 440 core
   layout(location = 0) in vec3 aPosition;
@@ -683,6 +938,19 @@ public:
     render::descriptor_set_t descriptorSet_;
   };
 
+  enum gi_mode_e
+  {
+    GI_DISABLED = 0,
+    GI_FULL_RESOLUTION = 1,
+    GI_REDUCED_RESOLUTION = 2
+  };
+
+  struct gi_push_constants_t
+  {
+    maths::mat4 prevWorldToClip_;
+    maths::uvec4 params_;           //Downsample factor, frame index, temporal accumulation enabled
+  };
+
   struct scene_uniforms_t
   {
     mat4 worldToViewMatrix_;
@@ -707,7 +975,7 @@ public:
       render::combined_image_sampler_count(1000u),
       render::uniform_buffer_count(1000u),
       render::storage_buffer_count(0u),
-      render::storage_image_count(0u),
+      render::storage_image_count(8u),
       &descriptorPool_);
 
     //Create vertex format (position + normal)
@@ -747,7 +1015,7 @@ public:
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &gBufferRT1_);
     render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &gBufferRT2_);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &gBufferRT2_);
-    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &finalImage_);
+    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT, render::texture_sampler_t(), &finalImage_);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &finalImage_);
     render::depthStencilBufferCreate(context, size.x, size.y, &depthStencilBuffer_);
 
@@ -840,6 +1108,7 @@ public:
     object_t object = { meshId, materialId, transformId, ubo };
     render::descriptor_t descriptor = render::getDescriptor(object.ubo_);
     render::descriptorSetCreate(context, descriptorPool_, objectDescriptorSetLayout_, &descriptor, &object.descriptorSet_);
+    shadowMapDirty_ = true;
     return object_.add(object);
   }
 
@@ -879,6 +1148,7 @@ public:
       render::descriptorSetCreate(context, descriptorPool_, lightDescriptorSetLayout_, &descriptor, &directionalLight_->descriptorSet_);
 
       initializeShadowPass(context);
+      initializeGIPass(context);
     }
   }
 
@@ -935,6 +1205,12 @@ public:
 
     buildAndSubmitCommandBuffer();
     render::presentFrame(&context, &renderComplete_, 1u);
+
+    //History is only valid if the previous frame used the same reduced resolution mode
+    giHistoryValid_ = (giMode_ == GI_REDUCED_RESOLUTION && giDownsample_ == giPreviousDownsample_);
+    giPreviousDownsample_ = giMode_ == GI_REDUCED_RESOLUTION ? giDownsample_ : 0u;
+    giPrevWorldToClip_ = uniforms_.worldToViewMatrix_ * uniforms_.projectionMatrix_;
+    ++giFrame_;
   }
 
   void onKeyEvent(u32 key, bool pressed)
@@ -982,7 +1258,7 @@ public:
       }
       case window::key_e::KEY_G:
       {
-        globalIllumination_ = !globalIllumination_;
+        giMode_ = (gi_mode_e)((giMode_ + 1) % 3);
         break;
       }
       default:
@@ -1057,8 +1333,22 @@ public:
       render::descriptorSetDestroy(context, &shadowGlobalsDescriptorSet_);
       render::frameBufferDestroy(context, &shadowFrameBuffer_);
       render::commandBufferDestroy(context, &shadowCommandBuffer_);
-      render::semaphoreDestroy( context, shadowPassComplete_);
-      
+
+      render::shaderDestroy(context, &giSampleShader_);
+      render::shaderDestroy(context, &giFilterShader_);
+      render::shaderDestroy(context, &giUpsampleShader_);
+      render::computePipelineDestroy(context, &giSamplePipeline_);
+      render::computePipelineDestroy(context, &giFilterPipeline_);
+      render::computePipelineDestroy(context, &giUpsamplePipeline_);
+      render::pipelineLayoutDestroy(context, &giPipelineLayout_);
+      render::descriptorSetDestroy(context, &giDescriptorSet_[0]);
+      render::descriptorSetDestroy(context, &giDescriptorSet_[1]);
+      render::descriptorSetLayoutDestroy(context, &giDescriptorSetLayout_);
+      render::textureDestroy(context, &giRaw_);
+      render::textureDestroy(context, &giAccumulation_[0]);
+      render::textureDestroy(context, &giAccumulation_[1]);
+      render::gpuProfilerDestroy(context, &gpuProfiler_);
+
       delete directionalLight_;
     }
 
@@ -1161,8 +1451,6 @@ private:
 
   void initializeShadowPass(render::context_t& context)
   {
-    shadowPassComplete_ = render::semaphoreCreate(context);
-
     shadowRenderPass_ = {};
     render::render_pass_t::attachment_t shadowAttachments[4];
     shadowAttachments[0].format_ = shadowMapRT0_.format_;
@@ -1208,10 +1496,11 @@ private:
     shadowDependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
     shadowDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+    //Reflective shadow map is only rendered when it changes so later frames rely on this dependency instead of a semaphore
     shadowDependencies[1].srcSubpass = 0;
     shadowDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    shadowDependencies[1].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    shadowDependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    shadowDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    shadowDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
     shadowDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     shadowDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
@@ -1251,6 +1540,65 @@ private:
     render::graphicsPipelineCreate(context, shadowRenderPass_.handle_, 0u, vertexFormat_, shadowPipelineLayout_, shadowPipelineDesc, &shadowPipeline_);
   }
 
+  void initializeGIPass(render::context_t& context)
+  {
+    //Reduced resolution GI targets. Quarter resolution uses the top left corner of the textures
+    uvec2 size = getWindowSize();
+    uvec2 lowResSize = uvec2((size.x + 1u) / 2u, (size.y + 1u) / 2u);
+    render::texture2DCreate(context, lowResSize.x, lowResSize.y, 1u, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, render::texture_sampler_t(), &giRaw_);
+    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_GENERAL, &giRaw_);
+    for (uint32_t i(0); i < 2; ++i)
+    {
+      render::texture2DCreate(context, lowResSize.x, lowResSize.y, 1u, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, render::texture_sampler_t(), &giAccumulation_[i]);
+      render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_GENERAL, &giAccumulation_[i]);
+    }
+
+    //Descriptor set layout shared by the three GI passes
+    render::descriptor_binding_t bindings[10];
+    bindings[0] = { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::COMPUTE };
+    bindings[1] = { render::descriptor_t::type::UNIFORM_BUFFER, 1, render::descriptor_t::stage::COMPUTE };
+    bindings[2] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 2, render::descriptor_t::stage::COMPUTE };
+    bindings[3] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 3, render::descriptor_t::stage::COMPUTE };
+    bindings[4] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 4, render::descriptor_t::stage::COMPUTE };
+    bindings[5] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 5, render::descriptor_t::stage::COMPUTE };
+    bindings[6] = { render::descriptor_t::type::STORAGE_IMAGE, 6, render::descriptor_t::stage::COMPUTE };
+    bindings[7] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 7, render::descriptor_t::stage::COMPUTE };
+    bindings[8] = { render::descriptor_t::type::STORAGE_IMAGE, 8, render::descriptor_t::stage::COMPUTE };
+    bindings[9] = { render::descriptor_t::type::STORAGE_IMAGE, 9, render::descriptor_t::stage::COMPUTE };
+    render::descriptorSetLayoutCreate(context, bindings, 10u, &giDescriptorSetLayout_);
+
+    //One descriptor set per accumulation target. Each one reads the history from the other
+    for (uint32_t i(0); i < 2; ++i)
+    {
+      render::descriptor_t descriptors[10];
+      descriptors[0] = render::getDescriptor(globalsUbo_);
+      descriptors[1] = render::getDescriptor(directionalLight_->ubo_);
+      descriptors[2] = render::getDescriptor(gBufferRT1_);
+      descriptors[3] = render::getDescriptor(shadowMapRT0_);
+      descriptors[4] = render::getDescriptor(shadowMapRT1_);
+      descriptors[5] = render::getDescriptor(shadowMapRT2_);
+      descriptors[6] = render::getDescriptor(giRaw_);
+      descriptors[7] = render::getDescriptor(giAccumulation_[1 - i]);
+      descriptors[8] = render::getDescriptor(giAccumulation_[i]);
+      descriptors[9] = render::getDescriptor(finalImage_);
+      descriptors[9].imageDescriptor_.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+      render::descriptorSetCreate(context, descriptorPool_, giDescriptorSetLayout_, descriptors, &giDescriptorSet_[i]);
+    }
+
+    render::push_constant_range_t pushConstantRange = { render::descriptor_t::stage::COMPUTE, sizeof(gi_push_constants_t), 0u };
+    render::pipelineLayoutCreate(context, &giDescriptorSetLayout_, 1u, &pushConstantRange, 1u, &giPipelineLayout_);
+
+    render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, gReducedGISampleComputeShaderSource, &giSampleShader_);
+    render::computePipelineCreate(context, giPipelineLayout_, giSampleShader_, &giSamplePipeline_);
+    render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, gReducedGIFilterComputeShaderSource, &giFilterShader_);
+    render::computePipelineCreate(context, giPipelineLayout_, giFilterShader_, &giFilterPipeline_);
+    render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, gReducedGIUpsampleComputeShaderSource, &giUpsampleShader_);
+    render::computePipelineCreate(context, giPipelineLayout_, giUpsampleShader_, &giUpsamplePipeline_);
+
+    //GPU profiler markers to compare the cost of both GI modes. The command buffer waits for the previous frame so one set of queries is enough
+    render::gpuProfilerCreate(context, 1u, 2u, &gpuProfiler_);
+  }
+
   void initializeOffscreenPass(render::context_t& context, const uvec2& size)
   {
     //Semaphore to indicate rendering has completed
@@ -1418,57 +1766,70 @@ private:
   }
 
 
+  void buildGuiFrame()
+  {
+    const char* modes[] = { "Disabled", "Full resolution", "Reduced resolution" };
+    ImGui::Begin("Controls");
+    ImGui::Combo("Global illumination", (int*)&giMode_, modes, 3);
+    if (giMode_ == GI_REDUCED_RESOLUTION)
+    {
+      ImGui::RadioButton("Half resolution", (int*)&giDownsample_, 2);
+      ImGui::RadioButton("Quarter resolution", (int*)&giDownsample_, 4);
+      ImGui::Checkbox("Temporal accumulation", &giTemporal_);
+    }
+    float lightTime = 0.0f, reducedResolutionTime = 0.0f, p50, p95, p99;
+    if (render::gpuProfilerGetTimings(gpuProfiler_, "GI light pass", &lightTime, &p50, &p95, &p99))
+    {
+      render::gpuProfilerGetTimings(gpuProfiler_, "GI reduced resolution", &reducedResolutionTime, &p50, &p95, &p99);
+      ImGui::Text("GI GPU time: %.3f ms", lightTime + reducedResolutionTime);
+    }
+    ImGui::End();
+  }
+
   void buildAndSubmitCommandBuffer()
   {
     render::context_t& context = getRenderContext();
 
-    //Render shadow map if there is a direcrtional light
-    if (directionalLight_ != nullptr)
+    //Render shadow map if there is a direcrtional light and the light or the geometry changed
+    if (directionalLight_ != nullptr && shadowMapDirty_)
     {
       if (shadowCommandBuffer_.handle_ == VK_NULL_HANDLE)
       {
-        render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, &shadowPassComplete_, 1u, render::command_buffer_t::GRAPHICS, &shadowCommandBuffer_);
+        render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, render::command_buffer_t::GRAPHICS, &shadowCommandBuffer_);
+      }
 
-        VkClearValue clearValues[4];
-        clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-        clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-        clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-        clearValues[3].depthStencil = { 1.0f,0 };
+      VkClearValue clearValues[4];
+      clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+      clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+      clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+      clearValues[3].depthStencil = { 1.0f,0 };
 
-        render::commandBufferBegin(context, shadowCommandBuffer_);
+      render::commandBufferBegin(context, shadowCommandBuffer_);
+      {
+        render::commandBufferRenderPassBegin(context, &shadowFrameBuffer_, clearValues, 4u, shadowCommandBuffer_);
+        //Shadow pass
+        render::graphicsPipelineBind(shadowCommandBuffer_, shadowPipeline_);
+        render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 0, &shadowGlobalsDescriptorSet_, 1u);
+        packed_freelist_iterator_t<object_t> objectIter = object_.begin();
+        while (objectIter != object_.end())
         {
-          render::commandBufferRenderPassBegin(context, &shadowFrameBuffer_, clearValues, 4u, shadowCommandBuffer_);
-          //Shadow pass
-          render::graphicsPipelineBind(shadowCommandBuffer_, shadowPipeline_);
-          render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 0, &shadowGlobalsDescriptorSet_, 1u);
-          packed_freelist_iterator_t<object_t> objectIter = object_.begin();
-          while (objectIter != object_.end())
-          {
-            render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 1, &objectIter.get().descriptorSet_, 1u);
-            render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 2, &material_.get(objectIter.get().material_)->descriptorSet_, 1u);
-            mesh::mesh_t* mesh = mesh_.get(objectIter.get().mesh_);
-            mesh::draw(shadowCommandBuffer_, *mesh);
-            ++objectIter;
-          }
+          render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 1, &objectIter.get().descriptorSet_, 1u);
+          render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 2, &material_.get(objectIter.get().material_)->descriptorSet_, 1u);
+          mesh::mesh_t* mesh = mesh_.get(objectIter.get().mesh_);
+          mesh::draw(shadowCommandBuffer_, *mesh);
+          ++objectIter;
         }
-        render::commandBufferRenderPassEnd(shadowCommandBuffer_);
-        render::commandBufferEnd(shadowCommandBuffer_);
       }
+      render::commandBufferRenderPassEnd(shadowCommandBuffer_);
+      render::commandBufferEnd(shadowCommandBuffer_);
 
       render::commandBufferSubmit(context, shadowCommandBuffer_);
+      shadowMapDirty_ = false;
     }
 
     if (commandBuffer_.handle_ == VK_NULL_HANDLE)
     {
-      if (directionalLight_ != nullptr)
-      {
-        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-        render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &shadowPassComplete_, &waitStage, 1u, &renderComplete_, 1u, render::command_buffer_t::GRAPHICS, &commandBuffer_);
-      }
-      else
-      {
-        render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, &renderComplete_, 1u, render::command_buffer_t::GRAPHICS, &commandBuffer_);
-      }
+      render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, &renderComplete_, 1u, render::command_buffer_t::GRAPHICS, &commandBuffer_);
     }
 
     VkClearValue clearValues[5];
@@ -1479,6 +1840,10 @@ private:
     clearValues[4].depthStencil = { 1.0f,0 };
     render::commandBufferBegin(context, commandBuffer_);
     {
+      //Results of the previous frame are available once commandBufferBegin has waited for it
+      render::gpuProfilerBeginFrame(context, &gpuProfiler_);
+      render::gpuProfilerResetQueries(commandBuffer_, &gpuProfiler_);
+
       render::commandBufferRenderPassBegin(context, &frameBuffer_, clearValues, 5u, commandBuffer_);
 
       //GBuffer pass
@@ -1512,8 +1877,8 @@ private:
       //Directional light
       if (directionalLight_ != nullptr)
       {
-        //render::graphicsPipelineBind(commandBuffer_.handle_, directionalLightPipeline_);
-        if (globalIllumination_)
+        render::gpuProfilerBeginMarker(commandBuffer_, "GI light pass", false, &gpuProfiler_);
+        if (giMode_ == GI_FULL_RESOLUTION)
         {
           render::graphicsPipelineBind(commandBuffer_, directionalLightGIPipeline_);
         }
@@ -1523,11 +1888,65 @@ private:
         }
         render::descriptorSetBind(commandBuffer_, lightPipelineLayout_, 2, &directionalLight_->descriptorSet_, 1u);
         mesh::draw(commandBuffer_, fullScreenQuad_);
+        render::gpuProfilerEndMarker(commandBuffer_, &gpuProfiler_);
       }
     }
     render::commandBufferRenderPassEnd(commandBuffer_);
+
+    if (directionalLight_ != nullptr)
+    {
+      render::gpuProfilerBeginMarker(commandBuffer_, "GI reduced resolution", false, &gpuProfiler_);
+      if (giMode_ == GI_REDUCED_RESOLUTION)
+      {
+        buildReducedResolutionGICommands();
+      }
+      render::gpuProfilerEndMarker(commandBuffer_, &gpuProfiler_);
+    }
     render::commandBufferEnd(commandBuffer_);
     render::commandBufferSubmit(context, commandBuffer_);
+    render::gpuProfilerEndFrame(&gpuProfiler_);
+  }
+
+  void buildReducedResolutionGICommands()
+  {
+    uvec2 size = getWindowSize();
+    uint32_t current = giFrame_ & 1u;
+    gi_push_constants_t pushConstants;
+    pushConstants.prevWorldToClip_ = giPrevWorldToClip_;
+    pushConstants.params_ = uvec4(giDownsample_, giFrame_, (giTemporal_ && giHistoryValid_) ? 1u : 0u, 0u);
+    uint32_t groupCountX = ((size.x + giDownsample_ - 1) / giDownsample_ + 7) / 8;
+    uint32_t groupCountY = ((size.y + giDownsample_ - 1) / giDownsample_ + 7) / 8;
+
+    //GBuffer and previous GI passes have to finish before the compute passes read their results
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer_.handle_, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0, 1u, &memoryBarrier, 0u, nullptr, 0u, nullptr);
+
+    render::descriptorSetBind(commandBuffer_, VK_PIPELINE_BIND_POINT_COMPUTE, giPipelineLayout_, 0u, &giDescriptorSet_[current], 1u);
+    render::pushConstants(commandBuffer_, giPipelineLayout_, 0u, &pushConstants);
+
+    //Interleaved sampling
+    render::computePipelineBind(commandBuffer_, giSamplePipeline_);
+    render::computeDispatch(commandBuffer_, groupCountX, groupCountY, 1u);
+
+    //Bilateral filter and temporal accumulation
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer_.handle_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0, 1u, &memoryBarrier, 0u, nullptr, 0u, nullptr);
+    render::computePipelineBind(commandBuffer_, giFilterPipeline_);
+    render::computeDispatch(commandBuffer_, groupCountX, groupCountY, 1u);
+
+    //Upsample and add to the lit image
+    vkCmdPipelineBarrier(commandBuffer_.handle_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0, 1u, &memoryBarrier, 0u, nullptr, 0u, nullptr);
+    render::textureChangeLayout(commandBuffer_, VK_IMAGE_LAYOUT_GENERAL, &finalImage_);
+    render::computePipelineBind(commandBuffer_, giUpsamplePipeline_);
+    render::computeDispatch(commandBuffer_, (size.x + 7) / 8, (size.y + 7) / 8, 1u);
+    render::textureChangeLayout(commandBuffer_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &finalImage_);
   }
 
   void buildPresentationCommandBuffers()
@@ -1607,7 +2026,7 @@ private:
 
   //Shadow pass
   uint32_t shadowMapSize_ = 4096u;
-  VkSemaphore shadowPassComplete_;
+  bool shadowMapDirty_ = true;
   render::command_buffer_t shadowCommandBuffer_;
   render::render_pass_t shadowRenderPass_;
   render::frame_buffer_t shadowFrameBuffer_;
@@ -1629,13 +2048,37 @@ private:
 
   directional_light_t* directionalLight_ = nullptr;
   framework::free_camera_t camera_;
-  bool globalIllumination_ = true;
+
+  //Global illumination
+  gi_mode_e giMode_ = GI_FULL_RESOLUTION;
+  uint32_t giDownsample_ = 2u;
+  uint32_t giPreviousDownsample_ = 0u;
+  bool giTemporal_ = true;
+  bool giHistoryValid_ = false;
+  uint32_t giFrame_ = 0u;
+  maths::mat4 giPrevWorldToClip_;
+  render::texture_t giRaw_;                 //Indirect light of the pixel sample subset + linear depth
+  render::texture_t giAccumulation_[2];     //Filtered indirect light + linear depth. Ping-pong for temporal accumulation
+  render::descriptor_set_layout_t giDescriptorSetLayout_;
+  render::descriptor_set_t giDescriptorSet_[2];
+  render::pipeline_layout_t giPipelineLayout_;
+  render::shader_t giSampleShader_;
+  render::shader_t giFilterShader_;
+  render::shader_t giUpsampleShader_;
+  render::compute_pipeline_t giSamplePipeline_;
+  render::compute_pipeline_t giFilterPipeline_;
+  render::compute_pipeline_t giUpsamplePipeline_;
+
+  //GPU time of the directional light pass and the reduced resolution passes
+  render::gpu_profiler_t gpuProfiler_;
 };
 
 
 //Entry point
-int main()
-{  
+int main(int argc, char** argv)
+{
+  framework::application_t::parseCommandLine(argc, argv);
+
   global_illumination_sample_t sample("../resources/sponza/sponza.obj");
   sample.addDirectionalLight(vec3(0.0, 1.75, 0.0), vec3(0.0f, 1.0f, 0.1f), vec3(1.0f, 1.0f, 1.0f), 0.0f);
   sample.loop();
@@ -26,12 +26,15 @@
 #include "framework/camera.h"
 
 #include "core/render.h"
+#include "core/gpu-primitives.h"
 #include "core/window.h"
 #include "core/image.h"
 #include "core/mesh.h"
 #include "core/maths.h"
 #include "core/timer.h"
 
+#include <string>
+
 using namespace bkk;
 using namespace bkk::core;
 using namespace bkk::core::maths;
@@ -61,6 +64,16 @@ static const char* gVertexShaderSource = R"(
   {
     particle_t data[];
   }particles;  
+
+  layout(set = 0, binding = 3)  readonly buffer SORTED_PARTICLES
+  {
+    uint index[];
+  }sortedParticles;
+
+  layout(set = 0, binding = 4)  readonly buffer ALIVE_PARTICLES
+  {
+    uint count;
+  }aliveParticles;
   
   mat3 rotationFromEuler( vec3 eulerAngles )
   {
@@ -92,11 +105,20 @@ static const char* gVertexShaderSource = R"(
   layout(location = 1) out vec2 uv;
   void main(void)
   { 
-    color = particles.data[gl_InstanceIndex].color;
+    if( uint(gl_InstanceIndex) >= aliveParticles.count )
+    {
+      //Instance not alive. Output a degenerate primitive outside the view volume
+      gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+      return;
+    }
+
+    //Particles are drawn back to front following the sorted alive list
+    uint particleIndex = sortedParticles.index[gl_InstanceIndex];
+    color = particles.data[particleIndex].color;
     uv = aTextCoord;    
       
-    mat3 rotation = rotationFromEuler(particles.data[gl_InstanceIndex].angle);
-    vec3 localPosition = aPosition.xyz * rotation * particles.data[gl_InstanceIndex].scale + particles.data[gl_InstanceIndex].position;
+    mat3 rotation = rotationFromEuler(particles.data[particleIndex].angle);
+    vec3 localPosition = aPosition.xyz * rotation * particles.data[particleIndex].scale + particles.data[particleIndex].position;
     gl_Position = uniforms.modelViewProjection * vec4(localPosition, 1.0);
     
   }
@@ -112,13 +134,13 @@ static const char* gFragmentShaderSource = R"(
   void main(void)
   {
     vec4 textureColor = texture( particleTexture, uv );
-    if( textureColor.a < 0.5 ) discard;
+    if( textureColor.a == 0.0 ) discard;
     result = textureColor * color;
   }
 )";
 
+//Version directive and subgroup helpers are added when the shader is created
 static const char* gComputeShader = R"(
-  #version 440 core
   #extension GL_ARB_separate_shader_objects : enable
   #extension GL_ARB_shading_language_420pack : enable
   layout (local_size_x = 64, local_size_y = 1) in;
@@ -159,6 +181,28 @@ static const char* gComputeShader = R"(
     vec2 initialVelocity_;
     vec3 angularVelocity_;
   }globals;
+
+  layout (std140, binding = 3) uniform UNIFORMS
+  {
+    mat4 modelView;
+    mat4 modelViewProjection;
+  }uniforms;
+
+  //Alive list. Keys are view depths and values particle indices
+  layout (std430, binding = 4) buffer ALIVE_PARTICLES
+  {
+    uint count;
+  }aliveParticles;
+
+  layout (std430, binding = 5) writeonly buffer SORT_KEYS
+  {
+    uint data[];
+  }sortKeys;
+
+  layout (std430, binding = 6) writeonly buffer SORT_VALUES
+  {
+    uint data[];
+  }sortValues;
   
   //Pseudo-random number generation
   uint rng_state = 0;
@@ -197,7 +241,7 @@ static const char* gComputeShader = R"(
   {    
     initRand();
     uint particleIndex = gl_GlobalInvocationID.x;    
-    if( particleIndex > globals.maxParticleCount_ )
+    if( particleIndex >= globals.maxParticleCount_ )
     {
       return;      
     }
@@ -212,7 +256,9 @@ static const char* gComputeShader = R"(
     if( particlesState.data[particleIndex].age < 0 )
     {      
       //Emit if required
-      if( atomicAdd( globals.particlesToEmit_, -1 ) > 0 )
+      int particlesToEmit;
+      ATOMIC_ADD_AGGREGATED( int, globals.particlesToEmit_, -1, particlesToEmit );
+      if( particlesToEmit > 0 )
       {
         //Initialize particle
         particles.data[particleIndex].scale = mix( globals.scale_.x, globals.scale_.y, rand() );
@@ -240,6 +286,16 @@ static const char* gComputeShader = R"(
       particles.data[particleIndex].angle += globals.angularVelocity_.xyz;
       particles.data[particleIndex].position +=  particlesState.data[particleIndex].velocity.xyz * globals.deltaTime_;
     }
+
+    if( particlesState.data[particleIndex].age >= 0 )
+    {
+      //Add to the alive list. Farthest particles get the smallest keys so the sorted list is back to front
+      uint aliveIndex;
+      ATOMIC_ADD_AGGREGATED( uint, aliveParticles.count, 1u, aliveIndex );
+      vec4 viewPosition = uniforms.modelView * vec4( particles.data[particleIndex].position, 1.0 );
+      sortKeys.data[aliveIndex] = ~floatBitsToUint( max( -viewPosition.z, 0.0 ) );
+      sortValues.data[aliveIndex] = particleIndex;
+    }
   }
 )";
 
@@ -339,24 +395,44 @@ public:
       render::gpu_memory_type_e::HOST_VISIBLE_COHERENT,
       (void*)&particleSystem_, sizeof(particle_system_t),
       nullptr, &particleGlobalsBuffer_);
+
+    //Create alive list buffers. The alive list is sorted by view depth every frame
+    u32 aliveCount = 0u;
+    render::gpuBufferCreate(context, usage,
+      render::gpu_memory_type_e::HOST_VISIBLE_COHERENT,
+      (void*)&aliveCount, sizeof(u32),
+      nullptr, &aliveCountBuffer_);
+
+    render::gpuBufferCreate(context, usage, render::gpu_memory_type_e::DEVICE_LOCAL,
+      nullptr, sizeof(u32)*particleSystem_.maxParticleCount_,
+      nullptr, &sortKeysBuffer_);
+
+    render::gpuBufferCreate(context, usage, render::gpu_memory_type_e::DEVICE_LOCAL,
+      nullptr, sizeof(u32)*particleSystem_.maxParticleCount_,
+      nullptr, &sortedIndicesBuffer_);
+
+    render::radixSortCreate(context, render::radix_sort_t::KEY_32BIT, particleSystem_.maxParticleCount_, aliveCountBuffer_, sortKeysBuffer_, sortedIndicesBuffer_, &radixSort_);
     
     //Create pipeline and descriptor set layouts
-    render::descriptor_binding_t bindings[3] = { { render::descriptor_t::type::UNIFORM_BUFFER, 0u, render::descriptor_t::stage::VERTEX },
+    render::descriptor_binding_t bindings[5] = { { render::descriptor_t::type::UNIFORM_BUFFER, 0u, render::descriptor_t::stage::VERTEX },
                                                  { render::descriptor_t::type::STORAGE_BUFFER, 1u, render::descriptor_t::stage::VERTEX },
-                                                 { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 2u, render::descriptor_t::stage::FRAGMENT } };
+                                                 { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 2u, render::descriptor_t::stage::FRAGMENT },
+                                                 { render::descriptor_t::type::STORAGE_BUFFER, 3u, render::descriptor_t::stage::VERTEX },
+                                                 { render::descriptor_t::type::STORAGE_BUFFER, 4u, render::descriptor_t::stage::VERTEX } };
 
-    render::descriptorSetLayoutCreate(context, bindings, 3u, &descriptorSetLayout_);
+    render::descriptorSetLayoutCreate(context, bindings, 5u, &descriptorSetLayout_);
     render::pipelineLayoutCreate(context, &descriptorSetLayout_, 1u, nullptr, 0u, &pipelineLayout_);
 
     render::descriptorPoolCreate(context, 2u,
       render::combined_image_sampler_count(1u),
-      render::uniform_buffer_count(1u),
-      render::storage_buffer_count(4u),
+      render::uniform_buffer_count(2u),
+      render::storage_buffer_count(9u),
       render::storage_image_count(0u),
       &descriptorPool_);
 
     //Create descriptor set
-    render::descriptor_t descriptors[3] = { render::getDescriptor(globalUnifomBuffer_), render::getDescriptor(particleBuffer_), render::getDescriptor(particleTexture_) };
+    render::descriptor_t descriptors[5] = { render::getDescriptor(globalUnifomBuffer_), render::getDescriptor(particleBuffer_), render::getDescriptor(particleTexture_),
+                                            render::getDescriptor(sortedIndicesBuffer_), render::getDescriptor(aliveCountBuffer_) };
     render::descriptorSetCreate(context, descriptorPool_, descriptorSetLayout_, descriptors, &descriptorSet_);
 
     //Create pipeline
@@ -367,10 +443,16 @@ public:
     pipelineDesc.scissorRect_ = { { 0,0 },{ context.swapChain_.imageWidth_,context.swapChain_.imageHeight_ } };
     pipelineDesc.blendState_.resize(1);
     pipelineDesc.blendState_[0].colorWriteMask = 0xF;
-    pipelineDesc.blendState_[0].blendEnable = VK_FALSE;
+    pipelineDesc.blendState_[0].blendEnable = VK_TRUE;
+    pipelineDesc.blendState_[0].colorBlendOp = VK_BLEND_OP_ADD;
+    pipelineDesc.blendState_[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    pipelineDesc.blendState_[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    pipelineDesc.blendState_[0].alphaBlendOp = VK_BLEND_OP_ADD;
+    pipelineDesc.blendState_[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    pipelineDesc.blendState_[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     pipelineDesc.cullMode_ = VK_CULL_MODE_NONE;
     pipelineDesc.depthTestEnabled_ = true;
-    pipelineDesc.depthWriteEnabled_ = true;
+    pipelineDesc.depthWriteEnabled_ = false;
     pipelineDesc.depthTestFunction_ = VK_COMPARE_OP_LESS_OR_EQUAL;
     pipelineDesc.vertexShader_ = vertexShader_;
     pipelineDesc.fragmentShader_ = fragmentShader_;
@@ -399,7 +481,10 @@ public:
     render::gpuBufferDestroy(context, nullptr, &particleGlobalsBuffer_);
     render::gpuBufferDestroy(context, nullptr, &particleBuffer_);
     render::gpuBufferDestroy(context, nullptr, &particleStateBuffer_);
-    
+    render::gpuBufferDestroy(context, nullptr, &aliveCountBuffer_);
+    render::gpuBufferDestroy(context, nullptr, &sortKeysBuffer_);
+    render::gpuBufferDestroy(context, nullptr, &sortedIndicesBuffer_);
+    render::radixSortDestroy(context, &radixSort_);
 
     render::shaderDestroy(context, &computeShader_);
     render::descriptorSetDestroy(context, &computeDescriptorSet_);
@@ -433,6 +518,9 @@ public:
     }
 
     render::gpuBufferUpdate(context, (void*)&particleSystem_, 0u, 8u, &particleGlobalsBuffer_);
+
+    u32 aliveCount = 0u;
+    render::gpuBufferUpdate(context, (void*)&aliveCount, 0u, sizeof(u32), &aliveCountBuffer_);
     render::commandBufferSubmit(context, computeCommandBuffer_);
     //vkQueueWaitIdle(context.computeQueue_.handle_);
   }
@@ -513,19 +601,26 @@ public:
     render::context_t& context = getRenderContext();
 
     //Create descriptor layout
-    render::descriptor_binding_t bindings[3] = { { render::descriptor_t::type::STORAGE_BUFFER, 0, render::descriptor_t::stage::COMPUTE },
+    render::descriptor_binding_t bindings[7] = { { render::descriptor_t::type::STORAGE_BUFFER, 0, render::descriptor_t::stage::COMPUTE },
                                                  { render::descriptor_t::type::STORAGE_BUFFER, 1, render::descriptor_t::stage::COMPUTE },
-                                                 { render::descriptor_t::type::STORAGE_BUFFER, 2, render::descriptor_t::stage::COMPUTE } };
+                                                 { render::descriptor_t::type::STORAGE_BUFFER, 2, render::descriptor_t::stage::COMPUTE },
+                                                 { render::descriptor_t::type::UNIFORM_BUFFER, 3, render::descriptor_t::stage::COMPUTE },
+                                                 { render::descriptor_t::type::STORAGE_BUFFER, 4, render::descriptor_t::stage::COMPUTE },
+                                                 { render::descriptor_t::type::STORAGE_BUFFER, 5, render::descriptor_t::stage::COMPUTE },
+                                                 { render::descriptor_t::type::STORAGE_BUFFER, 6, render::descriptor_t::stage::COMPUTE } };
 
-    render::descriptorSetLayoutCreate(context, bindings, 3u, &computeDescriptorSetLayout_);
+    render::descriptorSetLayoutCreate(context, bindings, 7u, &computeDescriptorSetLayout_);
     render::pipelineLayoutCreate(context, &computeDescriptorSetLayout_, 1u, nullptr, 0u, &computePipelineLayout_);
 
     //Create descriptor set
-    render::descriptor_t descriptors[3] = { render::getDescriptor(particleBuffer_), render::getDescriptor(particleStateBuffer_), render::getDescriptor(particleGlobalsBuffer_) };
+    render::descriptor_t descriptors[7] = { render::getDescriptor(particleBuffer_), render::getDescriptor(particleStateBuffer_), render::getDescriptor(particleGlobalsBuffer_),
+                                            render::getDescriptor(globalUnifomBuffer_), render::getDescriptor(aliveCountBuffer_),
+                                            render::getDescriptor(sortKeysBuffer_), render::getDescriptor(sortedIndicesBuffer_) };
     render::descriptorSetCreate(context, descriptorPool_, computeDescriptorSetLayout_, descriptors, &computeDescriptorSet_);
 
     //Create pipeline
-    render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, gComputeShader, &computeShader_);
+    std::string computeShaderSource = std::string("#version 440 core\n") + render::getSubgroupHelpersGLSL(context) + gComputeShader;
+    render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, computeShaderSource.c_str(), &computeShader_);
     render::computePipelineCreate(context, computePipelineLayout_, computeShader_, &computePipeline_);
 
     //Build compute command buffer
@@ -535,6 +630,9 @@ public:
     render::descriptorSetBind(computeCommandBuffer_, computePipelineLayout_, 0, &computeDescriptorSet_, 1u);
     u32 groupSizeX = (particleSystem_.maxParticleCount_ + 63) / 64;
     render::computeDispatch(computeCommandBuffer_, groupSizeX, 1, 1);
+
+    //Sort alive particles by view depth
+    render::radixSort(computeCommandBuffer_, radixSort_);
     render::commandBufferEnd(computeCommandBuffer_);
   }
 
@@ -558,6 +656,10 @@ private:
   render::gpu_buffer_t particleGlobalsBuffer_;
   render::gpu_buffer_t particleBuffer_;
   render::gpu_buffer_t particleStateBuffer_;
+  render::gpu_buffer_t aliveCountBuffer_;
+  render::gpu_buffer_t sortKeysBuffer_;
+  render::gpu_buffer_t sortedIndicesBuffer_;
+  render::radix_sort_t radixSort_;
   render::pipeline_layout_t computePipelineLayout_;
   render::descriptor_set_layout_t computeDescriptorSetLayout_;
   render::descriptor_set_t computeDescriptorSet_;
@@ -572,8 +674,10 @@ private:
 };
 
 //Entry point
-int main()
+int main(int argc, char** argv)
 {
+  framework::application_t::parseCommandLine(argc, argv);
+
   particles_sample_t sample;
   sample.loop();
   return 0;
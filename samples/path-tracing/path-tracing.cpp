@@ -30,6 +30,7 @@
 #include "core/image.h"
 #include "core/mesh.h"
 #include "core/maths.h"
+#include "core/workgroup-autotune.h"
 
 using namespace bkk;
 using namespace bkk::core;
@@ -139,7 +140,7 @@ public:
 
     render::descriptorSetDestroy(context, &computeDescriptorSet_);
     render::descriptorSetLayoutDestroy(context, &computeDescriptorSetLayout_);    
-    render::computePipelineDestroy(context, &computePipeline_);
+    render::computeKernelDestroy(context, &computeKernel_);
     render::pipelineLayoutDestroy(context, &computePipelineLayout_);
     render::commandBufferDestroy(context, &computeCommandBuffer_);
 
@@ -378,7 +379,8 @@ private:
 
     //Create pipeline
     render::shaderCreateFromGLSL(context, render::shader_t::COMPUTE_SHADER, "../path-tracing/path-tracing.comp", &computeShader_);    
-    render::computePipelineCreate(context, computePipelineLayout_, computeShader_, &computePipeline_);
+    render::computeKernelCreate(context, computePipelineLayout_, computeShader_, render::specialization_constants_t(), "path-tracing",
+      imageSize_.x, imageSize_.y, 1u, &computeDescriptorSet_, 1u, &computeKernel_);
   }
   
   void buildPresentationCommandBuffers()
@@ -404,9 +406,9 @@ private:
 
     render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, render::command_buffer_t::COMPUTE, &computeCommandBuffer_);
     render::commandBufferBegin(context, computeCommandBuffer_);
-    render::computePipelineBind(computeCommandBuffer_, computePipeline_);
+    render::computePipelineBind(computeCommandBuffer_, computeKernel_.pipeline_);
     render::descriptorSetBind(computeCommandBuffer_, computePipelineLayout_, 0, &computeDescriptorSet_, 1u);
-    render::computeDispatch(computeCommandBuffer_, (imageSize_.x + 15) / 16, (imageSize_.y + 15) / 16, 1);
+    render::computeDispatch(computeCommandBuffer_, computeKernel_, imageSize_.x, imageSize_.y, 1u);
     render::commandBufferEnd(computeCommandBuffer_);
   }
 
@@ -432,7 +434,7 @@ private:
   render::pipeline_layout_t computePipelineLayout_;
   render::descriptor_set_layout_t computeDescriptorSetLayout_;
   render::descriptor_set_t computeDescriptorSet_;
-  render::compute_pipeline_t computePipeline_;
+  render::compute_kernel_t computeKernel_;
   render::command_buffer_t computeCommandBuffer_;
 
   render::gpu_buffer_t sceneBuffer_;
@@ -448,8 +450,10 @@ private:
 
 
 //Entry point
-int main()
+int main(int argc, char** argv)
 {
+  framework::application_t::parseCommandLine(argc, argv);
+
   path_tracing_sample_t sample(1200u, 800u);
   sample.loop();
 
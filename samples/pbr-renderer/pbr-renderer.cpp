@@ -1111,8 +1111,10 @@ private:
   framework::free_camera_t camera_;
 };
 
-int main()
+int main(int argc, char** argv)
 {
+  framework::application_t::parseCommandLine(argc, argv);
+
   pbr_renderer_t renderer;
 
   //Generate scene
@@ -22,9 +22,11 @@
 * SOFTWARE.
 */
 #include <string>
+#include <float.h>
 
 #include "framework/application.h"
 #include "framework/camera.h"
+#include "framework/shadow-atlas.h"
 
 #include "core/render.h"
 #include "core/window.h"
@@ -118,6 +120,7 @@ static const char* gPointLightPassVertexShaderSource = R"(
     vec4 position;
     vec3 color;
     float radius;
+    uint shadowTile;
   }light;
 
   layout(location = 0) out vec3 lightPositionVS;
@@ -149,11 +152,24 @@ static const char* gPointLightPassFragmentShaderSource = R"(
     vec4 position;
     vec3 color;
     float radius;
+    uint shadowTile;
   }light;
 
   layout(set = 1, binding = 0) uniform sampler2D RT0;
   layout(set = 1, binding = 1) uniform sampler2D RT1;
   layout(set = 1, binding = 2) uniform sampler2D RT2;
+  layout(set = 1, binding = 4) uniform sampler2DShadow shadowAtlas;
+
+  struct shadow_tile_t
+  {
+    mat4 worldToClip;
+    vec4 rect;
+  };
+
+  layout(std430, set = 1, binding = 5) readonly buffer SHADOW_TILES
+  {
+    shadow_tile_t shadowTiles[];
+  };
 
   layout(location = 0) in vec3 lightPositionVS;
   
@@ -202,6 +218,48 @@ static const char* gPointLightPassFragmentShaderSource = R"(
     return ggx1 * ggx2;
   }
 
+  float shadowAttenuation(vec3 positionVS, vec3 normalVS)
+  {
+    if(light.shadowTile == 0xFFFFFFFF)
+      return 1.0;
+
+    //Select the cube face (+X,-X,+Y,-Y,+Z,-Z) that contains the fragment
+    vec3 positionWS = (scene.viewToWorld * vec4(positionVS, 1.0)).xyz;
+    vec3 lightToPosition = positionWS - light.position.xyz;
+    vec3 absLightToPosition = abs(lightToPosition);
+    uint face;
+    if(absLightToPosition.x >= absLightToPosition.y && absLightToPosition.x >= absLightToPosition.z)
+      face = lightToPosition.x > 0.0 ? 0u : 1u;
+    else if(absLightToPosition.y >= absLightToPosition.z)
+      face = lightToPosition.y > 0.0 ? 2u : 3u;
+    else
+      face = lightToPosition.z > 0.0 ? 4u : 5u;
+
+    shadow_tile_t tile = shadowTiles[light.shadowTile + face];
+    if(tile.rect.z == 0.0)
+      return 1.0;
+
+    //Offset the position along the normal by the size of a texel to avoid acne
+    vec2 atlasTexelSize = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    float texelSize = 2.0 * length(lightToPosition) * atlasTexelSize.x / tile.rect.z;
+    positionWS += (scene.viewToWorld * vec4(normalVS, 0.0)).xyz * 1.5 * texelSize;
+    vec4 positionInLightClipSpace = tile.worldToClip * vec4(positionWS, 1.0);
+    positionInLightClipSpace.xyz /= positionInLightClipSpace.w;
+
+    //Clamp to keep the filter footprint inside the tile
+    vec2 uv = tile.rect.xy + (0.5 * positionInLightClipSpace.xy + 0.5) * tile.rect.zw;
+    uv = clamp(uv, tile.rect.xy + 1.5 * atlasTexelSize, tile.rect.xy + tile.rect.zw - 1.5 * atlasTexelSize);
+
+    vec2 offset = 0.5 * atlasTexelSize;
+    float reference = positionInLightClipSpace.z;
+    float attenuation = 0.0;
+    attenuation += texture(shadowAtlas, vec3(uv + vec2(-offset.x,-offset.y), reference));
+    attenuation += texture(shadowAtlas, vec3(uv + vec2( offset.x,-offset.y), reference));
+    attenuation += texture(shadowAtlas, vec3(uv + vec2(-offset.x, offset.y), reference));
+    attenuation += texture(shadowAtlas, vec3(uv + vec2( offset.x, offset.y), reference));
+    return 0.25 * attenuation;
+  }
+
   void main(void)
   {
     vec2 uv = gl_FragCoord.xy * scene.imageSize.zw;
@@ -229,7 +287,7 @@ static const char* gPointLightPassFragmentShaderSource = R"(
     vec3 specular = nominator / denominator;
     float lightDistance    = length(lightPositionVS - positionVS);
     float attenuation = 1.0 - clamp( lightDistance / light.radius, 0.0, 1.0);
-    attenuation *= attenuation;
+    attenuation *= attenuation * shadowAttenuation(positionVS, N);
     float NdotL =  max( 0.0, dot( N, L ) );
     result = vec4( (kD * albedo / PI + specular) * (light.color*attenuation) * NdotL, 1.0);
   }
@@ -264,9 +322,8 @@ static const char* gDirectionalLightPassVertexShaderSource = R"(
 )";
 
 
+//Version and multiview helpers are prepended when the shader is created. With multiview the cascades are the layers of an array
 static const char* gDirectionalLightPassFragmentShaderSource = R"(
-  #version 440 core
-
   layout (set = 0, binding = 0) uniform SCENE
   {
     mat4 worldToView;
@@ -280,14 +337,20 @@ static const char* gDirectionalLightPassFragmentShaderSource = R"(
   {
     vec4 direction;
     vec4 color;
-    mat4 worldToLightClipSpace; 
-    vec4 shadowMapSize; 
+    mat4 worldToLightClipSpace[4];
+    vec4 cascadeSplits;
+    vec4 cascadeTexelSize;
+    vec4 shadowMapSize;
   }light;
 
   layout(set = 1, binding = 0) uniform sampler2D RT0;
   layout(set = 1, binding = 1) uniform sampler2D RT1;
   layout(set = 1, binding = 2) uniform sampler2D RT2;
-  layout(set = 1, binding = 3) uniform sampler2D shadowMap;
+#if MULTIVIEW
+  layout(set = 1, binding = 3) uniform sampler2DArrayShadow shadowMap;
+#else
+  layout(set = 1, binding = 3) uniform sampler2DShadow shadowMap;
+#endif
   
   layout(location = 0) out vec4 result;
   
@@ -334,6 +397,43 @@ static const char* gDirectionalLightPassFragmentShaderSource = R"(
     return ggx1 * ggx2;
   }
 
+  float shadowCompare(vec2 uv, int cascade, float reference)
+  {
+#if MULTIVIEW
+    return texture(shadowMap, vec4(uv, cascade, reference));
+#else
+    //Cascades are stored in a 2x2 atlas
+    return texture(shadowMap, vec3(0.5 * (uv + vec2(cascade & 1, cascade >> 1)), reference));
+#endif
+  }
+
+  float shadowAttenuation(vec3 positionVS, vec3 normalVS)
+  {
+    //Select the cascade that contains the fragment
+    int cascade = int(dot(vec4(greaterThan(vec4(-positionVS.z), light.cascadeSplits)), vec4(1.0)));
+    if(cascade > 3)
+      return 1.0;
+
+    //Offset the position along the normal by the size of a texel to avoid acne
+    vec3 positionWS = (scene.viewToWorld * vec4(positionVS, 1.0)).xyz;
+    positionWS += (scene.viewToWorld * vec4(normalVS, 0.0)).xyz * 1.5 * light.cascadeTexelSize[cascade];
+    vec4 positionInLightClipSpace = light.worldToLightClipSpace[cascade] * vec4(positionWS, 1.0);
+    positionInLightClipSpace.xyz /= positionInLightClipSpace.w;
+
+    //Clamp to keep the filter footprint inside the cascade
+    vec2 uv = clamp(0.5 * positionInLightClipSpace.xy + 0.5, 2.0 * light.shadowMapSize.zw, 1.0 - 2.0 * light.shadowMapSize.zw);
+
+    //Four bilinear hardware comparisons cover a 3x3 texels footprint
+    vec2 offset = 0.5 * light.shadowMapSize.zw;
+    float reference = positionInLightClipSpace.z;
+    float attenuation = 0.0;
+    attenuation += shadowCompare(uv + vec2(-offset.x,-offset.y), cascade, reference);
+    attenuation += shadowCompare(uv + vec2( offset.x,-offset.y), cascade, reference);
+    attenuation += shadowCompare(uv + vec2(-offset.x, offset.y), cascade, reference);
+    attenuation += shadowCompare(uv + vec2( offset.x, offset.y), cascade, reference);
+    return 0.25 * attenuation;
+  }
+
   void main(void)
   {
     vec2 uv = gl_FragCoord.xy * scene.imageSize.zw;
@@ -362,29 +462,13 @@ static const char* gDirectionalLightPassFragmentShaderSource = R"(
     float NdotL =  max( 0.0, dot( N, L ) );
     vec3 diffuseColor = albedo / PI;
     vec3 ambientColor = light.color.a * diffuseColor;
-    vec4 postionInLigthClipSpace = light.worldToLightClipSpace * scene.viewToWorld * vec4(positionVS, 1.0 );
-    postionInLigthClipSpace.xyz /= postionInLigthClipSpace.w;
-    postionInLigthClipSpace.xy = 0.5 * postionInLigthClipSpace.xy + 0.5;
-    ivec2 shadowMapUV = ivec2( postionInLigthClipSpace.xy * light.shadowMapSize.xy );
-    float bias = 0.005;//0.0005*tan(acos(NdotL));
-    float attenuation = 0.0;
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2( 0, 0), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2( 1, 0), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2(-1, 0), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2( 0, 1), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2( 0,-1), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2( 1, 1), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2(-1, 1), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2(-1,-1), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation += step( 0.5, float((texelFetch( shadowMap, shadowMapUV+ivec2( 1,-1), 0).r + bias) > postionInLigthClipSpace.z ));
-    attenuation /= 9.0;
+    float attenuation = shadowAttenuation(positionVS, N);
     result = vec4( (kD * diffuseColor + specular) * (light.color.rgb * attenuation) * NdotL + ambientColor, 1.0);
   }
 )";
 
+//Version and multiview helpers are prepended when the shader is created. With multiview each cascade is a view of the pass
 static const char* gShadowPassVertexShaderSource = R"(
-  #version 440 core
-
   layout(location = 0) in vec3 aPosition;
   layout(location = 1) in vec3 aNormal;
   layout(location = 2) in vec2 aUV;
@@ -393,8 +477,10 @@ static const char* gShadowPassVertexShaderSource = R"(
   {
     vec4 direction;
     vec4 color;
-    mat4 worldToLightClipSpace; 
-    vec4 shadowMapSize; 
+    mat4 worldToLightClipSpace[4];
+    vec4 cascadeSplits;
+    vec4 cascadeTexelSize;
+    vec4 shadowMapSize;
   }light;
 
   layout(set = 1, binding = 0) uniform MODEL
@@ -402,20 +488,61 @@ static const char* gShadowPassVertexShaderSource = R"(
     mat4 transform;
   }model;
 
+  layout(push_constant) uniform PushConstants
+  {
+    uint cascade;
+  }pushConstants;
+
   void main(void)
   {
-    gl_Position =  light.worldToLightClipSpace * model.transform * vec4(aPosition,1.0);
+#if MULTIVIEW
+    uint cascade = uint(VIEW_INDEX);
+#else
+    uint cascade = pushConstants.cascade;
+#endif
+    gl_Position =  light.worldToLightClipSpace[cascade] * model.transform * vec4(aPosition,1.0);
   }
 )";
 
 static const char* gShadowPassFragmentShaderSource = R"(
   #version 440 core
 
-  layout(location = 0) out vec4 color;
+  void main(void)
+  {
+  }
+)";
+
+static const char* gAtlasShadowPassVertexShaderSource = R"(
+  #version 440 core
+
+  layout(location = 0) in vec3 aPosition;
+  layout(location = 1) in vec3 aNormal;
+  layout(location = 2) in vec2 aUV;
+
+  struct shadow_tile_t
+  {
+    mat4 worldToClip;
+    vec4 rect;
+  };
+
+  layout(std430, set = 0, binding = 0) readonly buffer SHADOW_TILES
+  {
+    shadow_tile_t shadowTiles[];
+  };
+
+  layout(set = 1, binding = 0) uniform MODEL
+  {
+    mat4 transform;
+  }model;
+
+  layout(push_constant) uniform PushConstants
+  {
+    uint tile;
+  }pushConstants;
 
   void main(void)
   {
-    color = vec4(gl_FragCoord.z,0,0,0);
+    gl_Position =  shadowTiles[pushConstants.tile].worldToClip * model.transform * vec4(aPosition,1.0);
   }
 )";
 
@@ -447,6 +574,15 @@ static const char* gPresentationFragmentShaderSource = R"(
   }
 )";
 
+//Directional light shadows use cascades. With multiview they are the layers of an array rendered in a single pass, otherwise they are stored in a 2x2 atlas
+static const uint32_t gShadowCascadeCount = 4u;
+
+//Point light shadows are packed in a shadow atlas. Tile sizes go from 128 to 1024 texels and at most 12 tiles are rendered per frame
+static const uint32_t gShadowAtlasSize = 4096u;
+static const uint32_t gShadowAtlasMinTileSize = 128u;
+static const uint32_t gShadowAtlasMaxTileSize = 1024u;
+static const uint32_t gShadowAtlasTileBudget = 12u;
+
 class scene_sample_t : public framework::application_t
 {
 public:
@@ -457,11 +593,13 @@ public:
       maths::vec4 position_;
       maths::vec3 color_;
       float radius_;
+      uint32_t shadowTile_;   //First tile of the light in the shadow atlas
     };
 
     uniforms_t uniforms_;
     render::gpu_buffer_t ubo_;
     render::descriptor_set_t descriptorSet_;
+    framework::shadow_handle_t shadow_;
   };
 
   struct directional_light_t
@@ -469,19 +607,25 @@ public:
     struct uniforms_t
     {
       maths::vec4 direction_;
-      maths::vec4 color_;             //RGB is light color, A is ambient
-      maths::mat4 worldToClipSpace_;  //Transforms points from world space to light clip space
-      maths::vec4 shadowMapSize_;
+      maths::vec4 color_;                                   //RGB is light color, A is ambient
+      maths::mat4 worldToClipSpace_[gShadowCascadeCount];   //Transforms points from world space to each cascade clip space
+      maths::vec4 cascadeSplits_;                           //View space distance where each cascade ends
+      maths::vec4 cascadeTexelSize_;                        //World space size of a shadow map texel in each cascade
+      maths::vec4 shadowMapSize_;                           //Size of a cascade in texels
     };
 
-
     uniforms_t uniforms_;
-    maths::vec3 position_;  //For shadow map rendering
-    maths::mat4 viewProjection_;
     render::gpu_buffer_t ubo_;
     render::descriptor_set_t descriptorSet_;
   };
 
+  struct shadow_cascade_t
+  {
+    float extent_;            //Half size of the cascade window in light space
+    maths::vec2 center_;      //Snapped center of the cascade window in light space
+    bool cacheValid_;         //Static casters cached for the current window
+  };
+
   struct material_t
   {
     struct uniforms_t
@@ -505,6 +649,7 @@ public:
     core::handle_t transform_;
     render::gpu_buffer_t ubo_;
     render::descriptor_set_t descriptorSet_;
+    bool dynamic_;            //Dynamic objects are drawn every frame on top of the cached static shadows
   };
 
   struct scene_uniforms_t
@@ -532,7 +677,7 @@ public:
     render::descriptorPoolCreate(context, 1000u,
       render::combined_image_sampler_count(1000u),
       render::uniform_buffer_count(1000u),
-      render::storage_buffer_count(0u),
+      render::storage_buffer_count(2u),
       render::storage_image_count(0u),
       &descriptorPool_);
 
@@ -563,7 +708,8 @@ public:
     camera_.position_ = vec3(-1.1f, 0.6f, -0.1f);
     camera_.angle_ = vec2(0.2f, 1.57f);
     camera_.Update();
-    uniforms_.projectionMatrix_ = perspectiveProjectionMatrix(1.2f, (f32)size.x / (f32)size.y, 0.01f, 10.0f);
+    cameraAspect_ = (f32)size.x / (f32)size.y;
+    uniforms_.projectionMatrix_ = perspectiveProjectionMatrix(cameraFov_, cameraAspect_, cameraNearPlane_, cameraFarPlane_);
     invertMatrix(uniforms_.projectionMatrix_, uniforms_.projectionInverseMatrix_);
     uniforms_.worldToViewMatrix_ = camera_.view_;
     uniforms_.viewToWorldMatrix_ = camera_.tx_;
@@ -589,10 +735,31 @@ public:
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &finalImage_);
     render::depthStencilBufferCreate(context, size.x, size.y, &depthStencilBuffer_);
 
-    //Shadow map
-    render::texture2DCreate(context, shadowMapSize_, shadowMapSize_, 1u, VK_FORMAT_R16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &shadowMap_);
-    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &shadowMap_);
-    render::depthStencilBufferCreate(context, shadowMapSize_, shadowMapSize_, &shadowPassDepthStencilBuffer);
+    //Shadow map. Static casters are rendered into shadowMapCache_ only when their cascade is invalidated. Every frame the cache
+    //is copied to shadowMap_ and dynamic casters are rendered on top
+    multiviewShadows_ = render::multiviewSupported(context);
+    render::texture_sampler_t shadowSampler = {};
+    shadowSampler.wrapU_ = shadowSampler.wrapV_ = shadowSampler.wrapW_ = render::texture_sampler_t::wrap_mode::CLAMP_TO_EDGE;
+    shadowSampler.mipmap_ = render::texture_sampler_t::filter_mode::NEAREST;
+    render::texture_sampler_t shadowCompareSampler = shadowSampler;
+    shadowCompareSampler.depthCompare_ = true;
+    if (multiviewShadows_)
+    {
+      //Invalidated layers of the cache are cleared with transfer commands
+      uint32_t cascadeSize = shadowMapSize_ / 2;
+      render::texture2DArrayCreate(context, cascadeSize, cascadeSize, gShadowCascadeCount, 1u, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, shadowSampler, &shadowMapCache_);
+      render::texture2DArrayCreate(context, cascadeSize, cascadeSize, gShadowCascadeCount, 1u, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, shadowCompareSampler, &shadowMap_);
+    }
+    else
+    {
+      render::texture2DCreate(context, shadowMapSize_, shadowMapSize_, 1u, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, shadowSampler, &shadowMapCache_);
+      render::texture2DCreate(context, shadowMapSize_, shadowMapSize_, 1u, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, shadowCompareSampler, &shadowMap_);
+    }
+    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, getShadowMapLayers(), &shadowMapCache_);
+    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, getShadowMapLayers(), &shadowMap_);
+
+    //Shadow atlas for point lights
+    shadowAtlas_.initialize(context, gShadowAtlasSize, gShadowAtlasMinTileSize, gShadowAtlasMaxTileSize, gShadowAtlasTileBudget);
 
     //Presentation descriptor set layout and pipeline layout
     binding = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, render::descriptor_t::stage::FRAGMENT };
@@ -609,6 +776,21 @@ public:
     descriptor = render::getDescriptor(gBufferRT2_);
     render::descriptorSetCreate(context, descriptorPool_, presentationDescriptorSetLayout_, &descriptor, &presentationDescriptorSet_[3]);
     descriptor = render::getDescriptor(shadowMap_);
+    descriptor.imageDescriptor_.sampler = shadowMapCache_.sampler_;  //Shadow map sampler does depth comparison
+    if (multiviewShadows_)
+    {
+      //The presentation shader samples a 2D texture. Show the first cascade
+      VkImageViewCreateInfo imageViewCreateInfo = {};
+      imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      imageViewCreateInfo.format = shadowMap_.format_;
+      imageViewCreateInfo.image = shadowMap_.image_;
+      imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+      imageViewCreateInfo.subresourceRange.levelCount = 1u;
+      imageViewCreateInfo.subresourceRange.layerCount = 1u;
+      imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      vkCreateImageView(context.device_, &imageViewCreateInfo, nullptr, &shadowMapPresentationView_);
+      descriptor.imageDescriptor_.imageView = shadowMapPresentationView_;
+    }
     render::descriptorSetCreate(context, descriptorPool_, presentationDescriptorSetLayout_, &descriptor, &presentationDescriptorSet_[4]);
 
     //Create presentation pipeline
@@ -628,6 +810,7 @@ public:
     render::graphicsPipelineCreate(context, context.swapChain_.renderPass_, 0u, fullScreenQuad_.vertexFormat_, presentationPipelineLayout_, pipelineDesc, &presentationPipeline_);
 
     initializeOffscreenPass(context, size);
+    initializeShadowAtlasPass(context);
     buildPresentationCommandBuffers();
     load(url);
   }
@@ -665,7 +848,7 @@ public:
     return material_.add(material);
   }
 
-  core::handle_t addObject(core::handle_t meshId, core::handle_t materialId, const maths::mat4& transform)
+  core::handle_t addObject(core::handle_t meshId, core::handle_t materialId, const maths::mat4& transform, bool isDynamic = false)
   {
     render::context_t& context = getRenderContext();
 
@@ -678,30 +861,56 @@ public:
       &allocator_, &ubo);
 
     object_t object = { meshId, materialId, transformId, ubo };
+    object.dynamic_ = isDynamic;
     render::descriptor_t descriptor = render::getDescriptor(object.ubo_);
     render::descriptorSetCreate(context, descriptorPool_, objectDescriptorSetLayout_, &descriptor, &object.descriptorSet_);
+
+    if (!isDynamic)
+    {
+      invalidateShadowCache();
+    }
+
+    invalidatePointLightShadows(object, transform);
     return object_.add(object);
   }
+
+  void setObjectTransform(core::handle_t objectId, const maths::mat4& transform)
+  {
+    object_t* object = object_.get(objectId);
+    if (object != nullptr)
+    {
+      //Shadows need to be updated both where the object was and where it is now
+      invalidatePointLightShadows(*object, *transformManager_.getWorldMatrix(object->transform_));
+      invalidatePointLightShadows(*object, transform);
+      transformManager_.setTransform(object->transform_, transform);
+      if (!object->dynamic_)
+      {
+        invalidateShadowCache();
+      }
+    }
+  }
+
+  void setDirectionalLightDirection(const maths::vec3& direction)
+  {
+    if (directionalLight_ != nullptr)
+    {
+      directionalLight_->uniforms_.direction_ = maths::vec4(normalize(direction), 0.0f);
+      invalidateShadowCache();
+    }
+  }
   
-  void addDirectionalLight(const maths::vec3& position, const maths::vec3& direction, const maths::vec3& color, float ambient)
+  void addDirectionalLight(const maths::vec3& direction, const maths::vec3& color, float ambient)
   {
     if (directionalLight_ == nullptr)
     {
       render::context_t& context = getRenderContext();
 
       directionalLight_ = new directional_light_t;
-
-      vec3 lightDirection = normalize(direction);
-      directionalLight_->uniforms_.direction_ = maths::vec4(lightDirection, 0.0f);
+      directionalLight_->uniforms_.direction_ = maths::vec4(normalize(direction), 0.0f);
       directionalLight_->uniforms_.color_ = vec4(color, ambient);
 
-      mat4 lightViewMatrix;
-      quat orientation(vec3(0.0f, 0.0f, 1.0f), lightDirection);
-      mat4 lightModelMatrix = maths::createTransform(position, VEC3_ONE, orientation);
-      invertMatrix(lightModelMatrix, lightViewMatrix);
-
-      directionalLight_->uniforms_.worldToClipSpace_ = lightViewMatrix * orthographicProjectionMatrix(-1.0f, 1.0f, 1.0f, -1.0f, 0.01f, 2.0f);
-      directionalLight_->uniforms_.shadowMapSize_ = vec4((float)shadowMapSize_, (float)shadowMapSize_, 1.0f / (float)shadowMapSize_, 1.0f / (float)shadowMapSize_);
+      uint32_t cascadeSize = shadowMapSize_ / 2;
+      directionalLight_->uniforms_.shadowMapSize_ = vec4((float)cascadeSize, (float)cascadeSize, 1.0f / (float)cascadeSize, 1.0f / (float)cascadeSize);
 
       //Create uniform buffer and descriptor set
       render::gpuBufferCreate(context, render::gpu_buffer_t::usage::UNIFORM_BUFFER,
@@ -712,6 +921,7 @@ public:
       render::descriptorSetCreate(context, descriptorPool_, lightDescriptorSetLayout_, &descriptor, &directionalLight_->descriptorSet_);
 
       initializeShadowPass(context);
+      invalidateShadowCache();
     }
   }
 
@@ -724,6 +934,9 @@ public:
     light.uniforms_.position_ = maths::vec4(position, 1.0);
     light.uniforms_.color_ = color;
     light.uniforms_.radius_ = radius;
+    light.shadow_ = shadowAtlas_.pointShadowCreate(position, radius);
+    light.uniforms_.shadowTile_ = shadowAtlas_.getFirstTile(light.shadow_);
+
     //Create uniform buffer and descriptor set
     render::gpuBufferCreate(context, render::gpu_buffer_t::usage::UNIFORM_BUFFER,
       &light.uniforms_, sizeof(point_light_t::uniforms_t),
@@ -767,6 +980,14 @@ public:
       render::gpuBufferUpdate(context, &lights[i].uniforms_.position_, 0, sizeof(vec4), &lights[i].ubo_);
     }
 
+    if (directionalLight_ != nullptr)
+    {
+      updateShadowCascades();
+      render::gpuBufferUpdate(context, &directionalLight_->uniforms_, 0, sizeof(directional_light_t::uniforms_t), &directionalLight_->ubo_);
+    }
+
+    shadowAtlas_.update(context, uniforms_.worldToViewMatrix_, uniforms_.projectionMatrix_, (uint32_t)uniforms_.imageSize_.y);
+
     buildAndSubmitCommandBuffer();
     render::presentFrame(&context, &renderComplete_, 1u);
   }
@@ -874,18 +1095,26 @@ public:
       render::gpuBufferDestroy(context, &allocator_, &directionalLight_->ubo_);
       render::descriptorSetDestroy(context, &directionalLight_->descriptorSet_);
       render::shaderDestroy(context, &shadowVertexShader_);
-      render::shaderDestroy(context, &shadowFragmentShader_);
       render::graphicsPipelineDestroy(context, &shadowPipeline_);
       render::pipelineLayoutDestroy(context, &shadowPipelineLayout_);
       render::descriptorSetDestroy(context, &shadowGlobalsDescriptorSet_);
       render::descriptorSetLayoutDestroy(context, &shadowGlobalsDescriptorSetLayout_);
       render::frameBufferDestroy(context, &shadowFrameBuffer_);
+      render::frameBufferDestroy(context, &shadowCacheFrameBuffer_);
       render::renderPassDestroy(context, &shadowRenderPass_);
-      render::commandBufferDestroy(context, &shadowCommandBuffer_);
-      render::semaphoreDestroy(context, shadowPassComplete_);
       delete directionalLight_;
     }
 
+    shadowAtlas_.destroy(context);
+    render::shaderDestroy(context, &atlasShadowVertexShader_);
+    render::shaderDestroy(context, &shadowFragmentShader_);
+    render::graphicsPipelineDestroy(context, &atlasShadowPipeline_);
+    render::pipelineLayoutDestroy(context, &atlasShadowPipelineLayout_);
+    render::descriptorSetDestroy(context, &atlasShadowDescriptorSet_);
+    render::descriptorSetLayoutDestroy(context, &atlasShadowDescriptorSetLayout_);
+    render::commandBufferDestroy(context, &shadowCommandBuffer_);
+    render::semaphoreDestroy(context, shadowPassComplete_);
+
     render::shaderDestroy(context, &gBuffervertexShader_);
     render::shaderDestroy(context, &gBufferfragmentShader_);
     render::shaderDestroy(context, &pointLightVertexShader_);
@@ -926,7 +1155,11 @@ public:
     render::textureDestroy(context, &defaultDiffuseMap_);
     render::depthStencilBufferDestroy(context, &depthStencilBuffer_);
     render::textureDestroy(context, &shadowMap_);
-    render::depthStencilBufferDestroy(context, &shadowPassDepthStencilBuffer);
+    render::textureDestroy(context, &shadowMapCache_);
+    if (shadowMapPresentationView_ != VK_NULL_HANDLE)
+    {
+      vkDestroyImageView(context.device_, shadowMapPresentationView_, nullptr);
+    }
 
     mesh::destroy(context, &fullScreenQuad_);
     mesh::destroy(context, &sphereMesh_);
@@ -987,67 +1220,45 @@ private:
   }
   void initializeShadowPass(render::context_t& context)
   {
-    shadowPassComplete_ = render::semaphoreCreate(context);
-
+    //Depth only render pass. Cascades not being rendered are preserved, so contents are loaded and
+    //cascades are cleared individually when needed. With multiview the pass renders all the cascades at once
     shadowRenderPass_ = {};
-    render::render_pass_t::attachment_t shadowAttachments[2];
-    shadowAttachments[0].format_ = shadowMap_.format_;
-    shadowAttachments[0].initialLayout_ = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    shadowAttachments[0].finallLayout_ = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    shadowAttachments[0].storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
-    shadowAttachments[0].loadOp_ = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    shadowAttachments[0].samples_ = VK_SAMPLE_COUNT_1_BIT;
-
-    shadowAttachments[1].format_ = depthStencilBuffer_.format_;
-    shadowAttachments[1].initialLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    shadowAttachments[1].finallLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    shadowAttachments[1].storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
-    shadowAttachments[1].loadOp_ = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    shadowAttachments[1].samples_ = VK_SAMPLE_COUNT_1_BIT;
+    render::render_pass_t::attachment_t shadowAttachment;
+    shadowAttachment.format_ = shadowMap_.format_;
+    shadowAttachment.initialLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    shadowAttachment.finallLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    shadowAttachment.storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
+    shadowAttachment.loadOp_ = VK_ATTACHMENT_LOAD_OP_LOAD;
+    shadowAttachment.samples_ = VK_SAMPLE_COUNT_1_BIT;
 
     render::render_pass_t::subpass_t shadowPass;
-    shadowPass.colorAttachmentIndex_.push_back(0);
-    shadowPass.depthStencilAttachmentIndex_ = 1;
-
-    //Dependency chain for layout transitions
-    render::render_pass_t::subpass_dependency_t shadowDependencies[2];
-    shadowDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-    shadowDependencies[0].dstSubpass = 0;
-    shadowDependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    shadowDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    shadowDependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    shadowDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    shadowDependencies[1].srcSubpass = 0;
-    shadowDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    shadowDependencies[1].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    shadowDependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    shadowDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    shadowDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    render::renderPassCreate(context, shadowAttachments, 2u, &shadowPass, 1u, nullptr, 0u, &shadowRenderPass_);
+    shadowPass.depthStencilAttachmentIndex_ = 0;
+    if (multiviewShadows_)
+    {
+      shadowPass.viewMask_ = (1u << gShadowCascadeCount) - 1u;
+    }
+    render::renderPassCreate(context, &shadowAttachment, 1u, &shadowPass, 1u, nullptr, 0u, &shadowRenderPass_);
 
-    //Create frame buffer
-    VkImageView shadowFbAttachment[2] = { shadowMap_.imageView_, shadowPassDepthStencilBuffer.imageView_ };
-    render::frameBufferCreate(context, shadowMapSize_, shadowMapSize_, shadowRenderPass_, shadowFbAttachment, &shadowFrameBuffer_);
+    //Create frame buffers for the static casters cache and the final shadow map
+    uint32_t frameBufferSize = shadowMap_.extent_.width;
+    render::frameBufferCreate(context, frameBufferSize, frameBufferSize, shadowRenderPass_, &shadowMapCache_.imageView_, &shadowCacheFrameBuffer_);
+    render::frameBufferCreate(context, frameBufferSize, frameBufferSize, shadowRenderPass_, &shadowMap_.imageView_, &shadowFrameBuffer_);
 
-    //Create shadow pipeline layout
+    //Create shadow pipeline layout. Cascade index is sent as a push constant
     render::descriptor_binding_t binding = { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT };
     render::descriptorSetLayoutCreate(context, &binding, 1u, &shadowGlobalsDescriptorSetLayout_);
     render::descriptor_t descriptor = render::getDescriptor(directionalLight_->ubo_);
     render::descriptorSetCreate(context, descriptorPool_, shadowGlobalsDescriptorSetLayout_, &descriptor, &shadowGlobalsDescriptorSet_);
     render::descriptor_set_layout_t shadowDescriptorSetLayouts[2] = { shadowGlobalsDescriptorSetLayout_, objectDescriptorSetLayout_ };
-    render::pipelineLayoutCreate(context, shadowDescriptorSetLayouts, 2, nullptr, 0u, &shadowPipelineLayout_);
+    render::push_constant_range_t pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, sizeof(uint32_t), 0u };
+    render::pipelineLayoutCreate(context, shadowDescriptorSetLayouts, 2, &pushConstantRange, 1u, &shadowPipelineLayout_);
 
     //Create shadow pipeline
-    render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, gShadowPassVertexShaderSource, &shadowVertexShader_);
-    render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, gShadowPassFragmentShaderSource, &shadowFragmentShader_);
+    std::string shadowVertexShaderSource = std::string("#version 440 core\n") + render::getMultiviewHelpersGLSL(context) + gShadowPassVertexShaderSource;
+    render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, shadowVertexShaderSource.c_str(), &shadowVertexShader_);
     render::graphics_pipeline_t::description_t shadowPipelineDesc = {};
-    shadowPipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)shadowMapSize_, (float)shadowMapSize_, 0.0f, 1.0f };
-    shadowPipelineDesc.scissorRect_ = { { 0,0 },{ shadowMapSize_, shadowMapSize_ } };
-    shadowPipelineDesc.blendState_.resize(1);
-    shadowPipelineDesc.blendState_[0].colorWriteMask = 0xF;
-    shadowPipelineDesc.blendState_[0].blendEnable = VK_FALSE;
+    shadowPipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)frameBufferSize, (float)frameBufferSize, 0.0f, 1.0f };
+    shadowPipelineDesc.scissorRect_ = { { 0,0 },{ frameBufferSize, frameBufferSize } };
     shadowPipelineDesc.cullMode_ = VK_CULL_MODE_NONE;
     shadowPipelineDesc.depthTestEnabled_ = true;
     shadowPipelineDesc.depthWriteEnabled_ = true;
@@ -1057,9 +1268,415 @@ private:
     render::graphicsPipelineCreate(context, shadowRenderPass_.handle_, 0u, vertexFormat_, shadowPipelineLayout_, shadowPipelineDesc, &shadowPipeline_);
   }
 
+  void initializeShadowAtlasPass(render::context_t& context)
+  {
+    //Shadow atlas pipeline layout. Tile matrices are read from the atlas tile buffer and the tile index is sent as a push constant
+    render::descriptor_binding_t binding = { render::descriptor_t::type::STORAGE_BUFFER, 0, render::descriptor_t::stage::VERTEX };
+    render::descriptorSetLayoutCreate(context, &binding, 1u, &atlasShadowDescriptorSetLayout_);
+    render::descriptor_t descriptor = render::getDescriptor(shadowAtlas_.getTileBuffer());
+    render::descriptorSetCreate(context, descriptorPool_, atlasShadowDescriptorSetLayout_, &descriptor, &atlasShadowDescriptorSet_);
+    render::descriptor_set_layout_t descriptorSetLayouts[2] = { atlasShadowDescriptorSetLayout_, objectDescriptorSetLayout_ };
+    render::push_constant_range_t pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, sizeof(uint32_t), 0u };
+    render::pipelineLayoutCreate(context, descriptorSetLayouts, 2, &pushConstantRange, 1u, &atlasShadowPipelineLayout_);
+
+    //Shadow atlas pipeline
+    render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, gAtlasShadowPassVertexShaderSource, &atlasShadowVertexShader_);
+    render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, gShadowPassFragmentShaderSource, &shadowFragmentShader_);
+    render::graphics_pipeline_t::description_t pipelineDesc = {};
+    pipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)gShadowAtlasSize, (float)gShadowAtlasSize, 0.0f, 1.0f };
+    pipelineDesc.scissorRect_ = { { 0,0 },{ gShadowAtlasSize, gShadowAtlasSize } };
+    pipelineDesc.cullMode_ = VK_CULL_MODE_NONE;
+    pipelineDesc.depthTestEnabled_ = true;
+    pipelineDesc.depthWriteEnabled_ = true;
+    pipelineDesc.depthTestFunction_ = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipelineDesc.vertexShader_ = atlasShadowVertexShader_;
+    pipelineDesc.fragmentShader_ = shadowFragmentShader_;
+    render::graphicsPipelineCreate(context, shadowAtlas_.getRenderPass().handle_, 0u, vertexFormat_, atlasShadowPipelineLayout_, pipelineDesc, &atlasShadowPipeline_);
+  }
+
+  //Invalidates the shadows of the point lights in range of the object
+  void invalidatePointLightShadows(const object_t& object, const maths::mat4& worldTransform)
+  {
+    vec3 boundsMin, boundsMax;
+    getBounds(object, worldTransform, &boundsMin, &boundsMax);
+
+    point_light_t* lights;
+    uint32_t lightCount = pointLight_.getData(&lights);
+    for (uint32_t i(0); i < lightCount; ++i)
+    {
+      if (shadowAtlas_.isInTileRange(lights[i].uniforms_.shadowTile_, boundsMin, boundsMax))
+      {
+        shadowAtlas_.shadowInvalidate(lights[i].shadow_);
+      }
+    }
+  }
+
+  void invalidateShadowCache()
+  {
+    for (uint32_t i(0); i < gShadowCascadeCount; ++i)
+    {
+      shadowCascade_[i].cacheValid_ = false;
+    }
+    shadowCasterBoundsDirty_ = true;
+  }
+
+  //Computes the light space bounds of an object's mesh
+  void getLightSpaceBounds(const object_t& object, const maths::mat4& worldToLightView, maths::vec3* boundsMin, maths::vec3* boundsMax)
+  {
+    getBounds(object, (*transformManager_.getWorldMatrix(object.transform_)) * worldToLightView, boundsMin, boundsMax);
+  }
+
+  //Computes the bounds of an object's mesh transformed by the given matrix
+  void getBounds(const object_t& object, const maths::mat4& transform, maths::vec3* boundsMin, maths::vec3* boundsMax)
+  {
+    const mesh::aabb_t& aabb = mesh_.get(object.mesh_)->aabb_;
+    vec3 center = (aabb.min_ + aabb.max_) * 0.5f;
+    vec3 extent = (aabb.max_ - aabb.min_) * 0.5f;
+    vec4 lightSpaceCenter = vec4(center, 1.0f) * transform;
+    vec3 lightSpaceExtent;
+    for (uint32_t i(0); i < 3; ++i)
+    {
+      lightSpaceExtent[i] = fabsf(transform[i]) * extent.x + fabsf(transform[4 + i]) * extent.y + fabsf(transform[8 + i]) * extent.z;
+    }
+
+    *boundsMin = lightSpaceCenter.xyz() - lightSpaceExtent;
+    *boundsMax = lightSpaceCenter.xyz() + lightSpaceExtent;
+  }
+
+  //Fits each cascade to the camera frustum and invalidates the cascades whose window moved
+  void updateShadowCascades()
+  {
+    //Light view. The light camera looks along the light rays (-direction)
+    vec3 lightDirection = directionalLight_->uniforms_.direction_.xyz();
+    vec3 up = fabsf(lightDirection.y) > 0.99f ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f);
+    mat4 worldToLightView = lookAtMatrix(lightDirection, VEC3_ZERO, up);
+
+    //Light space bounds of the casters. Static bounds only change when the cache is invalidated
+    object_t* objects = nullptr;
+    uint32_t objectCount = object_.getData(&objects);
+    casterBoundsMin_.resize(objectCount);
+    casterBoundsMax_.resize(objectCount);
+    for (uint32_t i(0); i < objectCount; ++i)
+    {
+      if (objects[i].dynamic_ || shadowCasterBoundsDirty_)
+      {
+        getLightSpaceBounds(objects[i], worldToLightView, &casterBoundsMin_[i], &casterBoundsMax_[i]);
+      }
+    }
+
+    if (shadowCasterBoundsDirty_)
+    {
+      //Depth range of the cascades covers all the casters
+      shadowDepthRange_ = vec2(FLT_MAX, -FLT_MAX);
+      for (uint32_t i(0); i < objectCount; ++i)
+      {
+        shadowDepthRange_.x = minValue(shadowDepthRange_.x, -casterBoundsMax_[i].z);
+        shadowDepthRange_.y = maxValue(shadowDepthRange_.y, -casterBoundsMin_[i].z);
+      }
+
+      float margin = 0.1f * (shadowDepthRange_.y - shadowDepthRange_.x);
+      shadowDepthRange_ = vec2(shadowDepthRange_.x - margin, shadowDepthRange_.y + margin);
+      shadowCasterBoundsDirty_ = false;
+    }
+
+    //Cascade splits. Blend between logarithmic and uniform distributions
+    const float splitLambda = 0.75f;
+    float splits[gShadowCascadeCount + 1];
+    splits[0] = cameraNearPlane_;
+    for (uint32_t i(1); i <= gShadowCascadeCount; ++i)
+    {
+      float t = (float)i / (float)gShadowCascadeCount;
+      float logSplit = cameraNearPlane_ * powf(cameraFarPlane_ / cameraNearPlane_, t);
+      float uniformSplit = cameraNearPlane_ + (cameraFarPlane_ - cameraNearPlane_) * t;
+      splits[i] = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+    }
+
+    uint32_t cascadeSize = shadowMapSize_ / 2;
+    float tanHalfFovY = tanf(0.5f * cameraFov_);
+    float tanHalfFovX = tanHalfFovY * cameraAspect_;
+    for (uint32_t i(0); i < gShadowCascadeCount; ++i)
+    {
+      //Bounding sphere of the frustum slice. It doesn't depend on the camera orientation so the cascade size is stable
+      float nearPlane = splits[i];
+      float farPlane = splits[i + 1];
+      float centerDistance = minValue(farPlane, 0.5f * (nearPlane + farPlane) * (1.0f + tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY));
+      vec3 farCorner(farPlane * tanHalfFovX, farPlane * tanHalfFovY, farPlane - centerDistance);
+      vec3 nearCorner(nearPlane * tanHalfFovX, nearPlane * tanHalfFovY, nearPlane - centerDistance);
+      float radius = maxValue(length(farCorner), length(nearCorner));
+
+      //Window is bigger than the sphere and moves in coarse steps, so the cache survives small camera movements.
+      //Steps are a whole number of texels to avoid shimmering
+      float extent = 1.25f * radius;
+      float texelSize = 2.0f * extent / (float)cascadeSize;
+      float step = floorf(0.25f * radius / texelSize) * texelSize;
+      vec4 center = vec4(0.0f, 0.0f, -centerDistance, 1.0f) * camera_.tx_ * worldToLightView;
+      vec2 snappedCenter(floorf(center.x / step + 0.5f) * step, floorf(center.y / step + 0.5f) * step);
+
+      shadow_cascade_t& cascade = shadowCascade_[i];
+      if (!cascade.cacheValid_ || cascade.extent_ != extent || cascade.center_.x != snappedCenter.x || cascade.center_.y != snappedCenter.y)
+      {
+        cascade.extent_ = extent;
+        cascade.center_ = snappedCenter;
+        cascade.cacheValid_ = false;
+
+        //Orthographic projection of the window. Depth is mapped to [0,1]
+        float depthRange = shadowDepthRange_.y - shadowDepthRange_.x;
+        mat4 projection;
+        projection[0] = 1.0f / extent;
+        projection[5] = 1.0f / extent;
+        projection[10] = -1.0f / depthRange;
+        projection[12] = -snappedCenter.x / extent;
+        projection[13] = -snappedCenter.y / extent;
+        projection[14] = -shadowDepthRange_.x / depthRange;
+        directionalLight_->uniforms_.worldToClipSpace_[i] = worldToLightView * projection;
+      }
+
+      directionalLight_->uniforms_.cascadeSplits_[i] = farPlane;
+      directionalLight_->uniforms_.cascadeTexelSize_[i] = texelSize;
+    }
+  }
+
+  //Returns true if the caster may cast shadows inside the cascade
+  bool isVisibleInCascade(uint32_t objectIndex, const shadow_cascade_t& cascade)
+  {
+    return casterBoundsMax_[objectIndex].x >= cascade.center_.x - cascade.extent_ && casterBoundsMin_[objectIndex].x <= cascade.center_.x + cascade.extent_ &&
+           casterBoundsMax_[objectIndex].y >= cascade.center_.y - cascade.extent_ && casterBoundsMin_[objectIndex].y <= cascade.center_.y + cascade.extent_;
+  }
+
+  //Draws static or dynamic casters overlapping the cascade
+  void drawShadowCasters(uint32_t cascadeIndex, bool dynamicCasters)
+  {
+    uint32_t cascadeSize = shadowMapSize_ / 2;
+    int32_t x = (cascadeIndex & 1) * cascadeSize;
+    int32_t y = (cascadeIndex >> 1) * cascadeSize;
+    render::setViewport(shadowCommandBuffer_, x, y, cascadeSize, cascadeSize);
+    render::setScissor(shadowCommandBuffer_, x, y, cascadeSize, cascadeSize);
+    render::pushConstants(shadowCommandBuffer_, shadowPipelineLayout_, 0u, &cascadeIndex);
+
+    object_t* objects = nullptr;
+    uint32_t objectCount = object_.getData(&objects);
+    for (uint32_t i(0); i < objectCount; ++i)
+    {
+      if (objects[i].dynamic_ == dynamicCasters && isVisibleInCascade(i, shadowCascade_[cascadeIndex]))
+      {
+        render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 1, &objects[i].descriptorSet_, 1u);
+        mesh::draw(shadowCommandBuffer_, *mesh_.get(objects[i].mesh_));
+      }
+    }
+  }
+
+  //Draws static or dynamic casters overlapping any of the cascades in the mask. With multiview a single draw renders all the cascades
+  void drawShadowCastersMultiview(uint32_t cascadeMask, bool dynamicCasters)
+  {
+    uint32_t cascadeSize = shadowMap_.extent_.width;
+    render::setViewport(shadowCommandBuffer_, 0, 0, cascadeSize, cascadeSize);
+    render::setScissor(shadowCommandBuffer_, 0, 0, cascadeSize, cascadeSize);
+
+    object_t* objects = nullptr;
+    uint32_t objectCount = object_.getData(&objects);
+    for (uint32_t i(0); i < objectCount; ++i)
+    {
+      if (objects[i].dynamic_ != dynamicCasters)
+        continue;
+
+      bool visible = false;
+      for (uint32_t cascade(0); cascade < gShadowCascadeCount && !visible; ++cascade)
+      {
+        visible = (cascadeMask & (1u << cascade)) != 0u && isVisibleInCascade(i, shadowCascade_[cascade]);
+      }
+
+      if (visible)
+      {
+        render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 1, &objects[i].descriptorSet_, 1u);
+        mesh::draw(shadowCommandBuffer_, *mesh_.get(objects[i].mesh_));
+      }
+    }
+  }
+
+  //Layout changes of the shadow maps cover all the cascades when they are the layers of an array
+  VkImageSubresourceRange getShadowMapLayers() const
+  {
+    VkImageSubresourceRange subresourceRange = {};
+    subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    subresourceRange.levelCount = 1u;
+    subresourceRange.layerCount = multiviewShadows_ ? gShadowCascadeCount : 1u;
+    return subresourceRange;
+  }
+
+  void shadowMapChangeLayout(VkImageLayout layout, render::texture_t* shadowMap)
+  {
+    render::textureChangeLayout(shadowCommandBuffer_, layout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, getShadowMapLayers(), shadowMap);
+  }
+
+  void buildShadowCommandBuffer()
+  {
+    render::context_t& context = getRenderContext();
+
+    if (shadowCommandBuffer_.handle_ == VK_NULL_HANDLE)
+    {
+      render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, &shadowPassComplete_, 1u, render::command_buffer_t::GRAPHICS, &shadowCommandBuffer_);
+    }
+
+    render::commandBufferBegin(context, shadowCommandBuffer_);
+    if (directionalLight_ != nullptr)
+    {
+      renderShadowCascades();
+    }
+    renderShadowAtlasTiles();
+    render::commandBufferEnd(shadowCommandBuffer_);
+  }
+
+  void renderShadowCascades()
+  {
+    render::context_t& context = getRenderContext();
+
+    bool hasDynamicCasters = false;
+    object_t* objects = nullptr;
+    uint32_t objectCount = object_.getData(&objects);
+    for (uint32_t i(0); i < objectCount; ++i)
+    {
+      hasDynamicCasters |= objects[i].dynamic_;
+    }
+
+    //Render static casters in the invalidated cascades
+    uint32_t invalidCascades = 0u;
+    for (uint32_t i(0); i < gShadowCascadeCount; ++i)
+    {
+      if (!shadowCascade_[i].cacheValid_)
+      {
+        invalidCascades |= 1u << i;
+      }
+    }
+
+    if (invalidCascades != 0u)
+    {
+      if (multiviewShadows_)
+      {
+        //Clears inside a multiview pass affect all the views, so invalidated layers are cleared before it
+        shadowMapChangeLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &shadowMapCache_);
+        VkClearDepthStencilValue clearValue = { 1.0f, 0 };
+        for (uint32_t i(0); i < gShadowCascadeCount; ++i)
+        {
+          if (invalidCascades & (1u << i))
+          {
+            VkImageSubresourceRange layer = { VK_IMAGE_ASPECT_DEPTH_BIT, 0u, 1u, i, 1u };
+            vkCmdClearDepthStencilImage(shadowCommandBuffer_.handle_, shadowMapCache_.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1u, &layer);
+          }
+        }
+      }
+
+      shadowMapChangeLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, &shadowMapCache_);
+      render::commandBufferRenderPassBegin(context, &shadowCacheFrameBuffer_, nullptr, 0u, shadowCommandBuffer_);
+      render::graphicsPipelineBind(shadowCommandBuffer_, shadowPipeline_);
+      render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 0, &shadowGlobalsDescriptorSet_, 1u);
+
+      if (multiviewShadows_)
+      {
+        //Casters are drawn to all the cascades. Valid cascades already have the same static casters at the same depth, so they don't change
+        drawShadowCastersMultiview(invalidCascades, false);
+      }
+      else
+      {
+        uint32_t cascadeSize = shadowMapSize_ / 2;
+        for (uint32_t i(0); i < gShadowCascadeCount; ++i)
+        {
+          if (invalidCascades & (1u << i))
+          {
+            VkClearAttachment clearAttachment = {};
+            clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+            clearAttachment.clearValue.depthStencil = { 1.0f, 0 };
+            VkClearRect clearRect = { { { (int32_t)((i & 1) * cascadeSize), (int32_t)((i >> 1) * cascadeSize) },{ cascadeSize, cascadeSize } }, 0u, 1u };
+            vkCmdClearAttachments(shadowCommandBuffer_.handle_, 1u, &clearAttachment, 1u, &clearRect);
+            drawShadowCasters(i, false);
+          }
+        }
+      }
+
+      for (uint32_t i(0); i < gShadowCascadeCount; ++i)
+      {
+        shadowCascade_[i].cacheValid_ = true;
+      }
+
+      render::commandBufferRenderPassEnd(shadowCommandBuffer_);
+      shadowMapChangeLayout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, &shadowMapCache_);
+    }
+
+    //Copy the cache and render dynamic casters on top
+    shadowMapChangeLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &shadowMap_);
+    if (multiviewShadows_)
+    {
+      for (uint32_t i(0); i < gShadowCascadeCount; ++i)
+      {
+        render::textureCopy(shadowCommandBuffer_, &shadowMapCache_, &shadowMap_, shadowMap_.extent_.width, shadowMap_.extent_.height, 0u, i, 0u, i);
+      }
+    }
+    else
+    {
+      render::textureCopy(shadowCommandBuffer_, &shadowMapCache_, &shadowMap_, shadowMapSize_, shadowMapSize_);
+    }
+
+    if (hasDynamicCasters)
+    {
+      shadowMapChangeLayout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, &shadowMap_);
+      render::commandBufferRenderPassBegin(context, &shadowFrameBuffer_, nullptr, 0u, shadowCommandBuffer_);
+      render::graphicsPipelineBind(shadowCommandBuffer_, shadowPipeline_);
+      render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 0, &shadowGlobalsDescriptorSet_, 1u);
+      if (multiviewShadows_)
+      {
+        drawShadowCastersMultiview((1u << gShadowCascadeCount) - 1u, true);
+      }
+      else
+      {
+        for (uint32_t i(0); i < gShadowCascadeCount; ++i)
+        {
+          drawShadowCasters(i, true);
+        }
+      }
+      render::commandBufferRenderPassEnd(shadowCommandBuffer_);
+    }
+    shadowMapChangeLayout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &shadowMap_);
+  }
+
+  //Renders the point light shadow tiles scheduled by the shadow atlas this frame
+  void renderShadowAtlasTiles()
+  {
+    const uint32_t* tiles;
+    uint32_t tileCount = shadowAtlas_.getTilesToRender(&tiles);
+    if (tileCount == 0u)
+      return;
+
+    object_t* objects = nullptr;
+    uint32_t objectCount = object_.getData(&objects);
+    casterWorldBoundsMin_.resize(objectCount);
+    casterWorldBoundsMax_.resize(objectCount);
+    for (uint32_t i(0); i < objectCount; ++i)
+    {
+      getBounds(objects[i], *transformManager_.getWorldMatrix(objects[i].transform_), &casterWorldBoundsMin_[i], &casterWorldBoundsMax_[i]);
+    }
+
+    shadowAtlas_.renderPassBegin(getRenderContext(), shadowCommandBuffer_);
+    render::graphicsPipelineBind(shadowCommandBuffer_, atlasShadowPipeline_);
+    render::descriptorSetBind(shadowCommandBuffer_, atlasShadowPipelineLayout_, 0, &atlasShadowDescriptorSet_, 1u);
+    for (uint32_t i(0); i < tileCount; ++i)
+    {
+      shadowAtlas_.setTile(shadowCommandBuffer_, tiles[i]);
+      render::pushConstants(shadowCommandBuffer_, atlasShadowPipelineLayout_, 0u, &tiles[i]);
+      for (uint32_t j(0); j < objectCount; ++j)
+      {
+        if (shadowAtlas_.isInTileRange(tiles[i], casterWorldBoundsMin_[j], casterWorldBoundsMax_[j]))
+        {
+          render::descriptorSetBind(shadowCommandBuffer_, atlasShadowPipelineLayout_, 1, &objects[j].descriptorSet_, 1u);
+          mesh::draw(shadowCommandBuffer_, *mesh_.get(objects[j].mesh_));
+        }
+      }
+    }
+    shadowAtlas_.renderPassEnd(shadowCommandBuffer_);
+  }
+
   void initializeOffscreenPass(render::context_t& context, const uvec2& size)
   {
-    //Semaphore to indicate rendering has completed
+    //Semaphores to indicate shadow maps and rendering have completed
+    shadowPassComplete_ = render::semaphoreCreate(context);
     renderComplete_ = render::semaphoreCreate(context);
 
     //Create offscreen render pass (GBuffer + light subpasses)
@@ -1162,22 +1779,26 @@ private:
     render::graphicsPipelineCreate(context, renderPass_.handle_, 0u, vertexFormat_, gBufferPipelineLayout_, pipelineDesc, &gBufferPipeline_);
 
     //Create light pass descriptorSet layouts
-    render::descriptor_binding_t bindings[4];
+    render::descriptor_binding_t bindings[6];
     bindings[0] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, render::descriptor_t::stage::FRAGMENT };
     bindings[1] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 1, render::descriptor_t::stage::FRAGMENT };
     bindings[2] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 2, render::descriptor_t::stage::FRAGMENT };
     bindings[3] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 3, render::descriptor_t::stage::FRAGMENT };
-    render::descriptorSetLayoutCreate(context, bindings, 4u, &lightPassTexturesDescriptorSetLayout_);
+    bindings[4] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 4, render::descriptor_t::stage::FRAGMENT };
+    bindings[5] = { render::descriptor_t::type::STORAGE_BUFFER, 5, render::descriptor_t::stage::FRAGMENT };
+    render::descriptorSetLayoutCreate(context, bindings, 6u, &lightPassTexturesDescriptorSetLayout_);
 
     render::descriptor_binding_t lightBindings = { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT };
     render::descriptorSetLayoutCreate(context, &lightBindings, 1u, &lightDescriptorSetLayout_);
 
-    //Create descriptor sets for light pass (GBuffer textures)
-    render::descriptor_t descriptors[4];
+    //Create descriptor sets for light pass (GBuffer textures and shadow maps)
+    render::descriptor_t descriptors[6];
     descriptors[0] = render::getDescriptor(gBufferRT0_);
     descriptors[1] = render::getDescriptor(gBufferRT1_);
     descriptors[2] = render::getDescriptor(gBufferRT2_);
     descriptors[3] = render::getDescriptor(shadowMap_);
+    descriptors[4] = render::getDescriptor(shadowAtlas_.getTexture());
+    descriptors[5] = render::getDescriptor(shadowAtlas_.getTileBuffer());
     render::descriptorSetCreate(context, descriptorPool_, lightPassTexturesDescriptorSetLayout_, descriptors, &lightPassTexturesDescriptorSet_);
 
     //Create light pass pipeline layout
@@ -1208,7 +1829,8 @@ private:
 
     //Create directional light pass pipeline
     render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, gDirectionalLightPassVertexShaderSource, &directionalLightVertexShader_);
-    render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, gDirectionalLightPassFragmentShaderSource, &directionalLightFragmentShader_);
+    std::string directionalLightFragmentShaderSource = std::string("#version 440 core\n") + render::getMultiviewHelpersGLSL(context) + gDirectionalLightPassFragmentShaderSource;
+    render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, directionalLightFragmentShaderSource.c_str(), &directionalLightFragmentShader_);
     lightPipelineDesc.cullMode_ = VK_CULL_MODE_BACK_BIT;
     lightPipelineDesc.vertexShader_ = directionalLightVertexShader_;
     lightPipelineDesc.fragmentShader_ = directionalLightFragmentShader_;
@@ -1218,50 +1840,14 @@ private:
   {
     render::context_t& context = getRenderContext();
 
-    //Render shadow map if there is a direcrtional light
-    if (directionalLight_ != nullptr)
-    {
-      if (shadowCommandBuffer_.handle_ == VK_NULL_HANDLE)
-      {
-        render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, &shadowPassComplete_, 1u, render::command_buffer_t::GRAPHICS, &shadowCommandBuffer_);
-        VkClearValue clearValues[2];
-        clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-        clearValues[1].depthStencil = { 1.0f,0 };
-
-        render::commandBufferBegin(context, shadowCommandBuffer_);
-        {
-          render::commandBufferRenderPassBegin(context, &shadowFrameBuffer_, clearValues, 2u, shadowCommandBuffer_);
-          //Shadow pass
-          render::graphicsPipelineBind(shadowCommandBuffer_, shadowPipeline_);
-          render::descriptorSetBind(shadowCommandBuffer_, shadowPipelineLayout_, 0, &shadowGlobalsDescriptorSet_, 1u);
-          packed_freelist_iterator_t<object_t> objectIter = object_.begin();
-          while (objectIter != object_.end())
-          {
-            render::descriptorSetBind(shadowCommandBuffer_, gBufferPipelineLayout_, 1, &objectIter.get().descriptorSet_, 1u);
-            mesh::mesh_t* mesh = mesh_.get(objectIter.get().mesh_);
-            mesh::draw(shadowCommandBuffer_, *mesh);
-            ++objectIter;
-          }
-
-          render::commandBufferRenderPassEnd(shadowCommandBuffer_);
-        }
-        render::commandBufferEnd(shadowCommandBuffer_);
-      }
-
-      render::commandBufferSubmit(context, shadowCommandBuffer_);
-    }
+    //Render directional light cascades and point light shadow tiles
+    buildShadowCommandBuffer();
+    render::commandBufferSubmit(context, shadowCommandBuffer_);
 
     if (commandBuffer_.handle_ == VK_NULL_HANDLE)
     {
-      if (directionalLight_ != nullptr)
-      {
-        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-        render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &shadowPassComplete_, &waitStage, 1, &renderComplete_, 1, render::command_buffer_t::GRAPHICS, &commandBuffer_);
-      }
-      else
-      {
-        render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0, &renderComplete_, 1, render::command_buffer_t::GRAPHICS, &commandBuffer_);
-      }
+      VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, &shadowPassComplete_, &waitStage, 1, &renderComplete_, 1, render::command_buffer_t::GRAPHICS, &commandBuffer_);
 
       VkClearValue clearValues[5];
       clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
@@ -1396,15 +1982,32 @@ private:
   render::command_buffer_t shadowCommandBuffer_;
   render::render_pass_t shadowRenderPass_;
   render::frame_buffer_t shadowFrameBuffer_;
+  render::frame_buffer_t shadowCacheFrameBuffer_;
   render::texture_t shadowMap_;
-  render::depth_stencil_buffer_t shadowPassDepthStencilBuffer;
+  render::texture_t shadowMapCache_;
+  VkImageView shadowMapPresentationView_ = VK_NULL_HANDLE;
+  bool multiviewShadows_ = false;    //Cascades are the layers of an array rendered with a view mask instead of tiles of an atlas
   render::descriptor_set_layout_t shadowGlobalsDescriptorSetLayout_;
   render::pipeline_layout_t shadowPipelineLayout_;
   render::graphics_pipeline_t shadowPipeline_;
   render::shader_t shadowVertexShader_;
   render::shader_t shadowFragmentShader_;
   render::descriptor_set_t shadowGlobalsDescriptorSet_;
-  maths::mat4 worldToLightClipSpace_;
+  shadow_cascade_t shadowCascade_[gShadowCascadeCount] = {};
+  bool shadowCasterBoundsDirty_ = true;
+  maths::vec2 shadowDepthRange_;
+  std::vector<maths::vec3> casterBoundsMin_;
+  std::vector<maths::vec3> casterBoundsMax_;
+  std::vector<maths::vec3> casterWorldBoundsMin_;
+  std::vector<maths::vec3> casterWorldBoundsMax_;
+
+  //Point light shadows
+  framework::shadow_atlas_t shadowAtlas_;
+  render::descriptor_set_layout_t atlasShadowDescriptorSetLayout_;
+  render::descriptor_set_t atlasShadowDescriptorSet_;
+  render::pipeline_layout_t atlasShadowPipelineLayout_;
+  render::graphics_pipeline_t atlasShadowPipeline_;
+  render::shader_t atlasShadowVertexShader_;
 
   render::texture_t defaultDiffuseMap_;
   mesh::mesh_t sphereMesh_;
@@ -1412,17 +2015,31 @@ private:
 
   directional_light_t* directionalLight_ = nullptr;
   framework::free_camera_t camera_;
+  f32 cameraFov_ = 1.2f;
+  f32 cameraAspect_ = 1.0f;
+  f32 cameraNearPlane_ = 0.01f;
+  f32 cameraFarPlane_ = 10.0f;
 };
 
-int main()
+int main(int argc, char** argv)
 {
+  framework::application_t::parseCommandLine(argc, argv);
+
   scene_sample_t scene("../resources/sponza/sponza.obj");
 
   //Lights
-  scene.addDirectionalLight(vec3(0.0, 1.5, 0.0), vec3(0.0f, 1.0f, 0.3f), vec3(5.0f, 5.0f, 5.0f), 0.1f);
+  scene.addDirectionalLight(vec3(0.0f, 1.0f, 0.3f), vec3(5.0f, 5.0f, 5.0f), 0.1f);
   scene.addPointLight(vec3(0.0f, 0.1f, 0.0f), 0.5f, vec3(0.5f, 0.0f, 0.0f));
   scene.addPointLight(vec3(-1.0f, 0.1f, 0.0f), 0.5f, vec3(0.0f, 0.5f, 0.0f));
   scene.addPointLight(vec3(1.0f, 0.1f, 0.0f), 0.5f, vec3(0.0f, 0.0f, 0.5f));
+
+  //Two rows of shadowed point lights along the sides of the atrium
+  for (uint32_t i(0); i < 24u; ++i)
+  {
+    float x = -1.5f + 3.0f * (float)(i % 12u) / 11.0f;
+    float z = (i < 12u) ? -0.4f : 0.4f;
+    scene.addPointLight(vec3(x, 0.15f, z), 0.3f, vec3(0.2f + 0.1f * (float)(i % 3u), 0.2f, 0.2f + 0.1f * (float)((i + 1u) % 3u)));
+  }
   
   scene.loop();
   return 0;
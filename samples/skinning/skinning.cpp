@@ -297,8 +297,10 @@ private:
 };
 
 //Entry point
-int main()
+int main(int argc, char** argv)
 {
+  framework::application_t::parseCommandLine(argc, argv);
+
   skinning_sample_t sample;
   sample.loop();
   return 0;
@@ -0,0 +1,296 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "core/maths.h"
+#include "core/cpu-profiler.h"
+#include "core/timer.h"
+
+#include "framework/application.h"
+#include "framework/camera.h"
+#include "framework/command-buffer.h"
+#include "framework/stress-scene.h"
+
+using namespace bkk::core;
+using namespace bkk::framework;
+
+//Procedural scene for scale testing (see stress_scene_t). Reports the time spent per frame in each subsystem when it quits,
+//so running it headless with increasing actor counts gives the scaling curves of the framework.
+//
+//Usage: stress-scene [options]
+//  --actors <n>         Number of actors. 1000 by default
+//  --meshes <n>         Number of distinct meshes. 4 by default
+//  --materials <n>      Number of materials. 16 by default
+//  --depth <n>          Actors in each transform hierarchy chain. 1 (flat) by default
+//  --lights <n>         Number of moving lights. 64 by default
+//  --dynamic <f>        Fraction of the actors animated every frame. 0.1 by default
+//  --extent <f>         Half size of the area covered by the scene. 50 by default
+//  --report <file>      Writes the scene parameters and the timings to a JSON file
+//Options of application_t (--headless, --seed, --bench, ...) are accepted too.
+//
+//Example: stress-scene --headless 100 --actors 100000 --depth 8 --report stress-100k.json
+
+static stress_scene_desc_t gDesc;
+static const char* gReportFile = nullptr;
+
+class stress_scene_sample_t : public application_t
+{
+public:
+  enum subsystem_e
+  {
+    ANIMATION = 0,    //stress_scene_t::update
+    TRANSFORMS,       //renderer_t::update. Transform hierarchy and actor uniform buffers
+    VISIBILITY,       //renderer_t::setupCamera. Camera, light clustering and culling
+    RECORDING,        //Recording and submission of the command buffers
+    PRESENT,          //renderer_t::presentFrame
+    SUBSYSTEM_COUNT
+  };
+
+  stress_scene_sample_t()
+  :application_t("Stress scene", 1200u, 800u, 3u),
+   cameraController_(maths::vec3(0.0f, 0.5f * gDesc.extent_, 1.2f * gDesc.extent_), maths::vec2(0.5f, 0.0f), 1.0f, 0.01f),
+   time_(0.0f),
+   frame_(0u)
+  {
+    maths::uvec2 imageSize(1200u, 800u);
+    sceneRT_ = renderer_.renderTargetCreate(imageSize.x, imageSize.y, renderer_.getHDRFormat(), true);
+    sceneFBO_ = renderer_.frameBufferCreate(&sceneRT_, 1u);
+
+    //Blinn-Phong shader of the framework test, lit by the clustered lights
+    shader_handle_t shader = renderer_.shaderCreate("../framework-test/simple.shader");
+
+    stress_scene_desc_t desc = gDesc;
+    desc.seed_ = getSeed();
+    timer::time_point_t start = timer::getCurrent();
+    scene_.create(desc, shader, &renderer_);
+    createTime_ = timer::getDifference(start, timer::getCurrent());
+
+    camera_ = renderer_.addCamera(camera_t(camera_t::PERSPECTIVE_PROJECTION, 1.2f, imageSize.x / (float)imageSize.y, 0.1f, 4.0f * gDesc.extent_));
+    cameraController_.setCameraHandle(camera_, &renderer_);
+
+    for (uint32_t i(0); i < SUBSYSTEM_COUNT; ++i)
+    {
+      total_[i] = 0.0;
+      max_[i] = 0.0f;
+    }
+  }
+
+  void onKeyEvent(u32 key, bool pressed)
+  {
+    if (pressed)
+    {
+      float delta = 0.02f * gDesc.extent_;
+      switch (key)
+      {
+        case window::key_e::KEY_UP:
+        case 'w':
+          cameraController_.Move(0.0f, -delta);
+          break;
+
+        case window::key_e::KEY_DOWN:
+        case 's':
+          cameraController_.Move(0.0f, delta);
+          break;
+
+        case window::key_e::KEY_LEFT:
+        case 'a':
+          cameraController_.Move(-delta, 0.0f);
+          break;
+
+        case window::key_e::KEY_RIGHT:
+        case 'd':
+          cameraController_.Move(delta, 0.0f);
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+
+  void onMouseMove(const maths::vec2& mousePos, const maths::vec2 &mouseDeltaPos)
+  {
+    if (getMousePressedButton() == window::MOUSE_RIGHT)
+      cameraController_.Rotate(mouseDeltaPos.x, mouseDeltaPos.y);
+  }
+
+  void render()
+  {
+    float timings[SUBSYSTEM_COUNT];
+    timer::time_point_t t0 = timer::getCurrent();
+
+    time_ += getTimeDelta() / 1000.0f;
+    scene_.update(time_, &renderer_);
+    timer::time_point_t t1 = timer::getCurrent();
+    timings[ANIMATION] = timer::getDifference(t0, t1);
+
+    beginFrame();
+    timer::time_point_t t2 = timer::getCurrent();
+    timings[TRANSFORMS] = timer::getDifference(t1, t2);
+
+    renderer_.setupCamera(camera_);
+    actor_t* visibleActors = nullptr;
+    int count = renderer_.getVisibleActors(camera_, &visibleActors);
+    timer::time_point_t t3 = timer::getCurrent();
+    timings[VISIBILITY] = timer::getDifference(t2, t3);
+
+    command_buffer_t renderSceneCmd(&renderer_, sceneFBO_);
+    renderSceneCmd.clearRenderTargets(maths::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    renderSceneCmd.render(visibleActors, count, "OpaquePass");
+    renderSceneCmd.submit();
+    renderSceneCmd.release();
+
+    command_buffer_t blitToBackbufferCmd(&renderer_, NULL_HANDLE, &renderSceneCmd);
+    blitToBackbufferCmd.clearRenderTargets(maths::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    blitToBackbufferCmd.blit(sceneRT_);
+    blitToBackbufferCmd.submit();
+    blitToBackbufferCmd.release();
+    timer::time_point_t t4 = timer::getCurrent();
+    timings[RECORDING] = timer::getDifference(t3, t4);
+
+    presentFrame();
+    timings[PRESENT] = timer::getDifference(t4, timer::getCurrent());
+
+    //The first frame creates the pipelines and is not representative
+    if (frame_++ > 0u)
+    {
+      for (uint32_t i(0); i < SUBSYSTEM_COUNT; ++i)
+      {
+        total_[i] += timings[i];
+        max_[i] = maths::maxValue(max_[i], timings[i]);
+      }
+    }
+  }
+
+  void buildGuiFrame()
+  {
+    ImGui::Begin("Stress scene");
+    ImGui::LabelText("", "Actors: %u (%u dynamic)", scene_.getDesc().actorCount_, scene_.getDynamicActorCount());
+    ImGui::LabelText("", "Lights: %u", scene_.getLightCount());
+    ImGui::LabelText("", "Triangles: %llu", (unsigned long long)scene_.getTriangleCount());
+    ImGui::LabelText("", "Hierarchy depth: %u", scene_.getDesc().hierarchyDepth_);
+    uint32_t frames = frame_ > 1u ? frame_ - 1u : 1u;
+    for (uint32_t i(0); i < SUBSYSTEM_COUNT; ++i)
+      ImGui::LabelText("", "%s: %.3f ms", getSubsystemName(i), total_[i] / frames);
+    ImGui::End();
+  }
+
+  void onQuit()
+  {
+    uint32_t frames = frame_ > 1u ? frame_ - 1u : 0u;
+    const stress_scene_desc_t& desc = scene_.getDesc();
+    printf("Stress scene: %u actors (%u dynamic), %u meshes, %u materials, depth %u, %u lights, %llu triangles\n",
+           desc.actorCount_, scene_.getDynamicActorCount(), desc.meshCount_, desc.materialCount_, desc.hierarchyDepth_,
+           scene_.getLightCount(), (unsigned long long)scene_.getTriangleCount());
+    printf("  %-12s %10.3f ms\n", "create", createTime_);
+    for (uint32_t i(0); i < SUBSYSTEM_COUNT; ++i)
+      printf("  %-12s %10.3f ms/frame (max %.3f)\n", getSubsystemName(i), frames ? total_[i] / frames : 0.0, max_[i]);
+
+    if (gReportFile && !writeReport(gReportFile, frames))
+      fprintf(stderr, "Unable to write the report to %s\n", gReportFile);
+  }
+
+private:
+  static const char* getSubsystemName(uint32_t subsystem)
+  {
+    static const char* names[SUBSYSTEM_COUNT] = { "animation", "transforms", "visibility", "recording", "present" };
+    return names[subsystem];
+  }
+
+  bool writeReport(const char* fileName, uint32_t frames)
+  {
+    FILE* file = fopen(fileName, "w");
+    if (!file)
+      return false;
+
+    const stress_scene_desc_t& desc = scene_.getDesc();
+    fprintf(file, "{\n");
+    fprintf(file, "  \"actors\": %u,\n", desc.actorCount_);
+    fprintf(file, "  \"dynamicActors\": %u,\n", scene_.getDynamicActorCount());
+    fprintf(file, "  \"meshes\": %u,\n", desc.meshCount_);
+    fprintf(file, "  \"materials\": %u,\n", desc.materialCount_);
+    fprintf(file, "  \"hierarchyDepth\": %u,\n", desc.hierarchyDepth_);
+    fprintf(file, "  \"lights\": %u,\n", scene_.getLightCount());
+    fprintf(file, "  \"triangles\": %llu,\n", (unsigned long long)scene_.getTriangleCount());
+    fprintf(file, "  \"seed\": %u,\n", desc.seed_);
+    fprintf(file, "  \"frames\": %u,\n", frames);
+    fprintf(file, "  \"createTime\": %.4f,\n", createTime_);
+    fprintf(file, "  \"subsystems\": {\n");
+    for (uint32_t i(0); i < SUBSYSTEM_COUNT; ++i)
+    {
+      fprintf(file, "    \"%s\": { \"mean\": %.4f, \"max\": %.4f }%s\n", getSubsystemName(i),
+              frames ? total_[i] / frames : 0.0, max_[i], i + 1 < SUBSYSTEM_COUNT ? "," : "");
+    }
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+    fclose(file);
+    return true;
+  }
+
+  stress_scene_t scene_;
+  frame_buffer_handle_t sceneFBO_;
+  render_target_handle_t sceneRT_;
+  camera_handle_t camera_;
+  free_camera_t cameraController_;
+
+  float time_;                        //Seconds
+  uint32_t frame_;
+  float createTime_;                  //Milliseconds
+  double total_[SUBSYSTEM_COUNT];     //Milliseconds, over all the frames but the first one
+  float max_[SUBSYSTEM_COUNT];
+};
+
+int main(int argc, char** argv)
+{
+  application_t::parseCommandLine(argc, argv);
+  for (int i(1); i < argc - 1; ++i)
+  {
+    if (strcmp(argv[i], "--actors") == 0)
+      gDesc.actorCount_ = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(argv[i], "--meshes") == 0)
+      gDesc.meshCount_ = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(argv[i], "--materials") == 0)
+      gDesc.materialCount_ = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(argv[i], "--depth") == 0)
+      gDesc.hierarchyDepth_ = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(argv[i], "--lights") == 0)
+      gDesc.lightCount_ = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (strcmp(argv[i], "--dynamic") == 0)
+      gDesc.dynamicFraction_ = (float)atof(argv[++i]);
+    else if (strcmp(argv[i], "--extent") == 0)
+      gDesc.extent_ = (float)atof(argv[++i]);
+    else if (strcmp(argv[i], "--report") == 0)
+      gReportFile = argv[++i];
+  }
+
+  stress_scene_sample_t sample;
+  sample.loop();
+
+  return 0;
+}
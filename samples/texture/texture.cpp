@@ -23,6 +23,8 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "core/render.h"
 #include "core/window.h"
@@ -94,15 +96,31 @@ void buildCommandBuffers(const bkk::core::render::context_t& context,const bkk::
   }
 }
 
-int main()
+int main(int argc, char** argv)
 {
-  //Create a window
-  bkk::core::window::window_t window;
-  bkk::core::window::create("Textured Quad", 400u, 400u, &window);
+  //--headless <frames> renders the given number of frames without a window, --output <file> saves the last one
+  uint32_t headlessFrames = 0u;
+  const char* output = nullptr;
+  for (int i(1); i + 1 < argc; ++i)
+  {
+    if (strcmp(argv[i], "--headless") == 0)
+      headlessFrames = (uint32_t)atoi(argv[++i]);
+    else if (strcmp(argv[i], "--output") == 0)
+      output = argv[++i];
+  }
 
-  //Initialize context
+  //Create a window and initialize context
+  bkk::core::window::window_t window;
   bkk::core::render::context_t context;
-  bkk::core::render::contextCreate("Textured Quad", "", window, 3, &context);
+  if (headlessFrames > 0u)
+  {
+    bkk::core::render::contextCreateHeadless("Textured Quad", "", 400u, 400u, 3, &context);
+  }
+  else
+  {
+    bkk::core::window::create("Textured Quad", 400u, 400u, &window);
+    bkk::core::render::contextCreate("Textured Quad", "", window, 3, &context);
+  }
 
   //Create a quad and a texture
   bkk::core::mesh::mesh_t mesh = bkk::core::mesh::fullScreenQuad(context);
@@ -155,11 +173,12 @@ int main()
   //Build command buffers
   buildCommandBuffers(context, mesh, &descriptorSet, &pipelineLayout, &pipeline);
 
+  uint32_t frame = 0u;
   bool quit = false;
   while (!quit)
   {
     bkk::core::window::event_t* event = nullptr;
-    while ((event = bkk::core::window::getNextEvent(&window)))
+    while (headlessFrames == 0u && (event = bkk::core::window::getNextEvent(&window)))
     {
       if (event->type_ == bkk::core::window::EVENT_QUIT)
       {
@@ -174,6 +193,20 @@ int main()
     }
 
     bkk::core::render::presentFrame(&context);
+    if (headlessFrames > 0u && ++frame == headlessFrames)
+    {
+      quit = true;
+    }
+  }
+
+  //Save the last frame
+  if (output)
+  {
+    bkk::core::image::image2D_t image = {};
+    if (bkk::core::render::presentationImageRead(context, &image))
+      bkk::core::image::save(output, image);
+
+    bkk::core::image::unload(&image);
   }
 
   //Wait for all pending operations to be finished
@@ -195,7 +228,10 @@ int main()
   bkk::core::render::contextDestroy(&context);
 
   //Close window
-  bkk::core::window::destroy(&window);
+  if (headlessFrames == 0u)
+  {
+    bkk::core::window::destroy(&window);
+  }
 
   return 0;
 }
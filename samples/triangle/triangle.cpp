@@ -22,9 +22,13 @@
 * SOFTWARE.
 */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "core/render.h"
 #include "core/window.h"
 #include "core/mesh.h"
+#include "core/image.h"
 
 static const char* gVertexShaderSource = R"(
   #version 440 core
@@ -97,15 +101,31 @@ void buildCommandBuffers(const bkk::core::render::context_t& context, const bkk:
   }
 }
 
-int main()
+int main(int argc, char** argv)
 {
-  //Create a window
-  bkk::core::window::window_t window;
-  bkk::core::window::create( "Hello Triangle", 400u, 400u, &window );
+  //--headless <frames> renders the given number of frames without a window, --output <file> saves the last one
+  uint32_t headlessFrames = 0u;
+  const char* output = nullptr;
+  for (int i(1); i + 1 < argc; ++i)
+  {
+    if (strcmp(argv[i], "--headless") == 0)
+      headlessFrames = (uint32_t)atoi(argv[++i]);
+    else if (strcmp(argv[i], "--output") == 0)
+      output = argv[++i];
+  }
 
-  //Create a context
+  //Create a window and a context
+  bkk::core::window::window_t window;
   bkk::core::render::context_t context;
-  bkk::core::render::contextCreate( "Hello triangle", "", window, 3, &context );
+  if (headlessFrames > 0u)
+  {
+    bkk::core::render::contextCreateHeadless( "Hello triangle", "", 400u, 400u, 3, &context );
+  }
+  else
+  {
+    bkk::core::window::create( "Hello Triangle", 400u, 400u, &window );
+    bkk::core::render::contextCreate( "Hello triangle", "", window, 3, &context );
+  }
 
   //Create a mesh
   bkk::core::mesh::mesh_t mesh = createTriangleGeometry( context );
@@ -138,11 +158,12 @@ int main()
   //Build command buffers
   buildCommandBuffers(context, mesh, pipeline);
   
+  uint32_t frame = 0u;
   bool quit = false;
   while( !quit )
   {
     bkk::core::window::event_t* event = nullptr;
-    while( (event = bkk::core::window::getNextEvent( &window )) )
+    while( headlessFrames == 0u && (event = bkk::core::window::getNextEvent( &window )) )
     {
       if( event->type_ == bkk::core::window::EVENT_QUIT )
       {
@@ -157,6 +178,20 @@ int main()
     }
 
     bkk::core::render::presentFrame( &context );
+    if( headlessFrames > 0u && ++frame == headlessFrames )
+    {
+      quit = true;
+    }
+  }
+
+  //Save the last frame
+  if (output)
+  {
+    bkk::core::image::image2D_t image = {};
+    if (bkk::core::render::presentationImageRead(context, &image))
+      bkk::core::image::save(output, image);
+
+    bkk::core::image::unload(&image);
   }
 
   //Wait for all pending operations to be finished
@@ -171,7 +206,10 @@ int main()
   bkk::core::render::contextDestroy( &context );
 
   //Close window
-  bkk::core::window::destroy( &window );
+  if( headlessFrames == 0u )
+  {
+    bkk::core::window::destroy( &window );
+  }
 
   return 0;
 }
\ No newline at end of file
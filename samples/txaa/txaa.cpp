@@ -50,21 +50,31 @@ static const char* gGeometryPassVertexShaderSource = R"(
     mat4 projection;
     mat4 projectionInverse;
     mat4 prevViewProjection;
+    mat4 viewProjection;
     vec4 imageSize;
+    vec4 renderSize;
+    vec4 jitter;
   }scene;
 
   layout(set = 1, binding = 0) uniform MODEL
   {
     mat4 transform;
+    mat4 prevTransform;
   }model;
 
   layout(location = 0) out vec3 normalViewSpace;
+  layout(location = 1) out vec4 currentPosition;
+  layout(location = 2) out vec4 previousPosition;
 
   void main(void)
   {
     mat4 modelView = scene.view * model.transform;
     gl_Position =  scene.projection * modelView * vec4(aPosition,1.0);
     normalViewSpace = normalize((transpose( inverse( modelView) ) * vec4(aNormal,0.0)).xyz);
+
+    //Unjittered positions for motion vectors
+    currentPosition = scene.viewProjection * model.transform * vec4(aPosition,1.0);
+    previousPosition = scene.prevViewProjection * model.prevTransform * vec4(aPosition,1.0);
   }
 )";
 
@@ -82,14 +92,18 @@ static const char* gGeometryPassFragmentShaderSource = R"(
   layout(location = 0) out vec4 RT0;
   layout(location = 1) out vec4 RT1;
   layout(location = 2) out vec4 RT2;
+  layout(location = 3) out vec2 RT3;
 
   layout(location = 0) in vec3 normalViewSpace;
+  layout(location = 1) in vec4 currentPosition;
+  layout(location = 2) in vec4 previousPosition;
 
   void main(void)
   {
     RT0 = vec4(material.albedo,  material.roughness );
     RT1 = vec4(normalize(normalViewSpace),gl_FragCoord.z);
     RT2 = vec4(material.F0, material.metallic);
+    RT3 = 0.5 * (currentPosition.xy / currentPosition.w - previousPosition.xy / previousPosition.w);
   }
 )";
 
@@ -104,7 +118,10 @@ static const char* gLightPassVertexShaderSource = R"(
     mat4 projection;
     mat4 projectionInverse;
     mat4 prevViewProjection;
+    mat4 viewProjection;
     vec4 imageSize;
+    vec4 renderSize;
+    vec4 jitter;
   }scene;
 
   layout (set = 2, binding = 0) uniform LIGHT
@@ -134,7 +151,10 @@ static const char* gLightPassFragmentShaderSource = R"(
     mat4 projection;
     mat4 projectionInverse;
     mat4 prevViewProjection;
+    mat4 viewProjection;
     vec4 imageSize;
+    vec4 renderSize;
+    vec4 jitter;
   }scene;
 
   layout (set = 2, binding = 0) uniform LIGHT
@@ -205,7 +225,7 @@ static const char* gLightPassFragmentShaderSource = R"(
     vec3 N = normalize(RT1Value.xyz); 
     float depth = RT1Value.w;
     vec4 RT2Value = texture(RT2, uv);
-    vec3 positionVS = ViewSpacePositionFromDepth( uv,depth );
+    vec3 positionVS = ViewSpacePositionFromDepth( gl_FragCoord.xy / scene.renderSize.xy, depth );
     vec3 L = normalize( lightPositionVS-positionVS );
     vec3 F0 = RT2Value.xyz;
     float metallic = RT2Value.w;
@@ -239,44 +259,53 @@ static const char* gTxaaResolveFragmentShaderSource = R"(
     mat4 projection;
     mat4 projectionInverse;
     mat4 prevViewProjection;
+    mat4 viewProjection;
     vec4 imageSize;
+    vec4 renderSize;
+    vec4 jitter;
   }scene;
 
   layout (set = 0, binding = 1) uniform sampler2D uRenderedImage;
   layout (set = 0, binding = 2) uniform sampler2D  uHistoryBuffer;
   layout (set = 0, binding = 3) uniform sampler2D  uDepthAndNormals;
+  layout (set = 0, binding = 4) uniform sampler2D  uMotionVectors;
   layout(location = 0) out vec4 color;
 
-  vec2 reproject(vec2 uv, float depth)
+  vec3 renderedImage(ivec2 pixel)
   {
-    vec3 clipSpacePosition = vec3(uv* 2.0 - 1.0, depth);
-    vec4 viewSpacePosition = scene.projectionInverse * vec4(clipSpacePosition,1.0);
-    viewSpacePosition /= viewSpacePosition.w;
-    vec4 worldSpacePos = inverse(scene.view) * viewSpacePosition;
-    vec4 a = scene.prevViewProjection * vec4(worldSpacePos.xyz, 1.0);
-    return vec2( ( a.x/a.w + 1.0 ) * 0.5, (a.y/a.w + 1.0) * 0.5 );
+    return texelFetch(uRenderedImage, clamp(pixel, ivec2(0), ivec2(scene.renderSize.xy) - 1), 0).xyz;
   }
 
   void main(void)
   {
-    vec3 currentFragment = texture(uRenderedImage, uv).xyz; 
-    float depth = texture(uDepthAndNormals, uv).w;
-    vec2 reprojectedUv = reproject(uv, depth);
+    //Scene is rendered in the top left corner of the render targets. Find the closest jittered sample to this output pixel
+    vec2 renderPosition = uv * scene.renderSize.xy;
+    ivec2 samplePixel = clamp(ivec2(floor(renderPosition - scene.jitter.xy)), ivec2(0), ivec2(scene.renderSize.xy) - 1);
+    vec2 sampleOffset = (renderPosition - (vec2(samplePixel) + 0.5 + scene.jitter.xy)) / scene.renderSize.zw;
+    float sampleWeight = exp(-2.0 * dot(sampleOffset, sampleOffset));
+    vec3 currentFragment = renderedImage(samplePixel);
+
+    float depth = texelFetch(uDepthAndNormals, samplePixel, 0).w;
+    vec2 reprojectedUv = uv - texelFetch(uMotionVectors, samplePixel, 0).xy;
     if( depth == 0.0 || reprojectedUv.x < 0.0 || reprojectedUv.x > 1.0 || reprojectedUv.y < 0.0 || reprojectedUv.y > 1.0 )
     {
-      color = vec4(currentFragment, 1.0);
+      //No history. Upsample the current frame
+      vec2 renderUv = min(uv * scene.renderSize.zw, (scene.renderSize.xy - 0.5) * scene.imageSize.zw);
+      color = vec4(texture(uRenderedImage, renderUv).xyz, 1.0);
       return;
     }
 
-    vec3 nearColor0 = texture(uRenderedImage, reprojectedUv + vec2(scene.imageSize.z, 0.0)).xyz;
-    vec3 nearColor1 = texture(uRenderedImage, reprojectedUv + vec2(0.0,scene.imageSize.w)).xyz;
-    vec3 nearColor2 = texture(uRenderedImage, reprojectedUv + vec2(-scene.imageSize.z, 0.0)).xyz;
-    vec3 nearColor3 = texture(uRenderedImage, reprojectedUv + vec2(0.0, -scene.imageSize.w)).xyz;
+    vec3 nearColor0 = renderedImage(samplePixel + ivec2(1, 0));
+    vec3 nearColor1 = renderedImage(samplePixel + ivec2(0, 1));
+    vec3 nearColor2 = renderedImage(samplePixel + ivec2(-1, 0));
+    vec3 nearColor3 = renderedImage(samplePixel + ivec2(0, -1));
     vec3 minColor = min(currentFragment, min(nearColor0, min(nearColor1, min(nearColor2, nearColor3))));
     vec3 maxColor = max(currentFragment, max(nearColor0, max(nearColor1, max(nearColor2, nearColor3))));
     vec3 historyFragment = texture(uHistoryBuffer, reprojectedUv).xyz; 
     historyFragment = clamp(historyFragment, minColor, maxColor);
-    color = vec4(mix(historyFragment,currentFragment, 1.0 / 8.0), 1.0);
+
+    //Samples far from the pixel center contribute less, so the history accumulates the samples of several frames
+    color = vec4(mix(historyFragment,currentFragment, sampleWeight / 8.0), 1.0);
   }
 )";
 
@@ -348,6 +377,7 @@ struct TXAA_sample_t : public framework::application_t
     core::handle_t transform_;
     render::gpu_buffer_t ubo_;
     render::descriptor_set_t descriptorSet_;
+    mat4 prevTransform_;
   };
 
   struct scene_uniforms_t
@@ -356,13 +386,17 @@ struct TXAA_sample_t : public framework::application_t
     mat4 projectionMatrix_;
     mat4 projectionInverseMatrix_;
     mat4 prevViewProjection_;
+    mat4 viewProjection_;           //Without jitter
     vec4 imageSize_;
+    vec4 renderSize_;               //Resolution the scene is rendered at (xy) and its ratio to the output resolution (zw)
+    vec4 jitter_;                   //Sub-pixel offset of the samples in render target pixels
   };
 
   TXAA_sample_t()
     :application_t("Temporal Anti-Aliasing", 1200u, 800u, 3u),
     camera_(vec3(0.0f, 2.5f, 8.5f), vec2(0.0f, 0.0f), 1.0f, 0.01f),
     bTemporalAA_(true),
+    renderScale_(1.0f),
     currentFrame_(0)
   {
     render::context_t& context = getRenderContext();
@@ -395,13 +429,15 @@ struct TXAA_sample_t : public framework::application_t
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &gBufferRT1_);
     render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, render::texture_sampler_t(), &gBufferRT2_);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &gBufferRT2_);
-    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, render::texture_sampler_t(), &finalImage_);
+    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, render::texture_sampler_t(), &gBufferRT3_);
+    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &gBufferRT3_);
+    render::texture2DCreate(context, size.x, size.y, 1u, getRenderer().getHDRFormat(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, render::texture_sampler_t(), &finalImage_);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &finalImage_);
     render::depthStencilBufferCreate(context, size.x, size.y, &depthStencilBuffer_);
     
-    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, render::texture_sampler_t(), &historyBuffer_[0]);
+    render::texture2DCreate(context, size.x, size.y, 1u, getRenderer().getHDRFormat(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, render::texture_sampler_t(), &historyBuffer_[0]);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &historyBuffer_[0]);
-    render::texture2DCreate(context, size.x, size.y, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, render::texture_sampler_t(), &historyBuffer_[1]);
+    render::texture2DCreate(context, size.x, size.y, 1u, getRenderer().getHDRFormat(), VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, render::texture_sampler_t(), &historyBuffer_[1]);
     render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &historyBuffer_[1]);
     
     //Create globals uniform buffer    
@@ -409,6 +445,7 @@ struct TXAA_sample_t : public framework::application_t
     invertMatrix(sceneUniforms_.projectionMatrix_, sceneUniforms_.projectionInverseMatrix_);
     sceneUniforms_.viewMatrix_ = camera_.view_;
     sceneUniforms_.imageSize_ = vec4((f32)size.x, (f32)size.y, 1.0f / (f32)size.x, 1.0f / (f32)size.y);
+    sceneUniforms_.renderSize_ = vec4((f32)size.x, (f32)size.y, 1.0f, 1.0f);
     render::gpuBufferCreate(context, render::gpu_buffer_t::usage::UNIFORM_BUFFER, (void*)&sceneUniforms_, sizeof(scene_uniforms_t), &allocator_, &globalsUbo_);
 
     //Create global descriptor set (Scene uniforms)   
@@ -505,10 +542,11 @@ struct TXAA_sample_t : public framework::application_t
     //Create uniform buffer and descriptor set
     render::gpu_buffer_t ubo;
     render::gpuBufferCreate(context, render::gpu_buffer_t::usage::UNIFORM_BUFFER,
-      nullptr, sizeof(mat4),
+      nullptr, 2 * sizeof(mat4),
       &allocator_, &ubo);
 
     object_t object = { meshId, materialId, transformId, ubo };
+    object.prevTransform_ = transform;
     render::descriptor_t descriptor = render::getDescriptor(object.ubo_);
     render::descriptorSetCreate(context, descriptorPool_, objectDescriptorSetLayout_, &descriptor, &object.descriptorSet_);
     return object_.add(object);
@@ -551,17 +589,24 @@ struct TXAA_sample_t : public framework::application_t
     //Update global matrices
     sceneUniforms_.prevViewProjection_ = sceneUniforms_.viewMatrix_ * sceneUniforms_.projectionMatrix_;
     sceneUniforms_.viewMatrix_ = camera_.view_;
-    
+    sceneUniforms_.viewProjection_ = sceneUniforms_.viewMatrix_ * sceneUniforms_.projectionMatrix_;
+
+    //Render resolution. Temporal upsampling needs the history so it is only used with TXAA enabled
+    uvec2 renderSize = getRenderSize();
+    sceneUniforms_.renderSize_ = vec4((f32)renderSize.x, (f32)renderSize.y, (f32)renderSize.x / (f32)windowSize.x, (f32)renderSize.y / (f32)windowSize.y);
+    sceneUniforms_.jitter_ = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+
     if (bTemporalAA_)
     {
       static const vec2 sampleLocations[8] = { vec2(-7.0f,1.0f) / 8.0f, vec2(-5.0f,-5.0f)/ 8.0f, vec2(-1.0f,-3.0f) / 8.0f, vec2(3.0f, -7.0f) / 8.0f,
                                                vec2(5.0f,-1.0f) / 8.0f, vec2(7.0f, 7.0f) / 8.0f, vec2(1.0f,3.0f)   / 8.0f, vec2(-3.0f, 5.0f) / 8.0f };
 
-      vec2 texelSize(sceneUniforms_.imageSize_.z, sceneUniforms_.imageSize_.w);
+      vec2 texelSize(1.0f / sceneUniforms_.renderSize_.x, 1.0f / sceneUniforms_.renderSize_.y);
       vec2 subsampleOffset = sampleLocations[currentFrame_ % 8] * texelSize;
 
       sceneUniforms_.projectionMatrix_[8] = subsampleOffset.x;
       sceneUniforms_.projectionMatrix_[9] = subsampleOffset.y;
+      sceneUniforms_.jitter_ = vec4(sampleLocations[currentFrame_ % 8].x * 0.5f, sampleLocations[currentFrame_ % 8].y * 0.5f, 0.0f, 0.0f);
     }
     
     render::gpuBufferUpdate(context, (void*)&sceneUniforms_, 0u, sizeof(scene_uniforms_t), &globalsUbo_);
@@ -572,6 +617,8 @@ struct TXAA_sample_t : public framework::application_t
     for (u32 i(0); i < objectCount; ++i)
     {
       render::gpuBufferUpdate(context, transformManager_.getWorldMatrix(objects[i].transform_), 0, sizeof(mat4), &objects[i].ubo_);
+      render::gpuBufferUpdate(context, &objects[i].prevTransform_, sizeof(mat4), sizeof(mat4), &objects[i].ubo_);
+      objects[i].prevTransform_ = *transformManager_.getWorldMatrix(objects[i].transform_);
     }
 
     //Update lights position
@@ -712,6 +759,7 @@ struct TXAA_sample_t : public framework::application_t
     render::textureDestroy(context, &gBufferRT0_);
     render::textureDestroy(context, &gBufferRT1_);
     render::textureDestroy(context, &gBufferRT2_);
+    render::textureDestroy(context, &gBufferRT3_);
     render::textureDestroy(context, &finalImage_);
     render::depthStencilBufferDestroy(context, &depthStencilBuffer_);
 
@@ -749,7 +797,7 @@ private:
 
     //Create offscreen render pass (GBuffer + light subpasses)
     renderPass_ = {};
-    render::render_pass_t::attachment_t attachments[5];
+    render::render_pass_t::attachment_t attachments[6];
     attachments[0].format_ = gBufferRT0_.format_;
     attachments[0].initialLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     attachments[0].finallLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -771,30 +819,38 @@ private:
     attachments[2].loadOp_ = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachments[2].samples_ = VK_SAMPLE_COUNT_1_BIT;
 
-    attachments[3].format_ = finalImage_.format_;
+    attachments[3].format_ = gBufferRT3_.format_;
     attachments[3].initialLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     attachments[3].finallLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     attachments[3].storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
     attachments[3].loadOp_ = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachments[3].samples_ = VK_SAMPLE_COUNT_1_BIT;
 
-    attachments[4].format_ = depthStencilBuffer_.format_;
-    attachments[4].initialLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    attachments[4].finallLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[4].format_ = finalImage_.format_;
+    attachments[4].initialLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[4].finallLayout_ = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     attachments[4].storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
     attachments[4].loadOp_ = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachments[4].samples_ = VK_SAMPLE_COUNT_1_BIT;
 
+    attachments[5].format_ = depthStencilBuffer_.format_;
+    attachments[5].initialLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[5].finallLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments[5].storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[5].loadOp_ = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[5].samples_ = VK_SAMPLE_COUNT_1_BIT;
+
     render::render_pass_t::subpass_t subpasses[2];
     subpasses[0].colorAttachmentIndex_.push_back(0);
     subpasses[0].colorAttachmentIndex_.push_back(1);
     subpasses[0].colorAttachmentIndex_.push_back(2);
-    subpasses[0].depthStencilAttachmentIndex_ = 4;
+    subpasses[0].colorAttachmentIndex_.push_back(3);
+    subpasses[0].depthStencilAttachmentIndex_ = 5;
 
     subpasses[1].inputAttachmentIndex_.push_back(0);
     subpasses[1].inputAttachmentIndex_.push_back(1);
     subpasses[1].inputAttachmentIndex_.push_back(2);
-    subpasses[1].colorAttachmentIndex_.push_back(3);
+    subpasses[1].colorAttachmentIndex_.push_back(4);
 
     render::render_pass_t::subpass_dependency_t dependency;
     dependency.srcSubpass = 0;
@@ -804,10 +860,10 @@ private:
     dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
 
-    render::renderPassCreate(context, attachments, 5u, subpasses, 2u, &dependency, 1u, &renderPass_);
+    render::renderPassCreate(context, attachments, 6u, subpasses, 2u, &dependency, 1u, &renderPass_);
 
     //Create frame buffer
-    VkImageView fbAttachment[5] = { gBufferRT0_.imageView_, gBufferRT1_.imageView_, gBufferRT2_.imageView_, finalImage_.imageView_, depthStencilBuffer_.imageView_ };
+    VkImageView fbAttachment[6] = { gBufferRT0_.imageView_, gBufferRT1_.imageView_, gBufferRT2_.imageView_, gBufferRT3_.imageView_, finalImage_.imageView_, depthStencilBuffer_.imageView_ };
     render::frameBufferCreate(context, size.x, size.y, renderPass_, fbAttachment, &frameBuffer_);
 
     //Create descriptorSets layouts
@@ -827,13 +883,15 @@ private:
     render::graphics_pipeline_t::description_t pipelineDesc = {};
     pipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)context.swapChain_.imageWidth_, (float)context.swapChain_.imageHeight_, 0.0f, 1.0f };
     pipelineDesc.scissorRect_ = { { 0,0 },{ context.swapChain_.imageWidth_,context.swapChain_.imageHeight_ } };
-    pipelineDesc.blendState_.resize(3);
+    pipelineDesc.blendState_.resize(4);
     pipelineDesc.blendState_[0].colorWriteMask = 0xF;
     pipelineDesc.blendState_[0].blendEnable = VK_FALSE;
     pipelineDesc.blendState_[1].colorWriteMask = 0xF;
     pipelineDesc.blendState_[1].blendEnable = VK_FALSE;
     pipelineDesc.blendState_[2].colorWriteMask = 0xF;
     pipelineDesc.blendState_[2].blendEnable = VK_FALSE;
+    pipelineDesc.blendState_[3].colorWriteMask = 0xF;
+    pipelineDesc.blendState_[3].blendEnable = VK_FALSE;
     pipelineDesc.cullMode_ = VK_CULL_MODE_BACK_BIT;
     pipelineDesc.depthTestEnabled_ = true;
     pipelineDesc.depthWriteEnabled_ = true;
@@ -902,12 +960,13 @@ private:
       render::frameBufferCreate(context, size.x, size.y, txaaResolveRenderPass_, &fbAttachment, &txaaResolveFrameBuffer_);
 
 
-      render::descriptor_binding_t bindings[4] = { { render::descriptor_t::type::UNIFORM_BUFFER, 0,  render::descriptor_t::stage::FRAGMENT },
+      render::descriptor_binding_t bindings[5] = { { render::descriptor_t::type::UNIFORM_BUFFER, 0,  render::descriptor_t::stage::FRAGMENT },
                                                    { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 1,  render::descriptor_t::stage::FRAGMENT },
                                                    { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 2, render::descriptor_t::stage::FRAGMENT },
-                                                   { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 3, render::descriptor_t::stage::FRAGMENT } };
+                                                   { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 3, render::descriptor_t::stage::FRAGMENT },
+                                                   { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 4, render::descriptor_t::stage::FRAGMENT } };
 
-      render::descriptorSetLayoutCreate(context, bindings, 4, &txaaResolveDescriptorSetLayout_);
+      render::descriptorSetLayoutCreate(context, bindings, 5, &txaaResolveDescriptorSetLayout_);
       render::pipelineLayoutCreate(context, &txaaResolveDescriptorSetLayout_, 1u, nullptr, 0u, &txaaResolvePipelineLayout_);
       render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, gTxaaResolveFragmentShaderSource, &txaaResolveFragmentShader_);
       render::graphics_pipeline_t::description_t pipelineDesc = {};
@@ -923,7 +982,7 @@ private:
       pipelineDesc.fragmentShader_ = txaaResolveFragmentShader_;
       render::graphicsPipelineCreate(context, txaaResolveRenderPass_.handle_, 0u, fullScreenQuad_.vertexFormat_, txaaResolvePipelineLayout_, pipelineDesc, &txaaResolvePipeline_);
 
-      render::descriptor_t descriptors[4] = { render::getDescriptor(globalsUbo_), render::getDescriptor(finalImage_), render::getDescriptor(historyBuffer_[1]), render::getDescriptor(gBufferRT1_) };
+      render::descriptor_t descriptors[5] = { render::getDescriptor(globalsUbo_), render::getDescriptor(finalImage_), render::getDescriptor(historyBuffer_[1]), render::getDescriptor(gBufferRT1_), render::getDescriptor(gBufferRT3_) };
       render::descriptorSetCreate(context, descriptorPool_, txaaResolveDescriptorSetLayout_, descriptors, &txaaResolveDescriptorSet_);
     }
   }
@@ -937,16 +996,23 @@ private:
       render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, &renderComplete_, 1u, render::command_buffer_t::GRAPHICS, &commandBuffer_);
     }
 
-    VkClearValue clearValues[5];
+    VkClearValue clearValues[6];
     clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
     clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
     clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
     clearValues[3].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-    clearValues[4].depthStencil = { 1.0f,0 };
+    clearValues[4].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+    clearValues[5].depthStencil = { 1.0f,0 };
 
     render::commandBufferBegin(context, commandBuffer_);
     {
-      render::commandBufferRenderPassBegin(context, &frameBuffer_, clearValues, 5u, commandBuffer_);
+      render::commandBufferRenderPassBegin(context, &frameBuffer_, clearValues, 6u, commandBuffer_);
+
+      //Scene is rendered in the top left corner of the render targets
+      uvec2 renderSize = getRenderSize();
+      render::setViewport(commandBuffer_, 0, 0, renderSize.x, renderSize.y);
+      render::setScissor(commandBuffer_, 0, 0, renderSize.x, renderSize.y);
+
       //GBuffer pass
       render::graphicsPipelineBind(commandBuffer_, gBufferPipeline_);
       render::descriptor_set_t descriptorSets[3];
@@ -1039,9 +1105,22 @@ private:
   {
     ImGui::Begin("Controls");
     ImGui::Checkbox("TXAA Enabled", &bTemporalAA_);
+    if (bTemporalAA_)
+    {
+      ImGui::SliderFloat("Render scale", &renderScale_, 0.5f, 1.0f);
+      uvec2 renderSize = getRenderSize();
+      ImGui::Text("Render resolution: %ux%u", renderSize.x, renderSize.y);
+    }
     ImGui::End();
   }
 
+  uvec2 getRenderSize()
+  {
+    uvec2 size = getWindowSize();
+    float scale = bTemporalAA_ ? renderScale_ : 1.0f;
+    return uvec2(maxValue(1u, (uint32_t)(size.x * scale + 0.5f)), maxValue(1u, (uint32_t)(size.y * scale + 0.5f)));
+  }
+
 private:
   ///Member variables
   transform_manager_t transformManager_;
@@ -1085,6 +1164,7 @@ private:
   render::texture_t gBufferRT0_;  //Albedo + roughness
   render::texture_t gBufferRT1_;  //Normal + Depth
   render::texture_t gBufferRT2_;  //F0 + metallic
+  render::texture_t gBufferRT3_;  //Motion vectors
   render::texture_t finalImage_;
   render::depth_stencil_buffer_t depthStencilBuffer_;
 
@@ -1113,12 +1193,15 @@ private:
 
   framework::free_camera_t camera_;
   bool bTemporalAA_;
+  float renderScale_;             //Fraction of the output resolution the scene is rendered at when TXAA is enabled
   uint32_t currentFrame_;
 };
 
 
-int main()
+int main(int argc, char** argv)
 {
+  framework::application_t::parseCommandLine(argc, argv);
+
   TXAA_sample_t scene;
 
   //Materials  
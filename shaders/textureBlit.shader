@@ -28,7 +28,7 @@
             layout(location = 0) out vec4 color;
             void main()
             {
-                color = texture(MainTexture, uv);
+                color = texture(MainTexture, scaledUV(uv));
             }			
         </FragmentShader>
 
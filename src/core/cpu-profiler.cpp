@@ -0,0 +1,315 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "core/cpu-profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace bkk::core;
+
+
+namespace
+{
+  struct event_t
+  {
+    const char* name_;
+    uint64_t begin_;  //Nanoseconds
+    uint64_t end_;
+  };
+
+  //Written only by its thread. Buffers are reused by new threads once the thread owning them exits
+  struct thread_buffer_t
+  {
+    static const uint32_t CAPACITY = 65536u;
+
+    std::vector<event_t> events_;
+    std::atomic<uint32_t> count_;
+    std::atomic<uint32_t> capture_;  //Capture the events belong to
+    std::atomic<uint32_t> dropped_;
+    uint32_t id_;
+    char name_[32];
+    bool inUse_;
+  };
+
+  struct profiler_state_t
+  {
+    std::mutex mutex_;  //Taken when threads start or stop using a buffer and while the capture is written, never while recording
+    std::vector<thread_buffer_t*> buffers_;
+
+    std::atomic<bool> capturing_;
+    std::atomic<uint32_t> capture_;
+    uint32_t pendingFrames_;
+    uint32_t framesLeft_;
+    uint64_t captureBegin_;
+    uint64_t frameBegin_;
+    std::string file_;
+
+    profiler_state_t()
+    :capturing_(false),
+     capture_(0u),
+     pendingFrames_(0u),
+     framesLeft_(0u),
+     captureBegin_(0u),
+     frameBegin_(0u)
+    {}
+
+    ~profiler_state_t()
+    {
+      for (uint32_t i(0); i < buffers_.size(); ++i)
+        delete buffers_[i];
+    }
+  };
+
+  profiler_state_t& getState()
+  {
+    static profiler_state_t state;
+    return state;
+  }
+
+  struct thread_registration_t
+  {
+    thread_buffer_t* buffer_ = nullptr;
+
+    ~thread_registration_t()
+    {
+      if (buffer_)
+      {
+        std::lock_guard<std::mutex> lock(getState().mutex_);
+        buffer_->name_[0] = '\0';
+        buffer_->inUse_ = false;
+      }
+    }
+  };
+
+  thread_local thread_registration_t gThreadRegistration;
+}
+
+static uint64_t getTime()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+static thread_buffer_t* getThreadBuffer()
+{
+  if (gThreadRegistration.buffer_)
+    return gThreadRegistration.buffer_;
+
+  profiler_state_t& state = getState();
+  std::lock_guard<std::mutex> lock(state.mutex_);
+  thread_buffer_t* buffer = nullptr;
+  for (uint32_t i(0); i < state.buffers_.size(); ++i)
+  {
+    if (!state.buffers_[i]->inUse_)
+    {
+      buffer = state.buffers_[i];
+      break;
+    }
+  }
+
+  if (!buffer)
+  {
+    buffer = new thread_buffer_t();
+    buffer->events_.resize(thread_buffer_t::CAPACITY);
+    buffer->count_ = 0u;
+    buffer->capture_ = 0u;
+    buffer->dropped_ = 0u;
+    buffer->id_ = (uint32_t)state.buffers_.size();
+    buffer->name_[0] = '\0';
+    state.buffers_.push_back(buffer);
+  }
+
+  buffer->inUse_ = true;
+  gThreadRegistration.buffer_ = buffer;
+  return buffer;
+}
+
+static void recordEvent(const char* name, uint64_t begin, uint64_t end)
+{
+  profiler_state_t& state = getState();
+  thread_buffer_t* buffer = getThreadBuffer();
+
+  //The first event of a new capture discards the ones of the previous capture
+  uint32_t capture = state.capture_.load(std::memory_order_acquire);
+  if (buffer->capture_.load(std::memory_order_relaxed) != capture)
+  {
+    buffer->count_.store(0u, std::memory_order_relaxed);
+    buffer->dropped_.store(0u, std::memory_order_relaxed);
+    buffer->capture_.store(capture, std::memory_order_release);
+  }
+
+  uint32_t index = buffer->count_.load(std::memory_order_relaxed);
+  if (index < thread_buffer_t::CAPACITY)
+  {
+    event_t& event = buffer->events_[index];
+    event.name_ = name;
+    event.begin_ = begin;
+    event.end_ = end;
+    buffer->count_.store(index + 1, std::memory_order_release);
+  }
+  else
+  {
+    buffer->dropped_.fetch_add(1u, std::memory_order_relaxed);
+  }
+}
+
+static void writeJsonString(FILE* file, const char* str)
+{
+  fputc('"', file);
+  for (const char* c = str; *c; ++c)
+  {
+    if (*c == '"' || *c == '\\')
+      fputc('\\', file);
+
+    if ((unsigned char)*c >= 0x20)
+      fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+static void writeCapture(profiler_state_t& state)
+{
+  FILE* file = fopen(state.file_.c_str(), "w");
+  if (!file)
+  {
+    fprintf(stderr, "CPU profiler: Unable to open %s\n", state.file_.c_str());
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(state.mutex_);
+  uint32_t capture = state.capture_.load(std::memory_order_relaxed);
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  uint32_t dropped = 0u;
+  for (uint32_t i(0); i < state.buffers_.size(); ++i)
+  {
+    thread_buffer_t* buffer = state.buffers_[i];
+    if (buffer->capture_.load(std::memory_order_acquire) != capture)
+      continue;
+
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", buffer->id_);
+    if (buffer->name_[0] != '\0')
+    {
+      writeJsonString(file, buffer->name_);
+    }
+    else
+    {
+      fprintf(file, "\"Thread %u\"", buffer->id_);
+    }
+    fprintf(file, "}}");
+    first = false;
+
+    uint32_t count = buffer->count_.load(std::memory_order_acquire);
+    for (uint32_t j(0); j < count; ++j)
+    {
+      const event_t& event = buffer->events_[j];
+      uint64_t begin = event.begin_ > state.captureBegin_ ? event.begin_ - state.captureBegin_ : 0u;
+      uint64_t duration = event.end_ > event.begin_ ? event.end_ - event.begin_ : 0u;
+      fprintf(file, ",\n{\"name\":");
+      writeJsonString(file, event.name_);
+      fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->id_, begin / 1000.0, duration / 1000.0);
+    }
+
+    dropped += buffer->dropped_.load(std::memory_order_relaxed);
+  }
+
+  fprintf(file, "\n]}\n");
+  fclose(file);
+
+  if (dropped > 0u)
+    fprintf(stderr, "CPU profiler: %u zones didn't fit in the thread buffers and were dropped\n", dropped);
+}
+
+void profiler::captureFrames(uint32_t frameCount, const char* file)
+{
+  profiler_state_t& state = getState();
+  if (frameCount == 0u || state.capturing_.load(std::memory_order_relaxed))
+    return;
+
+  state.file_ = file;
+  state.pendingFrames_ = frameCount;
+}
+
+bool profiler::isCapturing()
+{
+  profiler_state_t& state = getState();
+  return state.pendingFrames_ > 0u || state.capturing_.load(std::memory_order_relaxed);
+}
+
+void profiler::frameMark()
+{
+  profiler_state_t& state = getState();
+  uint64_t now = getTime();
+
+  if (state.capturing_.load(std::memory_order_relaxed))
+  {
+    recordEvent("Frame", state.frameBegin_, now);
+    state.frameBegin_ = now;
+    if (--state.framesLeft_ == 0u)
+    {
+      state.capturing_.store(false, std::memory_order_release);
+      writeCapture(state);
+    }
+  }
+  else if (state.pendingFrames_ > 0u)
+  {
+    state.framesLeft_ = state.pendingFrames_;
+    state.pendingFrames_ = 0u;
+    state.captureBegin_ = now;
+    state.frameBegin_ = now;
+    state.capture_.fetch_add(1u, std::memory_order_release);
+    state.capturing_.store(true, std::memory_order_release);
+  }
+}
+
+void profiler::setThreadName(const char* name)
+{
+  thread_buffer_t* buffer = getThreadBuffer();
+  strncpy(buffer->name_, name, sizeof(buffer->name_) - 1);
+  buffer->name_[sizeof(buffer->name_) - 1] = '\0';
+}
+
+profiler::zone_t::zone_t(const char* name)
+:name_(nullptr),
+ begin_(0u)
+{
+  if (getState().capturing_.load(std::memory_order_relaxed))
+  {
+    name_ = name;
+    begin_ = getTime();
+  }
+}
+
+profiler::zone_t::~zone_t()
+{
+  if (name_)
+    recordEvent(name_, begin_, getTime());
+}
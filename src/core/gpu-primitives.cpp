@@ -0,0 +1,711 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "core/gpu-primitives.h"
+#include "core/render.h"
+
+#include <assert.h>
+#include <string>
+
+using namespace bkk::core;
+using namespace bkk::core::render;
+
+static const uint32_t gWorkGroupSize = 256u;
+
+//Prefix sum processes 4 elements per invocation
+static const uint32_t gPrefixSumElementsPerWorkGroup = 4u * gWorkGroupSize;
+
+static const uint32_t gRadixSortBitsPerPass = 4u;
+static const uint32_t gRadixSortDigitCount = 1u << gRadixSortBitsPerPass;
+
+//Single workgroup exclusive scan of ENTRIES_PER_WORKGROUP * workGroupCount entries, done in place.
+//Used to scan the per workgroup partial results of the prefix sum and the radix sort
+static const char* gScanShader = R"(
+  layout (local_size_x = 256) in;
+
+  layout (std430, binding = 5) buffer SCAN { uint data[]; }scan;
+  layout (push_constant) uniform PASS
+  {
+    uint parameter;
+    uint workGroupCount;
+  }pass;
+
+  shared uint partialSum[256];
+
+  void main()
+  {
+    //Each invocation scans a contiguous chunk
+    uint thread = gl_LocalInvocationIndex;
+    uint entryCount = ENTRIES_PER_WORKGROUP * pass.workGroupCount;
+    uint chunkSize = (entryCount + 255) / 256;
+    uint begin = min( thread * chunkSize, entryCount );
+    uint end = min( begin + chunkSize, entryCount );
+
+    uint sum = 0;
+    for( uint i = begin; i < end; ++i )
+    {
+      sum += scan.data[i];
+    }
+
+    partialSum[thread] = sum;
+    barrier();
+
+    //Inclusive scan of the chunk sums
+    for( uint offset = 1; offset < 256; offset <<= 1 )
+    {
+      uint value = partialSum[thread];
+      if( thread >= offset )
+      {
+        value += partialSum[thread - offset];
+      }
+      barrier();
+      partialSum[thread] = value;
+      barrier();
+    }
+
+    uint prefix = partialSum[thread] - sum;
+    for( uint i = begin; i < end; ++i )
+    {
+      uint count = scan.data[i];
+      scan.data[i] = prefix;
+      prefix += count;
+    }
+  }
+)";
+
+//Prefix sum. Bindings: 0 element count, 1 input, 3 output, 5 per workgroup sums.
+//Inputs are read through INPUT_VALUE so stream compaction can scan its flags as 0 or 1
+static const char* gPrefixSumReduceShader = R"(
+  layout (local_size_x = 256) in;
+
+  layout (std430, binding = 0) readonly buffer COUNT { uint elementCount; };
+  layout (std430, binding = 1) buffer INPUT { uint data[]; }inputBuffer;
+  layout (std430, binding = 5) buffer BLOCK_SUMS { uint data[]; }blockSums;
+
+  shared uint partialSum[256];
+
+  void main()
+  {
+    uint thread = gl_LocalInvocationIndex;
+    uint base = gl_WorkGroupID.x * 1024 + thread * 4;
+    uint sum = 0;
+    for( uint i = 0; i < 4; ++i )
+    {
+      if( base + i < elementCount )
+      {
+        sum += INPUT_VALUE( inputBuffer.data[base + i] );
+      }
+    }
+
+    partialSum[thread] = sum;
+    barrier();
+
+    for( uint stride = 128; stride > 0; stride >>= 1 )
+    {
+      if( thread < stride )
+      {
+        partialSum[thread] += partialSum[thread + stride];
+      }
+      barrier();
+    }
+
+    if( thread == 0 )
+    {
+      blockSums.data[gl_WorkGroupID.x] = partialSum[0];
+    }
+  }
+)";
+
+static const char* gPrefixSumDownsweepShader = R"(
+  layout (local_size_x = 256) in;
+
+  layout (std430, binding = 0) readonly buffer COUNT { uint elementCount; };
+  layout (std430, binding = 1) buffer INPUT { uint data[]; }inputBuffer;
+  layout (std430, binding = 3) buffer OUTPUT { uint data[]; }outputBuffer;
+  layout (std430, binding = 5) readonly buffer BLOCK_SUMS { uint data[]; }blockSums;
+  layout (push_constant) uniform PASS
+  {
+    uint inclusive;
+    uint workGroupCount;
+  }pass;
+
+  shared uint partialSum[256];
+
+  void main()
+  {
+    uint thread = gl_LocalInvocationIndex;
+    uint base = gl_WorkGroupID.x * 1024 + thread * 4;
+    uint value[4];
+    uint sum = 0;
+    for( uint i = 0; i < 4; ++i )
+    {
+      value[i] = ( base + i < elementCount ) ? INPUT_VALUE( inputBuffer.data[base + i] ) : 0;
+      sum += value[i];
+    }
+
+    partialSum[thread] = sum;
+    barrier();
+
+    for( uint offset = 1; offset < 256; offset <<= 1 )
+    {
+      uint partial = partialSum[thread];
+      if( thread >= offset )
+      {
+        partial += partialSum[thread - offset];
+      }
+      barrier();
+      partialSum[thread] = partial;
+      barrier();
+    }
+
+    uint prefix = blockSums.data[gl_WorkGroupID.x] + partialSum[thread] - sum;
+    for( uint i = 0; i < 4; ++i )
+    {
+      if( base + i < elementCount )
+      {
+        outputBuffer.data[base + i] = ( pass.inclusive != 0 ) ? prefix + value[i] : prefix;
+      }
+      prefix += value[i];
+    }
+  }
+)";
+
+//Stream compaction. Bindings: 0 element count, 1 input, 2 flags, 3 output, 4 output count, 5 scanned flags
+static const char* gStreamCompactionShader = R"(
+  #version 440 core
+  layout (local_size_x = 256) in;
+
+  layout (std430, binding = 0) readonly buffer COUNT { uint elementCount; };
+  layout (std430, binding = 1) readonly buffer INPUT { uint data[]; }inputBuffer;
+  layout (std430, binding = 2) readonly buffer FLAGS { uint data[]; }flags;
+  layout (std430, binding = 3) writeonly buffer OUTPUT { uint data[]; }outputBuffer;
+  layout (std430, binding = 4) writeonly buffer OUTPUT_COUNT { uint outputCount; };
+  layout (std430, binding = 5) readonly buffer SCANNED_FLAGS { uint data[]; }scannedFlags;
+
+  void main()
+  {
+    uint index = gl_GlobalInvocationID.x;
+    if( index < elementCount )
+    {
+      bool keep = flags.data[index] != 0;
+      if( keep )
+      {
+        outputBuffer.data[scannedFlags.data[index]] = inputBuffer.data[index];
+      }
+
+      if( index == elementCount - 1 )
+      {
+        outputCount = scannedFlags.data[index] + ( keep ? 1 : 0 );
+      }
+    }
+    else if( index == 0 )
+    {
+      outputCount = 0;
+    }
+  }
+)";
+
+//Radix sort. Bindings: 0 element count, 1-2 input keys and values, 3-4 output keys and values, 5 per workgroup digit histograms.
+//Histograms are stored digit-major (histogram[digit * workGroupCount + workGroup]) so an exclusive scan
+//of the whole array gives the output offset of each digit for each workgroup
+static const char* gRadixSortHistogramShader = R"(
+  layout (local_size_x = 256) in;
+
+  layout (std430, binding = 0) readonly buffer COUNT { uint elementCount; };
+  layout (std430, binding = 1) readonly buffer KEYS_IN { uint keysIn[]; };
+  layout (std430, binding = 5) buffer HISTOGRAM { uint histogram[]; };
+  layout (push_constant) uniform PASS
+  {
+    uint shift;
+    uint workGroupCount;
+  }pass;
+
+  shared uint localHistogram[16];
+
+  void main()
+  {
+    if( gl_LocalInvocationIndex < 16 )
+    {
+      localHistogram[gl_LocalInvocationIndex] = 0;
+    }
+    barrier();
+
+    uint index = gl_GlobalInvocationID.x;
+    if( index < elementCount )
+    {
+      uint keyWord = keysIn[index * KEY_WORDS + pass.shift / 32];
+      atomicAdd( localHistogram[ (keyWord >> (pass.shift & 31)) & 0xF ], 1 );
+    }
+    barrier();
+
+    if( gl_LocalInvocationIndex < 16 )
+    {
+      histogram[gl_LocalInvocationIndex * pass.workGroupCount + gl_WorkGroupID.x] = localHistogram[gl_LocalInvocationIndex];
+    }
+  }
+)";
+
+static const char* gRadixSortScatterShader = R"(
+  layout (local_size_x = 256) in;
+
+  layout (std430, binding = 0) readonly buffer COUNT { uint elementCount; };
+  layout (std430, binding = 1) readonly buffer KEYS_IN { uint keysIn[]; };
+  layout (std430, binding = 2) readonly buffer VALUES_IN { uint valuesIn[]; };
+  layout (std430, binding = 3) writeonly buffer KEYS_OUT { uint keysOut[]; };
+  layout (std430, binding = 4) writeonly buffer VALUES_OUT { uint valuesOut[]; };
+  layout (std430, binding = 5) readonly buffer HISTOGRAM { uint histogram[]; };
+  layout (push_constant) uniform PASS
+  {
+    uint shift;
+    uint workGroupCount;
+  }pass;
+
+  //16 digit counters per invocation, packed in pairs of 16 bits
+  shared uint digitCount[8][256];
+
+  void main()
+  {
+    uint thread = gl_LocalInvocationIndex;
+    uint index = gl_GlobalInvocationID.x;
+    bool valid = index < elementCount;
+
+    uint key[KEY_WORDS];
+    for( uint i = 0; i < KEY_WORDS; ++i )
+    {
+      key[i] = valid ? keysIn[index * KEY_WORDS + i] : 0;
+    }
+    uint digit = (key[pass.shift / 32] >> (pass.shift & 31)) & 0xF;
+    uint digitShift = (digit & 1) * 16;
+
+    for( uint i = 0; i < 8; ++i )
+    {
+      digitCount[i][thread] = 0;
+    }
+    if( valid )
+    {
+      digitCount[digit >> 1][thread] = 1 << digitShift;
+    }
+    barrier();
+
+    //Inclusive scan of the digit counters. Gives the rank of each key among the keys
+    //with the same digit in the workgroup, which keeps the sort stable
+    for( uint offset = 1; offset < 256; offset <<= 1 )
+    {
+      uint value[8];
+      for( uint i = 0; i < 8; ++i )
+      {
+        value[i] = digitCount[i][thread];
+        if( thread >= offset )
+        {
+          value[i] += digitCount[i][thread - offset];
+        }
+      }
+      barrier();
+      for( uint i = 0; i < 8; ++i )
+      {
+        digitCount[i][thread] = value[i];
+      }
+      barrier();
+    }
+
+    if( valid )
+    {
+      uint rank = ((digitCount[digit >> 1][thread] >> digitShift) & 0xFFFF) - 1;
+      uint destination = histogram[digit * pass.workGroupCount + gl_WorkGroupID.x] + rank;
+      for( uint i = 0; i < KEY_WORDS; ++i )
+      {
+        keysOut[destination * KEY_WORDS + i] = key[i];
+      }
+      valuesOut[destination] = valuesIn[index];
+    }
+  }
+)";
+
+//Histogram. Bindings: 0 element count, 1 input, 2 histogram
+static const char* gHistogramClearShader = R"(
+  #version 440 core
+  layout (local_size_x = 256) in;
+
+  layout (std430, binding = 2) writeonly buffer HISTOGRAM { uint bins[]; }histogram;
+  layout (push_constant) uniform PASS
+  {
+    uint binCount;
+  }pass;
+
+  void main()
+  {
+    if( gl_GlobalInvocationID.x < pass.binCount )
+    {
+      histogram.bins[gl_GlobalInvocationID.x] = 0;
+    }
+  }
+)";
+
+static const char* gHistogramAccumulateShader = R"(
+  #version 440 core
+  layout (local_size_x = 256) in;
+
+  layout (std430, binding = 0) readonly buffer COUNT { uint elementCount; };
+  layout (std430, binding = 1) readonly buffer INPUT { uint data[]; }inputBuffer;
+  layout (std430, binding = 2) buffer HISTOGRAM { uint bins[]; }histogram;
+  layout (push_constant) uniform PASS
+  {
+    uint binCount;
+  }pass;
+
+  shared uint localHistogram[1024];
+
+  void main()
+  {
+    //Small histograms are accumulated per workgroup to reduce contention on global atomics
+    bool useSharedMemory = pass.binCount <= 1024;
+    if( useSharedMemory )
+    {
+      for( uint bin = gl_LocalInvocationIndex; bin < pass.binCount; bin += 256 )
+      {
+        localHistogram[bin] = 0;
+      }
+    }
+    barrier();
+
+    uint index = gl_GlobalInvocationID.x;
+    if( index < elementCount )
+    {
+      uint bin = min( inputBuffer.data[index], pass.binCount - 1 );
+      if( useSharedMemory )
+      {
+        atomicAdd( localHistogram[bin], 1 );
+      }
+      else
+      {
+        atomicAdd( histogram.bins[bin], 1 );
+      }
+    }
+    barrier();
+
+    if( useSharedMemory )
+    {
+      for( uint bin = gl_LocalInvocationIndex; bin < pass.binCount; bin += 256 )
+      {
+        if( localHistogram[bin] > 0 )
+        {
+          atomicAdd( histogram.bins[bin], localHistogram[bin] );
+        }
+      }
+    }
+  }
+)";
+
+static std::string shaderSource(const char* source, const char* defines)
+{
+  return std::string("#version 440 core\n") + defines + source;
+}
+
+static void kernelCreate(const context_t& context, const pipeline_layout_t& layout, const char* source, shader_t* shader, compute_pipeline_t* pipeline)
+{
+  shaderCreateFromGLSLSource(context, shader_t::COMPUTE_SHADER, source, shader);
+  computePipelineCreate(context, layout, *shader, pipeline);
+}
+
+static void kernelDestroy(const context_t& context, shader_t* shader, compute_pipeline_t* pipeline)
+{
+  computePipelineDestroy(context, pipeline);
+  shaderDestroy(context, shader);
+}
+
+static void storageBufferLayoutCreate(const context_t& context, uint32_t bindingCount, uint32_t pushConstantsSize, descriptor_set_layout_t* descriptorSetLayout, pipeline_layout_t* pipelineLayout)
+{
+  std::vector<descriptor_binding_t> bindings(bindingCount);
+  for (uint32_t i(0); i < bindingCount; ++i)
+  {
+    bindings[i] = { descriptor_t::type::STORAGE_BUFFER, i, descriptor_t::stage::COMPUTE };
+  }
+  descriptorSetLayoutCreate(context, bindings.data(), bindingCount, descriptorSetLayout);
+
+  push_constant_range_t pushConstantRange = { VK_SHADER_STAGE_COMPUTE_BIT, pushConstantsSize, 0u };
+  pipelineLayoutCreate(context, descriptorSetLayout, 1u, &pushConstantRange, 1u, pipelineLayout);
+}
+
+static void computeToComputeBarrier(command_buffer_t commandBuffer)
+{
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer.handle_,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+    1u, &barrier, 0u, nullptr, 0u, nullptr);
+}
+
+//If 'flags' is true every non zero input counts as 1
+static void prefixSumCreate(const context_t& context, prefix_sum_t::type type, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& input, const gpu_buffer_t& output, bool flags, prefix_sum_t* prefixSum)
+{
+  assert(maxElementCount > 0u);
+
+  prefixSum->type_ = type;
+  prefixSum->maxElementCount_ = maxElementCount;
+  prefixSum->workGroupCount_ = (maxElementCount + gPrefixSumElementsPerWorkGroup - 1) / gPrefixSumElementsPerWorkGroup;
+
+  gpuBufferCreate(context, gpu_buffer_t::usage::STORAGE_BUFFER, DEVICE_LOCAL, nullptr, sizeof(uint32_t) * prefixSum->workGroupCount_, nullptr, &prefixSum->blockSums_);
+
+  storageBufferLayoutCreate(context, 6u, 2 * sizeof(uint32_t), &prefixSum->descriptorSetLayout_, &prefixSum->pipelineLayout_);
+  descriptorPoolCreate(context, 1u,
+    combined_image_sampler_count(0u),
+    uniform_buffer_count(0u),
+    storage_buffer_count(6u),
+    storage_image_count(0u),
+    &prefixSum->descriptorPool_);
+
+  //Bindings 2 and 4 are not used by the prefix sum kernels
+  descriptor_t descriptors[6] = { getDescriptor(elementCount), getDescriptor(input), getDescriptor(input), getDescriptor(output), getDescriptor(output), getDescriptor(prefixSum->blockSums_) };
+  descriptorSetCreate(context, prefixSum->descriptorPool_, prefixSum->descriptorSetLayout_, descriptors, &prefixSum->descriptorSet_);
+
+  const char* inputValue = flags ? "#define INPUT_VALUE(value) ((value) != 0 ? 1 : 0)\n" : "#define INPUT_VALUE(value) (value)\n";
+  kernelCreate(context, prefixSum->pipelineLayout_, shaderSource(gPrefixSumReduceShader, inputValue).c_str(), &prefixSum->reduceShader_, &prefixSum->reducePipeline_);
+  kernelCreate(context, prefixSum->pipelineLayout_, shaderSource(gScanShader, "#define ENTRIES_PER_WORKGROUP 1\n").c_str(), &prefixSum->scanShader_, &prefixSum->scanPipeline_);
+  kernelCreate(context, prefixSum->pipelineLayout_, shaderSource(gPrefixSumDownsweepShader, inputValue).c_str(), &prefixSum->downsweepShader_, &prefixSum->downsweepPipeline_);
+}
+
+void render::prefixSumCreate(const context_t& context, prefix_sum_t::type type, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& input, const gpu_buffer_t& output, prefix_sum_t* prefixSum)
+{
+  ::prefixSumCreate(context, type, maxElementCount, elementCount, input, output, false, prefixSum);
+}
+
+void render::prefixSumDestroy(const context_t& context, prefix_sum_t* prefixSum)
+{
+  kernelDestroy(context, &prefixSum->reduceShader_, &prefixSum->reducePipeline_);
+  kernelDestroy(context, &prefixSum->scanShader_, &prefixSum->scanPipeline_);
+  kernelDestroy(context, &prefixSum->downsweepShader_, &prefixSum->downsweepPipeline_);
+
+  descriptorSetDestroy(context, &prefixSum->descriptorSet_);
+  descriptorPoolDestroy(context, &prefixSum->descriptorPool_);
+  pipelineLayoutDestroy(context, &prefixSum->pipelineLayout_);
+  descriptorSetLayoutDestroy(context, &prefixSum->descriptorSetLayout_);
+
+  gpuBufferDestroy(context, nullptr, &prefixSum->blockSums_);
+}
+
+void render::prefixSum(command_buffer_t commandBuffer, const prefix_sum_t& prefixSum)
+{
+  descriptor_set_t descriptorSet = prefixSum.descriptorSet_;
+  uint32_t passConstants[2] = { prefixSum.type_ == prefix_sum_t::INCLUSIVE ? 1u : 0u, prefixSum.workGroupCount_ };
+
+  computeToComputeBarrier(commandBuffer);
+  descriptorSetBind(commandBuffer, prefixSum.pipelineLayout_, 0u, &descriptorSet, 1u);
+
+  computePipelineBind(commandBuffer, prefixSum.reducePipeline_);
+  pushConstants(commandBuffer, prefixSum.pipelineLayout_, 0u, passConstants);
+  computeDispatch(commandBuffer, prefixSum.workGroupCount_, 1u, 1u);
+  computeToComputeBarrier(commandBuffer);
+
+  computePipelineBind(commandBuffer, prefixSum.scanPipeline_);
+  computeDispatch(commandBuffer, 1u, 1u, 1u);
+  computeToComputeBarrier(commandBuffer);
+
+  computePipelineBind(commandBuffer, prefixSum.downsweepPipeline_);
+  computeDispatch(commandBuffer, prefixSum.workGroupCount_, 1u, 1u);
+  computeToComputeBarrier(commandBuffer);
+}
+
+void render::streamCompactionCreate(const context_t& context, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& input, const gpu_buffer_t& flags, const gpu_buffer_t& output, const gpu_buffer_t& outputCount, stream_compaction_t* compaction)
+{
+  assert(maxElementCount > 0u);
+
+  compaction->maxElementCount_ = maxElementCount;
+
+  //Output position of each element is the exclusive prefix sum of the flags, with any non zero flag counted as 1
+  gpuBufferCreate(context, gpu_buffer_t::usage::STORAGE_BUFFER, DEVICE_LOCAL, nullptr, sizeof(uint32_t) * maxElementCount, nullptr, &compaction->scannedFlags_);
+  ::prefixSumCreate(context, prefix_sum_t::EXCLUSIVE, maxElementCount, elementCount, flags, compaction->scannedFlags_, true, &compaction->prefixSum_);
+
+  storageBufferLayoutCreate(context, 6u, 2 * sizeof(uint32_t), &compaction->descriptorSetLayout_, &compaction->pipelineLayout_);
+  descriptorPoolCreate(context, 1u,
+    combined_image_sampler_count(0u),
+    uniform_buffer_count(0u),
+    storage_buffer_count(6u),
+    storage_image_count(0u),
+    &compaction->descriptorPool_);
+
+  descriptor_t descriptors[6] = { getDescriptor(elementCount), getDescriptor(input), getDescriptor(flags), getDescriptor(output), getDescriptor(outputCount), getDescriptor(compaction->scannedFlags_) };
+  descriptorSetCreate(context, compaction->descriptorPool_, compaction->descriptorSetLayout_, descriptors, &compaction->descriptorSet_);
+
+  kernelCreate(context, compaction->pipelineLayout_, gStreamCompactionShader, &compaction->scatterShader_, &compaction->scatterPipeline_);
+}
+
+void render::streamCompactionDestroy(const context_t& context, stream_compaction_t* compaction)
+{
+  kernelDestroy(context, &compaction->scatterShader_, &compaction->scatterPipeline_);
+
+  descriptorSetDestroy(context, &compaction->descriptorSet_);
+  descriptorPoolDestroy(context, &compaction->descriptorPool_);
+  pipelineLayoutDestroy(context, &compaction->pipelineLayout_);
+  descriptorSetLayoutDestroy(context, &compaction->descriptorSetLayout_);
+
+  prefixSumDestroy(context, &compaction->prefixSum_);
+  gpuBufferDestroy(context, nullptr, &compaction->scannedFlags_);
+}
+
+void render::streamCompaction(command_buffer_t commandBuffer, const stream_compaction_t& compaction)
+{
+  prefixSum(commandBuffer, compaction.prefixSum_);
+
+  descriptor_set_t descriptorSet = compaction.descriptorSet_;
+  descriptorSetBind(commandBuffer, compaction.pipelineLayout_, 0u, &descriptorSet, 1u);
+  computePipelineBind(commandBuffer, compaction.scatterPipeline_);
+  computeDispatch(commandBuffer, (compaction.maxElementCount_ + gWorkGroupSize - 1) / gWorkGroupSize, 1u, 1u);
+  computeToComputeBarrier(commandBuffer);
+}
+
+void render::radixSortCreate(const context_t& context, radix_sort_t::key_size keySize, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& keys, const gpu_buffer_t& values, radix_sort_t* sort)
+{
+  assert(maxElementCount > 0u);
+
+  sort->keySize_ = keySize;
+  sort->maxElementCount_ = maxElementCount;
+  sort->workGroupCount_ = (maxElementCount + gWorkGroupSize - 1) / gWorkGroupSize;
+
+  //Scratch buffers
+  gpuBufferCreate(context, gpu_buffer_t::usage::STORAGE_BUFFER, DEVICE_LOCAL, nullptr, sizeof(uint32_t) * gRadixSortDigitCount * sort->workGroupCount_, nullptr, &sort->histogram_);
+  gpuBufferCreate(context, gpu_buffer_t::usage::STORAGE_BUFFER, DEVICE_LOCAL, nullptr, sizeof(uint32_t) * keySize * maxElementCount, nullptr, &sort->tempKeys_);
+  gpuBufferCreate(context, gpu_buffer_t::usage::STORAGE_BUFFER, DEVICE_LOCAL, nullptr, sizeof(uint32_t) * maxElementCount, nullptr, &sort->tempValues_);
+
+  storageBufferLayoutCreate(context, 6u, 2 * sizeof(uint32_t), &sort->descriptorSetLayout_, &sort->pipelineLayout_);
+
+  //Descriptor sets. Even passes read from the user buffers and write to the scratch buffers, odd passes do the opposite
+  descriptorPoolCreate(context, 2u,
+    combined_image_sampler_count(0u),
+    uniform_buffer_count(0u),
+    storage_buffer_count(12u),
+    storage_image_count(0u),
+    &sort->descriptorPool_);
+
+  descriptor_t descriptors[6] = { getDescriptor(elementCount), getDescriptor(keys), getDescriptor(values), getDescriptor(sort->tempKeys_), getDescriptor(sort->tempValues_), getDescriptor(sort->histogram_) };
+  descriptorSetCreate(context, sort->descriptorPool_, sort->descriptorSetLayout_, descriptors, &sort->descriptorSet_[0]);
+
+  descriptors[1] = getDescriptor(sort->tempKeys_);
+  descriptors[2] = getDescriptor(sort->tempValues_);
+  descriptors[3] = getDescriptor(keys);
+  descriptors[4] = getDescriptor(values);
+  descriptorSetCreate(context, sort->descriptorPool_, sort->descriptorSetLayout_, descriptors, &sort->descriptorSet_[1]);
+
+  //Pipelines
+  std::string keyWords = "#define KEY_WORDS " + std::to_string(keySize) + "\n";
+  kernelCreate(context, sort->pipelineLayout_, shaderSource(gRadixSortHistogramShader, keyWords.c_str()).c_str(), &sort->histogramShader_, &sort->histogramPipeline_);
+  kernelCreate(context, sort->pipelineLayout_, shaderSource(gScanShader, "#define ENTRIES_PER_WORKGROUP 16\n").c_str(), &sort->scanShader_, &sort->scanPipeline_);
+  kernelCreate(context, sort->pipelineLayout_, shaderSource(gRadixSortScatterShader, keyWords.c_str()).c_str(), &sort->scatterShader_, &sort->scatterPipeline_);
+}
+
+void render::radixSortDestroy(const context_t& context, radix_sort_t* sort)
+{
+  kernelDestroy(context, &sort->histogramShader_, &sort->histogramPipeline_);
+  kernelDestroy(context, &sort->scanShader_, &sort->scanPipeline_);
+  kernelDestroy(context, &sort->scatterShader_, &sort->scatterPipeline_);
+
+  descriptorSetDestroy(context, &sort->descriptorSet_[0]);
+  descriptorSetDestroy(context, &sort->descriptorSet_[1]);
+  descriptorPoolDestroy(context, &sort->descriptorPool_);
+  pipelineLayoutDestroy(context, &sort->pipelineLayout_);
+  descriptorSetLayoutDestroy(context, &sort->descriptorSetLayout_);
+
+  gpuBufferDestroy(context, nullptr, &sort->histogram_);
+  gpuBufferDestroy(context, nullptr, &sort->tempKeys_);
+  gpuBufferDestroy(context, nullptr, &sort->tempValues_);
+}
+
+void render::radixSort(command_buffer_t commandBuffer, const radix_sort_t& sort)
+{
+  //Number of passes is always even so the sorted result ends up in the user buffers
+  descriptor_set_t descriptorSets[2] = { sort.descriptorSet_[0], sort.descriptorSet_[1] };
+  uint32_t passCount = 32u * sort.keySize_ / gRadixSortBitsPerPass;
+  uint32_t passConstants[2] = { 0u, sort.workGroupCount_ };
+  for (uint32_t pass(0); pass < passCount; ++pass)
+  {
+    passConstants[0] = pass * gRadixSortBitsPerPass;
+    descriptorSetBind(commandBuffer, sort.pipelineLayout_, 0u, &descriptorSets[pass % 2u], 1u);
+    computeToComputeBarrier(commandBuffer);
+
+    computePipelineBind(commandBuffer, sort.histogramPipeline_);
+    pushConstants(commandBuffer, sort.pipelineLayout_, 0u, passConstants);
+    computeDispatch(commandBuffer, sort.workGroupCount_, 1u, 1u);
+    computeToComputeBarrier(commandBuffer);
+
+    computePipelineBind(commandBuffer, sort.scanPipeline_);
+    computeDispatch(commandBuffer, 1u, 1u, 1u);
+    computeToComputeBarrier(commandBuffer);
+
+    computePipelineBind(commandBuffer, sort.scatterPipeline_);
+    computeDispatch(commandBuffer, sort.workGroupCount_, 1u, 1u);
+  }
+
+  computeToComputeBarrier(commandBuffer);
+}
+
+void render::histogramCreate(const context_t& context, uint32_t binCount, uint32_t maxElementCount, const gpu_buffer_t& elementCount, const gpu_buffer_t& input, const gpu_buffer_t& histogram, histogram_t* result)
+{
+  assert(maxElementCount > 0u && binCount > 0u);
+
+  result->maxElementCount_ = maxElementCount;
+  result->binCount_ = binCount;
+
+  storageBufferLayoutCreate(context, 3u, sizeof(uint32_t), &result->descriptorSetLayout_, &result->pipelineLayout_);
+  descriptorPoolCreate(context, 1u,
+    combined_image_sampler_count(0u),
+    uniform_buffer_count(0u),
+    storage_buffer_count(3u),
+    storage_image_count(0u),
+    &result->descriptorPool_);
+
+  descriptor_t descriptors[3] = { getDescriptor(elementCount), getDescriptor(input), getDescriptor(histogram) };
+  descriptorSetCreate(context, result->descriptorPool_, result->descriptorSetLayout_, descriptors, &result->descriptorSet_);
+
+  kernelCreate(context, result->pipelineLayout_, gHistogramClearShader, &result->clearShader_, &result->clearPipeline_);
+  kernelCreate(context, result->pipelineLayout_, gHistogramAccumulateShader, &result->accumulateShader_, &result->accumulatePipeline_);
+}
+
+void render::histogramDestroy(const context_t& context, histogram_t* histogram)
+{
+  kernelDestroy(context, &histogram->clearShader_, &histogram->clearPipeline_);
+  kernelDestroy(context, &histogram->accumulateShader_, &histogram->accumulatePipeline_);
+
+  descriptorSetDestroy(context, &histogram->descriptorSet_);
+  descriptorPoolDestroy(context, &histogram->descriptorPool_);
+  pipelineLayoutDestroy(context, &histogram->pipelineLayout_);
+  descriptorSetLayoutDestroy(context, &histogram->descriptorSetLayout_);
+}
+
+void render::histogram(command_buffer_t commandBuffer, const histogram_t& histogram)
+{
+  descriptor_set_t descriptorSet = histogram.descriptorSet_;
+
+  computeToComputeBarrier(commandBuffer);
+  descriptorSetBind(commandBuffer, histogram.pipelineLayout_, 0u, &descriptorSet, 1u);
+
+  computePipelineBind(commandBuffer, histogram.clearPipeline_);
+  pushConstants(commandBuffer, histogram.pipelineLayout_, 0u, &histogram.binCount_);
+  computeDispatch(commandBuffer, (histogram.binCount_ + gWorkGroupSize - 1) / gWorkGroupSize, 1u, 1u);
+  computeToComputeBarrier(commandBuffer);
+
+  computePipelineBind(commandBuffer, histogram.accumulatePipeline_);
+  computeDispatch(commandBuffer, (histogram.maxElementCount_ + gWorkGroupSize - 1) / gWorkGroupSize, 1u, 1u);
+  computeToComputeBarrier(commandBuffer);
+}
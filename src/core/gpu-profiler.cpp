@@ -0,0 +1,304 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "core/gpu-profiler.h"
+#include "core/render.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace bkk::core;
+using namespace bkk::core::render;
+
+static const VkQueryPipelineStatisticFlags gStatisticFlags = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+                                                             VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                                                             VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                             VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                             VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+                                                             VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+static uint32_t getHistoryIndex(gpu_profiler_t* profiler, const char* name)
+{
+  for (uint32_t i(0); i < profiler->history_.size(); ++i)
+  {
+    if (strcmp(profiler->history_[i].name_, name) == 0)
+      return i;
+  }
+
+  gpu_profiler_t::history_t history = {};
+  strcpy(history.name_, name);
+  profiler->history_.push_back(history);
+  return (uint32_t)profiler->history_.size() - 1;
+}
+
+//Reads the queries of a frame if all of them are available
+static bool readFrameResults(const context_t& context, uint32_t slot, gpu_profiler_t* profiler)
+{
+  gpu_profiler_t::frame_t& frame = profiler->frames_[slot];
+  uint32_t markerCount = (uint32_t)frame.markers_.size();
+
+  std::vector<uint64_t> timestamps(2u * markerCount);
+  if (vkGetQueryPoolResults(context.device_, profiler->timestampPool_, 2u * slot * profiler->maxMarkers_, 2u * markerCount,
+                            timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+  {
+    return false;
+  }
+
+  std::vector<uint64_t> statistics(gpu_profiler_t::STATISTIC_COUNT * frame.statisticsCount_);
+  if (frame.statisticsCount_ > 0u &&
+      vkGetQueryPoolResults(context.device_, profiler->statisticsPool_, slot * profiler->maxMarkers_, frame.statisticsCount_,
+                            statistics.size() * sizeof(uint64_t), statistics.data(), gpu_profiler_t::STATISTIC_COUNT * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+  {
+    return false;
+  }
+
+  //Times relative to the first timestamp of the frame
+  uint64_t frameBegin = ~0ull;
+  uint64_t frameEnd = 0ull;
+  for (uint32_t i(0); i < 2u * markerCount; ++i)
+  {
+    timestamps[i] &= profiler->timestampMask_;
+    frameBegin = std::min(frameBegin, timestamps[i]);
+    frameEnd = std::max(frameEnd, timestamps[i]);
+  }
+
+  const double toMilliseconds = profiler->timestampPeriod_ / 1000000.0;
+  profiler->frameTime_ = float((double)(frameEnd - frameBegin) * toMilliseconds);
+  profiler->results_ = frame.markers_;
+  for (uint32_t i(0); i < markerCount; ++i)
+  {
+    gpu_profiler_t::marker_t& marker = profiler->results_[i];
+    marker.begin_ = float((double)(timestamps[2 * i] - frameBegin) * toMilliseconds);
+    marker.end_ = float((double)(timestamps[2 * i + 1] - frameBegin) * toMilliseconds);
+    if (marker.statisticsQuery_ != -1)
+      memcpy(marker.statistics_, &statistics[marker.statisticsQuery_ * gpu_profiler_t::STATISTIC_COUNT], sizeof(marker.statistics_));
+  }
+
+  //Add the total time of each marker name in the frame to its history
+  std::vector<uint32_t> updated;
+  for (uint32_t i(0); i < markerCount; ++i)
+  {
+    uint32_t index = getHistoryIndex(profiler, profiler->results_[i].name_);
+    gpu_profiler_t::history_t& history = profiler->history_[index];
+    if (std::find(updated.begin(), updated.end(), index) == updated.end())
+    {
+      history.time_[history.next_] = 0.0f;
+      updated.push_back(index);
+    }
+    history.time_[history.next_] += profiler->results_[i].end_ - profiler->results_[i].begin_;
+  }
+
+  for (uint32_t i(0); i < updated.size(); ++i)
+  {
+    gpu_profiler_t::history_t& history = profiler->history_[updated[i]];
+    history.next_ = (history.next_ + 1) % gpu_profiler_t::HISTORY_SIZE;
+    history.count_ = history.count_ < gpu_profiler_t::HISTORY_SIZE ? history.count_ + 1 : gpu_profiler_t::HISTORY_SIZE;
+  }
+
+  return true;
+}
+
+void render::gpuProfilerCreate(const context_t& context, uint32_t frameCount, uint32_t maxMarkersPerFrame, gpu_profiler_t* profiler)
+{
+  profiler->timestampPool_ = VK_NULL_HANDLE;
+  profiler->statisticsPool_ = VK_NULL_HANDLE;
+  profiler->maxMarkers_ = maxMarkersPerFrame;
+  profiler->timestampMask_ = 0u;
+  profiler->timestampPeriod_ = 1.0f;
+  profiler->frame_ = 0u;
+  profiler->frameTime_ = 0.0f;
+  profiler->frames_.resize(frameCount);
+  for (uint32_t i(0); i < frameCount; ++i)
+  {
+    profiler->frames_[i].statisticsCount_ = 0u;
+    profiler->frames_[i].reset_ = false;
+  }
+
+  uint32_t queueFamilyCount = 0u;
+  vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice_, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice_, &queueFamilyCount, queueFamilyProperties.data());
+  uint32_t timestampValidBits = queueFamilyProperties[context.graphicsQueue_.queueIndex_].timestampValidBits;
+  if (timestampValidBits == 0u)
+    return;
+
+  profiler->timestampMask_ = timestampValidBits >= 64u ? ~0ull : ((1ull << timestampValidBits) - 1ull);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(context.physicalDevice_, &properties);
+  profiler->timestampPeriod_ = properties.limits.timestampPeriod;
+
+  //Begin and end timestamps of every marker
+  VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+  queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolCreateInfo.queryCount = 2u * maxMarkersPerFrame * frameCount;
+  vkCreateQueryPool(context.device_, &queryPoolCreateInfo, nullptr, &profiler->timestampPool_);
+
+  if (context.features_.pipelineStatisticsQuery == VK_TRUE)
+  {
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolCreateInfo.queryCount = maxMarkersPerFrame * frameCount;
+    queryPoolCreateInfo.pipelineStatistics = gStatisticFlags;
+    vkCreateQueryPool(context.device_, &queryPoolCreateInfo, nullptr, &profiler->statisticsPool_);
+  }
+}
+
+void render::gpuProfilerDestroy(const context_t& context, gpu_profiler_t* profiler)
+{
+  if (profiler->timestampPool_ != VK_NULL_HANDLE)
+    vkDestroyQueryPool(context.device_, profiler->timestampPool_, nullptr);
+
+  if (profiler->statisticsPool_ != VK_NULL_HANDLE)
+    vkDestroyQueryPool(context.device_, profiler->statisticsPool_, nullptr);
+
+  profiler->timestampPool_ = VK_NULL_HANDLE;
+  profiler->statisticsPool_ = VK_NULL_HANDLE;
+  profiler->frames_.clear();
+  profiler->results_.clear();
+  profiler->history_.clear();
+}
+
+bool render::gpuProfilerBeginFrame(const context_t& context, gpu_profiler_t* profiler)
+{
+  if (profiler->timestampPool_ == VK_NULL_HANDLE)
+    return false;
+
+  //The queries about to be reused belong to the oldest frame in flight
+  uint32_t slot = profiler->frame_ % (uint32_t)profiler->frames_.size();
+  gpu_profiler_t::frame_t& frame = profiler->frames_[slot];
+  bool read = false;
+  if (frame.reset_ && !frame.markers_.empty() && frame.openMarkers_.empty())
+    read = readFrameResults(context, slot, profiler);
+
+  frame.markers_.clear();
+  frame.openMarkers_.clear();
+  frame.statisticsCount_ = 0u;
+  frame.reset_ = false;
+  return read;
+}
+
+void render::gpuProfilerEndFrame(gpu_profiler_t* profiler)
+{
+  ++profiler->frame_;
+}
+
+void render::gpuProfilerResetQueries(command_buffer_t commandBuffer, gpu_profiler_t* profiler)
+{
+  if (profiler->timestampPool_ == VK_NULL_HANDLE)
+    return;
+
+  uint32_t slot = profiler->frame_ % (uint32_t)profiler->frames_.size();
+  gpu_profiler_t::frame_t& frame = profiler->frames_[slot];
+  if (frame.reset_)
+    return;
+
+  vkCmdResetQueryPool(commandBuffer.handle_, profiler->timestampPool_, 2u * slot * profiler->maxMarkers_, 2u * profiler->maxMarkers_);
+  if (profiler->statisticsPool_ != VK_NULL_HANDLE)
+    vkCmdResetQueryPool(commandBuffer.handle_, profiler->statisticsPool_, slot * profiler->maxMarkers_, profiler->maxMarkers_);
+
+  frame.reset_ = true;
+}
+
+void render::gpuProfilerBeginMarker(command_buffer_t commandBuffer, const char* name, bool pipelineStatistics, gpu_profiler_t* profiler)
+{
+  if (profiler->timestampPool_ == VK_NULL_HANDLE)
+    return;
+
+  uint32_t slot = profiler->frame_ % (uint32_t)profiler->frames_.size();
+  gpu_profiler_t::frame_t& frame = profiler->frames_[slot];
+  assert(frame.reset_);
+
+  //Markers over the limit are ignored but still have to be closed
+  uint32_t index = (uint32_t)frame.markers_.size();
+  if (index >= profiler->maxMarkers_ || !frame.reset_)
+  {
+    frame.openMarkers_.push_back(~0u);
+    return;
+  }
+
+  gpu_profiler_t::marker_t marker = {};
+  strncpy(marker.name_, name, gpu_profiler_t::MAX_NAME_LENGTH - 1);
+  marker.depth_ = (uint32_t)frame.openMarkers_.size();
+  marker.statisticsQuery_ = -1;
+  if (pipelineStatistics && profiler->statisticsPool_ != VK_NULL_HANDLE)
+  {
+    marker.statisticsQuery_ = frame.statisticsCount_++;
+    vkCmdBeginQuery(commandBuffer.handle_, profiler->statisticsPool_, slot * profiler->maxMarkers_ + marker.statisticsQuery_, 0u);
+  }
+
+  vkCmdWriteTimestamp(commandBuffer.handle_, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->timestampPool_, 2u * (slot * profiler->maxMarkers_ + index));
+  frame.markers_.push_back(marker);
+  frame.openMarkers_.push_back(index);
+}
+
+void render::gpuProfilerEndMarker(command_buffer_t commandBuffer, gpu_profiler_t* profiler)
+{
+  if (profiler->timestampPool_ == VK_NULL_HANDLE)
+    return;
+
+  uint32_t slot = profiler->frame_ % (uint32_t)profiler->frames_.size();
+  gpu_profiler_t::frame_t& frame = profiler->frames_[slot];
+  assert(!frame.openMarkers_.empty());
+
+  uint32_t index = frame.openMarkers_.back();
+  frame.openMarkers_.pop_back();
+  if (index == ~0u)
+    return;
+
+  vkCmdWriteTimestamp(commandBuffer.handle_, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->timestampPool_, 2u * (slot * profiler->maxMarkers_ + index) + 1u);
+  if (frame.markers_[index].statisticsQuery_ != -1)
+    vkCmdEndQuery(commandBuffer.handle_, profiler->statisticsPool_, slot * profiler->maxMarkers_ + frame.markers_[index].statisticsQuery_);
+}
+
+bool render::gpuProfilerGetTimings(const gpu_profiler_t& profiler, const char* name, float* average, float* p50, float* p95, float* p99)
+{
+  for (uint32_t i(0); i < profiler.history_.size(); ++i)
+  {
+    const gpu_profiler_t::history_t& history = profiler.history_[i];
+    if (strcmp(history.name_, name) != 0 || history.count_ == 0u)
+      continue;
+
+    //Last count_ samples written, oldest first
+    std::vector<float> samples(history.count_);
+    uint32_t first = (history.next_ + gpu_profiler_t::HISTORY_SIZE - history.count_) % gpu_profiler_t::HISTORY_SIZE;
+    float sum = 0.0f;
+    for (uint32_t j(0); j < history.count_; ++j)
+    {
+      samples[j] = history.time_[(first + j) % gpu_profiler_t::HISTORY_SIZE];
+      sum += samples[j];
+    }
+
+    std::sort(samples.begin(), samples.end());
+    *average = sum / history.count_;
+    *p50 = samples[(history.count_ - 1) * 50 / 100];
+    *p95 = samples[(history.count_ - 1) * 95 / 100];
+    *p99 = samples[(history.count_ - 1) * 99 / 100];
+    return true;
+  }
+
+  return false;
+}
@@ -23,6 +23,12 @@
 */
 
 #include "core/image.h"
+#include "core/cpu-profiler.h"
+#include "core/maths.h"
+
+#include <stdio.h>
+#include <vector>
+
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_STATIC
 #include "stb_image.h"
@@ -39,6 +45,8 @@ static const char* getFileExtension(const char *filename)
 
 bool image::load( const char* path, bool flipVertical, image2D_t* image )
 {
+  BKK_ZONE("image::load");
+
   if( image->data_ != nullptr )
   {
     unload(image);
@@ -111,3 +119,202 @@ void image::unload( image2D_t* image )
   image->data_ = nullptr;
   image->width_ = image->height_ = image->componentCount_ = image->dataSize_ = 0u;
 }
+
+//Component of a pixel in the range [0,1] for 8 bit images
+static float getComponent(const image2D_t& image, uint32_t pixel, uint32_t component)
+{
+  uint32_t index = pixel * image.componentCount_ + component;
+  if (image.componentSize_ == 1)
+    return image.data_[index] / 255.0f;
+
+  return ((const float*)image.data_)[index];
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0u)
+{
+  crc = ~crc;
+  for (size_t i(0); i < size; ++i)
+  {
+    crc ^= data[i];
+    for (uint32_t bit(0); bit < 8; ++bit)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+
+static void writeBigEndian(uint32_t value, std::vector<uint8_t>* data)
+{
+  data->push_back((uint8_t)(value >> 24));
+  data->push_back((uint8_t)(value >> 16));
+  data->push_back((uint8_t)(value >> 8));
+  data->push_back((uint8_t)value);
+}
+
+static void writePNGChunk(FILE* file, const char* type, const std::vector<uint8_t>& data)
+{
+  std::vector<uint8_t> chunk;
+  writeBigEndian((uint32_t)data.size(), &chunk);
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  writeBigEndian(crc32(&chunk[4], chunk.size() - 4), &chunk);
+  fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+//8 bit PNG. Pixels are stored uncompressed (zlib stream made of stored deflate blocks)
+static bool savePNG(const char* path, const image2D_t& image)
+{
+  static const uint8_t colorTypes[] = { 0, 4, 2, 6 };  //Gray, gray+alpha, RGB, RGBA
+  if (image.componentCount_ == 0 || image.componentCount_ > 4)
+    return false;
+
+  FILE* file = fopen(path, "wb");
+  if (!file)
+    return false;
+
+  static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  fwrite(signature, 1, sizeof(signature), file);
+
+  std::vector<uint8_t> header;
+  writeBigEndian(image.width_, &header);
+  writeBigEndian(image.height_, &header);
+  header.push_back(8);
+  header.push_back(colorTypes[image.componentCount_ - 1]);
+  header.push_back(0);
+  header.push_back(0);
+  header.push_back(0);
+  writePNGChunk(file, "IHDR", header);
+
+  //Scanlines, each one preceded by its filter type (none)
+  uint32_t rowSize = image.width_ * image.componentCount_;
+  std::vector<uint8_t> scanlines((rowSize + 1) * image.height_);
+  for (uint32_t y(0); y < image.height_; ++y)
+  {
+    uint8_t* row = &scanlines[y * (rowSize + 1)];
+    row[0] = 0;
+    for (uint32_t x(0); x < rowSize; ++x)
+    {
+      float value = getComponent(image, y * image.width_ + x / image.componentCount_, x % image.componentCount_);
+      row[x + 1] = (uint8_t)(maths::clamp(0.0f, 1.0f, value) * 255.0f + 0.5f);
+    }
+  }
+
+  std::vector<uint8_t> zlib;
+  zlib.push_back(0x78);
+  zlib.push_back(0x01);
+  uint32_t adlerA = 1u, adlerB = 0u;
+  size_t offset = 0u;
+  do
+  {
+    uint32_t blockSize = (uint32_t)maths::minValue(scanlines.size() - offset, (size_t)65535u);
+    zlib.push_back(offset + blockSize == scanlines.size() ? 1 : 0);
+    zlib.push_back((uint8_t)blockSize);
+    zlib.push_back((uint8_t)(blockSize >> 8));
+    zlib.push_back((uint8_t)~blockSize);
+    zlib.push_back((uint8_t)(~blockSize >> 8));
+    for (uint32_t i(0); i < blockSize; ++i)
+    {
+      uint8_t value = scanlines[offset + i];
+      zlib.push_back(value);
+      adlerA = (adlerA + value) % 65521u;
+      adlerB = (adlerB + adlerA) % 65521u;
+    }
+    offset += blockSize;
+  } while (offset < scanlines.size());
+  writeBigEndian((adlerB << 16) | adlerA, &zlib);
+  writePNGChunk(file, "IDAT", zlib);
+
+  writePNGChunk(file, "IEND", std::vector<uint8_t>());
+  fclose(file);
+  return true;
+}
+
+template <typename T>
+static void writeEXRAttribute(FILE* file, const char* name, const char* type, const T& value)
+{
+  int32_t size = sizeof(T);
+  fwrite(name, 1, strlen(name) + 1, file);
+  fwrite(type, 1, strlen(type) + 1, file);
+  fwrite(&size, sizeof(size), 1, file);
+  fwrite(&value, sizeof(T), 1, file);
+}
+
+//Uncompressed scanline OpenEXR with 32 bit float channels. 8 bit images are written in the range [0,1]
+static bool saveEXR(const char* path, const image2D_t& image)
+{
+  //Channels must be sorted by name
+  static const char* channelNames[] = { "Y", "AY", "BGR", "ABGR" };
+  static const uint32_t channelComponents[4][4] = { { 0 },{ 1, 0 },{ 2, 1, 0 },{ 3, 2, 1, 0 } };
+  if (image.componentCount_ == 0 || image.componentCount_ > 4)
+    return false;
+
+  FILE* file = fopen(path, "wb");
+  if (!file)
+    return false;
+
+  static const uint8_t magic[] = { 0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0 };
+  fwrite(magic, 1, sizeof(magic), file);
+
+  const char* names = channelNames[image.componentCount_ - 1];
+  int32_t channelListSize = image.componentCount_ * 18 + 1;
+  fwrite("channels\0chlist\0", 1, 16, file);
+  fwrite(&channelListSize, sizeof(channelListSize), 1, file);
+  for (uint32_t i(0); i < image.componentCount_; ++i)
+  {
+    const int32_t channel[4] = { 2, 0, 1, 1 };  //Float, pLinear and reserved, x and y sampling
+    fwrite(&names[i], 1, 1, file);
+    fputc(0, file);
+    fwrite(channel, sizeof(channel), 1, file);
+  }
+  fputc(0, file);
+
+  const int32_t window[4] = { 0, 0, (int32_t)image.width_ - 1, (int32_t)image.height_ - 1 };
+  const float screenWindowCenter[2] = { 0.0f, 0.0f };
+  writeEXRAttribute(file, "compression", "compression", (uint8_t)0);
+  writeEXRAttribute(file, "dataWindow", "box2i", window);
+  writeEXRAttribute(file, "displayWindow", "box2i", window);
+  writeEXRAttribute(file, "lineOrder", "lineOrder", (uint8_t)0);
+  writeEXRAttribute(file, "pixelAspectRatio", "float", 1.0f);
+  writeEXRAttribute(file, "screenWindowCenter", "v2f", screenWindowCenter);
+  writeEXRAttribute(file, "screenWindowWidth", "float", 1.0f);
+  fputc(0, file);
+
+  //Offsets of the scanlines, then the scanlines with all the pixels of each channel one after another
+  int32_t scanlineSize = image.width_ * image.componentCount_ * sizeof(float);
+  uint64_t offset = (uint64_t)ftell(file) + image.height_ * sizeof(uint64_t);
+  for (uint32_t y(0); y < image.height_; ++y)
+  {
+    fwrite(&offset, sizeof(offset), 1, file);
+    offset += 2 * sizeof(int32_t) + scanlineSize;
+  }
+
+  std::vector<float> scanline(image.width_ * image.componentCount_);
+  for (int32_t y(0); y < (int32_t)image.height_; ++y)
+  {
+    for (uint32_t c(0); c < image.componentCount_; ++c)
+    {
+      for (uint32_t x(0); x < image.width_; ++x)
+        scanline[c * image.width_ + x] = getComponent(image, y * image.width_ + x, channelComponents[image.componentCount_ - 1][c]);
+    }
+
+    fwrite(&y, sizeof(y), 1, file);
+    fwrite(&scanlineSize, sizeof(scanlineSize), 1, file);
+    fwrite(scanline.data(), scanlineSize, 1, file);
+  }
+
+  fclose(file);
+  return true;
+}
+
+bool image::save(const char* path, const image2D_t& image)
+{
+  if (image.data_ == nullptr || (image.componentSize_ != 1 && image.componentSize_ != 4))
+    return false;
+
+  const char* extension = getFileExtension(path);
+  if (strcmp(extension, "png") == 0)
+    return savePNG(path, image);
+  else if (strcmp(extension, "exr") == 0)
+    return saveEXR(path, image);
+
+  return false;
+}
@@ -23,6 +23,7 @@
 */
 
 #include "core/mesh.h"
+#include "core/cpu-profiler.h"
 
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
@@ -429,6 +430,8 @@ void mesh::create(const render::context_t& context,
 
 void mesh::createFromFile(const render::context_t& context, const char* file, export_flags_e exportFlags, render::gpu_memory_allocator_t* allocator, uint32_t submesh, mesh_t* mesh)
 {
+  BKK_ZONE("mesh::createFromFile");
+
   Assimp::Importer Importer;
   int flags = aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights | aiProcess_GenSmoothNormals;
   const struct aiScene* scene = Importer.ReadFile(file, flags);
@@ -439,6 +442,8 @@ void mesh::createFromFile(const render::context_t& context, const char* file, ex
 
 uint32_t mesh::createFromFile(const render::context_t& context, const char* file, export_flags_e exportFlags, render::gpu_memory_allocator_t* allocator, mesh_t** meshes)
 {
+  BKK_ZONE("mesh::createFromFile");
+
   Assimp::Importer Importer;
   int flags = aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights | aiProcess_GenSmoothNormals;
   const struct aiScene* scene = Importer.ReadFile(file, flags);
@@ -497,11 +502,9 @@ uint32_t mesh::loadMaterials(const char* file, uint32_t** materialIndices, mater
   return materialCount;
 }
 
-void mesh::destroy(const render::context_t& context, mesh_t* mesh, render::gpu_memory_allocator_t* allocator)
+//Skeleton, animations and vertex format
+static void DestroyMeshData(mesh_t* mesh)
 {
-  render::gpuBufferDestroy(context, allocator, &mesh->indexBuffer_);
-  render::gpuBufferDestroy(context, allocator, &mesh->vertexBuffer_);
-
   if (mesh->skeleton_)
   {
     delete[] mesh->skeleton_->bindPose_;
@@ -522,6 +525,20 @@ void mesh::destroy(const render::context_t& context, mesh_t* mesh, render::gpu_m
   vertexFormatDestroy(&mesh->vertexFormat_);
 }
 
+void mesh::destroy(const render::context_t& context, mesh_t* mesh, render::gpu_memory_allocator_t* allocator)
+{
+  render::gpuBufferDestroy(context, allocator, &mesh->indexBuffer_);
+  render::gpuBufferDestroy(context, allocator, &mesh->vertexBuffer_);
+  DestroyMeshData(mesh);
+}
+
+void mesh::destroyDeferred(render::context_t* context, mesh_t* mesh, render::gpu_memory_allocator_t* allocator)
+{
+  render::gpuBufferDestroyDeferred(context, allocator, &mesh->indexBuffer_);
+  render::gpuBufferDestroyDeferred(context, allocator, &mesh->vertexBuffer_);
+  DestroyMeshData(mesh);
+}
+
 void mesh::draw(render::command_buffer_t commandBuffer, const mesh_t& mesh)
 {
   vkCmdBindIndexBuffer(commandBuffer.handle_, mesh.indexBuffer_.handle_, 0, VK_INDEX_TYPE_UINT32);
@@ -537,6 +554,25 @@ void mesh::draw(render::command_buffer_t commandBuffer, const mesh_t& mesh)
 
   vkCmdBindVertexBuffers(commandBuffer.handle_, 0, attributeCount, &buffers[0], &offsets[0]);
   vkCmdDrawIndexed(commandBuffer.handle_, mesh.indexCount_, 1, 0, 0, 0);
+  render::statsAddDraws(commandBuffer, 1u);
+}
+
+void mesh::drawIndirect(render::command_buffer_t commandBuffer, const render::gpu_buffer_t& indirectBuffer, VkDeviceSize offset, const mesh_t& mesh)
+{
+  vkCmdBindIndexBuffer(commandBuffer.handle_, mesh.indexBuffer_.handle_, 0, VK_INDEX_TYPE_UINT32);
+
+  uint32_t attributeCount = mesh.vertexFormat_.attributeCount_;
+  std::vector<VkBuffer> buffers(attributeCount);
+  std::vector<VkDeviceSize> offsets(attributeCount);
+  for (uint32_t i(0); i<attributeCount; ++i)
+  {
+    buffers[i] = mesh.vertexBuffer_.handle_;
+    offsets[i] = 0u;
+  }
+
+  vkCmdBindVertexBuffers(commandBuffer.handle_, 0, attributeCount, &buffers[0], &offsets[0]);
+  vkCmdDrawIndexedIndirect(commandBuffer.handle_, indirectBuffer.handle_, offset, 1u, sizeof(VkDrawIndexedIndirectCommand));
+  render::statsAddDraws(commandBuffer, 1u);
 }
 
 void mesh::drawInstanced(render::command_buffer_t commandBuffer, u32 instanceCount, render::gpu_buffer_t* instanceBuffer, u32 instancedAttributesCount, const mesh_t& mesh)
@@ -567,6 +603,7 @@ void mesh::drawInstanced(render::command_buffer_t commandBuffer, u32 instanceCou
 
   //Draw command
   vkCmdDrawIndexed(commandBuffer.handle_, mesh.indexCount_, instanceCount, 0, 0, 0);
+  render::statsAddDraws(commandBuffer, 1u);
 };
 
 
@@ -588,7 +625,7 @@ void mesh::animatorCreate(const render::context_t& context, const mesh_t& mesh,
 }
 
 
-void mesh::animatorUpdate(const render::context_t& context, f32 deltaTime, skeletal_animator_t* animator)
+void mesh::animatorSample(f32 deltaTime, skeletal_animator_t* animator)
 {
   animator->cursor_ += ( deltaTime / animator->animation_->duration_ ) * animator->speed_;
 
@@ -638,6 +675,11 @@ void mesh::animatorUpdate(const render::context_t& context, f32 deltaTime, skele
     maths::mat4* boneGlobalTx = animator->skeleton_->txManager_.getWorldMatrix(animator->skeleton_->bones_[i]);
     animator->boneTransform_[i] = animator->skeleton_->bindPose_[i] * (*boneGlobalTx) * animator->skeleton_->rootBoneInverseTransform_;
   }
+}
+
+void mesh::animatorUpdate(const render::context_t& context, f32 deltaTime, skeletal_animator_t* animator)
+{
+  animatorSample(deltaTime, animator);
 
   //Upload bone transforms to the uniform buffer
   render::gpuBufferUpdate(context, (void*)animator->boneTransform_, 0u, sizeof(maths::mat4)*animator->skeleton_->boneCount_, &animator->buffer_);
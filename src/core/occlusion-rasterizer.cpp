@@ -0,0 +1,438 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "core/occlusion-rasterizer.h"
+#include "core/cpu-profiler.h"
+
+#include <emmintrin.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cmath>
+
+using namespace bkk::core;
+using namespace bkk::core::occlusion;
+
+//Outside bits of a clip space position. Near plane is z = 0 (Vulkan clip volume)
+static uint32_t outCode(const maths::vec4& v)
+{
+  return (v.x < -v.w ? 1u : 0u) | (v.x > v.w ? 2u : 0u) |
+         (v.y < -v.w ? 4u : 0u) | (v.y > v.w ? 8u : 0u) |
+         (v.z < 0.0f ? 16u : 0u) | (v.z > v.w ? 32u : 0u);
+}
+
+//Pixel coordinates can be far outside of the buffer for triangles crossing the side planes
+static int32_t pixelFloor(float value, int32_t size)
+{
+  return (int32_t)floorf(maths::clamp(-1.0f, (float)size, value));
+}
+
+static int32_t pixelCeil(float value, int32_t size)
+{
+  return (int32_t)ceilf(maths::clamp(-1.0f, (float)size, value));
+}
+
+//Threads helping rasterize(). They are created the first time they are needed and sleep between calls
+struct worker_pool_t
+{
+  ~worker_pool_t()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+    }
+
+    wake_.notify_all();
+    for (uint32_t i(0); i < threads_.size(); ++i)
+      threads_[i].join();
+  }
+
+  //Rasterizes all the tiles using 'helperCount' workers and the calling thread
+  void run(depth_buffer_t* depthBuffer, uint32_t tileCount, uint32_t helperCount)
+  {
+    std::lock_guard<std::mutex> runLock(runMutex_);
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (threads_.size() < helperCount)
+      {
+        uint32_t index = (uint32_t)threads_.size();
+        threads_.push_back(std::thread([this, index]() { workerLoop(index); }));
+      }
+
+      depthBuffer_ = depthBuffer;
+      tileCount_ = tileCount;
+      helperCount_ = helperCount;
+      pending_ = helperCount;
+      nextTile_ = 0u;
+      ++generation_;
+    }
+
+    wake_.notify_all();
+    rasterizeTiles();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (pending_ > 0u)
+      done_.wait(lock);
+
+    depthBuffer_ = nullptr;
+  }
+
+private:
+
+  //Tiles are handed out one at a time so threads finishing empty tiles take more work
+  void rasterizeTiles()
+  {
+    for (uint32_t tile = nextTile_++; tile < tileCount_; tile = nextTile_++)
+      rasterizeTile(tile, depthBuffer_);
+  }
+
+  void workerLoop(uint32_t index)
+  {
+    uint64_t generation = 0u;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      while (!quit_ && generation == generation_)
+        wake_.wait(lock);
+
+      if (quit_)
+        return;
+
+      //Workers beyond the count requested by this call sit it out
+      generation = generation_;
+      if (index >= helperCount_)
+        continue;
+
+      lock.unlock();
+      {
+        BKK_ZONE("occlusion::rasterize worker");
+        rasterizeTiles();
+      }
+      lock.lock();
+
+      if (--pending_ == 0u)
+        done_.notify_one();
+    }
+  }
+
+  std::vector<std::thread> threads_;
+  std::mutex runMutex_;                 //One rasterization at a time
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  uint64_t generation_ = 0u;
+  bool quit_ = false;
+
+  depth_buffer_t* depthBuffer_ = nullptr;
+  uint32_t tileCount_ = 0u;
+  uint32_t helperCount_ = 0u;
+  uint32_t pending_ = 0u;
+  std::atomic<uint32_t> nextTile_{ 0u };
+};
+
+static worker_pool_t gWorkerPool;
+
+static void binTriangle(const maths::vec4& v0, const maths::vec4& v1, const maths::vec4& v2, depth_buffer_t* depthBuffer)
+{
+  const maths::vec4* v[3] = { &v0, &v1, &v2 };
+  triangle_t triangle;
+  for (uint32_t i(0); i < 3; ++i)
+  {
+    float invW = 1.0f / v[i]->w;
+    triangle.x_[i] = (v[i]->x * invW * 0.5f + 0.5f) * depthBuffer->width_;
+    triangle.y_[i] = (v[i]->y * invW * 0.5f + 0.5f) * depthBuffer->height_;
+    triangle.z_[i] = v[i]->z * invW;
+  }
+
+  float area = (triangle.x_[1] - triangle.x_[0]) * (triangle.y_[2] - triangle.y_[0]) - (triangle.y_[1] - triangle.y_[0]) * (triangle.x_[2] - triangle.x_[0]);
+  if (area == 0.0f)
+    return;
+
+  //Pixels whose center is inside the bounding box
+  float minX = maths::minValue(triangle.x_[0], maths::minValue(triangle.x_[1], triangle.x_[2]));
+  float maxX = maths::maxValue(triangle.x_[0], maths::maxValue(triangle.x_[1], triangle.x_[2]));
+  float minY = maths::minValue(triangle.y_[0], maths::minValue(triangle.y_[1], triangle.y_[2]));
+  float maxY = maths::maxValue(triangle.y_[0], maths::maxValue(triangle.y_[1], triangle.y_[2]));
+  const int32_t width = (int32_t)depthBuffer->width_;
+  const int32_t height = (int32_t)depthBuffer->height_;
+  int32_t x0 = maths::maxValue(0, pixelCeil(minX - 0.5f, width));
+  int32_t x1 = maths::minValue(width - 1, pixelFloor(maxX - 0.5f, width));
+  int32_t y0 = maths::maxValue(0, pixelCeil(minY - 0.5f, height));
+  int32_t y1 = maths::minValue(height - 1, pixelFloor(maxY - 0.5f, height));
+  if (x0 > x1 || y0 > y1)
+    return;
+
+  uint32_t index = (uint32_t)depthBuffer->triangles_.size();
+  depthBuffer->triangles_.push_back(triangle);
+  for (uint32_t tileY(y0 / TILE_HEIGHT); tileY <= y1 / TILE_HEIGHT; ++tileY)
+  {
+    for (uint32_t tileX(x0 / TILE_WIDTH); tileX <= x1 / TILE_WIDTH; ++tileX)
+    {
+      depthBuffer->bins_[tileY * depthBuffer->tileCountX_ + tileX].push_back(index);
+    }
+  }
+}
+
+void occlusion::depthBufferCreate(uint32_t width, uint32_t height, depth_buffer_t* depthBuffer)
+{
+  depthBuffer->tileCountX_ = maths::maxValue(1u, (width + TILE_WIDTH - 1) / TILE_WIDTH);
+  depthBuffer->tileCountY_ = maths::maxValue(1u, (height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+  depthBuffer->width_ = depthBuffer->tileCountX_ * TILE_WIDTH;
+  depthBuffer->height_ = depthBuffer->tileCountY_ * TILE_HEIGHT;
+  depthBuffer->depth_.assign(depthBuffer->width_ * depthBuffer->height_, 1.0f);
+  depthBuffer->bins_.resize(depthBuffer->tileCountX_ * depthBuffer->tileCountY_);
+  depthBuffer->triangles_.clear();
+}
+
+void occlusion::begin(const maths::mat4& viewProjection, depth_buffer_t* depthBuffer)
+{
+  depthBuffer->viewProjection_ = viewProjection;
+  depthBuffer->triangles_.clear();
+  for (uint32_t i(0); i < depthBuffer->bins_.size(); ++i)
+    depthBuffer->bins_[i].clear();
+}
+
+void occlusion::addOccluder(const occluder_t& occluder, const maths::mat4& transform, depth_buffer_t* depthBuffer)
+{
+  maths::mat4 modelViewProjection = transform * depthBuffer->viewProjection_;
+  std::vector<maths::vec4>& clipVertices = depthBuffer->clipVertices_;
+  clipVertices.resize(occluder.vertices_.size());
+  for (uint32_t i(0); i < occluder.vertices_.size(); ++i)
+  {
+    const maths::vec3& v = occluder.vertices_[i];
+    clipVertices[i] = maths::vec4(v.x, v.y, v.z, 1.0f) * modelViewProjection;
+  }
+
+  for (uint32_t i(0); i + 2 < occluder.indices_.size(); i += 3)
+  {
+    const maths::vec4* v[3] = { &clipVertices[occluder.indices_[i]], &clipVertices[occluder.indices_[i + 1]], &clipVertices[occluder.indices_[i + 2]] };
+    uint32_t code[3] = { outCode(*v[0]), outCode(*v[1]), outCode(*v[2]) };
+
+    //Outside of the same frustum plane
+    if ((code[0] & code[1] & code[2]) != 0u)
+      continue;
+
+    if (((code[0] | code[1] | code[2]) & 16u) == 0u)
+    {
+      binTriangle(*v[0], *v[1], *v[2], depthBuffer);
+      continue;
+    }
+
+    //Clip against the near plane. Result has 3 or 4 vertices
+    maths::vec4 polygon[4];
+    uint32_t vertexCount = 0u;
+    for (uint32_t j(0); j < 3; ++j)
+    {
+      const maths::vec4& a = *v[j];
+      const maths::vec4& b = *v[(j + 1) % 3];
+      if (a.z >= 0.0f)
+        polygon[vertexCount++] = a;
+
+      if ((a.z >= 0.0f) != (b.z >= 0.0f))
+        polygon[vertexCount++] = a + (b - a) * (a.z / (a.z - b.z));
+    }
+
+    for (uint32_t j(2); j < vertexCount; ++j)
+      binTriangle(polygon[0], polygon[j - 1], polygon[j], depthBuffer);
+  }
+}
+
+void occlusion::rasterizeTile(uint32_t tile, depth_buffer_t* depthBuffer)
+{
+  const uint32_t width = depthBuffer->width_;
+  const int32_t tileX0 = (tile % depthBuffer->tileCountX_) * TILE_WIDTH;
+  const int32_t tileY0 = (tile / depthBuffer->tileCountX_) * TILE_HEIGHT;
+  float* depth = depthBuffer->depth_.data();
+
+  const __m128 one = _mm_set1_ps(1.0f);
+  for (int32_t y(tileY0); y < tileY0 + (int32_t)TILE_HEIGHT; ++y)
+  {
+    for (int32_t x(tileX0); x < tileX0 + (int32_t)TILE_WIDTH; x += 4)
+      _mm_storeu_ps(depth + y * width + x, one);
+  }
+
+  const __m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const std::vector<uint32_t>& bin = depthBuffer->bins_[tile];
+  for (uint32_t i(0); i < bin.size(); ++i)
+  {
+    const triangle_t& triangle = depthBuffer->triangles_[bin[i]];
+
+    //No backface culling. Clockwise triangles are swapped so edge functions are positive inside
+    uint32_t i1 = 1u, i2 = 2u;
+    float area = (triangle.x_[1] - triangle.x_[0]) * (triangle.y_[2] - triangle.y_[0]) - (triangle.y_[1] - triangle.y_[0]) * (triangle.x_[2] - triangle.x_[0]);
+    if (area < 0.0f)
+    {
+      i1 = 2u;
+      i2 = 1u;
+      area = -area;
+    }
+
+    float x[3] = { triangle.x_[0], triangle.x_[i1], triangle.x_[i2] };
+    float y[3] = { triangle.y_[0], triangle.y_[i1], triangle.y_[i2] };
+    float z[3] = { triangle.z_[0], triangle.z_[i1], triangle.z_[i2] };
+
+    //Edge functions E(p) = a*px + b*py + c. Edge k is opposite to vertex k
+    float a[3], b[3], c[3];
+    for (uint32_t k(0); k < 3; ++k)
+    {
+      uint32_t j0 = (k + 1) % 3;
+      uint32_t j1 = (k + 2) % 3;
+      a[k] = y[j0] - y[j1];
+      b[k] = x[j1] - x[j0];
+      c[k] = x[j0] * y[j1] - y[j0] * x[j1];
+    }
+
+    //Depth plane from the barycentric coordinates
+    float invArea = 1.0f / area;
+    float za = (a[0] * z[0] + a[1] * z[1] + a[2] * z[2]) * invArea;
+    float zb = (b[0] * z[0] + b[1] * z[1] + b[2] * z[2]) * invArea;
+    float zc = (c[0] * z[0] + c[1] * z[1] + c[2] * z[2]) * invArea;
+
+    //Bounding box clipped to the tile. X is aligned to the SIMD width
+    float minX = maths::minValue(x[0], maths::minValue(x[1], x[2]));
+    float maxX = maths::maxValue(x[0], maths::maxValue(x[1], x[2]));
+    float minY = maths::minValue(y[0], maths::minValue(y[1], y[2]));
+    float maxY = maths::maxValue(y[0], maths::maxValue(y[1], y[2]));
+    int32_t x0 = maths::maxValue(tileX0, pixelCeil(minX - 0.5f, (int32_t)width)) & ~3;
+    int32_t x1 = maths::minValue(tileX0 + (int32_t)TILE_WIDTH - 1, pixelFloor(maxX - 0.5f, (int32_t)width));
+    int32_t y0 = maths::maxValue(tileY0, pixelCeil(minY - 0.5f, (int32_t)depthBuffer->height_));
+    int32_t y1 = maths::minValue(tileY0 + (int32_t)TILE_HEIGHT - 1, pixelFloor(maxY - 0.5f, (int32_t)depthBuffer->height_));
+
+    const __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]), aZ = _mm_set1_ps(za);
+    for (int32_t py(y0); py <= y1; ++py)
+    {
+      float centerY = py + 0.5f;
+      const __m128 row0 = _mm_set1_ps(b[0] * centerY + c[0]);
+      const __m128 row1 = _mm_set1_ps(b[1] * centerY + c[1]);
+      const __m128 row2 = _mm_set1_ps(b[2] * centerY + c[2]);
+      const __m128 rowZ = _mm_set1_ps(zb * centerY + zc);
+      float* row = depth + py * width;
+      for (int32_t px(x0); px <= x1; px += 4)
+      {
+        __m128 centerX = _mm_add_ps(_mm_set1_ps((float)px), laneOffset);
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, centerX), row0);
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, centerX), row1);
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, centerX), row2);
+        __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+        if (_mm_movemask_ps(inside) == 0)
+          continue;
+
+        __m128 pixelZ = _mm_add_ps(_mm_mul_ps(aZ, centerX), rowZ);
+        __m128 current = _mm_loadu_ps(row + px);
+        __m128 closest = _mm_min_ps(current, pixelZ);
+        _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, current)));
+      }
+    }
+  }
+}
+
+void occlusion::rasterize(depth_buffer_t* depthBuffer, uint32_t threadCount)
+{
+  BKK_ZONE("occlusion::rasterize");
+
+  uint32_t tileCount = depthBuffer->tileCountX_ * depthBuffer->tileCountY_;
+  if (threadCount == 0u)
+    threadCount = maths::maxValue(1u, std::thread::hardware_concurrency());
+
+  threadCount = maths::minValue(threadCount, tileCount);
+  if (threadCount <= 1u || depthBuffer->triangles_.empty())
+  {
+    for (uint32_t tile(0); tile < tileCount; ++tile)
+      rasterizeTile(tile, depthBuffer);
+
+    return;
+  }
+
+  gWorkerPool.run(depthBuffer, tileCount, threadCount - 1u);
+}
+
+bool occlusion::isVisible(const maths::vec3& aabbMin, const maths::vec3& aabbMax, const maths::mat4& transform, const depth_buffer_t& depthBuffer)
+{
+  maths::mat4 modelViewProjection = transform * depthBuffer.viewProjection_;
+  maths::vec4 corners[8];
+  uint32_t codeAnd = ~0u;
+  uint32_t codeOr = 0u;
+  for (uint32_t i(0); i < 8; ++i)
+  {
+    maths::vec4 corner((i & 1u) ? aabbMax.x : aabbMin.x, (i & 2u) ? aabbMax.y : aabbMin.y, (i & 4u) ? aabbMax.z : aabbMin.z, 1.0f);
+    corners[i] = corner * modelViewProjection;
+    uint32_t code = outCode(corners[i]);
+    codeAnd &= code;
+    codeOr |= code;
+  }
+
+  //Outside of the frustum
+  if (codeAnd != 0u)
+    return false;
+
+  //Crossing the near plane
+  if ((codeOr & 16u) != 0u)
+    return true;
+
+  //Screen space bounds and closest depth
+  float minX = (float)depthBuffer.width_, maxX = 0.0f, minY = (float)depthBuffer.height_, maxY = 0.0f, minZ = 1.0f;
+  for (uint32_t i(0); i < 8; ++i)
+  {
+    float invW = 1.0f / corners[i].w;
+    float x = (corners[i].x * invW * 0.5f + 0.5f) * depthBuffer.width_;
+    float y = (corners[i].y * invW * 0.5f + 0.5f) * depthBuffer.height_;
+    minX = maths::minValue(minX, x);
+    maxX = maths::maxValue(maxX, x);
+    minY = maths::minValue(minY, y);
+    maxY = maths::maxValue(maxY, y);
+    minZ = maths::minValue(minZ, corners[i].z * invW);
+  }
+
+  //Every pixel the box touches, not only the ones whose center is covered, so small boxes are never missed
+  const int32_t width = (int32_t)depthBuffer.width_;
+  const int32_t height = (int32_t)depthBuffer.height_;
+  int32_t x0 = maths::maxValue(0, pixelFloor(minX, width));
+  int32_t x1 = maths::minValue(width - 1, pixelFloor(maxX, width));
+  int32_t y0 = maths::maxValue(0, pixelFloor(minY, height));
+  int32_t y1 = maths::minValue(height - 1, pixelFloor(maxY, height));
+  if (x0 > x1 || y0 > y1)
+    return false;
+
+  const __m128 boxZ = _mm_set1_ps(minZ);
+  const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+  const __m128i first = _mm_set1_epi32(x0 - 1);
+  const __m128i last = _mm_set1_epi32(x1 + 1);
+  const float* depth = depthBuffer.depth_.data();
+  for (int32_t y(y0); y <= y1; ++y)
+  {
+    const float* row = depth + y * width;
+    for (int32_t x(x0 & ~3); x <= x1; x += 4)
+    {
+      __m128i pixelX = _mm_add_epi32(_mm_set1_epi32(x), lane);
+      __m128 inRange = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(pixelX, first), _mm_cmplt_epi32(pixelX, last)));
+      __m128 notOccluded = _mm_cmpge_ps(_mm_loadu_ps(row + x), boxZ);
+      if (_mm_movemask_ps(_mm_and_ps(inRange, notOccluded)) != 0)
+        return true;
+    }
+  }
+
+  return false;
+}
@@ -26,8 +26,10 @@
 #include "core/mesh.h"
 #include "core/window.h"
 #include "core/image.h"
+#include "core/cpu-profiler.h"
 
 #include <stdio.h>
+#include <math.h>
 #include <assert.h>
 #include <string>
 
@@ -55,6 +57,34 @@ static VkDeviceSize GetNextMultiple(VkDeviceSize from, VkDeviceSize multiple)
   return ((from + multiple - 1) / multiple) * multiple;
 }
 
+//Statistics. Commands recorded in each command buffer since it began (see command_buffer_t::recordedStats_) are added to
+//the totals when it is submitted
+static render_stats_t gStats = {};
+
+static void StatsBeginCommandBuffer(const command_buffer_t& commandBuffer)
+{
+  if (commandBuffer.recordedStats_)
+    *commandBuffer.recordedStats_ = {};
+}
+
+static void StatsSubmitCommandBuffer(const command_buffer_t& commandBuffer)
+{
+  ++gStats.submitCount_;
+  if (commandBuffer.recordedStats_)
+  {
+    gStats.drawCount_ += commandBuffer.recordedStats_->drawCount_;
+    gStats.dispatchCount_ += commandBuffer.recordedStats_->dispatchCount_;
+    gStats.pipelineBindCount_ += commandBuffer.recordedStats_->pipelineBindCount_;
+    gStats.descriptorSetBindCount_ += commandBuffer.recordedStats_->descriptorSetBindCount_;
+  }
+}
+
+static void StatsMemoryAllocated(VkDeviceSize size)
+{
+  gStats.gpuMemory_ += size;
+  gStats.gpuMemoryPeak_ = maths::maxValue(gStats.gpuMemoryPeak_, gStats.gpuMemory_);
+}
+
 static int32_t GetQueueIndex(const VkPhysicalDevice* physicalDevice, VkQueueFlagBits queueType)
 {
   //Get number of queue families
@@ -78,7 +108,7 @@ static int32_t GetQueueIndex(const VkPhysicalDevice* physicalDevice, VkQueueFlag
   return -1;
 }
 
-static VkRenderPass CreatePresentationRenderPass(VkDevice device, VkFormat imageFormat, VkFormat depthStencilFormat)
+static VkRenderPass CreatePresentationRenderPass(VkDevice device, VkFormat imageFormat, VkFormat depthStencilFormat, VkImageLayout finalLayout)
 {
   VkAttachmentDescription attachmentDescription[2] = {};
   attachmentDescription[0].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -86,7 +116,7 @@ static VkRenderPass CreatePresentationRenderPass(VkDevice device, VkFormat image
   attachmentDescription[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
   attachmentDescription[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   attachmentDescription[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  attachmentDescription[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  attachmentDescription[0].finalLayout = finalLayout;
   attachmentDescription[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   attachmentDescription[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
@@ -127,20 +157,38 @@ static VkRenderPass CreatePresentationRenderPass(VkDevice device, VkFormat image
   return result;
 }
 
-static VkInstance CreateInstance(const char* applicationName, const char* engineName)
+static uint32_t GetInstanceVersion()
+{
+  //vkEnumerateInstanceVersion is not available in Vulkan 1.0 loaders
+  PFN_vkEnumerateInstanceVersion enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion"));
+
+  uint32_t version = VK_API_VERSION_1_0;
+  if (enumerateInstanceVersion)
+  {
+    enumerateInstanceVersion(&version);
+  }
+
+  return version >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
+}
+
+static VkInstance CreateInstance(const char* applicationName, const char* engineName, uint32_t apiVersion, bool headless)
 {
   VkInstanceCreateInfo instanceCreateInfo = {};
   instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 
 
+  //Headless contexts don't need any window system extension
   std::vector<const char*> instanceExtensions;
-  instanceExtensions.push_back("VK_KHR_surface");
+  if (!headless)
+  {
+    instanceExtensions.push_back("VK_KHR_surface");
 
 #ifdef WIN32
-  instanceExtensions.push_back("VK_KHR_win32_surface");
+    instanceExtensions.push_back("VK_KHR_win32_surface");
 #else
-  instanceExtensions.push_back("VK_KHR_xcb_surface");
+    instanceExtensions.push_back("VK_KHR_xcb_surface");
 #endif
+  }
   std::vector<const char*> instanceLayers;
 
 
@@ -157,7 +205,7 @@ static VkInstance CreateInstance(const char* applicationName, const char* engine
 
   VkApplicationInfo applicationInfo = {};
   applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-  applicationInfo.apiVersion = VK_API_VERSION_1_0;
+  applicationInfo.apiVersion = apiVersion;
   applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   applicationInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
   applicationInfo.pApplicationName = "brokkr Application";
@@ -172,10 +220,14 @@ static VkInstance CreateInstance(const char* applicationName, const char* engine
 }
 
 static void CreateDeviceAndQueues(VkInstance instance,
+  uint32_t* apiVersion,
   VkPhysicalDevice* physicalDevice,
   VkDevice* logicalDevice,
   queue_t* graphicsQueue,
-  queue_t* computeQueue)
+  queue_t* computeQueue,
+  VkPhysicalDeviceFeatures* features,
+  VkPhysicalDeviceMultiviewFeatures* multiviewFeatures,
+  bool headless)
 {
   uint32_t physicalDeviceCount = 0;
   vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr);
@@ -200,6 +252,40 @@ static void CreateDeviceAndQueues(VkInstance instance,
 
   assert(*physicalDevice);
 
+  //Vulkan 1.1 features can only be used if the device supports them too
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(*physicalDevice, &deviceProperties);
+  if (deviceProperties.apiVersion < VK_API_VERSION_1_1)
+  {
+    *apiVersion = VK_API_VERSION_1_0;
+  }
+
+  //Enable pipeline statistics queries if available (Used by the GPU profiler)
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(*physicalDevice, &supportedFeatures);
+  *features = {};
+  features->pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
+  //Enable multiview if available. Only rendering to several views is needed, not multiview geometry or tessellation shaders
+  *multiviewFeatures = {};
+  multiviewFeatures->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+  PFN_vkGetPhysicalDeviceFeatures2 getPhysicalDeviceFeatures2 = nullptr;
+  if (*apiVersion >= VK_API_VERSION_1_1)
+  {
+    getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2"));
+  }
+
+  if (getPhysicalDeviceFeatures2)
+  {
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = multiviewFeatures;
+    getPhysicalDeviceFeatures2(*physicalDevice, &features);
+    multiviewFeatures->pNext = nullptr;
+    multiviewFeatures->multiviewGeometryShader = VK_FALSE;
+    multiviewFeatures->multiviewTessellationShader = VK_FALSE;
+  }
+
   VkDeviceQueueCreateInfo deviceQueueCreateInfo = {};
   deviceQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
   deviceQueueCreateInfo.queueCount = 1;
@@ -212,14 +298,16 @@ static void CreateDeviceAndQueues(VkInstance instance,
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   deviceCreateInfo.queueCreateInfoCount = 1;
   deviceCreateInfo.pQueueCreateInfos = &deviceQueueCreateInfo;
+  deviceCreateInfo.pNext = multiviewFeatures->multiview == VK_TRUE ? multiviewFeatures : nullptr;
+  deviceCreateInfo.pEnabledFeatures = features;
 
   deviceCreateInfo.ppEnabledLayerNames = NULL;
   deviceCreateInfo.enabledLayerCount = 0u;
 
   const char* deviceExtensions = "VK_KHR_swapchain";
 
-  deviceCreateInfo.ppEnabledExtensionNames = &deviceExtensions;
-  deviceCreateInfo.enabledExtensionCount = 1u;
+  deviceCreateInfo.ppEnabledExtensionNames = headless ? nullptr : &deviceExtensions;
+  deviceCreateInfo.enabledExtensionCount = headless ? 0u : 1u;
 
   *logicalDevice = nullptr;
   vkCreateDevice(*physicalDevice, &deviceCreateInfo, nullptr, logicalDevice);
@@ -234,6 +322,26 @@ static void CreateDeviceAndQueues(VkInstance instance,
   assert(computeQueue->handle_);
 }
 
+static void GetSubgroupProperties(VkInstance instance, VkPhysicalDevice physicalDevice, uint32_t apiVersion, VkPhysicalDeviceSubgroupProperties* subgroupProperties)
+{
+  *subgroupProperties = {};
+  subgroupProperties->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+  if (apiVersion < VK_API_VERSION_1_1)
+  {
+    return;
+  }
+
+  PFN_vkGetPhysicalDeviceProperties2 getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2"));
+  if (getPhysicalDeviceProperties2)
+  {
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = subgroupProperties;
+    getPhysicalDeviceProperties2(physicalDevice, &properties);
+    subgroupProperties->pNext = nullptr;
+  }
+}
+
 static VkBool32 GetDepthStencilFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat)
 {
   VkFormat depthFormats[] = { VK_FORMAT_D32_SFLOAT_S8_UINT,
@@ -257,7 +365,7 @@ static VkBool32 GetDepthStencilFormat(VkPhysicalDevice physicalDevice, VkFormat
 }
 
 
-static void CreateDepthStencilBuffer(const context_t* context, uint32_t width, uint32_t height, VkFormat format, depth_stencil_buffer_t* depthStencilBuffer)
+static void CreateDepthStencilBuffer(const context_t* context, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, depth_stencil_buffer_t* depthStencilBuffer)
 {
   depthStencilBuffer->format_ = format;
 
@@ -269,7 +377,7 @@ static void CreateDepthStencilBuffer(const context_t* context, uint32_t width, u
   imageCreateInfo.format = format;
   imageCreateInfo.arrayLayers = 1;
   imageCreateInfo.extent = { width, height, 1u };
-  imageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  imageCreateInfo.usage = usage;
   imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
   imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
   imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -402,53 +510,74 @@ static void CreateSurface(VkInstance instance, VkPhysicalDevice physicalDevice,
   surface->colorSpace_ = surfaceFormats.front().colorSpace;
 }
 
-static void CreateSwapChain(context_t* context,
-  uint32_t width, uint32_t height,
-  uint32_t imageCount)
+//Images, image views, depth stencil buffer, render pass and frame buffers. Everything in the swapchain that depends on its size
+static void CreateSwapChainImages(context_t* context, uint32_t width, uint32_t height, VkSwapchainKHR oldSwapChain)
 {
-  //Create semaphores
-  VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-  semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-  vkCreateSemaphore(context->device_, &semaphoreCreateInfo, nullptr, &context->swapChain_.imageAcquired_);
-  vkCreateSemaphore(context->device_, &semaphoreCreateInfo, nullptr, &context->swapChain_.renderingComplete_);
-
   VkExtent2D swapChainSize = { width, height };
   context->swapChain_.imageWidth_ = width;
   context->swapChain_.imageHeight_ = height;
-  context->swapChain_.imageCount_ = imageCount;
-  context->swapChain_.currentImage_ = 0;
+  uint32_t imageCount = context->swapChain_.imageCount_;
+
+  if (context->headless_)
+  {
+    //Offscreen images in place of the swapchain ones. They can be copied to read back the frames
+    context->swapChain_.handle_ = VK_NULL_HANDLE;
+    context->swapChain_.image_.resize(imageCount);
+    context->swapChain_.imageMemory_.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; ++i)
+    {
+      VkImageCreateInfo imageCreateInfo = {};
+      imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageCreateInfo.format = context->surface_.imageFormat_;
+      imageCreateInfo.extent = { width, height, 1u };
+      imageCreateInfo.mipLevels = 1u;
+      imageCreateInfo.arrayLayers = 1u;
+      imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+      imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      vkCreateImage(context->device_, &imageCreateInfo, nullptr, &context->swapChain_.image_[i]);
+
+      VkMemoryRequirements requirements = {};
+      vkGetImageMemoryRequirements(context->device_, context->swapChain_.image_[i], &requirements);
+      context->swapChain_.imageMemory_[i] = gpuMemoryAllocate(*context, requirements.size, requirements.alignment, requirements.memoryTypeBits, DEVICE_LOCAL);
+      vkBindImageMemory(context->device_, context->swapChain_.image_[i], context->swapChain_.imageMemory_[i].handle_, context->swapChain_.imageMemory_[i].offset_);
+    }
+  }
+  else
+  {
+    //Create the swapchain
+    VkSwapchainCreateInfoKHR swapchainCreateInfo = {};
+    swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swapchainCreateInfo.surface = context->surface_.handle_;
+    swapchainCreateInfo.minImageCount = imageCount;
+    swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    swapchainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    swapchainCreateInfo.imageColorSpace = context->surface_.colorSpace_;
+    swapchainCreateInfo.imageFormat = context->surface_.imageFormat_;
+    swapchainCreateInfo.pQueueFamilyIndices = nullptr;
+    swapchainCreateInfo.queueFamilyIndexCount = 0;
+    swapchainCreateInfo.clipped = VK_TRUE;
+    swapchainCreateInfo.oldSwapchain = oldSwapChain;  //Retired. Destroyed by the caller once the frames that use it have finished
+    swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    swapchainCreateInfo.imageExtent = swapChainSize;
+    swapchainCreateInfo.imageArrayLayers = 1;
+    swapchainCreateInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    context->vkCreateSwapchainKHR(context->device_, &swapchainCreateInfo, nullptr, &context->swapChain_.handle_);
+
+    //Get the maximum number of images supported by the swapchain
+    uint32_t maxImageCount = 0;
+    context->vkGetSwapchainImagesKHR(context->device_, context->swapChain_.handle_, &maxImageCount, nullptr);
+
+    //Create the swapchain images
+    assert(imageCount <= maxImageCount);
+    context->swapChain_.image_.resize(imageCount);
+    context->vkGetSwapchainImagesKHR(context->device_, context->swapChain_.handle_, &maxImageCount, context->swapChain_.image_.data());
+  }
 
-  //Create the swapchain
-  VkSwapchainCreateInfoKHR swapchainCreateInfo = {};
-  swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-  swapchainCreateInfo.surface = context->surface_.handle_;
-  swapchainCreateInfo.minImageCount = imageCount;
-  swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-  swapchainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-  swapchainCreateInfo.imageColorSpace = context->surface_.colorSpace_;
-  swapchainCreateInfo.imageFormat = context->surface_.imageFormat_;
-  swapchainCreateInfo.pQueueFamilyIndices = nullptr;
-  swapchainCreateInfo.queueFamilyIndexCount = 0;
-  swapchainCreateInfo.clipped = VK_TRUE;
-  swapchainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
-  swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-  swapchainCreateInfo.imageExtent = swapChainSize;
-  swapchainCreateInfo.imageArrayLayers = 1;
-  swapchainCreateInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
-  context->vkCreateSwapchainKHR(context->device_, &swapchainCreateInfo, nullptr, &context->swapChain_.handle_);
-
-  //Get the maximum number of images supported by the swapchain
-  uint32_t maxImageCount = 0;
-  context->vkGetSwapchainImagesKHR(context->device_, context->swapChain_.handle_, &maxImageCount, nullptr);
-
-  //Create the swapchain images
-  assert(imageCount <= maxImageCount);
-  context->swapChain_.image_.resize(imageCount);
-  context->vkGetSwapchainImagesKHR(context->device_, context->swapChain_.handle_, &maxImageCount, context->swapChain_.image_.data());
-
-  //Create an imageview and one command buffer for each image
+  //Create an imageview for each image
   context->swapChain_.imageView_.resize(imageCount);
-  context->swapChain_.commandBuffer_.resize(imageCount);
   for (uint32_t i = 0; i < imageCount; ++i)
   {
     VkImageViewCreateInfo imageViewCreateInfo = {};
@@ -461,20 +590,16 @@ static void CreateSwapChain(context_t* context,
     imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 
     vkCreateImageView(context->device_, &imageViewCreateInfo, nullptr, &context->swapChain_.imageView_[i]);
-
-    commandBufferCreate(*context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u,
-      &context->swapChain_.renderingComplete_, 1u, command_buffer_t::GRAPHICS,
-      &context->swapChain_.commandBuffer_[i]);
-
   }
 
   //Create depth stencil buffer (shared by all the framebuffers)
   VkFormat depthStencilFormat = VK_FORMAT_UNDEFINED;
   GetDepthStencilFormat(context->physicalDevice_, &depthStencilFormat);
-  CreateDepthStencilBuffer(context, width, height, depthStencilFormat, &context->swapChain_.depthStencil_);
+  CreateDepthStencilBuffer(context, width, height, depthStencilFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &context->swapChain_.depthStencil_);
 
   //Create the presentation render pass
-  context->swapChain_.renderPass_ = CreatePresentationRenderPass(context->device_, context->surface_.imageFormat_, depthStencilFormat);
+  context->swapChain_.renderPass_ = CreatePresentationRenderPass(context->device_, context->surface_.imageFormat_, depthStencilFormat,
+    context->headless_ ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
   //Create frame buffers
   context->swapChain_.frameBuffer_.resize(imageCount);
@@ -496,6 +621,31 @@ static void CreateSwapChain(context_t* context,
   }
 }
 
+static void CreateSwapChain(context_t* context,
+  uint32_t width, uint32_t height,
+  uint32_t imageCount)
+{
+  //Create semaphores
+  VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+  semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  vkCreateSemaphore(context->device_, &semaphoreCreateInfo, nullptr, &context->swapChain_.imageAcquired_);
+  vkCreateSemaphore(context->device_, &semaphoreCreateInfo, nullptr, &context->swapChain_.renderingComplete_);
+
+  context->swapChain_.imageCount_ = imageCount;
+  context->swapChain_.currentImage_ = 0;
+  CreateSwapChainImages(context, width, height, VK_NULL_HANDLE);
+
+  //Create one command buffer for each image. Their fences tell when the frames have finished, so they are kept when the swapchain is resized
+  context->swapChain_.commandBuffer_.resize(imageCount);
+  context->swapChain_.fenceFrame_.assign(imageCount, 0u);
+  for (uint32_t i = 0; i < imageCount; ++i)
+  {
+    commandBufferCreate(*context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u,
+      &context->swapChain_.renderingComplete_, 1u, command_buffer_t::GRAPHICS,
+      &context->swapChain_.commandBuffer_[i]);
+  }
+}
+
 static VkCommandPool CreateCommandPool(VkDevice device, uint32_t queueIndex)
 {
   VkCommandPool pool;
@@ -525,18 +675,17 @@ static void ImportFunctions(VkInstance instance, VkDevice device, context_t* con
   context->vkQueuePresentKHR = reinterpret_cast<PFN_vkQueuePresentKHR>(vkGetDeviceProcAddr(device, "vkQueuePresentKHR"));
 }
 
-/*********************
-* API Implementation
-**********************/
-
-void render::contextCreate(const char* applicationName,
-  const char* engineName,
-  const window::window_t& window,
-  uint32_t swapChainImageCount,
-  context_t* context)
+//Instance, device, queues and command pool. Everything but the surface and the swapchain
+static void CreateDevice(const char* applicationName, const char* engineName, bool headless, context_t* context)
 {
-  context->instance_ = CreateInstance(applicationName, engineName);
-  CreateDeviceAndQueues(context->instance_, &context->physicalDevice_, &context->device_, &context->graphicsQueue_, &context->computeQueue_);
+  context->headless_ = headless;
+  context->frameCount_ = 0u;
+  context->completedFrameCount_ = 0u;
+  context->deferredDestructions_.clear();
+  context->apiVersion_ = GetInstanceVersion();
+  context->instance_ = CreateInstance(applicationName, engineName, context->apiVersion_, headless);
+  CreateDeviceAndQueues(context->instance_, &context->apiVersion_, &context->physicalDevice_, &context->device_, &context->graphicsQueue_, &context->computeQueue_, &context->features_, &context->multiviewFeatures_, headless);
+  GetSubgroupProperties(context->instance_, context->physicalDevice_, context->apiVersion_, &context->subgroupProperties_);
 
   //Get memory properties of the physical device
   vkGetPhysicalDeviceMemoryProperties(context->physicalDevice_, &context->memoryProperties_);
@@ -552,14 +701,115 @@ void render::contextCreate(const char* applicationName,
   createInfo.pfnCallback = debugCallback;
   context->vkCreateDebugReportCallbackEXT(context->instance_, &createInfo, nullptr, &context->debugCallback_);
 #endif
+}
 
-  CreateSurface(context->instance_, context->physicalDevice_, window, *context, &context->surface_);
+/*********************
+* API Implementation
+**********************/
 
+void render::contextCreate(const char* applicationName,
+  const char* engineName,
+  const window::window_t& window,
+  uint32_t swapChainImageCount,
+  context_t* context)
+{
+  CreateDevice(applicationName, engineName, false, context);
+  CreateSurface(context->instance_, context->physicalDevice_, window, *context, &context->surface_);
   CreateSwapChain(context, window.width_, window.height_, swapChainImageCount);
 }
 
+void render::contextCreateHeadless(const char* applicationName,
+  const char* engineName,
+  uint32_t width, uint32_t height,
+  uint32_t swapChainImageCount,
+  context_t* context)
+{
+  CreateDevice(applicationName, engineName, true, context);
+
+  context->surface_.handle_ = VK_NULL_HANDLE;
+  context->surface_.imageFormat_ = VK_FORMAT_R8G8B8A8_UNORM;
+  context->surface_.colorSpace_ = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+  context->surface_.preTransform_ = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+  CreateSwapChain(context, width, height, swapChainImageCount);
+}
+
+static void DestroySwapChainImages(context_t* context)
+{
+  if (context->headless_)
+  {
+    for (uint32_t i = 0; i < context->swapChain_.imageCount_; ++i)
+    {
+      vkDestroyImage(context->device_, context->swapChain_.image_[i], nullptr);
+      gpuMemoryDeallocate(*context, nullptr, context->swapChain_.imageMemory_[i]);
+    }
+  }
+  else
+  {
+    vkDestroySwapchainKHR(context->device_, context->swapChain_.handle_, nullptr);
+  }
+}
+
+static void DestroyObjects(const context_t& context, const deferred_destruction_t& objects)
+{
+  if (objects.frameBuffer_ != VK_NULL_HANDLE)
+    vkDestroyFramebuffer(context.device_, objects.frameBuffer_, nullptr);
+
+  if (objects.renderPass_ != VK_NULL_HANDLE)
+    vkDestroyRenderPass(context.device_, objects.renderPass_, nullptr);
+
+  if (objects.imageView_ != VK_NULL_HANDLE)
+    vkDestroyImageView(context.device_, objects.imageView_, nullptr);
+
+  if (objects.sampler_ != VK_NULL_HANDLE)
+    vkDestroySampler(context.device_, objects.sampler_, nullptr);
+
+  if (objects.image_ != VK_NULL_HANDLE)
+    vkDestroyImage(context.device_, objects.image_, nullptr);
+
+  if (objects.buffer_ != VK_NULL_HANDLE)
+    vkDestroyBuffer(context.device_, objects.buffer_, nullptr);
+
+  if (objects.swapChain_ != VK_NULL_HANDLE)
+    context.vkDestroySwapchainKHR(context.device_, objects.swapChain_, nullptr);
+
+  if (objects.descriptorSet_ != VK_NULL_HANDLE)
+    vkFreeDescriptorSets(context.device_, objects.descriptorPool_, 1, &objects.descriptorSet_);
+
+  if (objects.memory_.handle_ != VK_NULL_HANDLE)
+    gpuMemoryDeallocate(context, objects.allocator_, objects.memory_);
+}
+
+//Destroys the queued objects released in frames which have finished. Frames finish in order, so the last one finished is
+//the one with the highest count among the signaled fences
+static void DestroyCompletedObjects(context_t* context)
+{
+  for (uint32_t i = 0; i < context->swapChain_.imageCount_; ++i)
+  {
+    uint64_t frame = context->swapChain_.fenceFrame_[i];
+    if (frame > context->completedFrameCount_ && vkGetFenceStatus(context->device_, context->swapChain_.commandBuffer_[i].fence_) == VK_SUCCESS)
+      context->completedFrameCount_ = frame;
+  }
+
+  std::vector<deferred_destruction_t>& queue = context->deferredDestructions_;
+  for (size_t i = 0; i < queue.size();)
+  {
+    if (queue[i].frame_ < context->completedFrameCount_)
+    {
+      DestroyObjects(*context, queue[i]);
+      queue[i] = queue.back();
+      queue.pop_back();
+    }
+    else
+    {
+      ++i;
+    }
+  }
+}
+
 void render::contextDestroy(context_t* context)
 {
+  deferredDestructionFlush(context);
+
   vkDestroySemaphore(context->device_, context->swapChain_.imageAcquired_, nullptr);
   vkDestroySemaphore(context->device_, context->swapChain_.renderingComplete_, nullptr);
 
@@ -577,8 +827,11 @@ void render::contextDestroy(context_t* context)
 
   vkDestroyCommandPool(context->device_, context->commandPool_, nullptr);
   vkDestroyRenderPass(context->device_, context->swapChain_.renderPass_, nullptr);
-  vkDestroySwapchainKHR(context->device_, context->swapChain_.handle_, nullptr);
-  vkDestroySurfaceKHR(context->instance_, context->surface_.handle_, nullptr);
+  DestroySwapChainImages(context);
+  if (!context->headless_)
+  {
+    vkDestroySurfaceKHR(context->instance_, context->surface_.handle_, nullptr);
+  }
 
 #ifdef VK_DEBUG_LAYERS
   context->vkDestroyDebugReportCallbackEXT(context->instance_, context->debugCallback_, nullptr);
@@ -592,26 +845,32 @@ void render::contextDestroy(context_t* context)
 void render::swapchainResize(context_t* context, uint32_t width, uint32_t height)
 {
   //TODO: Handle width and height equal 0!
-  contextFlush(*context);
-
-  //Destroy framebuffers and command buffers
-  for (uint32_t i = 0; i < context->swapChain_.imageCount_; ++i)
+  //Objects that depend on the size may still be used by frames in flight, so they are destroyed once those have finished.
+  //Command buffers and their fences don't depend on the size and are kept
+  swapchain_t& swapChain = context->swapChain_;
+  for (uint32_t i = 0; i < swapChain.imageCount_; ++i)
   {
-    vkDestroyFramebuffer(context->device_, context->swapChain_.frameBuffer_[i], nullptr);
-    vkDestroyImageView(context->device_, context->swapChain_.imageView_[i], nullptr);
-    commandBufferDestroy(*context, &context->swapChain_.commandBuffer_[i]);
+    deferred_destruction_t objects = {};
+    objects.frameBuffer_ = swapChain.frameBuffer_[i];
+    objects.imageView_ = swapChain.imageView_[i];
+    if (context->headless_)
+    {
+      objects.image_ = swapChain.image_[i];
+      objects.memory_ = swapChain.imageMemory_[i];
+    }
+    destroyDeferred(context, objects);
   }
-  
-  //Destroy depthstencil buffer
-  vkDestroyImageView(context->device_, context->swapChain_.depthStencil_.imageView_, nullptr);
-  vkDestroyImage(context->device_, context->swapChain_.depthStencil_.image_, nullptr);
-  gpuMemoryDeallocate(*context, nullptr, context->swapChain_.depthStencil_.memory_);
 
-  //Recreate swapchain with the new size
-  vkDestroyRenderPass(context->device_, context->swapChain_.renderPass_, nullptr);
-  vkDestroySwapchainKHR(context->device_, context->swapChain_.handle_, nullptr);
-  CreateSwapChain(context, width, height, context->swapChain_.imageCount_);
+  deferred_destruction_t objects = {};
+  objects.imageView_ = swapChain.depthStencil_.imageView_;
+  objects.image_ = swapChain.depthStencil_.image_;
+  objects.memory_ = swapChain.depthStencil_.memory_;
+  objects.renderPass_ = swapChain.renderPass_;
+  objects.swapChain_ = swapChain.handle_;
+  destroyDeferred(context, objects);
 
+  //Recreate swapchain with the new size
+  CreateSwapChainImages(context, width, height, swapChain.handle_);
 }
 
 void render::contextFlush(const context_t& context)
@@ -652,6 +911,7 @@ void render::beginPresentationCommandBuffer(const context_t& context, uint32_t i
 
   //Begin command buffer
   vkBeginCommandBuffer(context.swapChain_.commandBuffer_[index].handle_, &beginInfo);
+  StatsBeginCommandBuffer(context.swapChain_.commandBuffer_[index]);
 
   //Begin render pass
   renderPassBeginInfo.framebuffer = context.swapChain_.frameBuffer_[index];
@@ -684,11 +944,41 @@ void render::endPresentationCommandBuffer(const context_t& context, uint32_t ind
 
 void render::presentFrame(context_t* context, VkSemaphore* waitSemaphore, uint32_t waitSemaphoreCount)
 {
+  BKK_ZONE("render::presentFrame");
+
+  if (context->headless_)
+  {
+    //No swapchain. Images are used in order and the frame is finished when this returns, so it can be read back
+    uint32_t currentImage = (context->swapChain_.currentImage_ + 1) % context->swapChain_.imageCount_;
+    context->swapChain_.currentImage_ = currentImage;
+
+    std::vector<VkPipelineStageFlags> waitStageList(waitSemaphoreCount, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+    submitInfo.pWaitSemaphores = waitSemaphore;
+    submitInfo.pWaitDstStageMask = waitStageList.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &context->swapChain_.commandBuffer_[currentImage].handle_;
+    vkResetFences(context->device_, 1, &context->swapChain_.commandBuffer_[currentImage].fence_);
+    vkQueueSubmit(context->graphicsQueue_.handle_, 1, &submitInfo, context->swapChain_.commandBuffer_[currentImage].fence_);
+    context->swapChain_.fenceFrame_[currentImage] = ++context->frameCount_;
+    StatsSubmitCommandBuffer(context->swapChain_.commandBuffer_[currentImage]);
+
+    BKK_ZONE("Wait for frame fence");
+    vkWaitForFences(context->device_, 1, &context->swapChain_.commandBuffer_[currentImage].fence_, VK_TRUE, UINT64_MAX);
+    DestroyCompletedObjects(context);
+    return;
+  }
+
   //Aquire next image in the swapchain
-  context->vkAcquireNextImageKHR(context->device_,
-    context->swapChain_.handle_,
-    UINT64_MAX, context->swapChain_.imageAcquired_,
-    VK_NULL_HANDLE, &context->swapChain_.currentImage_);
+  {
+    BKK_ZONE("Acquire swapchain image");
+    context->vkAcquireNextImageKHR(context->device_,
+      context->swapChain_.handle_,
+      UINT64_MAX, context->swapChain_.imageAcquired_,
+      VK_NULL_HANDLE, &context->swapChain_.currentImage_);
+  }
 
   uint32_t currentImage = context->swapChain_.currentImage_;
 
@@ -713,6 +1003,7 @@ void render::presentFrame(context_t* context, VkSemaphore* waitSemaphore, uint32
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &context->swapChain_.commandBuffer_[currentImage].handle_;
   vkQueueSubmit(context->graphicsQueue_.handle_, 1, &submitInfo, VK_NULL_HANDLE);
+  StatsSubmitCommandBuffer(context->swapChain_.commandBuffer_[currentImage]);
   
   //Present the image
   VkPresentInfoKHR presentInfo = {};
@@ -727,7 +1018,25 @@ void render::presentFrame(context_t* context, VkSemaphore* waitSemaphore, uint32
   //Submit presentation
   vkResetFences(context->device_, 1, &context->swapChain_.commandBuffer_[currentImage].fence_);
   vkQueueSubmit(context->graphicsQueue_.handle_, 0, nullptr, context->swapChain_.commandBuffer_[currentImage].fence_);
+  context->swapChain_.fenceFrame_[currentImage] = ++context->frameCount_;
+
+  BKK_ZONE("Wait for frame fence");
   vkWaitForFences(context->device_, 1, &context->swapChain_.commandBuffer_[currentImage].fence_, VK_TRUE, UINT64_MAX);
+  DestroyCompletedObjects(context);
+}
+
+void render::destroyDeferred(context_t* context, const deferred_destruction_t& objects)
+{
+  context->deferredDestructions_.push_back(objects);
+  context->deferredDestructions_.back().frame_ = context->frameCount_;
+}
+
+void render::deferredDestructionFlush(context_t* context)
+{
+  for (size_t i = 0; i < context->deferredDestructions_.size(); ++i)
+    DestroyObjects(*context, context->deferredDestructions_[i]);
+
+  context->deferredDestructions_.clear();
 }
 
 bool render::shaderCreateFromSPIRV(const context_t& context, shader_t::type type, const char* file, shader_t* shader)
@@ -774,6 +1083,12 @@ bool render::shaderCreateFromGLSL(const context_t& context, shader_t::type type,
     glslangvalidator_params = "arg0 -V -o \""; 
     glslangvalidator_params += spirv_file_path + "\" \"" + file + "\"";
   #endif
+
+  //Subgroup operations require SPIR-V 1.3
+  if (context.apiVersion_ >= VK_API_VERSION_1_1)
+  {
+    glslangvalidator_params += " --target-env vulkan1.1";
+  }
   
   PROCESS_INFORMATION process_info;
   memset(&process_info, 0, sizeof(process_info));
@@ -836,6 +1151,65 @@ void render::shaderDestroy(const context_t& context, shader_t* shader)
   vkDestroyShaderModule(context.device_, shader->handle_, nullptr);
 }
 
+static const char* gSubgroupHelpers = R"(
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#extension GL_KHR_shader_subgroup_ballot : require
+#define SUBGROUP_OPERATIONS 1
+#define SUBGROUP_ADD(value) subgroupAdd(value)
+#define SUBGROUP_INCLUSIVE_ADD(value) subgroupInclusiveAdd(value)
+#define SUBGROUP_EXCLUSIVE_ADD(value) subgroupExclusiveAdd(value)
+#define ATOMIC_ADD_AGGREGATED(type, memory, value, result) \
+{ \
+  type subgroupTotal_ = subgroupAdd(value); \
+  type subgroupBase_ = type(0); \
+  if( subgroupElect() ){ subgroupBase_ = atomicAdd(memory, subgroupTotal_); } \
+  result = subgroupBroadcastFirst(subgroupBase_) + subgroupExclusiveAdd(value); \
+}
+)";
+
+static const char* gSubgroupHelpersFallback = R"(
+#define SUBGROUP_OPERATIONS 0
+#define SUBGROUP_ADD(value) (value)
+#define SUBGROUP_INCLUSIVE_ADD(value) (value)
+#define SUBGROUP_EXCLUSIVE_ADD(value) ((value) - (value))
+#define ATOMIC_ADD_AGGREGATED(type, memory, value, result) { result = atomicAdd(memory, value); }
+)";
+
+bool render::subgroupOperationsSupported(const context_t& context)
+{
+  const VkSubgroupFeatureFlags requiredOperations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+  return context.apiVersion_ >= VK_API_VERSION_1_1 &&
+         (context.subgroupProperties_.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0 &&
+         (context.subgroupProperties_.supportedOperations & requiredOperations) == requiredOperations;
+}
+
+const char* render::getSubgroupHelpersGLSL(const context_t& context)
+{
+  return subgroupOperationsSupported(context) ? gSubgroupHelpers : gSubgroupHelpersFallback;
+}
+
+static const char* gMultiviewHelpers = R"(
+#extension GL_EXT_multiview : require
+#define MULTIVIEW 1
+#define VIEW_INDEX gl_ViewIndex
+)";
+
+static const char* gMultiviewHelpersFallback = R"(
+#define MULTIVIEW 0
+#define VIEW_INDEX 0
+)";
+
+bool render::multiviewSupported(const context_t& context)
+{
+  return context.apiVersion_ >= VK_API_VERSION_1_1 && context.multiviewFeatures_.multiview == VK_TRUE;
+}
+
+const char* render::getMultiviewHelpersGLSL(const context_t& context)
+{
+  return multiviewSupported(context) ? gMultiviewHelpers : gMultiviewHelpersFallback;
+}
+
 gpu_memory_t render::gpuMemoryAllocate(const context_t& context,
   VkDeviceSize size, VkDeviceSize alignment,
   uint32_t memoryTypes, uint32_t flags,
@@ -863,6 +1237,7 @@ gpu_memory_t render::gpuMemoryAllocate(const context_t& context,
         {
           result.handle_ = memory;
           result.size_ = size;
+          StatsMemoryAllocated(size);
           return result;
         }
       }
@@ -888,6 +1263,7 @@ void render::gpuMemoryDeallocate(const context_t& context, gpu_memory_allocator_
   if (allocator == nullptr)
   {
     vkFreeMemory(context.device_, memory.handle_, nullptr);
+    gStats.gpuMemory_ -= memory.size_;
   }
   else
   {
@@ -934,6 +1310,7 @@ void render::gpuAllocatorCreate(const context_t& context, size_t size,
 void render::gpuAllocatorDestroy(const context_t& context, gpu_memory_allocator_t* allocator)
 {
   vkFreeMemory(context.device_, allocator->memory_, nullptr);
+  gStats.gpuMemory_ -= allocator->size_;
 }
 
 static VkFormat getImageFormat(const image::image2D_t& image)
@@ -1152,16 +1529,21 @@ void render::texture2DCreate(const context_t& context, const image::image2D_t* i
   textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture);
 }
 
-void render::texture2DCreate(const context_t& context,
-  uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage,
-  texture_sampler_t sampler, texture_t* texture)
+//Layers of array textures are viewed as a 2D array, so they can be sampled as a whole or used as the attachment of a multiview render pass
+static void Texture2DCreate(const context_t& context,
+  uint32_t width, uint32_t height, uint32_t layerCount, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage,
+  VkImageViewType viewType, texture_sampler_t sampler, texture_t* texture)
 {
   VkExtent3D extents = { width, height, 1u };
   
   VkImageAspectFlags aspectFlags = 0;
   if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
   {
-    aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT)
+    {
+      aspectFlags |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
   }
   else
   {
@@ -1174,7 +1556,7 @@ void render::texture2DCreate(const context_t& context,
   imageCreateInfo.pNext = nullptr;
   imageCreateInfo.mipLevels = mipLevels;
   imageCreateInfo.format = format;
-  imageCreateInfo.arrayLayers = 1;
+  imageCreateInfo.arrayLayers = layerCount;
   imageCreateInfo.extent = extents;
   imageCreateInfo.usage = usage;
   imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -1198,8 +1580,8 @@ void render::texture2DCreate(const context_t& context,
   imageViewCreateInfo.image = texture->image_;
   imageViewCreateInfo.subresourceRange.aspectMask = aspectFlags;
   imageViewCreateInfo.subresourceRange.levelCount = mipLevels;
-  imageViewCreateInfo.subresourceRange.layerCount = 1;
-  imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  imageViewCreateInfo.subresourceRange.layerCount = layerCount;
+  imageViewCreateInfo.viewType = viewType;
   vkCreateImageView(context.device_, &imageViewCreateInfo, nullptr, &texture->imageView_);
 
   //Create sampler
@@ -1212,7 +1594,8 @@ void render::texture2DCreate(const context_t& context,
   samplerCreateInfo.addressModeV = (VkSamplerAddressMode)sampler.wrapV_;
   samplerCreateInfo.addressModeW = (VkSamplerAddressMode)sampler.wrapW_;
   samplerCreateInfo.mipLodBias = 0.0f;
-  samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+  samplerCreateInfo.compareEnable = sampler.depthCompare_ ? VK_TRUE : VK_FALSE;
+  samplerCreateInfo.compareOp = sampler.depthCompare_ ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_NEVER;
   samplerCreateInfo.minLod = 0.0f;
   samplerCreateInfo.maxLod = (float)mipLevels;
   samplerCreateInfo.maxAnisotropy = 1.0;
@@ -1229,6 +1612,20 @@ void render::texture2DCreate(const context_t& context,
   texture->extent_ = extents;
 }
 
+void render::texture2DCreate(const context_t& context,
+  uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage,
+  texture_sampler_t sampler, texture_t* texture)
+{
+  Texture2DCreate(context, width, height, 1u, mipLevels, format, usage, VK_IMAGE_VIEW_TYPE_2D, sampler, texture);
+}
+
+void render::texture2DArrayCreate(const context_t& context,
+  uint32_t width, uint32_t height, uint32_t layerCount, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage,
+  texture_sampler_t sampler, texture_t* texture)
+{
+  Texture2DCreate(context, width, height, layerCount, mipLevels, format, usage, VK_IMAGE_VIEW_TYPE_2D_ARRAY, sampler, texture);
+}
+
 void render::textureCubemapCreate(const context_t& context, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, texture_sampler_t sampler, texture_t* texture)
 {
   //Get base level image width and height
@@ -1243,6 +1640,14 @@ void render::textureCubemapCreate(const context_t& context, VkFormat format, uin
   imageCreateInfo.arrayLayers = 6;  //Cubemap faces
   imageCreateInfo.extent = extents;
   imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+  //Faces can be rendered directly if the format can be used as a color attachment (See RenderCubemapFaces)
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(context.physicalDevice_, format, &formatProperties);
+  if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+  {
+    imageCreateInfo.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  }
   imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
   imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
   imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -1447,17 +1852,41 @@ void render::textureDestroy(const context_t& context, texture_t* texture)
   gpuMemoryDeallocate(context, nullptr, texture->memory_);
 }
 
+void render::textureDestroyDeferred(context_t* context, texture_t* texture)
+{
+  deferred_destruction_t objects = {};
+  objects.imageView_ = texture->imageView_;
+  objects.image_ = texture->image_;
+  objects.sampler_ = texture->sampler_;
+  objects.memory_ = texture->memory_;
+  destroyDeferred(context, objects);
+}
+
+VkFormat render::getHDRFormat(const context_t& context, hdr_format_e format)
+{
+  if (format == HDR_FORMAT_R11G11B10)
+  {
+    const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(context.physicalDevice_, VK_FORMAT_B10G11R11_UFLOAT_PACK32, &formatProperties);
+    if ((formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures)
+      return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+  }
+
+  return VK_FORMAT_R16G16B16A16_SFLOAT;
+}
+
 void render::textureCopy(const command_buffer_t& commandBuffer, texture_t* srcTexture, texture_t* dstTexture,
                          uint32_t width, uint32_t height, uint32_t dstMipmap, uint32_t dstLayer, uint32_t srcMipmap, uint32_t srcLayer)
 {  
   VkImageCopy copyRegion = {};
-  copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  copyRegion.srcSubresource.aspectMask = srcTexture->aspectFlags_;
   copyRegion.srcSubresource.baseArrayLayer = srcLayer;
   copyRegion.srcSubresource.mipLevel = srcMipmap;
   copyRegion.srcSubresource.layerCount = 1;
   copyRegion.srcOffset = { 0, 0, 0 };
 
-  copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  copyRegion.dstSubresource.aspectMask = dstTexture->aspectFlags_;
   copyRegion.dstSubresource.baseArrayLayer = dstLayer;
   copyRegion.dstSubresource.mipLevel = dstMipmap;
   copyRegion.dstSubresource.layerCount = 1;
@@ -1531,6 +1960,12 @@ void render::textureChangeLayout(command_buffer_t cmdBuffer, VkImageLayout newLa
     // Make sure any shader reads from the image have been finished
     imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
     break;
+
+  case VK_IMAGE_LAYOUT_GENERAL:
+    // Image is a storage image
+    // Make sure any shader writes to the image have been finished
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    break;
   default:
     // Other source layouts aren't handled (yet)
     break;
@@ -1561,7 +1996,7 @@ void render::textureChangeLayout(command_buffer_t cmdBuffer, VkImageLayout newLa
   case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
     // Image layout will be used as a depth/stencil attachment
     // Make sure any writes to depth/stencil buffer have been finished
-    imageMemoryBarrier.dstAccessMask = imageMemoryBarrier.dstAccessMask | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    imageMemoryBarrier.dstAccessMask = imageMemoryBarrier.dstAccessMask | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     break;
 
   case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
@@ -1573,6 +2008,11 @@ void render::textureChangeLayout(command_buffer_t cmdBuffer, VkImageLayout newLa
     }
     imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
     break;
+
+  case VK_IMAGE_LAYOUT_GENERAL:
+    // Image will be read or written in a shader as a storage image
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    break;
   default:
     // Other source layouts aren't handled (yet)
     break;
@@ -1648,24 +2088,154 @@ void render::textureChangeLayoutNow(const context_t& context, VkImageLayout layo
   textureChangeLayoutNow(context, layout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, texture);
 }
 
-
-void render::gpuBufferCreate(const context_t& context,
-  uint32_t usage, uint32_t memoryType, void* data,
-  size_t size, gpu_memory_allocator_t* allocator, gpu_buffer_t* buffer)
+static float HalfToFloat(uint16_t value)
 {
-  //Create the buffer
-  VkBufferCreateInfo bufferCreateInfo = {};
-  bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferCreateInfo.size = static_cast<uint32_t> (size);
-  bufferCreateInfo.usage = (VkBufferUsageFlagBits)usage;
-  vkCreateBuffer(context.device_, &bufferCreateInfo, nullptr, &buffer->handle_);
+  uint32_t sign = (value >> 15) & 1u;
+  uint32_t exponent = (value >> 10) & 0x1Fu;
+  uint32_t mantissa = value & 0x3FFu;
+  float result;
+  if (exponent == 0u)
+    result = mantissa * (1.0f / 16777216.0f);  //Denormal: mantissa * 2^-24
+  else if (exponent == 31u)
+    result = mantissa ? NAN : INFINITY;
+  else
+    result = ldexpf((float)(mantissa | 0x400u), (int)exponent - 25);
 
-  //Get memory requirements of the buffer
-  VkMemoryRequirements requirements = {};
-  vkGetBufferMemoryRequirements(context.device_, buffer->handle_, &requirements);
+  return sign ? -result : result;
+}
 
-  //Allocate memory for the buffer
-  buffer->memory_ = gpuMemoryAllocate(context, requirements.size, requirements.alignment, 0xFFFF, memoryType, allocator);
+bool render::textureRead(const context_t& context, texture_t* texture, image::image2D_t* image)
+{
+  uint32_t componentSize = 0u;
+  uint32_t texelSize = 0u;
+  switch (texture->format_)
+  {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    componentSize = 1u;
+    texelSize = 4u;
+    break;
+  case VK_FORMAT_R16G16B16A16_SFLOAT:
+    componentSize = 4u;
+    texelSize = 8u;
+    break;
+  case VK_FORMAT_R32G32B32A32_SFLOAT:
+    componentSize = 4u;
+    texelSize = 16u;
+    break;
+  default:
+    return false;
+  }
+
+  uint32_t width = texture->extent_.width;
+  uint32_t height = texture->extent_.height;
+  gpu_buffer_t stagingBuffer;
+  gpuBufferCreate(context, gpu_buffer_t::usage::TRANSFER_DST, HOST_VISIBLE_COHERENT, nullptr, width * height * texelSize, nullptr, &stagingBuffer);
+
+  command_buffer_t commandBuffer;
+  commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, command_buffer_t::GRAPHICS, &commandBuffer);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  vkBeginCommandBuffer(commandBuffer.handle_, &beginInfo);
+
+  //Copy the first mipmap to the staging buffer and restore the layout of the texture
+  VkImageLayout layout = texture->layout_;
+  VkImageSubresourceRange subresourceRange = { texture->aspectFlags_, 0u, 1u, 0u, 1u };
+  textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange, texture);
+
+  VkBufferImageCopy region = {};
+  region.imageSubresource.aspectMask = texture->aspectFlags_;
+  region.imageSubresource.layerCount = 1u;
+  region.imageExtent = { width, height, 1u };
+  vkCmdCopyImageToBuffer(commandBuffer.handle_, texture->image_, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer.handle_, 1u, &region);
+
+  if (layout != VK_IMAGE_LAYOUT_UNDEFINED)
+  {
+    textureChangeLayout(commandBuffer, layout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, texture);
+  }
+
+  vkEndCommandBuffer(commandBuffer.handle_);
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer.handle_;
+  vkResetFences(context.device_, 1u, &commandBuffer.fence_);
+  vkQueueSubmit(context.graphicsQueue_.handle_, 1, &submitInfo, commandBuffer.fence_);
+  vkWaitForFences(context.device_, 1u, &commandBuffer.fence_, VK_TRUE, UINT64_MAX);
+  commandBufferDestroy(context, &commandBuffer);
+
+  //Convert to RGBA with 8 bit or 32 bit float components
+  image->width_ = width;
+  image->height_ = height;
+  image->componentCount_ = 4u;
+  image->componentSize_ = componentSize;
+  image->dataSize_ = width * height * 4u * componentSize;
+  image->data_ = (uint8_t*)malloc(image->dataSize_);
+
+  const uint8_t* data = (const uint8_t*)gpuBufferMap(context, stagingBuffer);
+  if (texture->format_ == VK_FORMAT_R16G16B16A16_SFLOAT)
+  {
+    const uint16_t* src = (const uint16_t*)data;
+    float* dst = (float*)image->data_;
+    for (uint32_t i(0); i < width * height * 4u; ++i)
+      dst[i] = HalfToFloat(src[i]);
+  }
+  else
+  {
+    memcpy(image->data_, data, image->dataSize_);
+    if (texture->format_ == VK_FORMAT_B8G8R8A8_UNORM || texture->format_ == VK_FORMAT_B8G8R8A8_SRGB)
+    {
+      for (uint32_t i(0); i < width * height; ++i)
+      {
+        uint8_t blue = image->data_[i * 4];
+        image->data_[i * 4] = image->data_[i * 4 + 2];
+        image->data_[i * 4 + 2] = blue;
+      }
+    }
+  }
+
+  gpuBufferUnmap(context, stagingBuffer);
+  gpuBufferDestroy(context, nullptr, &stagingBuffer);
+  return true;
+}
+
+bool render::presentationImageRead(const context_t& context, image::image2D_t* image)
+{
+  //Swapchain images can't be copied
+  if (!context.headless_)
+    return false;
+
+  texture_t texture = {};
+  texture.image_ = context.swapChain_.image_[context.swapChain_.currentImage_];
+  texture.layout_ = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  texture.format_ = context.surface_.imageFormat_;
+  texture.aspectFlags_ = VK_IMAGE_ASPECT_COLOR_BIT;
+  texture.mipLevels_ = 1u;
+  texture.extent_ = { context.swapChain_.imageWidth_, context.swapChain_.imageHeight_, 1u };
+  return textureRead(context, &texture, image);
+}
+
+void render::gpuBufferCreate(const context_t& context,
+  uint32_t usage, uint32_t memoryType, void* data,
+  size_t size, gpu_memory_allocator_t* allocator, gpu_buffer_t* buffer)
+{
+  //Create the buffer
+  VkBufferCreateInfo bufferCreateInfo = {};
+  bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferCreateInfo.size = static_cast<uint32_t> (size);
+  bufferCreateInfo.usage = (VkBufferUsageFlagBits)usage;
+  vkCreateBuffer(context.device_, &bufferCreateInfo, nullptr, &buffer->handle_);
+
+  //Get memory requirements of the buffer
+  VkMemoryRequirements requirements = {};
+  vkGetBufferMemoryRequirements(context.device_, buffer->handle_, &requirements);
+
+  //Allocate memory for the buffer
+  buffer->memory_ = gpuMemoryAllocate(context, requirements.size, requirements.alignment, 0xFFFF, memoryType, allocator);
 
   //Bind memory to the buffer
   vkBindBufferMemory(context.device_, buffer->handle_, buffer->memory_.handle_, buffer->memory_.offset_);
@@ -1699,6 +2269,15 @@ void render::gpuBufferDestroy(const context_t& context, gpu_memory_allocator_t*
   gpuMemoryDeallocate(context, allocator, buffer->memory_);
 }
 
+void render::gpuBufferDestroyDeferred(context_t* context, gpu_memory_allocator_t* allocator, gpu_buffer_t* buffer)
+{
+  deferred_destruction_t objects = {};
+  objects.buffer_ = buffer->handle_;
+  objects.memory_ = buffer->memory_;
+  objects.allocator_ = allocator;
+  destroyDeferred(context, objects);
+}
+
 void render::gpuBufferUpdate(const context_t& context, void* data, size_t offset, size_t size, gpu_buffer_t* buffer)
 {
   void* mapping = gpuMemoryMap(context, offset, size, 0u, buffer->memory_);
@@ -1731,6 +2310,13 @@ descriptor_t render::getDescriptor(const texture_t& texture)
   return descriptor;
 }
 
+descriptor_t render::getDescriptor(const depth_stencil_buffer_t& depthStencilBuffer)
+{
+  descriptor_t descriptor;
+  descriptor.imageDescriptor_ = depthStencilBuffer.descriptor_;
+  return descriptor;
+}
+
 void render::descriptorSetLayoutCreate(const context_t& context, descriptor_binding_t* bindings, uint32_t bindingCount, descriptor_set_layout_t* descriptorSetLayout)
 {
   descriptorSetLayout->bindingCount_ = bindingCount;
@@ -1892,6 +2478,16 @@ void render::descriptorSetDestroy(const context_t& context, descriptor_set_t* de
   vkFreeDescriptorSets(context.device_, descriptorSet->pool_.handle_, 1, &descriptorSet->handle_);
 }
 
+void render::descriptorSetDestroyDeferred(context_t* context, descriptor_set_t* descriptorSet)
+{
+  delete[] descriptorSet->descriptors_;
+
+  deferred_destruction_t objects = {};
+  objects.descriptorSet_ = descriptorSet->handle_;
+  objects.descriptorPool_ = descriptorSet->pool_.handle_;
+  destroyDeferred(context, objects);
+}
+
 void render::descriptorSetUpdate(const context_t& context, const descriptor_set_layout_t& descriptorSetLayout, descriptor_set_t* descriptorSet)
 {
   std::vector<VkWriteDescriptorSet> writeDescriptorSets(descriptorSet->descriptorCount_);
@@ -1936,6 +2532,11 @@ void render::descriptorSetBind(command_buffer_t commandBuffer, const pipeline_la
   VkPipelineBindPoint bindPoint = commandBuffer.type_ == command_buffer_t::GRAPHICS ? VK_PIPELINE_BIND_POINT_GRAPHICS :
                                                                                       VK_PIPELINE_BIND_POINT_COMPUTE;
   
+  descriptorSetBind(commandBuffer, bindPoint, pipelineLayout, firstSet, descriptorSets, descriptorSetCount);
+}
+
+void render::descriptorSetBind(command_buffer_t commandBuffer, VkPipelineBindPoint bindPoint, const pipeline_layout_t& pipelineLayout, uint32_t firstSet, descriptor_set_t* descriptorSets, uint32_t descriptorSetCount)
+{
   std::vector<VkDescriptorSet> descriptorSetHandles(descriptorSetCount);
   for (u32 i(0); i < descriptorSetCount; ++i)
   {
@@ -1943,6 +2544,64 @@ void render::descriptorSetBind(command_buffer_t commandBuffer, const pipeline_la
   }
   
   vkCmdBindDescriptorSets(commandBuffer.handle_, bindPoint, pipelineLayout.handle_, firstSet, descriptorSetCount, descriptorSetHandles.data(), 0, 0);
+  if (commandBuffer.recordedStats_)
+    commandBuffer.recordedStats_->descriptorSetBindCount_ += descriptorSetCount;
+}
+
+static void specializationConstantSetRaw(uint32_t id, uint32_t value, specialization_constants_t* constants)
+{
+  for (uint32_t i(0); i < constants->id_.size(); ++i)
+  {
+    if (constants->id_[i] == id)
+    {
+      constants->value_[i] = value;
+      return;
+    }
+  }
+
+  constants->id_.push_back(id);
+  constants->value_.push_back(value);
+}
+
+//Map entries reference the values in constants, so the info is only valid while constants is alive and unchanged
+static VkSpecializationInfo GetSpecializationInfo(const specialization_constants_t& constants, std::vector<VkSpecializationMapEntry>* mapEntries)
+{
+  mapEntries->resize(constants.id_.size());
+  for (uint32_t i(0); i < constants.id_.size(); ++i)
+  {
+    (*mapEntries)[i].constantID = constants.id_[i];
+    (*mapEntries)[i].offset = i * sizeof(uint32_t);
+    (*mapEntries)[i].size = sizeof(uint32_t);
+  }
+
+  VkSpecializationInfo specializationInfo = {};
+  specializationInfo.mapEntryCount = (uint32_t)mapEntries->size();
+  specializationInfo.pMapEntries = mapEntries->data();
+  specializationInfo.dataSize = constants.value_.size() * sizeof(uint32_t);
+  specializationInfo.pData = constants.value_.data();
+  return specializationInfo;
+}
+
+void render::specializationConstantSet(uint32_t id, int32_t value, specialization_constants_t* constants)
+{
+  specializationConstantSetRaw(id, (uint32_t)value, constants);
+}
+
+void render::specializationConstantSet(uint32_t id, uint32_t value, specialization_constants_t* constants)
+{
+  specializationConstantSetRaw(id, value, constants);
+}
+
+void render::specializationConstantSet(uint32_t id, float value, specialization_constants_t* constants)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(uint32_t));
+  specializationConstantSetRaw(id, bits, constants);
+}
+
+void render::specializationConstantSet(uint32_t id, bool value, specialization_constants_t* constants)
+{
+  specializationConstantSetRaw(id, value ? VK_TRUE : VK_FALSE, constants);
 }
 
 void render::graphicsPipelineCreate(const context_t& context, VkRenderPass renderPass, uint32_t subpass, const render::vertex_format_t& vertexFormat, 
@@ -1959,7 +2618,7 @@ void render::graphicsPipelineCreate(const context_t& context, VkRenderPass rende
   VkPipelineColorBlendStateCreateInfo pipelineColorBlendStateCreateInfo = {};
   pipelineColorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
   pipelineColorBlendStateCreateInfo.attachmentCount = (uint32_t)pipeline->desc_.blendState_.size();
-  pipelineColorBlendStateCreateInfo.pAttachments = &pipeline->desc_.blendState_[0];
+  pipelineColorBlendStateCreateInfo.pAttachments = pipeline->desc_.blendState_.data();
 
   VkPipelineRasterizationStateCreateInfo pipelineRasterizationStateCreateInfo = {};
   pipelineRasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -1987,16 +2646,22 @@ void render::graphicsPipelineCreate(const context_t& context, VkRenderPass rende
   pipelineMultisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
   pipelineMultisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+  std::vector<VkSpecializationMapEntry> specializationMapEntries;
+  VkSpecializationInfo specializationInfo = GetSpecializationInfo(pipeline->desc_.specialization_, &specializationMapEntries);
+  const VkSpecializationInfo* specializationInfoPtr = specializationMapEntries.empty() ? nullptr : &specializationInfo;
+
   VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfos[2] = {};
   pipelineShaderStageCreateInfos[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   pipelineShaderStageCreateInfos[0].module = pipeline->desc_.vertexShader_.handle_;
   pipelineShaderStageCreateInfos[0].pName = "main";
   pipelineShaderStageCreateInfos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  pipelineShaderStageCreateInfos[0].pSpecializationInfo = specializationInfoPtr;
 
   pipelineShaderStageCreateInfos[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   pipelineShaderStageCreateInfos[1].module = pipeline->desc_.fragmentShader_.handle_;
   pipelineShaderStageCreateInfos[1].pName = "main";
   pipelineShaderStageCreateInfos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pipelineShaderStageCreateInfos[1].pSpecializationInfo = specializationInfoPtr;
 
   VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {};
   graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -2034,19 +2699,31 @@ void render::graphicsPipelineDestroy(const context_t& context, graphics_pipeline
 void render::graphicsPipelineBind(command_buffer_t commandBuffer, const graphics_pipeline_t& pipeline)
 {
   vkCmdBindPipeline(commandBuffer.handle_, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.handle_);
+  if (commandBuffer.recordedStats_)
+    ++commandBuffer.recordedStats_->pipelineBindCount_;
 }
 
 
 void render::computePipelineCreate(const context_t& context, const pipeline_layout_t& layout, const render::shader_t& computeShader, compute_pipeline_t* pipeline)
+{
+  computePipelineCreate(context, layout, computeShader, specialization_constants_t(), pipeline);
+}
+
+void render::computePipelineCreate(const context_t& context, const pipeline_layout_t& layout, const render::shader_t& computeShader, const specialization_constants_t& specialization, compute_pipeline_t* pipeline)
 {
   //Compute pipeline
   pipeline->computeShader_ = computeShader;
+  pipeline->specialization_ = specialization;
+
+  std::vector<VkSpecializationMapEntry> specializationMapEntries;
+  VkSpecializationInfo specializationInfo = GetSpecializationInfo(pipeline->specialization_, &specializationMapEntries);
 
   VkPipelineShaderStageCreateInfo shaderStage = {};
   shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
   shaderStage.pName = "main";
   shaderStage.module = pipeline->computeShader_.handle_;
+  shaderStage.pSpecializationInfo = specializationMapEntries.empty() ? nullptr : &specializationInfo;
 
   VkComputePipelineCreateInfo computePipelineCreateInfo = {};
   computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -2064,11 +2741,15 @@ void render::computePipelineDestroy(const context_t& context, compute_pipeline_t
 void render::computePipelineBind(command_buffer_t commandBuffer, const compute_pipeline_t& pipeline)
 {
   vkCmdBindPipeline(commandBuffer.handle_, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle_);
+  if (commandBuffer.recordedStats_)
+    ++commandBuffer.recordedStats_->pipelineBindCount_;
 }
 
 void render::computeDispatch(command_buffer_t commandBuffer, uint32_t groupSizeX, uint32_t groupSizeY, uint32_t groupSizeZ)
 {
   vkCmdDispatch(commandBuffer.handle_, groupSizeX, groupSizeY, groupSizeZ);
+  if (commandBuffer.recordedStats_)
+    ++commandBuffer.recordedStats_->dispatchCount_;
 }
 
 void render::pushConstants(command_buffer_t commandBuffer, pipeline_layout_t pipelineLayout, uint32_t offset, const void* constant)
@@ -2219,9 +2900,25 @@ void render::vertexFormatDestroy(vertex_format_t* format)
 
 void render::depthStencilBufferCreate(const context_t& context, uint32_t width, uint32_t height, depth_stencil_buffer_t* depthStencilBuffer)
 {
-  CreateDepthStencilBuffer(&context, width, height, context.swapChain_.depthStencil_.format_, depthStencilBuffer);
-  
-  
+  //Offscreen depth buffers can be read in later passes (e.g to reconstruct positions)
+  CreateDepthStencilBuffer(&context, width, height, context.swapChain_.depthStencil_.format_,
+    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+    depthStencilBuffer);
+
+  //Shaders can only read the depth aspect
+  VkImageViewCreateInfo imageViewCreateInfo = {};
+  imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  imageViewCreateInfo.format = depthStencilBuffer->format_;
+  imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+  imageViewCreateInfo.subresourceRange.levelCount = 1;
+  imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+  imageViewCreateInfo.subresourceRange.layerCount = 1;
+  imageViewCreateInfo.image = depthStencilBuffer->image_;
+  VkImageView depthView;
+  vkCreateImageView(context.device_, &imageViewCreateInfo, nullptr, &depthView);
+
   //Create sampler
   texture_sampler_t defaultSampler;
   VkSampler sampler;
@@ -2241,7 +2938,7 @@ void render::depthStencilBufferCreate(const context_t& context, uint32_t width,
   vkCreateSampler(context.device_, &samplerCreateInfo, nullptr, &sampler);
 
   depthStencilBuffer->descriptor_.sampler = sampler;
-  depthStencilBuffer->descriptor_.imageView = depthStencilBuffer->imageView_;
+  depthStencilBuffer->descriptor_.imageView = depthView;
   depthStencilBuffer->descriptor_.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
   depthStencilBuffer->aspectFlags_ = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
   depthStencilBuffer->layout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -2250,11 +2947,27 @@ void render::depthStencilBufferCreate(const context_t& context, uint32_t width,
 void render::depthStencilBufferDestroy(const context_t& context, depth_stencil_buffer_t* depthStencilBuffer)
 {
   vkDestroyImageView(context.device_, depthStencilBuffer->imageView_, nullptr);
+  vkDestroyImageView(context.device_, depthStencilBuffer->descriptor_.imageView, nullptr);
   vkDestroyImage(context.device_, depthStencilBuffer->image_, nullptr);
   vkDestroySampler(context.device_, depthStencilBuffer->descriptor_.sampler, nullptr);
   gpuMemoryDeallocate(context, nullptr, depthStencilBuffer->memory_);
 }
 
+void render::depthStencilBufferDestroyDeferred(context_t* context, depth_stencil_buffer_t* depthStencilBuffer)
+{
+  deferred_destruction_t objects = {};
+  objects.imageView_ = depthStencilBuffer->imageView_;
+  objects.image_ = depthStencilBuffer->image_;
+  objects.sampler_ = depthStencilBuffer->descriptor_.sampler;
+  objects.memory_ = depthStencilBuffer->memory_;
+  destroyDeferred(context, objects);
+
+  //Depth only view used by shaders
+  objects = {};
+  objects.imageView_ = depthStencilBuffer->descriptor_.imageView;
+  destroyDeferred(context, objects);
+}
+
 void render::renderPassCreate(const context_t& context,
   render_pass_t::attachment_t* attachments, uint32_t attachmentCount,
   render_pass_t::subpass_t* subpasses, uint32_t subpassCount,
@@ -2264,6 +2977,7 @@ void render::renderPassCreate(const context_t& context,
   renderPass->attachment_ = new render_pass_t::attachment_t[attachmentCount];
   renderPass->attachmentCount_ = attachmentCount;
   memcpy(renderPass->attachment_, attachments, sizeof(render_pass_t::attachment_t)*attachmentCount);
+  renderPass->viewMask_ = subpassCount > 0u ? subpasses[0].viewMask_ : 0u;
 
   std::vector<VkAttachmentDescription> attachmentDescription(attachmentCount);
   for (uint32_t i(0); i < attachmentCount; ++i)
@@ -2321,10 +3035,14 @@ void render::renderPassCreate(const context_t& context,
     std::vector< std::vector<VkAttachmentReference> > inputAttachmentRef( subpassCount );
     std::vector< std::vector<VkAttachmentReference> > colorAttachmentRef(subpassCount);
     std::vector<VkAttachmentReference> depthStencilAttachmentRef(subpassCount);
+    std::vector<uint32_t> viewMask(subpassCount);
+    bool multiview = false;
     
     for (uint32_t i = 0; i < subpassCount; ++i)
     {
       subpassDescription[i].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      viewMask[i] = subpasses[i].viewMask_;
+      multiview |= viewMask[i] != 0u;
 
       //Input attachments
       uint32_t inputAttachmentCount = (uint32_t)subpasses[i].inputAttachmentIndex_.size();
@@ -2332,7 +3050,8 @@ void render::renderPassCreate(const context_t& context,
       for (uint32_t j = 0; j < inputAttachmentCount; ++j)
       {
         inputAttachmentRef[i][j].attachment = subpasses[i].inputAttachmentIndex_[j];
-        inputAttachmentRef[i][j].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        inputAttachmentRef[i][j].layout = attachments[subpasses[i].inputAttachmentIndex_[j]].format_ == context.swapChain_.depthStencil_.format_ ?
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
       }
       subpassDescription[i].inputAttachmentCount = inputAttachmentCount;
       subpassDescription[i].pInputAttachments = inputAttachmentRef[i].data();
@@ -2380,6 +3099,16 @@ void render::renderPassCreate(const context_t& context,
     renderPassCreateInfo.dependencyCount = dependencyCount;
     renderPassCreateInfo.pDependencies = subpassDependencies.data();
 
+    //Multiview. If a subpass has a view mask all of them must have one
+    VkRenderPassMultiviewCreateInfo multiviewCreateInfo = {};
+    if (multiview)
+    {
+      assert(multiviewSupported(context));
+      multiviewCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+      multiviewCreateInfo.subpassCount = subpassCount;
+      multiviewCreateInfo.pViewMasks = viewMask.data();
+      renderPassCreateInfo.pNext = &multiviewCreateInfo;
+    }
 
     vkCreateRenderPass(context.device_, &renderPassCreateInfo, nullptr, &renderPass->handle_);
   }  
@@ -2391,6 +3120,13 @@ void render::renderPassDestroy(const context_t& context, render_pass_t* renderPa
   vkDestroyRenderPass(context.device_, renderPass->handle_, nullptr);
 }
 
+static bool IsDepthStencilFormat(VkFormat format)
+{
+  return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+         format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
 void render::frameBufferCreate(const context_t& context, uint32_t width, uint32_t height, const render_pass_t& renderPass, VkImageView* imageViews, frame_buffer_t* frameBuffer)
 { 
   VkFramebufferCreateInfo framebufferCreateInfo = {};
@@ -2406,13 +3142,15 @@ void render::frameBufferCreate(const context_t& context, uint32_t width, uint32_
 
   //No clear render pass
   render::render_pass_t::subpass_t noclearSubpass;
+  noclearSubpass.viewMask_ = renderPass.viewMask_;
   std::vector<render_pass_t::attachment_t> noclearAttachments(renderPass.attachmentCount_);
   for (uint32_t i(0); i < renderPass.attachmentCount_; ++i)
   {
     noclearAttachments[i] = renderPass.attachment_[i];
     noclearAttachments[i].loadOp_ = VK_ATTACHMENT_LOAD_OP_LOAD;
 
-    if(noclearAttachments[i].format_ == context.swapChain_.depthStencil_.format_ )
+    //Any depth format, not only the one of the swapchain depth buffer (e.g shadow maps)
+    if (IsDepthStencilFormat(noclearAttachments[i].format_))
       noclearSubpass.depthStencilAttachmentIndex_ = i;
     else
       noclearSubpass.colorAttachmentIndex_.push_back(i);
@@ -2462,6 +3200,7 @@ void render::commandBufferCreate(const context_t& context, VkCommandBufferLevel
   commandBufferAllocateInfo.commandPool = context.commandPool_;
   commandBufferAllocateInfo.level = level;
   vkAllocateCommandBuffers(context.device_, &commandBufferAllocateInfo, &commandBuffer->handle_ );
+  commandBuffer->recordedStats_ = new render_stats_t();
 
   VkFenceCreateInfo fenceCreateInfo = {};
   fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
@@ -2475,19 +3214,25 @@ void render::commandBufferDestroy(const context_t& context, command_buffer_t* co
   delete[] commandBuffer->waitStages_;
   delete[] commandBuffer->signalSemaphore_;
 
+  delete commandBuffer->recordedStats_;
+  commandBuffer->recordedStats_ = nullptr;
   vkFreeCommandBuffers(context.device_, context.commandPool_, 1u, &commandBuffer->handle_ );
   vkDestroyFence(context.device_, commandBuffer->fence_, nullptr);
 }
 
 void render::commandBufferBegin(const context_t& context, const command_buffer_t& commandBuffer)
 {
-  vkWaitForFences(context.device_, 1u, &commandBuffer.fence_, VK_TRUE, UINT64_MAX);
+  {
+    BKK_ZONE("Wait for command buffer fence");
+    vkWaitForFences(context.device_, 1u, &commandBuffer.fence_, VK_TRUE, UINT64_MAX);
+  }
 
   VkCommandBufferBeginInfo beginInfo = {};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
   //Begin command buffer
   vkBeginCommandBuffer(commandBuffer.handle_, &beginInfo);
+  StatsBeginCommandBuffer(commandBuffer);
 }
 
 void render::commandBufferRenderPassBegin(const context_t& context, const frame_buffer_t* frameBuffer, VkClearValue* clearValues, uint32_t clearValuesCount, const command_buffer_t& commandBuffer)
@@ -2557,6 +3302,8 @@ void render::commandBufferSubmit(const context_t& context, const command_buffer_
   {
     vkQueueSubmit(context.computeQueue_.handle_, 1, &submitInfo, commandBuffer.fence_);
   }
+
+  StatsSubmitCommandBuffer(commandBuffer);
 }
 
 VkSemaphore render::semaphoreCreate(const context_t& context)
@@ -2574,81 +3321,117 @@ void render::semaphoreDestroy(const context_t& context, VkSemaphore semaphore)
 }
 
 
-void render::textureCubemapCreateFromEquirectangularImage(const context_t& context, const image::image2D_t& image, uint32_t size, bool generateMipmaps, texture_t* cubemap)
+//Push constants and uniforms of the shaders used to render cubemap faces (See RenderCubemapFaces)
+static const char* gCubemapFaceShaderCommon = R"(
+layout(push_constant) uniform PushConstants
 {
-  u32 mipLevels = generateMipmaps ? u32(1 + floor(log2(size))) : 1u;
+  layout (offset = 0) uint face;                     //First face rendered by the pass. Zero with multiview
+  layout (offset = 4) float roughness;               //Mip level of the face normalized to [0,1]
+  layout (offset = 8) float sourceCubemapResolution; //Resolution of the source texture
+}pushConstants;
+layout(set = 0, binding = 1) uniform Faces
+{
+  mat4 viewProjection[6];
+}faces;
+)";
+
+static const char* gCubemapFaceVertexShaderSource = R"(
+layout(location = 0) in vec3 aPosition;
+layout(location = 0) out vec3 localPos;
+void main(void)
+{
+  localPos = aPosition;
+  gl_Position = faces.viewProjection[pushConstants.face + VIEW_INDEX] * vec4(aPosition,1.0);
+}
+)";
 
-  render::texture_t texture;
-  render::texture2DCreate(context, &image, 1, render::texture_sampler_t(), &texture);
-  render::textureCubemapCreate(context, VK_FORMAT_R32G32B32A32_SFLOAT, size, size, mipLevels, render::texture_sampler_t(), cubemap);
+//Renders a unit cube seen from its center into every face and mip level of a cubemap. The fragment shader gets the direction to the
+//fragment in localPos and the source texture in binding 0 of set 0. If multiview is supported the six faces of a mip level are rendered
+//straight to the cubemap in a single pass, otherwise each face is rendered to a temporary target and copied to the cubemap
+static void RenderCubemapFaces(const context_t& context, const char* fragmentShaderSource, const texture_t& source, texture_t* cubemap)
+{
+  const u32 size = cubemap->extent_.width;
+  const u32 mipLevels = cubemap->mipLevels_;
+  const VkFormat format = cubemap->format_;
+
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(context.physicalDevice_, format, &formatProperties);
+  const bool multiview = render::multiviewSupported(context) && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) != 0;
 
   mesh::mesh_t cube = mesh::unitCube(context);
 
-  //Change cubemap layout for transfer
-  VkImageSubresourceRange subresourceRange = {};
-  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  subresourceRange.baseMipLevel = 0;
-  subresourceRange.levelCount = mipLevels;
-  subresourceRange.layerCount = 6;
-  render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, cubemap);
+  //View-projection matrices of the faces
+  maths::mat4 projection = maths::perspectiveProjectionMatrix(1.57f, 1.0f, 0.1f, 1.0f);
+  maths::mat4 view[6] = { maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(1.0f, 0.0f, 0.0f),  maths::vec3(0.0f, 1.0f, 0.0f)),
+                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(-1.0f, 0.0f, 0.0f), maths::vec3(0.0f, 1.0f, 0.0f)),
+                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 1.0f, 0.0f),  maths::vec3(0.0f, 0.0f, 1.0f)),
+                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, -1.0f, 0.0f), maths::vec3(0.0f, 0.0f,-1.0f)),
+                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 0.0f, -1.0f), maths::vec3(0.0f, 1.0f, 0.0f)),
+                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 0.0f, 1.0f),  maths::vec3(0.0f, 1.0f, 0.0f)) };
+
+  maths::mat4 viewProjection[6];
+  for (u32 i(0); i < 6; ++i)
+    viewProjection[i] = view[i] * projection;
+
+  render::gpu_buffer_t ubo;
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::UNIFORM_BUFFER, viewProjection, sizeof(viewProjection), nullptr, &ubo);
 
   //Create descriptor pool
   render::descriptor_pool_t descriptorPool;
   render::descriptorPoolCreate(context, 1u,
     render::combined_image_sampler_count(1u),
-    render::uniform_buffer_count(0u),
+    render::uniform_buffer_count(1u),
     render::storage_buffer_count(0u),
     render::storage_image_count(0u),
     &descriptorPool);
 
-  //Create pipeline
-  render::graphics_pipeline_t pipeline;
-  render::pipeline_layout_t pipelineLayout;
+  //Create pipeline layout
   render::descriptor_set_layout_t descriptorSetLayout;
-  render::descriptor_binding_t bindings = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, VK_SHADER_STAGE_FRAGMENT_BIT };
-  render::descriptorSetLayoutCreate(context, &bindings, 1u, &descriptorSetLayout);
+  render::descriptor_binding_t bindings[2] = { { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, VK_SHADER_STAGE_FRAGMENT_BIT },
+                                               { render::descriptor_t::type::UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT } };
+  render::descriptorSetLayoutCreate(context, bindings, 2u, &descriptorSetLayout);
+
+  struct push_constants_t
+  {
+    u32 face_;
+    float roughness_;
+    float sourceCubemapResolution_;
+    float padding_;
+  }pushConstants = { 0u, 0.0f, (float)source.extent_.width, 0.0f };
 
-  render::push_constant_range_t pushConstantsRange = { VK_SHADER_STAGE_VERTEX_BIT, sizeof(maths::mat4), 0u };
+  render::pipeline_layout_t pipelineLayout;
+  render::push_constant_range_t pushConstantsRange = { VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(pushConstants), 0u };
   render::pipelineLayoutCreate(context, &descriptorSetLayout, 1u, &pushConstantsRange, 1u, &pipelineLayout);
 
+  //Create render pass. With multiview the faces of the cubemap are the views of the pass
   render::render_pass_t renderPass = {};
-  render::render_pass_t::attachment_t attachments = { VK_FORMAT_R32G32B32A32_SFLOAT, VK_SAMPLE_COUNT_1_BIT,
-    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-    VK_ATTACHMENT_STORE_OP_STORE,VK_ATTACHMENT_LOAD_OP_CLEAR };
-  render::renderPassCreate(context, &attachments, 1u, nullptr, 0u, nullptr, 0u, &renderPass);
+  if (multiview)
+  {
+    render::render_pass_t::attachment_t attachment = { format, VK_SAMPLE_COUNT_1_BIT,
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_CLEAR };
+
+    render::render_pass_t::subpass_t subpass;
+    subpass.colorAttachmentIndex_.push_back(0);
+    subpass.viewMask_ = 0x3F;
+    render::renderPassCreate(context, &attachment, 1u, &subpass, 1u, nullptr, 0u, &renderPass);
+  }
+  else
+  {
+    render::render_pass_t::attachment_t attachment = { format, VK_SAMPLE_COUNT_1_BIT,
+      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+      VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_LOAD_OP_CLEAR };
+    render::renderPassCreate(context, &attachment, 1u, nullptr, 0u, nullptr, 0u, &renderPass);
+  }
 
   //Load shaders
+  std::string header = std::string("#version 440 core\n") + render::getMultiviewHelpersGLSL(context) + gCubemapFaceShaderCommon;
   render::shader_t vertexShader;
-  const char* vsSource = R"(  
-                                #version 440 core
-                                layout(push_constant) uniform PushConstants
-                                {
-	                                layout (offset = 0) mat4 viewProjection;
-                                }pushConstants;  
-                                layout(location = 0) in vec3 aPosition;
-                                layout(location = 0) out vec3 localPos;
-                                void main(void)
-                                {
-                                  localPos = aPosition;
-                                  gl_Position = pushConstants.viewProjection * vec4(aPosition,1.0);
-                                })";
-  render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, vsSource, &vertexShader);
-
+  render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, (header + gCubemapFaceVertexShaderSource).c_str(), &vertexShader);
   render::shader_t fragmentShader;
-  const char* fsSource = R"(  
-                                #version 440 core
-                                layout(location = 0) in vec3 localPos;
-                                layout (set = 0, binding = 0) uniform sampler2D uTexture;
-                                layout(location = 0) out vec4 color;
-                                const vec2 invAtan = vec2(0.1591, 0.3183);
-                                void main(void)
-                                {
-                                  vec3 direction = normalize( localPos );
-                                  vec2 uv = vec2( atan(direction.z, direction.x), asin(direction.y) ) * invAtan + 0.5;
-                                  color = texture( uTexture, uv );
-                                })";
-  render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, fsSource, &fragmentShader);
+  render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, (header + fragmentShaderSource).c_str(), &fragmentShader);
 
+  render::graphics_pipeline_t pipeline;
   render::graphics_pipeline_t::description_t pipelineDesc = {};
   pipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)size, (float)size, 0.0f, 1.0f };
   pipelineDesc.scissorRect_ = { { 0,0 },{ size, size } };
@@ -2663,9 +3446,9 @@ void render::textureCubemapCreateFromEquirectangularImage(const context_t& conte
   render::graphicsPipelineCreate(context, renderPass.handle_, 0u, cube.vertexFormat_, pipelineLayout, pipelineDesc, &pipeline);
 
   //Create descriptor set
-  render::descriptor_t textureDescriptor = render::getDescriptor(texture);
+  render::descriptor_t descriptors[2] = { render::getDescriptor(source), render::getDescriptor(ubo) };
   render::descriptor_set_t descriptorSet;
-  render::descriptorSetCreate(context, descriptorPool, descriptorSetLayout, &textureDescriptor, &descriptorSet);
+  render::descriptorSetCreate(context, descriptorPool, descriptorSetLayout, descriptors, &descriptorSet);
 
   //Create command buffer
   VkClearValue clearValue;
@@ -2674,62 +3457,115 @@ void render::textureCubemapCreateFromEquirectangularImage(const context_t& conte
   render::command_buffer_t commandBuffer = {};
   render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, render::command_buffer_t::GRAPHICS, &commandBuffer);
 
-  maths::mat4 projection = maths::perspectiveProjectionMatrix(1.57f, 1.0f, 0.1f, 1.0f);
-  maths::mat4 view[6] = { maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(1.0f, 0.0f, 0.0f),  maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(-1.0f, 0.0f, 0.0f), maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 1.0f, 0.0f),  maths::vec3(0.0f, 0.0f, 1.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, -1.0f, 0.0f), maths::vec3(0.0f, 0.0f,-1.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 0.0f, -1.0f), maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 0.0f, 1.0f),  maths::vec3(0.0f, 1.0f, 0.0f)) };
+  VkImageSubresourceRange subresourceRange = {};
+  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  subresourceRange.baseMipLevel = 0;
+  subresourceRange.levelCount = mipLevels;
+  subresourceRange.layerCount = 6;
 
   std::vector<render::frame_buffer_t> frameBuffers(mipLevels);
-  std::vector<render::texture_t> renderTargets(mipLevels);
-  u32 mipSize = size;
-  for (u32 mipLevel = 0; mipLevel < mipLevels; ++mipLevel)
+  std::vector<render::texture_t> renderTargets;
+  std::vector<VkImageView> mipViews;
+  if (multiview)
   {
-    //Create render target and framebuffer
-    frameBuffers[mipLevel] = {};
-    render::texture2DCreate(context, mipSize, mipSize, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, render::texture_sampler_t(), &renderTargets[mipLevel]);
-    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &renderTargets[mipLevel]);
-    render::frameBufferCreate(context, mipSize, mipSize, renderPass, &renderTargets[mipLevel].imageView_, &frameBuffers[mipLevel]);
+    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, cubemap);
+
+    //All the mip levels are rendered in a single submission, one pass per level
+    mipViews.resize(mipLevels);
+    render::commandBufferBegin(context, commandBuffer);
+    render::graphicsPipelineBind(commandBuffer, pipeline);
+    render::descriptorSetBind(commandBuffer, pipelineLayout, 0, &descriptorSet, 1u);
 
-    for (u32 i(0); i < 6; ++i)
+    u32 mipSize = size;
+    for (u32 mipLevel = 0; mipLevel < mipLevels; ++mipLevel)
     {
-      maths::mat4 viewProjection = view[i] * projection;
-      render::commandBufferBegin(context, commandBuffer);
+      //Framebuffers can't use cube views. Render to the six faces of the level as layers of an array
+      VkImageViewCreateInfo imageViewCreateInfo = {};
+      imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      imageViewCreateInfo.format = format;
+      imageViewCreateInfo.image = cubemap->image_;
+      imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      imageViewCreateInfo.subresourceRange.baseMipLevel = mipLevel;
+      imageViewCreateInfo.subresourceRange.levelCount = 1;
+      imageViewCreateInfo.subresourceRange.layerCount = 6;
+      imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+      vkCreateImageView(context.device_, &imageViewCreateInfo, nullptr, &mipViews[mipLevel]);
+
+      frameBuffers[mipLevel] = {};
+      render::frameBufferCreate(context, mipSize, mipSize, renderPass, &mipViews[mipLevel], &frameBuffers[mipLevel]);
+
+      pushConstants.roughness_ = mipLevels > 1 ? (float)mipLevel / (float)(mipLevels - 1) : 0.0f;
       render::commandBufferRenderPassBegin(context, &frameBuffers[mipLevel], &clearValue, 1u, commandBuffer);
-
-      render::pushConstants(commandBuffer, pipelineLayout, 0u, &viewProjection);
-      render::graphicsPipelineBind(commandBuffer, pipeline);
-      render::descriptorSetBind(commandBuffer, pipelineLayout, 0, &descriptorSet, 1u);
+      render::pushConstants(commandBuffer, pipelineLayout, 0u, &pushConstants);
       mesh::draw(commandBuffer, cube);
-
       render::commandBufferRenderPassEnd(commandBuffer);
 
-      //Copy render target to cubemap layer
-      renderTargets[mipLevel].layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
-      render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, &renderTargets[mipLevel]);
-      render::textureCopy(commandBuffer, &renderTargets[mipLevel], cubemap, mipSize, mipSize, mipLevel, i);
-      render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &renderTargets[mipLevel]);
-      
-      render::commandBufferEnd(commandBuffer);
-      render::commandBufferSubmit(context, commandBuffer);
+      mipSize /= 2;
     }
 
-    mipSize /= 2;
+    render::commandBufferEnd(commandBuffer);
+    render::commandBufferSubmit(context, commandBuffer);
+  }
+  else
+  {
+    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, cubemap);
+
+    renderTargets.resize(mipLevels);
+    u32 mipSize = size;
+    for (u32 mipLevel = 0; mipLevel < mipLevels; ++mipLevel)
+    {
+      //Create render target and framebuffer
+      frameBuffers[mipLevel] = {};
+      render::texture2DCreate(context, mipSize, mipSize, 1u, format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, render::texture_sampler_t(), &renderTargets[mipLevel]);
+      render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &renderTargets[mipLevel]);
+      render::frameBufferCreate(context, mipSize, mipSize, renderPass, &renderTargets[mipLevel].imageView_, &frameBuffers[mipLevel]);
+
+      pushConstants.roughness_ = mipLevels > 1 ? (float)mipLevel / (float)(mipLevels - 1) : 0.0f;
+      for (u32 i(0); i < 6; ++i)
+      {
+        pushConstants.face_ = i;
+
+        render::commandBufferBegin(context, commandBuffer);
+        render::commandBufferRenderPassBegin(context, &frameBuffers[mipLevel], &clearValue, 1u, commandBuffer);
+        render::pushConstants(commandBuffer, pipelineLayout, 0u, &pushConstants);
+        render::graphicsPipelineBind(commandBuffer, pipeline);
+        render::descriptorSetBind(commandBuffer, pipelineLayout, 0, &descriptorSet, 1u);
+        mesh::draw(commandBuffer, cube);
+        render::commandBufferRenderPassEnd(commandBuffer);
+
+        //Copy render target to cubemap layer
+        renderTargets[mipLevel].layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
+        render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, &renderTargets[mipLevel]);
+        render::textureCopy(commandBuffer, &renderTargets[mipLevel], cubemap, mipSize, mipSize, mipLevel, i);
+        render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &renderTargets[mipLevel]);
+
+        render::commandBufferEnd(commandBuffer);
+        render::commandBufferSubmit(context, commandBuffer);
+      }
+
+      mipSize /= 2;
+    }
   }
 
   //Change cubemap layout for shader access
   render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, cubemap);
 
-
+  //Clean-up
   for (u32 i(0); i < mipLevels; ++i)
   {
-    render::textureDestroy(context, &renderTargets[i]);
     render::frameBufferDestroy(context, &frameBuffers[i]);
   }
 
-  render::textureDestroy(context, &texture);
+  for (u32 i(0); i < renderTargets.size(); ++i)
+  {
+    render::textureDestroy(context, &renderTargets[i]);
+  }
+
+  for (u32 i(0); i < mipViews.size(); ++i)
+  {
+    vkDestroyImageView(context.device_, mipViews[i], nullptr);
+  }
+
   render::descriptorSetLayoutDestroy(context, &descriptorSetLayout);
   render::pipelineLayoutDestroy(context, &pipelineLayout);
   render::renderPassDestroy(context, &renderPass);
@@ -2739,74 +3575,39 @@ void render::textureCubemapCreateFromEquirectangularImage(const context_t& conte
   render::descriptorSetDestroy(context, &descriptorSet);
   render::commandBufferDestroy(context, &commandBuffer);
   render::descriptorPoolDestroy(context, &descriptorPool);
+  render::gpuBufferDestroy(context, nullptr, &ubo);
   mesh::destroy(context, &cube);
 }
 
-void render::diffuseConvolution(const context_t& context, texture_t environmentMap, uint32_t size, texture_t* irradiance)
+void render::textureCubemapCreateFromEquirectangularImage(const context_t& context, const image::image2D_t& image, uint32_t size, bool generateMipmaps, texture_t* cubemap)
 {
-  mesh::mesh_t cube = mesh::unitCube(context);
-
-  render::textureCubemapCreate(context, VK_FORMAT_R32G32B32A32_SFLOAT, size, size, 1u, render::texture_sampler_t(), irradiance);
-  //Change cubemap layout for transfer
-  VkImageSubresourceRange subresourceRange = {};
-  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  subresourceRange.baseMipLevel = 0;
-  subresourceRange.levelCount = 1;
-  subresourceRange.layerCount = 6;
-  render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, irradiance);
-
-  //Create descriptor pool
-  render::descriptor_pool_t descriptorPool;
-  render::descriptorPoolCreate(context, 1u,
-    render::combined_image_sampler_count(1u),
-    render::uniform_buffer_count(0u),
-    render::storage_buffer_count(0u),
-    render::storage_image_count(0u),
-    &descriptorPool);
-
-  //Create pipeline
-  render::graphics_pipeline_t pipeline;
-  render::pipeline_layout_t pipelineLayout;
-  render::descriptor_set_layout_t descriptorSetLayout;
-  render::descriptor_binding_t bindings = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, VK_SHADER_STAGE_FRAGMENT_BIT };
-  render::descriptorSetLayoutCreate(context, &bindings, 1u, &descriptorSetLayout);
-
-  render::push_constant_range_t pushConstantsRange = { VK_SHADER_STAGE_VERTEX_BIT, sizeof(maths::mat4), 0u };
-  render::pipelineLayoutCreate(context, &descriptorSetLayout, 1u, &pushConstantsRange, 1u, &pipelineLayout);
-
-  render::render_pass_t renderPass = {};
-  render::render_pass_t::attachment_t attachments = { VK_FORMAT_R32G32B32A32_SFLOAT, VK_SAMPLE_COUNT_1_BIT,
-    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-    VK_ATTACHMENT_STORE_OP_STORE,VK_ATTACHMENT_LOAD_OP_CLEAR };
-  render::renderPassCreate(context, &attachments, 1u, nullptr, 0u, nullptr, 0u, &renderPass);
+  u32 mipLevels = generateMipmaps ? u32(1 + floor(log2(size))) : 1u;
 
-  //Create render target and framebuffer
-  render::texture_t renderTarget;
-  render::frame_buffer_t frameBuffer = {};
-  render::texture2DCreate(context, size, size, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, render::texture_sampler_t(), &renderTarget);
-  render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &renderTarget);
-  render::frameBufferCreate(context, size, size, renderPass, &renderTarget.imageView_, &frameBuffer);
+  render::texture_t texture;
+  render::texture2DCreate(context, &image, 1, render::texture_sampler_t(), &texture);
+  render::textureCubemapCreate(context, VK_FORMAT_R32G32B32A32_SFLOAT, size, size, mipLevels, render::texture_sampler_t(), cubemap);
 
-  //Load shaders
-  render::shader_t vertexShader;
-  const char* vsSource = R"(  
-                                #version 440 core
-                                layout(push_constant) uniform PushConstants
-                                {
-	                                layout (offset = 0) mat4 viewProjection;
-                                }pushConstants;  
-                                layout(location = 0) in vec3 aPosition;
-                                layout(location = 0) out vec3 localPos;
+  const char* fsSource = R"(  
+                                layout(location = 0) in vec3 localPos;
+                                layout (set = 0, binding = 0) uniform sampler2D uTexture;
+                                layout(location = 0) out vec4 color;
+                                const vec2 invAtan = vec2(0.1591, 0.3183);
                                 void main(void)
                                 {
-                                  localPos = aPosition;
-                                  gl_Position = pushConstants.viewProjection * vec4(aPosition,1.0);
+                                  vec3 direction = normalize( localPos );
+                                  vec2 uv = vec2( atan(direction.z, direction.x), asin(direction.y) ) * invAtan + 0.5;
+                                  color = texture( uTexture, uv );
                                 })";
-  render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, vsSource, &vertexShader);
+  RenderCubemapFaces(context, fsSource, texture, cubemap);
+
+  render::textureDestroy(context, &texture);
+}
+
+void render::diffuseConvolution(const context_t& context, texture_t environmentMap, uint32_t size, texture_t* irradiance)
+{
+  render::textureCubemapCreate(context, VK_FORMAT_R32G32B32A32_SFLOAT, size, size, 1u, render::texture_sampler_t(), irradiance);
 
-  render::shader_t fragmentShader;
   const char* fsSource = R"(  
-                                #version 440 core
                                 layout(location = 0) in vec3 localPos;
                                 layout (set = 0, binding = 0) uniform samplerCube uTexture;
                                 layout(location = 0) out vec4 color;
@@ -2839,159 +3640,16 @@ void render::diffuseConvolution(const context_t& context, texture_t environmentM
                                   irradiance = PI * irradiance * (1.0 / float(nrSamples));                                  
                                   color = vec4(irradiance,1.0);
                                 })";
-  render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, fsSource, &fragmentShader);
-
-  render::graphics_pipeline_t::description_t pipelineDesc = {};
-  pipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)size, (float)size, 0.0f, 1.0f };
-  pipelineDesc.scissorRect_ = { { 0,0 },{ size, size } };
-  pipelineDesc.blendState_.resize(1);
-  pipelineDesc.blendState_[0].colorWriteMask = 0xF;
-  pipelineDesc.blendState_[0].blendEnable = VK_FALSE;
-  pipelineDesc.cullMode_ = VK_CULL_MODE_FRONT_BIT;
-  pipelineDesc.depthTestEnabled_ = false;
-  pipelineDesc.depthWriteEnabled_ = false;
-  pipelineDesc.vertexShader_ = vertexShader;
-  pipelineDesc.fragmentShader_ = fragmentShader;
-  render::graphicsPipelineCreate(context, renderPass.handle_, 0u, cube.vertexFormat_, pipelineLayout, pipelineDesc, &pipeline);
-
-  //Create descriptor set
-  render::descriptor_t texture = render::getDescriptor(environmentMap);
-  render::descriptor_set_t descriptorSet;
-  render::descriptorSetCreate(context, descriptorPool, descriptorSetLayout, &texture, &descriptorSet);
-
-  //Create command buffer
-  VkClearValue clearValue;
-  clearValue.color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-  render::command_buffer_t commandBuffer = {};
-  render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, render::command_buffer_t::GRAPHICS, &commandBuffer);
-
-  maths::mat4 projection = maths::perspectiveProjectionMatrix(1.57f, 1.0f, 0.1f, 1.0f);
-  maths::mat4 view[6] = { maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(1.0f, 0.0f, 0.0f),  maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(-1.0f, 0.0f, 0.0f), maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 1.0f, 0.0f),  maths::vec3(0.0f, 0.0f, 1.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, -1.0f, 0.0f), maths::vec3(0.0f, 0.0f,-1.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 0.0f, -1.0f), maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 0.0f, 1.0f),  maths::vec3(0.0f, 1.0f, 0.0f)) };
-
-  for (u32 i(0); i<6; ++i)
-  {
-    maths::mat4 viewProjection = view[i] * projection;
-    render::commandBufferBegin(context, commandBuffer);
-    render::commandBufferRenderPassBegin(context, &frameBuffer, &clearValue, 1u, commandBuffer);
-
-    render::pushConstants(commandBuffer, pipelineLayout, 0u, &viewProjection);
-    render::graphicsPipelineBind(commandBuffer, pipeline);
-    render::descriptorSetBind(commandBuffer, pipelineLayout, 0, &descriptorSet, 1u);
-    mesh::draw(commandBuffer, cube);
-    render::commandBufferRenderPassEnd(commandBuffer);
-
-    //Copy render target to cubemap layer
-    renderTarget.layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
-    render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, &renderTarget);
-    render::textureCopy(commandBuffer, &renderTarget, irradiance, size, size, 0, i);
-    render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &renderTarget);
-
-    
-    render::commandBufferEnd(commandBuffer);
-    render::commandBufferSubmit(context, commandBuffer);
-  }
-
-  //Change cubemap layout for shader access
-  render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, irradiance);
-
-  //Clean-up
-  render::descriptorSetLayoutDestroy(context, &descriptorSetLayout);
-  render::pipelineLayoutDestroy(context, &pipelineLayout);
-  render::renderPassDestroy(context, &renderPass);
-  render::textureDestroy(context, &renderTarget);
-  render::frameBufferDestroy(context, &frameBuffer);
-  render::shaderDestroy(context, &vertexShader);
-  render::shaderDestroy(context, &fragmentShader);
-  render::graphicsPipelineDestroy(context, &pipeline);
-  render::descriptorSetDestroy(context, &descriptorSet);
-  render::commandBufferDestroy(context, &commandBuffer);
-  render::descriptorPoolDestroy(context, &descriptorPool);
-  mesh::destroy(context, &cube);
+  RenderCubemapFaces(context, fsSource, environmentMap, irradiance);
 }
 
 void render::specularConvolution(const context_t& context, texture_t environmentMap, uint32_t size, uint32_t maxMipmapLevels, texture_t* specularMap)
 {
-  mesh::mesh_t cube = mesh::unitCube(context);
-
   u32 mipLevels = maths::minValue((u32)(1 + floor(log2(size))), maxMipmapLevels);
   render::textureCubemapCreate(context, VK_FORMAT_R32G32B32A32_SFLOAT, size, size, mipLevels, render::texture_sampler_t(), specularMap);
-  //Change cubemap layout for transfer
-  VkImageSubresourceRange subresourceRange = {};
-  subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  subresourceRange.baseMipLevel = 0;
-  subresourceRange.levelCount = mipLevels;
-  subresourceRange.layerCount = 6;
-  render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, specularMap);
-
-  //Create descriptor pool
-  render::descriptor_pool_t descriptorPool;
-  render::descriptorPoolCreate(context, 1u,
-    render::combined_image_sampler_count(1u),
-    render::uniform_buffer_count(0u),
-    render::storage_buffer_count(0u),
-    render::storage_image_count(0u),
-    &descriptorPool);
 
-  //Create pipeline
-  render::graphics_pipeline_t pipeline;
-  render::pipeline_layout_t pipelineLayout;
-  render::descriptor_set_layout_t descriptorSetLayout;
-  render::descriptor_binding_t bindings = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, VK_SHADER_STAGE_FRAGMENT_BIT };
-  render::descriptorSetLayoutCreate(context, &bindings, 1u, &descriptorSetLayout);
-
-  struct push_constants_t
-  {
-    maths::mat4 viewProjection_;
-    float roughness_;
-    float sourceCubemapResolution_;
-  }pushConstants;
-
-  pushConstants.sourceCubemapResolution_ = (float)environmentMap.extent_.width;
-
-  render::push_constant_range_t pushConstantsRange = { VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(pushConstants), 0u };
-  render::pipelineLayoutCreate(context, &descriptorSetLayout, 1u, &pushConstantsRange, 1u, &pipelineLayout);
-
-  render::render_pass_t::attachment_t attachments = { VK_FORMAT_R32G32B32A32_SFLOAT, VK_SAMPLE_COUNT_1_BIT,
-    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
-    VK_ATTACHMENT_STORE_OP_STORE,VK_ATTACHMENT_LOAD_OP_CLEAR };
-  render::render_pass_t renderPass = {};
-  render::renderPassCreate(context, &attachments, 1u, nullptr, 0u, nullptr, 0u, &renderPass);
-
-  //Load shaders
-  render::shader_t vertexShader;
-  const char* vsSource = R"(  
-                                #version 440 core
-                                layout(push_constant) uniform PushConstants
-                                {
-	                                layout (offset = 0) mat4 viewProjection;
-                                  layout (offset = 64) float roughness;
-                                  layout (offset = 68) float sourceCubemapResolution;
-                                }pushConstants;
-                                layout(location = 0) in vec3 aPosition;
-                                layout(location = 0) out vec3 localPos;
-                                void main(void)
-                                {
-                                  localPos = aPosition;
-                                  gl_Position = pushConstants.viewProjection * vec4(aPosition,1.0);
-                                })";
-  render::shaderCreateFromGLSLSource(context, render::shader_t::VERTEX_SHADER, vsSource, &vertexShader);
-
-  render::shader_t fragmentShader;
+  //Roughness of each mip level and resolution of the environment map are in the push constants declared by RenderCubemapFaces
   const char* fsSource = R"(  
-                                #version 440 core
-                                layout(push_constant) uniform PushConstants
-                                {
-	                                layout (offset = 0) mat4 viewProjection;
-                                  layout (offset = 64) float roughness;
-                                  layout (offset = 68) float sourceCubemapResolution;
-                                }pushConstants;
-
                                 layout(location = 0) in vec3 localPos;
                                 layout (set = 0, binding = 0) uniform samplerCube uTexture;
                                 layout(location = 0) out vec4 color;
@@ -3084,100 +3742,10 @@ void render::specularConvolution(const context_t& context, texture_t environment
                                     color = vec4(prefilteredColor, 1.0);
                                 }
                           )";
-  render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, fsSource, &fragmentShader);
-
-  render::graphics_pipeline_t::description_t pipelineDesc = {};
-  pipelineDesc.viewPort_ = { 0.0f, 0.0f, (float)size, (float)size, 0.0f, 1.0f };
-  pipelineDesc.scissorRect_ = { { 0,0 },{ size, size } };
-  pipelineDesc.blendState_.resize(1);
-  pipelineDesc.blendState_[0].colorWriteMask = 0xF;
-  pipelineDesc.blendState_[0].blendEnable = VK_FALSE;
-  pipelineDesc.cullMode_ = VK_CULL_MODE_FRONT_BIT;
-  pipelineDesc.depthTestEnabled_ = false;
-  pipelineDesc.depthWriteEnabled_ = false;
-  pipelineDesc.vertexShader_ = vertexShader;
-  pipelineDesc.fragmentShader_ = fragmentShader;
-  render::graphicsPipelineCreate(context, renderPass.handle_, 0u, cube.vertexFormat_, pipelineLayout, pipelineDesc, &pipeline);
-
-  //Create descriptor set
-  render::descriptor_t texture = render::getDescriptor(environmentMap);
-  render::descriptor_set_t descriptorSet;
-  render::descriptorSetCreate(context, descriptorPool, descriptorSetLayout, &texture, &descriptorSet);
-
-  //Create command buffer
-  VkClearValue clearValue;
-  clearValue.color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-
-  render::command_buffer_t commandBuffer = {};
-  render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, render::command_buffer_t::GRAPHICS, &commandBuffer);
-
-  maths::mat4 projection = maths::perspectiveProjectionMatrix(1.57f, 1.0f, 0.1f, 1.0f);
-  maths::mat4 view[6] = { maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(1.0f, 0.0f, 0.0f),  maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(-1.0f, 0.0f, 0.0f), maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 1.0f, 0.0f),  maths::vec3(0.0f, 0.0f, 1.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, -1.0f, 0.0f), maths::vec3(0.0f, 0.0f,-1.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 0.0f, -1.0f), maths::vec3(0.0f, 1.0f, 0.0f)),
-                          maths::lookAtMatrix(maths::vec3(0.0f, 0.0f, 0.0f), maths::vec3(0.0f, 0.0f, 1.0f),  maths::vec3(0.0f, 1.0f, 0.0f)) };
-
-  std::vector<render::frame_buffer_t> frameBuffers(mipLevels);
-  std::vector<render::texture_t> renderTargets(mipLevels);
-  u32 mipSize = size;
-  for (u32 mipLevel = 0; mipLevel < mipLevels; ++mipLevel)
-  {
-    //Create render target and framebuffer
-    frameBuffers[mipLevel] = {};
-    render::texture2DCreate(context, mipSize, mipSize, 1u, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, render::texture_sampler_t(), &renderTargets[mipLevel]);
-    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &renderTargets[mipLevel]);
-    render::frameBufferCreate(context, mipSize, mipSize, renderPass, &renderTargets[mipLevel].imageView_, &frameBuffers[mipLevel]);
-
-    pushConstants.roughness_ = (float)mipLevel / (float)(mipLevels - 1);
-    for (u32 i(0); i < 6; ++i)
-    {
-      pushConstants.viewProjection_ = view[i] * projection;
-
-      render::commandBufferBegin(context, commandBuffer);
-      render::commandBufferRenderPassBegin(context, &frameBuffers[mipLevel], &clearValue, 1u, commandBuffer);
-      render::pushConstants(commandBuffer, pipelineLayout, 0u, &pushConstants);
-      render::graphicsPipelineBind(commandBuffer, pipeline);
-      render::descriptorSetBind(commandBuffer, pipelineLayout, 0, &descriptorSet, 1u);
-      mesh::draw(commandBuffer, cube);
-      render::commandBufferRenderPassEnd(commandBuffer);
-
-      //Copy render target to cubemap layer
-      renderTargets[mipLevel].layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
-      render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, &renderTargets[mipLevel]);
-      render::textureCopy(commandBuffer, &renderTargets[mipLevel], specularMap, mipSize, mipSize, mipLevel, i);      
-      render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &renderTargets[mipLevel]);
-      
-      render::commandBufferEnd(commandBuffer);
-      render::commandBufferSubmit(context, commandBuffer);
-    }
-    mipSize /= 2;
-  }
-
-  //Change cubemap layout for shader access
-  render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, subresourceRange, specularMap);
-
-  //Clean-up
-  for (u32 i(0); i < mipLevels; ++i)
-  {
-    render::textureDestroy(context, &renderTargets[i]);
-    render::frameBufferDestroy(context, &frameBuffers[i]);
-  }
-
-  render::descriptorSetLayoutDestroy(context, &descriptorSetLayout);
-  render::pipelineLayoutDestroy(context, &pipelineLayout);
-  render::renderPassDestroy(context, &renderPass);
-
-  render::shaderDestroy(context, &vertexShader);
-  render::shaderDestroy(context, &fragmentShader);
-  render::graphicsPipelineDestroy(context, &pipeline);
-  render::descriptorSetDestroy(context, &descriptorSet);
-  render::commandBufferDestroy(context, &commandBuffer);
-  render::descriptorPoolDestroy(context, &descriptorPool);
-  mesh::destroy(context, &cube);
+  RenderCubemapFaces(context, fsSource, environmentMap, specularMap);
 }
 
+
 void render::waitForAllCommandBuffersToFinish(const context_t& context)
 {
   //Create command buffer
@@ -3565,3 +4133,22 @@ void render::texture2DCreateAndGenerateMipmaps(const context_t& context, const i
   render::descriptorPoolDestroy(context, &descriptorPool);
   mesh::destroy(context, &quad);
 }
+
+void render::statsGet(render_stats_t* stats)
+{
+  *stats = gStats;
+}
+
+void render::statsReset()
+{
+  VkDeviceSize gpuMemory = gStats.gpuMemory_;
+  gStats = {};
+  gStats.gpuMemory_ = gpuMemory;
+  gStats.gpuMemoryPeak_ = gpuMemory;
+}
+
+void render::statsAddDraws(const command_buffer_t& commandBuffer, uint32_t drawCount)
+{
+  if (commandBuffer.recordedStats_)
+    commandBuffer.recordedStats_->drawCount_ += drawCount;
+}
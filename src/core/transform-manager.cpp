@@ -23,6 +23,7 @@
 */
 
 #include "core/transform-manager.h"
+#include "core/cpu-profiler.h"
 #include <algorithm>
 
 using namespace bkk::core;
@@ -160,6 +161,8 @@ void transform_manager_t::sortTransforms()
 
 void transform_manager_t::update()
 {
+  BKK_ZONE("transform_manager_t::update");
+
   //Reorder transforms if hierarchy has changed since last update
   if( hierarchy_changed_ )
   {
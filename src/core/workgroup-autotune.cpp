@@ -0,0 +1,310 @@
+/*
+* Brokkr framework
+*
+* Copyright(c) 2017 by Ferran Sole
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "core/workgroup-autotune.h"
+#include "core/render.h"
+#include "core/gpu-profiler.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace bkk::core;
+using namespace bkk::core::render;
+
+struct workgroup_cache_entry_t
+{
+  uint32_t vendorId_;
+  uint32_t deviceId_;
+  uint32_t driverVersion_;
+  std::string name_;
+  uint32_t problemSize_[3];   //Log2 of the invocation count in each dimension, rounded up
+  uint32_t workGroupSize_[3];
+};
+
+static std::string gCacheFile = "workgroup-sizes.cache";
+static std::vector<workgroup_cache_entry_t> gCache;
+static bool gCacheLoaded = false;
+
+static const uint32_t gBenchmarkIterations = 8u;
+
+static const uint32_t gCandidates1D[][3] = { { 32,1,1 },{ 64,1,1 },{ 128,1,1 },{ 256,1,1 },{ 512,1,1 },{ 1024,1,1 } };
+static const uint32_t gCandidates2D[][3] = { { 8,4,1 },{ 8,8,1 },{ 16,8,1 },{ 8,16,1 },{ 16,16,1 },{ 32,8,1 },{ 32,16,1 },{ 32,32,1 } };
+static const uint32_t gCandidates3D[][3] = { { 4,4,4 },{ 8,4,4 },{ 8,8,4 },{ 8,8,8 } };
+
+static uint32_t log2RoundUp(uint32_t value)
+{
+  uint32_t result = 0u;
+  while ((1u << result) < value && result < 31u)
+    ++result;
+
+  return result;
+}
+
+static void cacheLoad()
+{
+  gCacheLoaded = true;
+  gCache.clear();
+
+  FILE* fp = fopen(gCacheFile.c_str(), "r");
+  if (!fp)
+    return;
+
+  char name[256];
+  workgroup_cache_entry_t entry = {};
+  while (fscanf(fp, "%u %u %u %255s %u %u %u %u %u %u",
+    &entry.vendorId_, &entry.deviceId_, &entry.driverVersion_, name,
+    &entry.problemSize_[0], &entry.problemSize_[1], &entry.problemSize_[2],
+    &entry.workGroupSize_[0], &entry.workGroupSize_[1], &entry.workGroupSize_[2]) == 10)
+  {
+    entry.name_ = name;
+    gCache.push_back(entry);
+  }
+
+  fclose(fp);
+}
+
+static void cacheSave()
+{
+  FILE* fp = fopen(gCacheFile.c_str(), "w");
+  if (!fp)
+    return;
+
+  for (uint32_t i(0); i < gCache.size(); ++i)
+  {
+    const workgroup_cache_entry_t& entry = gCache[i];
+    fprintf(fp, "%u %u %u %s %u %u %u %u %u %u\n",
+      entry.vendorId_, entry.deviceId_, entry.driverVersion_, entry.name_.c_str(),
+      entry.problemSize_[0], entry.problemSize_[1], entry.problemSize_[2],
+      entry.workGroupSize_[0], entry.workGroupSize_[1], entry.workGroupSize_[2]);
+  }
+
+  fclose(fp);
+}
+
+static const workgroup_cache_entry_t* cacheFind(const workgroup_cache_entry_t& key)
+{
+  for (uint32_t i(0); i < gCache.size(); ++i)
+  {
+    const workgroup_cache_entry_t& entry = gCache[i];
+    if (entry.vendorId_ == key.vendorId_ && entry.deviceId_ == key.deviceId_ && entry.driverVersion_ == key.driverVersion_ &&
+      entry.name_ == key.name_ &&
+      entry.problemSize_[0] == key.problemSize_[0] && entry.problemSize_[1] == key.problemSize_[1] && entry.problemSize_[2] == key.problemSize_[2])
+    {
+      return &entry;
+    }
+  }
+
+  return nullptr;
+}
+
+static void pipelineCreate(const context_t& context, const pipeline_layout_t& layout, const shader_t& computeShader,
+                           const specialization_constants_t& specialization, const uint32_t* workGroupSize, compute_pipeline_t* pipeline)
+{
+  specialization_constants_t constants = specialization;
+  specializationConstantSet(0u, workGroupSize[0], &constants);
+  specializationConstantSet(1u, workGroupSize[1], &constants);
+  specializationConstantSet(2u, workGroupSize[2], &constants);
+  computePipelineCreate(context, layout, computeShader, constants, pipeline);
+}
+
+static void computeToComputeBarrier(command_buffer_t commandBuffer)
+{
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer.handle_,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+    1u, &barrier, 0u, nullptr, 0u, nullptr);
+}
+
+//Returns the average GPU time of a dispatch in milliseconds, or a negative value if the profiler could not read it.
+//Each candidate is a frame of the profiler with a single marker
+static double benchmark(const context_t& context, const compute_kernel_t& kernel, const pipeline_layout_t& layout,
+                        descriptor_set_t* descriptorSets, uint32_t descriptorSetCount, gpu_profiler_t* profiler,
+                        uint32_t invocationCountX, uint32_t invocationCountY, uint32_t invocationCountZ)
+{
+  gpuProfilerBeginFrame(context, profiler);
+
+  command_buffer_t commandBuffer = {};
+  commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, command_buffer_t::GRAPHICS, &commandBuffer);
+  commandBufferBegin(context, commandBuffer);
+  gpuProfilerResetQueries(commandBuffer, profiler);
+  computePipelineBind(commandBuffer, kernel.pipeline_);
+  if (descriptorSetCount > 0u)
+    descriptorSetBind(commandBuffer, layout, 0u, descriptorSets, descriptorSetCount);
+
+  //Warm-up
+  computeDispatch(commandBuffer, kernel, invocationCountX, invocationCountY, invocationCountZ);
+  computeToComputeBarrier(commandBuffer);
+
+  gpuProfilerBeginMarker(commandBuffer, "Work group size", false, profiler);
+  for (uint32_t i(0); i < gBenchmarkIterations; ++i)
+  {
+    computeDispatch(commandBuffer, kernel, invocationCountX, invocationCountY, invocationCountZ);
+    computeToComputeBarrier(commandBuffer);
+  }
+  gpuProfilerEndMarker(commandBuffer, profiler);
+  commandBufferEnd(commandBuffer);
+
+  commandBufferSubmit(context, commandBuffer);
+  vkWaitForFences(context.device_, 1u, &commandBuffer.fence_, VK_TRUE, UINT64_MAX);
+  commandBufferDestroy(context, &commandBuffer);
+
+  //The profiler has a single frame so beginning the next one reads the results of this one
+  gpuProfilerEndFrame(profiler);
+  if (!gpuProfilerBeginFrame(context, profiler))
+    return -1.0;
+
+  return (double)profiler->frameTime_ / gBenchmarkIterations;
+}
+
+void render::workGroupSizeCacheSetFile(const char* file)
+{
+  gCacheFile = file;
+  gCacheLoaded = false;
+}
+
+void render::computeKernelCreate(const context_t& context, const pipeline_layout_t& layout, const shader_t& computeShader,
+                                 const specialization_constants_t& specialization, const char* name,
+                                 uint32_t invocationCountX, uint32_t invocationCountY, uint32_t invocationCountZ,
+                                 descriptor_set_t* descriptorSets, uint32_t descriptorSetCount,
+                                 compute_kernel_t* kernel)
+{
+  assert(name != nullptr && strchr(name, ' ') == nullptr);
+  assert(invocationCountX > 0u && invocationCountY > 0u && invocationCountZ > 0u);
+
+  if (!gCacheLoaded)
+    cacheLoad();
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(context.physicalDevice_, &properties);
+
+  workgroup_cache_entry_t key = {};
+  key.vendorId_ = properties.vendorID;
+  key.deviceId_ = properties.deviceID;
+  key.driverVersion_ = properties.driverVersion;
+  key.name_ = name;
+  key.problemSize_[0] = log2RoundUp(invocationCountX);
+  key.problemSize_[1] = log2RoundUp(invocationCountY);
+  key.problemSize_[2] = log2RoundUp(invocationCountZ);
+
+  const workgroup_cache_entry_t* cached = cacheFind(key);
+  if (cached)
+  {
+    memcpy(kernel->workGroupSize_, cached->workGroupSize_, sizeof(kernel->workGroupSize_));
+    pipelineCreate(context, layout, computeShader, specialization, kernel->workGroupSize_, &kernel->pipeline_);
+    return;
+  }
+
+  //Candidates supported by the device
+  const uint32_t(*candidates)[3] = gCandidates1D;
+  uint32_t candidateCount = sizeof(gCandidates1D) / sizeof(gCandidates1D[0]);
+  if (invocationCountZ > 1u)
+  {
+    candidates = gCandidates3D;
+    candidateCount = sizeof(gCandidates3D) / sizeof(gCandidates3D[0]);
+  }
+  else if (invocationCountY > 1u)
+  {
+    candidates = gCandidates2D;
+    candidateCount = sizeof(gCandidates2D) / sizeof(gCandidates2D[0]);
+  }
+
+  std::vector<const uint32_t*> supportedCandidates;
+  const VkPhysicalDeviceLimits& limits = properties.limits;
+  for (uint32_t i(0); i < candidateCount; ++i)
+  {
+    const uint32_t* size = candidates[i];
+    if (size[0] <= limits.maxComputeWorkGroupSize[0] && size[1] <= limits.maxComputeWorkGroupSize[1] && size[2] <= limits.maxComputeWorkGroupSize[2] &&
+      size[0] * size[1] * size[2] <= limits.maxComputeWorkGroupInvocations)
+    {
+      supportedCandidates.push_back(size);
+    }
+  }
+  assert(!supportedCandidates.empty());
+
+  //Default to the first candidate with at least 64 invocations if the graphics queue can't write timestamps
+  uint32_t best = 0u;
+  for (uint32_t i(0); i < supportedCandidates.size(); ++i)
+  {
+    best = i;
+    if (supportedCandidates[i][0] * supportedCandidates[i][1] * supportedCandidates[i][2] >= 64u)
+      break;
+  }
+
+  gpu_profiler_t profiler;
+  gpuProfilerCreate(context, 1u, 1u, &profiler);
+  if (profiler.timestampPool_ != VK_NULL_HANDLE && supportedCandidates.size() > 1u)
+  {
+    bool benchmarked = false;
+    double bestTime = 0.0;
+    for (uint32_t i(0); i < supportedCandidates.size(); ++i)
+    {
+      compute_kernel_t candidate = {};
+      memcpy(candidate.workGroupSize_, supportedCandidates[i], sizeof(candidate.workGroupSize_));
+      pipelineCreate(context, layout, computeShader, specialization, candidate.workGroupSize_, &candidate.pipeline_);
+
+      double time = benchmark(context, candidate, layout, descriptorSets, descriptorSetCount, &profiler,
+        invocationCountX, invocationCountY, invocationCountZ);
+
+      computePipelineDestroy(context, &candidate.pipeline_);
+
+      if (time >= 0.0 && (!benchmarked || time < bestTime))
+      {
+        best = i;
+        bestTime = time;
+        benchmarked = true;
+      }
+    }
+
+    //Only benchmarked results are persisted
+    if (benchmarked)
+    {
+      memcpy(key.workGroupSize_, supportedCandidates[best], sizeof(key.workGroupSize_));
+      gCache.push_back(key);
+      cacheSave();
+    }
+  }
+  gpuProfilerDestroy(context, &profiler);
+
+  memcpy(kernel->workGroupSize_, supportedCandidates[best], sizeof(kernel->workGroupSize_));
+  pipelineCreate(context, layout, computeShader, specialization, kernel->workGroupSize_, &kernel->pipeline_);
+}
+
+void render::computeKernelDestroy(const context_t& context, compute_kernel_t* kernel)
+{
+  computePipelineDestroy(context, &kernel->pipeline_);
+}
+
+void render::computeDispatch(command_buffer_t commandBuffer, const compute_kernel_t& kernel, uint32_t invocationCountX, uint32_t invocationCountY, uint32_t invocationCountZ)
+{
+  computeDispatch(commandBuffer,
+    (invocationCountX + kernel.workGroupSize_[0] - 1) / kernel.workGroupSize_[0],
+    (invocationCountY + kernel.workGroupSize_[1] - 1) / kernel.workGroupSize_[1],
+    (invocationCountZ + kernel.workGroupSize_[2] - 1) / kernel.workGroupSize_[2]);
+}
@@ -11,23 +11,26 @@ actor_t::actor_t()
   :name_(),
   mesh_(core::NULL_HANDLE),
   transform_(core::NULL_HANDLE),
-  material_(core::NULL_HANDLE)
+  material_(core::NULL_HANDLE),
+  occluder_(core::NULL_HANDLE),
+  allocator_(nullptr)
 {
 }
 
 actor_t::actor_t(const char* name, mesh_handle_t mesh, transform_handle_t transform, material_handle_t material, renderer_t* renderer)
-  :name_(name), mesh_(mesh), transform_(transform), material_(material)
+  :name_(name), mesh_(mesh), transform_(transform), material_(material), occluder_(core::NULL_HANDLE),
+  allocator_(renderer->getActorAllocator())
 {
   core::render::context_t& context = renderer->getContext();
 
   core::render::gpuBufferCreate(context,
     core::render::gpu_buffer_t::usage::UNIFORM_BUFFER,
     nullptr, sizeof(core::maths::mat4),
-    nullptr, &uniformBuffer_);
+    allocator_, &uniformBuffer_);
 
   render::descriptor_t descriptor = render::getDescriptor(uniformBuffer_);
   render::descriptorSetCreate(context, 
-                              renderer->getDescriptorPool(), renderer->getObjectDescriptorSetLayout(), 
+                              renderer->getActorDescriptorPool(), renderer->getObjectDescriptorSetLayout(), 
                               &descriptor, &descriptorSet_);
 }
 
@@ -35,7 +38,7 @@ void actor_t::destroy(renderer_t* renderer)
 {
   render::context_t& context = renderer->getContext();
   render::descriptorSetDestroy(context, &descriptorSet_);
-  render::gpuBufferDestroy(context, nullptr, &uniformBuffer_);
+  render::gpuBufferDestroy(context, allocator_, &uniformBuffer_);
 }
 
 mesh_handle_t actor_t::getMesh() {
@@ -25,10 +25,20 @@
 #include "framework/application.h"
 #include "framework/gui.h"
 
+#include "core/cpu-profiler.h"
+#include "core/image.h"
 #include "core/maths.h"
 #include "core/window.h"
 #include "core/render.h"
 #include "core/timer.h"
+#include "core/gpu-profiler.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef WIN32
+#include <psapi.h>
+#endif
 
 
 using namespace bkk;
@@ -75,18 +85,239 @@ struct application_t::frame_counter_t
   float timeAccum_ = 0.0f;
 };
 
-application_t::application_t(const char* title, u32 width, u32 height, u32 imageCount)
-:timeDelta_(0),
+//Peak resident memory of the process, in bytes
+static uint64_t getProcessMemoryPeak()
+{
+#ifdef WIN32
+  PROCESS_MEMORY_COUNTERS counters = {};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.PeakWorkingSetSize;
+#else
+  FILE* file = fopen("/proc/self/status", "r");
+  if (file)
+  {
+    char line[256];
+    unsigned long long kb = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+      if (sscanf(line, "VmHWM: %llu kB", &kb) == 1)
+        break;
+    }
+    fclose(file);
+    return kb * 1024u;
+  }
+#endif
+  return 0u;
+}
+
+//Mean and percentiles of the frame times
+static void writeTimings(FILE* file, const char* name, std::vector<float> times)
+{
+  float mean = 0.0f;
+  float percentiles[3] = {};
+  if (!times.empty())
+  {
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for (uint32_t i(0); i < times.size(); ++i)
+      sum += times[i];
+
+    mean = float(sum / times.size());
+    const float p[3] = { 0.5f, 0.95f, 0.99f };
+    for (uint32_t i(0); i < 3; ++i)
+      percentiles[i] = times[(size_t)(p[i] * (times.size() - 1) + 0.5f)];
+  }
+
+  fprintf(file, "  \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f },\n", name, mean, percentiles[0], percentiles[1], percentiles[2]);
+}
+
+//Measurements of a benchmark run. The first frame is left out of the frame times and statistics (It is part of the startup time).
+//The GPU time of a frame goes from a timestamp written before render() to one written after it, so it includes the time
+//the GPU waits for the CPU between the submissions of the frame
+struct application_t::benchmark_t
+{
+  void init(core::render::context_t& context)
+  {
+    core::render::gpuProfilerCreate(context, context.swapChain_.imageCount_ + 1u, 1u, &gpuProfiler_);
+    core::render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, core::render::command_buffer_t::GRAPHICS, &frameBegin_);
+    core::render::commandBufferCreate(context, VK_COMMAND_BUFFER_LEVEL_PRIMARY, nullptr, nullptr, 0u, nullptr, 0u, core::render::command_buffer_t::GRAPHICS, &frameEnd_);
+    startupTime_ = 0.0f;
+  }
+
+  void destroy(core::render::context_t& context)
+  {
+    core::render::commandBufferDestroy(context, &frameBegin_);
+    core::render::commandBufferDestroy(context, &frameEnd_);
+    core::render::gpuProfilerDestroy(context, &gpuProfiler_);
+  }
+
+  void readGpuTime(core::render::context_t& context)
+  {
+    //Results read when the profiler begins frame N belong to frame N - frames in flight
+    if (core::render::gpuProfilerBeginFrame(context, &gpuProfiler_) && gpuProfiler_.frame_ > gpuProfiler_.frames_.size())
+      gpuTime_.push_back(gpuProfiler_.frameTime_);
+  }
+
+  void beginFrame(core::render::context_t& context)
+  {
+    readGpuTime(context);
+    core::render::commandBufferBegin(context, frameBegin_);
+    core::render::gpuProfilerResetQueries(frameBegin_, &gpuProfiler_);
+    core::render::gpuProfilerBeginMarker(frameBegin_, "Frame", false, &gpuProfiler_);
+    core::render::commandBufferEnd(frameBegin_);
+    core::render::commandBufferSubmit(context, frameBegin_);
+  }
+
+  void endFrame(core::render::context_t& context, uint32_t frame, float cpuTime, float timeSinceStart)
+  {
+    core::render::commandBufferBegin(context, frameEnd_);
+    core::render::gpuProfilerEndMarker(frameEnd_, &gpuProfiler_);
+    core::render::commandBufferEnd(frameEnd_);
+    core::render::commandBufferSubmit(context, frameEnd_);
+    core::render::gpuProfilerEndFrame(&gpuProfiler_);
+
+    if (frame == 0u)
+    {
+      startupTime_ = timeSinceStart;
+      core::render::statsReset();
+    }
+    else
+    {
+      cpuTime_.push_back(cpuTime);
+    }
+  }
+
+  //Reads the GPU times of the frames still in flight. The device must be idle
+  void finish(core::render::context_t& context)
+  {
+    for (uint32_t i(0); i < gpuProfiler_.frames_.size(); ++i)
+    {
+      readGpuTime(context);
+      core::render::gpuProfilerEndFrame(&gpuProfiler_);
+    }
+  }
+
+  bool write(const char* fileName, const char* name, uint32_t seed)
+  {
+    FILE* file = fopen(fileName, "w");
+    if (!file)
+      return false;
+
+    core::render::render_stats_t stats;
+    core::render::statsGet(&stats);
+
+    //Statistics are per frame. Submissions of the benchmark itself are not counted
+    uint32_t frames = core::maths::maxValue(1u, (uint32_t)cpuTime_.size());
+    uint64_t benchmarkSubmits = 2u * cpuTime_.size();
+    uint64_t submitCount = stats.submitCount_ > benchmarkSubmits ? stats.submitCount_ - benchmarkSubmits : 0u;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"name\": \"%s\",\n", name);
+    fprintf(file, "  \"frames\": %u,\n", (uint32_t)cpuTime_.size());
+    fprintf(file, "  \"seed\": %u,\n", seed);
+    fprintf(file, "  \"startupTime\": %.4f,\n", startupTime_);
+    writeTimings(file, "cpuFrameTime", cpuTime_);
+    writeTimings(file, "gpuFrameTime", gpuTime_);
+    fprintf(file, "  \"gpuMemoryPeak\": %llu,\n", (unsigned long long)stats.gpuMemoryPeak_);
+    fprintf(file, "  \"processMemoryPeak\": %llu,\n", (unsigned long long)getProcessMemoryPeak());
+    fprintf(file, "  \"drawCount\": %.2f,\n", stats.drawCount_ / (double)frames);
+    fprintf(file, "  \"dispatchCount\": %.2f,\n", stats.dispatchCount_ / (double)frames);
+    fprintf(file, "  \"pipelineBindCount\": %.2f,\n", stats.pipelineBindCount_ / (double)frames);
+    fprintf(file, "  \"descriptorSetBindCount\": %.2f,\n", stats.descriptorSetBindCount_ / (double)frames);
+    fprintf(file, "  \"submitCount\": %.2f\n", submitCount / (double)frames);
+    fprintf(file, "}\n");
+    fclose(file);
+    return true;
+  }
+
+  core::render::gpu_profiler_t gpuProfiler_;
+  core::render::command_buffer_t frameBegin_;
+  core::render::command_buffer_t frameEnd_;
+  std::vector<float> cpuTime_;  //Milliseconds
+  std::vector<float> gpuTime_;
+  float startupTime_;           //Milliseconds from the creation of the application to the end of the first frame
+};
+
+//Options given in the command line, used by all the applications created afterwards
+struct command_line_t
+{
+  uint32_t headlessFrames_ = 0u;
+  float timeStep_ = 0.0f;
+  const char* output_ = nullptr;
+  const char* bench_ = nullptr;
+  uint32_t seed_ = 1u;
+};
+
+static command_line_t gCommandLine;
+
+void application_t::parseCommandLine(int argc, char** argv)
+{
+  for (int i(1); i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+    {
+      gCommandLine.headlessFrames_ = (uint32_t)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--timestep") == 0 && i + 1 < argc)
+    {
+      gCommandLine.timeStep_ = (float)atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+    {
+      gCommandLine.output_ = argv[++i];
+    }
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+    {
+      gCommandLine.seed_ = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+    {
+      gCommandLine.bench_ = argv[++i];
+    }
+  }
+}
+
+application_t::application_t(const char* title, u32 width, u32 height, u32 imageCount, core::render::hdr_format_e hdrFormat)
+:headless_(gCommandLine.headlessFrames_ > 0u),
+ frameCount_(gCommandLine.headlessFrames_),
+ fixedTimeStep_(gCommandLine.timeStep_),
+ outputFile_(gCommandLine.output_),
+ seed_(gCommandLine.seed_),
+ startTime_(core::timer::getCurrent()),
+ timeDelta_(0),
  mouseCurrentPos_(0.0f,0.0f),
  mousePrevPos_(0.0f,0.0f),
- mouseButtonPressed_(-1)
+ mouseButtonPressed_(-1),
+ frameCounter_(nullptr),
+ benchmark_(nullptr)
 {
-  core::window::create(title, width, height, &window_);
+  core::profiler::setThreadName("Main thread");
+  srand(seed_);
+  if (headless_)
+  {
+    //No window. Only its size and title are used
+    window_.width_ = width;
+    window_.height_ = height;
+    strncpy(window_.title_, title, sizeof(window_.title_) - 1);
+    window_.title_[sizeof(window_.title_) - 1] = '\0';
+    renderer_.initializeHeadless(title, imageCount, width, height, hdrFormat);
 
-  renderer_.initialize(title, imageCount, window_);
+    if (fixedTimeStep_ == 0.0f)
+      fixedTimeStep_ = 16.6f;
 
-  frameCounter_ = new frame_counter_t();
-  frameCounter_->init(&window_);
+    if (gCommandLine.bench_)
+    {
+      benchmark_ = new benchmark_t();
+      benchmark_->init(renderer_.getContext());
+    }
+  }
+  else
+  {
+    core::window::create(title, width, height, &window_);
+    renderer_.initialize(title, imageCount, window_, hdrFormat);
+
+    frameCounter_ = new frame_counter_t();
+    frameCounter_->init(&window_);
+  }
   timeDelta_ = 0.0f;
 
   framework::gui::init(renderer_.getContext());
@@ -94,8 +325,11 @@ application_t::application_t(const char* title, u32 width, u32 height, u32 image
 
 application_t::~application_t()
 {  
-  core::window::destroy(&window_);
+  if (!headless_)
+    core::window::destroy(&window_);
+
   delete frameCounter_;
+  delete benchmark_;
 }
 
 void application_t::loop()
@@ -103,14 +337,16 @@ void application_t::loop()
   core::timer::time_point_t timePrev = core::timer::getCurrent();
   core::timer::time_point_t currentTime = timePrev;
 
+  uint32_t frame = 0u;
   bool quit = false;
   while (!quit)
   {
+    core::profiler::frameMark();
     currentTime = core::timer::getCurrent();
-    timeDelta_ = core::timer::getDifference(timePrev, currentTime);
+    timeDelta_ = fixedTimeStep_ > 0.0f ? fixedTimeStep_ : core::timer::getDifference(timePrev, currentTime);
 
     core::window::event_t* event = nullptr;
-    while ((event = core::window::getNextEvent(&window_)))
+    while (!headless_ && (event = core::window::getNextEvent(&window_)))
     {
       switch (event->type_)
       {
@@ -164,21 +400,93 @@ void application_t::loop()
       }
     }
 
-    framework::gui::beginFrame(renderer_.getContext());
-    buildGuiFrame();
-    framework::gui::endFrame();
+    if (benchmark_)
+    {
+      scriptedInput(frame);
+      benchmark_->beginFrame(renderer_.getContext());
+    }
+
+    {
+      BKK_ZONE("application_t::buildGuiFrame");
+      framework::gui::beginFrame(renderer_.getContext());
+      buildGuiFrame();
+      framework::gui::endFrame();
+    }
+
+    {
+      BKK_ZONE("application_t::render");
+      render();
+    }
+
+    if (benchmark_)
+    {
+      core::timer::time_point_t frameEnd = core::timer::getCurrent();
+      benchmark_->endFrame(renderer_.getContext(), frame, core::timer::getDifference(currentTime, frameEnd), core::timer::getDifference(startTime_, frameEnd));
+    }
 
-    render();
+    if (frameCounter_)
+      frameCounter_->endFrame();
 
-    frameCounter_->endFrame();
     timePrev = currentTime;
+
+    if (headless_ && ++frame == frameCount_)
+    {
+      if (outputFile_)
+        saveFrame(outputFile_);
+
+      quit = true;
+    }
   }
 
   core::render::contextFlush(renderer_.getContext());
+  if (benchmark_)
+  {
+    benchmark_->finish(renderer_.getContext());
+    if (!benchmark_->write(gCommandLine.bench_, window_.title_, seed_))
+      fprintf(stderr, "Unable to write the benchmark results to %s\n", gCommandLine.bench_);
+
+    benchmark_->destroy(renderer_.getContext());
+  }
+
   framework::gui::destroy(renderer_.getContext());
   onQuit();
 }
 
+void application_t::saveFrame(const char* file)
+{
+  core::image::image2D_t image = {};
+  if (!core::render::presentationImageRead(renderer_.getContext(), &image) || !core::image::save(file, image))
+  {
+    fprintf(stderr, "Unable to save the frame to %s\n", file);
+  }
+
+  core::image::unload(&image);
+}
+
+//Camera path of the benchmarks. The right mouse button is held during the whole run while the mouse orbits the camera, and
+//the camera moves forward during the first half of the run and back during the second half
+void application_t::scriptedInput(uint32_t frame)
+{
+  if (frame == 0u)
+  {
+    mouseButtonPressed_ = core::window::MOUSE_RIGHT;
+    onMouseButton(core::window::MOUSE_RIGHT, true, mouseCurrentPos_, mousePrevPos_);
+  }
+
+  float t = frame / (float)frameCount_;
+  core::maths::vec2 delta(4.0f, 2.0f * sinf(2.0f * (float)PI * t));
+  mousePrevPos_ = mouseCurrentPos_;
+  mouseCurrentPos_ = mouseCurrentPos_ + delta;
+  onMouseMove(mouseCurrentPos_, delta);
+
+  if (frame % 4u == 0u)
+  {
+    u32 key = t < 0.5f ? 'w' : 's';
+    onKeyEvent(key, true);
+    onKeyEvent(key, false);
+  }
+}
+
 void application_t::beginFrame()
 {
   renderer_.update();
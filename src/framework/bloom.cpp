@@ -0,0 +1,379 @@
+#include "framework/bloom.h"
+#include "framework/renderer.h"
+
+#include <string>
+
+using namespace bkk::core;
+using namespace bkk::framework;
+
+static const char* gBloomDownsampleShaderSource = R"(
+  #version 440 core
+  layout (local_size_x = 16, local_size_y = 16) in;
+
+  layout(set = 0, binding = 0) uniform sampler2D uSource;
+  layout(set = 0, binding = 1, rgba16f) uniform writeonly image2D uLevel0;
+  layout(set = 0, binding = 2, rgba16f) uniform writeonly image2D uLevel1;
+  layout(set = 0, binding = 3, rgba16f) uniform writeonly image2D uLevel2;
+  layout(set = 0, binding = 4, rgba16f) uniform writeonly image2D uLevel3;
+  layout(set = 0, binding = 5, rgba16f) uniform writeonly image2D uLevel4;
+  layout(set = 0, binding = 6, rgba16f) uniform writeonly image2D uLevel5;
+
+  layout(push_constant) uniform PUSH_CONSTANTS
+  {
+    uvec2 srcSize;
+    uvec2 dstSize;  //Size of level 0
+    vec2 direction;
+    float threshold;
+    float weight;
+  }pushConstants;
+
+  const uint LEVEL_COUNT = 6u;
+  shared vec3 sTexels[16][16];
+
+  vec3 brightPixel(ivec2 pixel)
+  {
+    vec3 color = texelFetch(uSource, min(pixel, ivec2(pushConstants.srcSize) - 1), 0).rgb;
+    return dot(color, vec3(0.2126, 0.7152, 0.0722)) > pushConstants.threshold ? color : vec3(0.0);
+  }
+
+  void writeLevel(uint level, ivec2 texel, vec3 color)
+  {
+    uvec2 levelSize = max(pushConstants.dstSize >> level, uvec2(1u));
+    if (any(greaterThanEqual(uvec2(texel), levelSize)))
+      return;
+
+    vec4 value = vec4(color, 1.0);
+    switch (level)
+    {
+      case 0u: imageStore(uLevel0, texel, value); break;
+      case 1u: imageStore(uLevel1, texel, value); break;
+      case 2u: imageStore(uLevel2, texel, value); break;
+      case 3u: imageStore(uLevel3, texel, value); break;
+      case 4u: imageStore(uLevel4, texel, value); break;
+      case 5u: imageStore(uLevel5, texel, value); break;
+    }
+  }
+
+  //Each workgroup covers 64x64 source pixels: 32x32 texels of level 0 down to a single texel of level 5
+  void main()
+  {
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    ivec2 group = ivec2(gl_WorkGroupID.xy);
+
+    //Every invocation writes 2x2 texels of level 0 and one of level 1
+    vec3 color = vec3(0.0);
+    for (int i = 0; i < 4; ++i)
+    {
+      ivec2 texel = group * 32 + local * 2 + ivec2(i & 1, i >> 1);
+      ivec2 pixel = texel * 2;
+      vec3 level0 = 0.25 * (brightPixel(pixel) + brightPixel(pixel + ivec2(1, 0)) +
+                            brightPixel(pixel + ivec2(0, 1)) + brightPixel(pixel + ivec2(1, 1)));
+      writeLevel(0u, texel, level0);
+      color += 0.25 * level0;
+    }
+
+    writeLevel(1u, group * 16 + local, color);
+    sTexels[local.y][local.x] = color;
+
+    //Remaining levels reduce the previous one in shared memory
+    for (uint level = 2u; level < LEVEL_COUNT; ++level)
+    {
+      barrier();
+      int size = 32 >> level;
+      bool active = all(lessThan(local, ivec2(size)));
+      if (active)
+      {
+        ivec2 src = local * 2;
+        color = 0.25 * (sTexels[src.y][src.x] + sTexels[src.y][src.x + 1] +
+                        sTexels[src.y + 1][src.x] + sTexels[src.y + 1][src.x + 1]);
+        writeLevel(level, group * size + local, color);
+      }
+
+      barrier();
+      if (active)
+        sTexels[local.y][local.x] = color;
+    }
+  }
+)";
+
+static const char* gBloomFilterCommonGlsl = R"(
+  #version 440 core
+  layout (local_size_x = 8, local_size_y = 8) in;
+
+  layout(set = 0, binding = 0) uniform sampler2D uSource;
+  layout(set = 0, binding = 1, rgba16f) uniform image2D uDestination;
+
+  layout(push_constant) uniform PUSH_CONSTANTS
+  {
+    uvec2 srcSize;
+    uvec2 dstSize;
+    vec2 direction;
+    float threshold;
+    float weight;
+  }pushConstants;
+)";
+
+static const char* gBloomBlurShaderSource = R"(
+  const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+
+  void main()
+  {
+    if (any(greaterThanEqual(gl_GlobalInvocationID.xy, pushConstants.dstSize)))
+      return;
+
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 direction = ivec2(pushConstants.direction);
+    ivec2 maxTexel = ivec2(pushConstants.srcSize) - 1;
+    vec3 color = texelFetch(uSource, texel, 0).rgb * weights[0];
+    for (int i = 1; i < 5; ++i)
+    {
+      color += texelFetch(uSource, clamp(texel + direction * i, ivec2(0), maxTexel), 0).rgb * weights[i];
+      color += texelFetch(uSource, clamp(texel - direction * i, ivec2(0), maxTexel), 0).rgb * weights[i];
+    }
+
+    imageStore(uDestination, texel, vec4(color, 1.0));
+  }
+)";
+
+static const char* gBloomUpsampleShaderSource = R"(
+  void main()
+  {
+    if (any(greaterThanEqual(gl_GlobalInvocationID.xy, pushConstants.dstSize)))
+      return;
+
+    //3x3 tent filter over the lower level, clamped to its rendered region
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    vec2 sourceSize = vec2(textureSize(uSource, 0));
+    vec2 position = (vec2(texel) + 0.5) * 0.5;
+    vec2 maxPosition = vec2(pushConstants.srcSize) - 0.5;
+    vec3 color = vec3(0.0);
+    for (int y = -1; y <= 1; ++y)
+    {
+      for (int x = -1; x <= 1; ++x)
+      {
+        float weight = (2.0 - abs(float(x))) * (2.0 - abs(float(y))) / 16.0;
+        vec2 uv = clamp(position + vec2(x, y), vec2(0.5), maxPosition) / sourceSize;
+        color += textureLod(uSource, uv, 0.0).rgb * weight;
+      }
+    }
+
+    color += imageLoad(uDestination, texel).rgb;
+    imageStore(uDestination, texel, vec4(color * pushConstants.weight, 1.0));
+  }
+)";
+
+static void memoryBarrier(render::command_buffer_t commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+  VkMemoryBarrier memoryBarrier = {};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memoryBarrier.srcAccessMask = srcAccess;
+  memoryBarrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer.handle_, srcStage, dstStage, 0, 1u, &memoryBarrier, 0u, nullptr, 0u, nullptr);
+}
+
+static maths::uvec2 levelSize(const maths::uvec2& size, uint32_t level)
+{
+  return maths::uvec2(maths::maxValue(1u, size.x >> (level + 1u)), maths::maxValue(1u, size.y >> (level + 1u)));
+}
+
+bloom_t::bloom_t()
+:threshold_(1.0f),
+ width_(0u),
+ height_(0u),
+ memoryUsage_(0u),
+ levels_(),
+ blurTemp_(),
+ downsampleDescriptorSetLayout_(),
+ filterDescriptorSetLayout_(),
+ downsamplePipelineLayout_(),
+ filterPipelineLayout_(),
+ downsampleDescriptorSet_(),
+ blurHorizontalDescriptorSets_(),
+ blurVerticalDescriptorSets_(),
+ upsampleDescriptorSets_(),
+ downsampleShader_(),
+ blurShader_(),
+ upsampleShader_(),
+ downsamplePipeline_(),
+ blurPipeline_(),
+ upsamplePipeline_(),
+ pushConstants_()
+{
+}
+
+void bloom_t::initialize(renderer_t* renderer, render_target_handle_t source)
+{
+  render::context_t& context = renderer->getContext();
+  render_target_t* sourceTarget = renderer->getRenderTarget(source);
+  width_ = sourceTarget->getWidth();
+  height_ = sourceTarget->getHeight();
+
+  //Half precision is enough for bloom and, unlike the packed HDR formats, supports storage
+  render::texture_sampler_t sampler;
+  sampler.wrapU_ = sampler.wrapV_ = render::texture_sampler_t::wrap_mode::CLAMP_TO_EDGE;
+  const VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  maths::uvec2 size(width_, height_);
+  memoryUsage_ = 0u;
+  for (uint32_t i(0); i < LEVEL_COUNT; ++i)
+  {
+    maths::uvec2 textureSize = levelSize(size, i);
+    render::texture2DCreate(context, textureSize.x, textureSize.y, 1u, VK_FORMAT_R16G16B16A16_SFLOAT, usage, sampler, &levels_[i]);
+    render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_GENERAL, &levels_[i]);
+    memoryUsage_ += textureSize.x * textureSize.y * 8u;
+  }
+
+  maths::uvec2 tempSize = levelSize(size, 1u);
+  render::texture2DCreate(context, tempSize.x, tempSize.y, 1u, VK_FORMAT_R16G16B16A16_SFLOAT, usage, sampler, &blurTemp_);
+  render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_GENERAL, &blurTemp_);
+  memoryUsage_ += tempSize.x * tempSize.y * 8u;
+
+  //Layouts
+  render::descriptor_binding_t downsampleBindings[LEVEL_COUNT + 1];
+  downsampleBindings[0] = { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, render::descriptor_t::stage::COMPUTE };
+  for (uint32_t i(0); i < LEVEL_COUNT; ++i)
+    downsampleBindings[i + 1] = { render::descriptor_t::type::STORAGE_IMAGE, i + 1, render::descriptor_t::stage::COMPUTE };
+  render::descriptorSetLayoutCreate(context, downsampleBindings, LEVEL_COUNT + 1, &downsampleDescriptorSetLayout_);
+
+  render::descriptor_binding_t filterBindings[2] = {
+    { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 0, render::descriptor_t::stage::COMPUTE },
+    { render::descriptor_t::type::STORAGE_IMAGE, 1, render::descriptor_t::stage::COMPUTE }
+  };
+  render::descriptorSetLayoutCreate(context, filterBindings, 2u, &filterDescriptorSetLayout_);
+
+  render::push_constant_range_t pushConstantRange = { render::descriptor_t::stage::COMPUTE, sizeof(push_constants_t), 0u };
+  render::pipelineLayoutCreate(context, &downsampleDescriptorSetLayout_, 1u, &pushConstantRange, 1u, &downsamplePipelineLayout_);
+  render::pipelineLayoutCreate(context, &filterDescriptorSetLayout_, 1u, &pushConstantRange, 1u, &filterPipelineLayout_);
+
+  //Descriptor sets. Sources never change so they are all created upfront
+  render::descriptor_t downsampleDescriptors[LEVEL_COUNT + 1];
+  downsampleDescriptors[0] = render::getDescriptor(sourceTarget->getColorBuffer());
+  for (uint32_t i(0); i < LEVEL_COUNT; ++i)
+    downsampleDescriptors[i + 1] = render::getDescriptor(levels_[i]);
+  render::descriptorSetCreate(context, renderer->getDescriptorPool(), downsampleDescriptorSetLayout_, downsampleDescriptors, &downsampleDescriptorSet_);
+
+  for (uint32_t i(1); i < LEVEL_COUNT; ++i)
+  {
+    render::descriptor_t descriptors[2] = { render::getDescriptor(levels_[i]), render::getDescriptor(blurTemp_) };
+    render::descriptorSetCreate(context, renderer->getDescriptorPool(), filterDescriptorSetLayout_, descriptors, &blurHorizontalDescriptorSets_[i]);
+
+    descriptors[0] = render::getDescriptor(blurTemp_);
+    descriptors[1] = render::getDescriptor(levels_[i]);
+    render::descriptorSetCreate(context, renderer->getDescriptorPool(), filterDescriptorSetLayout_, descriptors, &blurVerticalDescriptorSets_[i]);
+
+    descriptors[0] = render::getDescriptor(levels_[i]);
+    descriptors[1] = render::getDescriptor(levels_[i - 1]);
+    render::descriptorSetCreate(context, renderer->getDescriptorPool(), filterDescriptorSetLayout_, descriptors, &upsampleDescriptorSets_[i - 1]);
+  }
+
+  //Pipelines
+  render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, gBloomDownsampleShaderSource, &downsampleShader_);
+  render::computePipelineCreate(context, downsamplePipelineLayout_, downsampleShader_, &downsamplePipeline_);
+
+  std::string code = std::string(gBloomFilterCommonGlsl) + gBloomBlurShaderSource;
+  render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, code.c_str(), &blurShader_);
+  render::computePipelineCreate(context, filterPipelineLayout_, blurShader_, &blurPipeline_);
+
+  code = std::string(gBloomFilterCommonGlsl) + gBloomUpsampleShaderSource;
+  render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, code.c_str(), &upsampleShader_);
+  render::computePipelineCreate(context, filterPipelineLayout_, upsampleShader_, &upsamplePipeline_);
+}
+
+void bloom_t::destroy(renderer_t* renderer)
+{
+  render::context_t& context = renderer->getContext();
+  if (downsamplePipeline_.handle_ == VK_NULL_HANDLE)
+    return;
+
+  render::descriptorSetDestroy(context, &downsampleDescriptorSet_);
+  for (uint32_t i(1); i < LEVEL_COUNT; ++i)
+  {
+    render::descriptorSetDestroy(context, &blurHorizontalDescriptorSets_[i]);
+    render::descriptorSetDestroy(context, &blurVerticalDescriptorSets_[i]);
+    render::descriptorSetDestroy(context, &upsampleDescriptorSets_[i - 1]);
+  }
+
+  render::computePipelineDestroy(context, &downsamplePipeline_);
+  render::computePipelineDestroy(context, &blurPipeline_);
+  render::computePipelineDestroy(context, &upsamplePipeline_);
+  render::shaderDestroy(context, &downsampleShader_);
+  render::shaderDestroy(context, &blurShader_);
+  render::shaderDestroy(context, &upsampleShader_);
+  render::pipelineLayoutDestroy(context, &downsamplePipelineLayout_);
+  render::pipelineLayoutDestroy(context, &filterPipelineLayout_);
+  render::descriptorSetLayoutDestroy(context, &downsampleDescriptorSetLayout_);
+  render::descriptorSetLayoutDestroy(context, &filterDescriptorSetLayout_);
+
+  for (uint32_t i(0); i < LEVEL_COUNT; ++i)
+    render::textureDestroy(context, &levels_[i]);
+
+  render::textureDestroy(context, &blurTemp_);
+}
+
+void bloom_t::dispatch(render::command_buffer_t commandBuffer, const render::compute_pipeline_t& pipeline, const render::pipeline_layout_t& layout,
+                       render::descriptor_set_t* descriptorSet, uint32_t width, uint32_t height, uint32_t groupSize)
+{
+  render::computePipelineBind(commandBuffer, pipeline);
+  render::descriptorSetBind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0u, descriptorSet, 1u);
+  render::pushConstants(commandBuffer, layout, 0u, &pushConstants_);
+  render::computeDispatch(commandBuffer, (width + groupSize - 1u) / groupSize, (height + groupSize - 1u) / groupSize, 1u);
+
+  memoryBarrier(commandBuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void bloom_t::execute(render::command_buffer_t commandBuffer, renderer_t* renderer)
+{
+  //Only the region rendered this frame
+  float scale = renderer->getDynamicResolution()->getScale();
+  maths::uvec2 size(maths::maxValue(1u, (uint32_t)(width_ * scale)), maths::maxValue(1u, (uint32_t)(height_ * scale)));
+  maths::uvec2 sizes[LEVEL_COUNT];
+  for (uint32_t i(0); i < LEVEL_COUNT; ++i)
+    sizes[i] = levelSize(size, i);
+
+  //Textures may still be in use by the previous frame
+  memoryBarrier(commandBuffer,
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  pushConstants_ = {};
+  pushConstants_.threshold_ = threshold_;
+  pushConstants_.weight_ = 1.0f;
+
+  //Bright pixels and the whole chain in a single dispatch
+  pushConstants_.srcSize_[0] = size.x;
+  pushConstants_.srcSize_[1] = size.y;
+  pushConstants_.dstSize_[0] = sizes[0].x;
+  pushConstants_.dstSize_[1] = sizes[0].y;
+  dispatch(commandBuffer, downsamplePipeline_, downsamplePipelineLayout_, &downsampleDescriptorSet_, sizes[0].x, sizes[0].y, 32u);
+
+  //Separable blur of the lower levels
+  for (uint32_t i(1); i < LEVEL_COUNT; ++i)
+  {
+    pushConstants_.srcSize_[0] = pushConstants_.dstSize_[0] = sizes[i].x;
+    pushConstants_.srcSize_[1] = pushConstants_.dstSize_[1] = sizes[i].y;
+
+    pushConstants_.direction_[0] = 1.0f;
+    pushConstants_.direction_[1] = 0.0f;
+    dispatch(commandBuffer, blurPipeline_, filterPipelineLayout_, &blurHorizontalDescriptorSets_[i], sizes[i].x, sizes[i].y, 8u);
+
+    pushConstants_.direction_[0] = 0.0f;
+    pushConstants_.direction_[1] = 1.0f;
+    dispatch(commandBuffer, blurPipeline_, filterPipelineLayout_, &blurVerticalDescriptorSets_[i], sizes[i].x, sizes[i].y, 8u);
+  }
+
+  //Upsample and accumulate. Level 0 ends up with the average of all the levels
+  for (int32_t i(LEVEL_COUNT - 2); i >= 0; --i)
+  {
+    pushConstants_.srcSize_[0] = sizes[i + 1].x;
+    pushConstants_.srcSize_[1] = sizes[i + 1].y;
+    pushConstants_.dstSize_[0] = sizes[i].x;
+    pushConstants_.dstSize_[1] = sizes[i].y;
+    pushConstants_.weight_ = i == 0 ? 1.0f / LEVEL_COUNT : 1.0f;
+    dispatch(commandBuffer, upsamplePipeline_, filterPipelineLayout_, &upsampleDescriptorSets_[i], sizes[i].x, sizes[i].y, 8u);
+  }
+
+  memoryBarrier(commandBuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
@@ -22,6 +22,7 @@
 * SOFTWARE.
 */
 
+#include "core/cpu-profiler.h"
 #include "core/maths.h"
 #include "core/packed-freelist.h"
 
@@ -45,6 +46,8 @@ farPlane_(farPlane)
 
 void camera_t::update(renderer_t* renderer)
 {
+  BKK_ZONE("camera_t::update");
+
   if (projection_ == camera_t::PERSPECTIVE_PROJECTION)
   {
     uniforms_.projection_ = maths::perspectiveProjectionMatrix(fov_, aspect_, nearPlane_, farPlane_);
@@ -58,6 +61,11 @@ void camera_t::update(renderer_t* renderer)
   maths::invertMatrix(uniforms_.viewToWorld_, uniforms_.worldToView_);
 
   render::context_t& context = renderer->getContext();
+  float width = (float)context.swapChain_.imageWidth_;
+  float height = (float)context.swapChain_.imageHeight_;
+  float scale = renderer->getDynamicResolution()->getScale();
+  uniforms_.imageSize_ = maths::vec4(width, height, 1.0f / width, 1.0f / height);
+  uniforms_.resolutionScale_ = maths::vec4(scale, scale, 0.0f, 0.0f);
   if (uniformBuffer_.handle_ == VK_NULL_HANDLE)
   {
     //Create buffer
@@ -65,8 +73,14 @@ void camera_t::update(renderer_t* renderer)
       (void*)&uniforms_, sizeof(uniforms_),
       nullptr, &uniformBuffer_);
 
-    render::descriptor_t descriptor = render::getDescriptor(uniformBuffer_);
-    render::descriptorSetCreate(context, renderer->getDescriptorPool(), renderer->getGlobalsDescriptorSetLayout(), &descriptor, &descriptorSet_);
+    light_manager_t* lightManager = renderer->getLightManager();
+    render::descriptor_t descriptors[4] = {
+      render::getDescriptor(uniformBuffer_),
+      render::getDescriptor(lightManager->getLightBuffer()),
+      render::getDescriptor(lightManager->getClusterBuffer()),
+      render::getDescriptor(lightManager->getLightIndexBuffer())
+    };
+    render::descriptorSetCreate(context, renderer->getDescriptorPool(), renderer->getGlobalsDescriptorSetLayout(), descriptors, &descriptorSet_);
   }
   else
   {
@@ -76,8 +90,10 @@ void camera_t::update(renderer_t* renderer)
   }
 }
 
-void camera_t::cull(actor_t* actors, uint32_t actorCount)
+void camera_t::cull(renderer_t* renderer, actor_t* actors, uint32_t actorCount)
 {
+  BKK_ZONE("camera_t::cull");
+
   if (visibleActors_ != nullptr)
   {
     delete[] visibleActors_;
@@ -85,10 +101,42 @@ void camera_t::cull(actor_t* actors, uint32_t actorCount)
 
   visibleActorsCount_ = 0u;
   visibleActors_ = new actor_t[actorCount];
+  if (!occlusionCulling_)
+  {
+    for (uint32_t i = 0; i < actorCount; ++i)
+    {
+      visibleActors_[i] = actors[i];
+      visibleActorsCount_++;
+    }
+
+    return;
+  }
+
+  if (occlusionBuffer_.depth_.empty())
+  {
+    occlusion::depthBufferCreate(256u, 128u, &occlusionBuffer_);
+  }
+
+  occlusion::begin(uniforms_.worldToView_ * uniforms_.projection_, &occlusionBuffer_);
+  for (uint32_t i = 0; i < actorCount; ++i)
+  {
+    occlusion::occluder_t* occluder = renderer->getOccluder(actors[i].occluder_);
+    if (occluder)
+    {
+      occlusion::addOccluder(*occluder, *renderer->getWorldTransform(actors[i].transform_), &occlusionBuffer_);
+    }
+  }
+
+  occlusion::rasterize(&occlusionBuffer_);
+
   for (uint32_t i = 0; i < actorCount; ++i)
   {
-    visibleActors_[i] = actors[i];
-    visibleActorsCount_++;
+    //Actors without a mesh are never drawn, but they are kept so users of the list still find them
+    mesh::mesh_t* mesh = renderer->getMesh(actors[i].mesh_);
+    if (!mesh || occlusion::isVisible(mesh->aabb_.min_, mesh->aabb_.max_, *renderer->getWorldTransform(actors[i].transform_), occlusionBuffer_))
+    {
+      visibleActors_[visibleActorsCount_++] = actors[i];
+    }
   }
 }
 
@@ -1,4 +1,5 @@
 
+#include "core/cpu-profiler.h"
 #include "core/mesh.h"
 
 #include "framework/command-buffer.h"
@@ -62,16 +63,24 @@ void command_buffer_t::clearRenderTargets(core::maths::vec4 color)
   clearColor_ = color;
 }
 
-void command_buffer_t::beginCommandBuffer()
+void command_buffer_t::beginCommandBuffer(const char* marker)
 {  
-  frame_buffer_t* frameBuffer = renderer_->getFrameBuffer(frameBuffer_);
+  render::commandBufferBegin(renderer_->getContext(), commandBuffer_);
+
+  //Every command buffer is a marker in the GPU profiler. Queries are reset by the first one recorded in the frame
+  render::gpu_profiler_t* profiler = renderer_->getGpuProfiler();
+  render::gpuProfilerResetQueries(commandBuffer_, profiler);
+  render::gpuProfilerBeginMarker(commandBuffer_, marker, true, profiler);
+}
 
+void command_buffer_t::beginRenderPass(bool clear)
+{
+  frame_buffer_t* frameBuffer = renderer_->getFrameBuffer(frameBuffer_);
   render::context_t& context = renderer_->getContext();
-  render::commandBufferBegin(context, commandBuffer_);
     
   VkClearValue* clearValues = nullptr;
   uint32_t clearValuesCount = 0u;
-  if (clear_)
+  if (clear)
   {
     clearValuesCount = frameBuffer->getTargetCount() + 1;
     clearValues = new VkClearValue[clearValuesCount];
@@ -85,15 +94,66 @@ void command_buffer_t::beginCommandBuffer()
   
   if (clearValues)
     delete[] clearValues;
+
+  //Offscreen passes only render the scaled sub-rectangle of the targets
+  dynamic_resolution_t* dynamicResolution = renderer_->getDynamicResolution();
+  if (frameBuffer_ != renderer_->getBackBuffer() && dynamicResolution->getScale() < 1.0f)
+  {
+    float scale = dynamicResolution->getScale();
+    uint32_t width = maths::maxValue(1u, (uint32_t)(frameBuffer->getWidth() * scale));
+    uint32_t height = maths::maxValue(1u, (uint32_t)(frameBuffer->getHeight() * scale));
+    render::setViewport(commandBuffer_, 0, 0, width, height);
+    render::setScissor(commandBuffer_, 0, 0, width, height);
+  }
+}
+
+void command_buffer_t::endCommandBuffer()
+{
+  render::commandBufferRenderPassEnd(commandBuffer_);
+  render::gpuProfilerEndMarker(commandBuffer_, renderer_->getGpuProfiler());
+  render::commandBufferEnd(commandBuffer_);
 }
 
 void command_buffer_t::render(actor_t* actors, uint32_t actorCount, const char* passName)
 {
-  camera_t* camera = renderer_->getActiveCamera();
+  BKK_ZONE("command_buffer_t::render");
 
-  beginCommandBuffer();
-  
-  
+  occlusion_culling_t* occlusionCulling = renderer_->getOcclusionCulling();
+  bool depthPrepass = occlusionCulling->isDepthPrepassEnabled(frameBuffer_);
+
+  beginCommandBuffer(passName);
+  if (!occlusionCulling->isOcclusionCullingEnabled(frameBuffer_))
+  {
+    beginRenderPass(clear_);
+    if (depthPrepass)
+      drawActors(actors, actorCount, passName, true);
+
+    drawActors(actors, actorCount, passName, false);
+    endCommandBuffer();
+    return;
+  }
+
+  //First phase. Actors not occluded in the previous frame's Hi-Z (only their depth if there is a pre-pass)
+  occlusionCulling->cullFirstPhase(commandBuffer_, actors, actorCount, renderer_);
+  beginRenderPass(clear_);
+  drawActors(actors, actorCount, passName, depthPrepass, occlusionCulling, occlusion_culling_t::EARLY_DRAWS);
+  render::commandBufferRenderPassEnd(commandBuffer_);
+
+  //Second phase. Actors rejected by the first phase tested against the Hi-Z built from this frame's depth
+  {
+    render::gpu_profiler_scope_t marker(commandBuffer_, "Hi-Z occlusion culling", renderer_->getGpuProfiler());
+    occlusionCulling->buildHiZ(commandBuffer_, renderer_);
+    occlusionCulling->cullSecondPhase(commandBuffer_);
+  }
+  beginRenderPass(false);
+  drawActors(actors, actorCount, passName, false, occlusionCulling, depthPrepass ? occlusion_culling_t::ALL_DRAWS : occlusion_culling_t::LATE_DRAWS);
+  endCommandBuffer();
+}
+
+void command_buffer_t::drawActors(actor_t* actors, uint32_t actorCount, const char* passName, bool depthOnly,
+                                  const occlusion_culling_t* occlusionCulling, occlusion_culling_t::draw_list_e drawList)
+{
+  camera_t* camera = renderer_->getActiveCamera();
   for (uint32_t i = 0; i < actorCount; ++i)
   {
     material_t* material = renderer_->getMaterial(actors[i].getMaterial());
@@ -101,7 +161,8 @@ void command_buffer_t::render(actor_t* actors, uint32_t actorCount, const char*
 
     if (material && mesh )
     {
-      core::render::graphics_pipeline_t pipeline = material->getPipeline(passName, frameBuffer_, renderer_);
+      core::render::graphics_pipeline_t pipeline = depthOnly ? material->getDepthOnlyPipeline(passName, frameBuffer_, renderer_) :
+                                                               material->getPipeline(passName, frameBuffer_, renderer_);
       if (pipeline.handle_ != VK_NULL_HANDLE)
       {
         //TODO: Order objects by material and bind pipeline and camera ubo only once for all objects
@@ -119,24 +180,47 @@ void command_buffer_t::render(actor_t* actors, uint32_t actorCount, const char*
         render::descriptorSetBind(commandBuffer_, pipeline.layout_, 2, &materialDescriptorSet, 1u);
 
         //Draw call
-        core::mesh::draw(commandBuffer_, *mesh);
+        if (occlusionCulling)
+          core::mesh::drawIndirect(commandBuffer_, occlusionCulling->getDrawCommands(), occlusionCulling->getDrawCommandOffset(drawList, i), *mesh);
+        else
+          core::mesh::draw(commandBuffer_, *mesh);
       }
     }
   }
-  
-  render::commandBufferRenderPassEnd(commandBuffer_);
-  render::commandBufferEnd(commandBuffer_);
 }
 
 void command_buffer_t::blit(render_target_handle_t renderTarget, material_handle_t materialHandle, const char* pass)
 {
+  beginCommandBuffer(pass ? pass : "blit");
+  blitPass(renderTarget, materialHandle, pass);
+}
+
+void command_buffer_t::blit(render_target_handle_t renderTarget, bloom_t* bloom, material_handle_t materialHandle, const char* pass)
+{
+  beginCommandBuffer(pass ? pass : "blit");
+  {
+    render::gpu_profiler_scope_t marker(commandBuffer_, "Bloom", renderer_->getGpuProfiler());
+    bloom->execute(commandBuffer_, renderer_);
+  }
+  blitPass(renderTarget, materialHandle, pass);
+}
+
+void command_buffer_t::blitPass(render_target_handle_t renderTarget, material_handle_t materialHandle, const char* pass)
+{
+  BKK_ZONE("command_buffer_t::blit");
+
   material_t* material = renderer_->getTextureBlitMaterial();
   if (materialHandle != NULL_HANDLE)
   {    
     material = renderer_->getMaterial(materialHandle);
   }
 
-  if (!material) return;
+  if (!material)
+  {
+    render::gpuProfilerEndMarker(commandBuffer_, renderer_->getGpuProfiler());
+    render::commandBufferEnd(commandBuffer_);
+    return;
+  }
 
   if (renderTarget != core::NULL_HANDLE)
   {
@@ -156,7 +240,7 @@ void command_buffer_t::blit(render_target_handle_t renderTarget, material_handle
   core::render::graphics_pipeline_t pipeline = material->getPipeline(passName, frameBuffer_, renderer_);  
   render::descriptor_set_t materialDescriptorSet = material->getDescriptorSet(passName);
 
-  beginCommandBuffer();
+  beginRenderPass(clear_);
 
   render::graphicsPipelineBind(commandBuffer_, pipeline);
   render::descriptorSetBind(commandBuffer_, pipeline.layout_, 0, &camera->descriptorSet_, 1u);
@@ -165,12 +249,13 @@ void command_buffer_t::blit(render_target_handle_t renderTarget, material_handle
 
   core::mesh::draw(commandBuffer_, *mesh);
 
-  render::commandBufferRenderPassEnd(commandBuffer_);
-  render::commandBufferEnd(commandBuffer_);
+  endCommandBuffer();
 }
 
 void command_buffer_t::submit()
 {
+  BKK_ZONE("command_buffer_t::submit");
+
   render::context_t& context = renderer_->getContext();  
   render::commandBufferSubmit(context, commandBuffer_);
 }
@@ -0,0 +1,53 @@
+#include "framework/dynamic-resolution.h"
+
+#include "core/maths.h"
+
+using namespace bkk::core;
+using namespace bkk::framework;
+
+dynamic_resolution_t::dynamic_resolution_t()
+:enabled_(false),
+ targetFrameTime_(16.6f),
+ minScale_(0.5f),
+ maxScale_(1.0f),
+ scale_(1.0f),
+ frameTime_(0.0f),
+ kp_(0.1f),
+ ki_(0.25f),
+ kd_(0.05f)
+{
+  error_[0] = error_[1] = 0.0f;
+}
+
+void dynamic_resolution_t::setEnabled(bool enabled)
+{
+  if (enabled && !enabled_)
+  {
+    scale_ = maxScale_;
+    error_[0] = error_[1] = 0.0f;
+  }
+
+  enabled_ = enabled;
+}
+
+void dynamic_resolution_t::setScaleRange(float minScale, float maxScale)
+{
+  minScale_ = maths::clamp(0.1f, 1.0f, minScale);
+  maxScale_ = maths::clamp(minScale_, 1.0f, maxScale);
+  scale_ = maths::clamp(minScale_, maxScale_, scale_);
+}
+
+void dynamic_resolution_t::update(float frameTime)
+{
+  frameTime_ = frameTime_ == 0.0f ? frameTime : 0.9f * frameTime_ + 0.1f * frameTime;
+  if (!enabled_)
+    return;
+
+  //Incremental PID. Positive error means there is headroom to increase the resolution
+  float error = maths::clamp(-1.0f, 1.0f, (targetFrameTime_ - frameTime) / targetFrameTime_);
+  float delta = kp_ * (error - error_[0]) + ki_ * error + kd_ * (error - 2.0f * error_[0] + error_[1]);
+  error_[1] = error_[0];
+  error_[0] = error;
+
+  scale_ = maths::clamp(minScale_, maxScale_, scale_ + delta);
+}
@@ -13,14 +13,18 @@ frame_buffer_t::frame_buffer_t()
  width_(0),
  height_(0),
  targetCount_(0),
+ hasDepthBuffer_(false),
  renderTargets_(nullptr) 
 {  
+  depthBuffer_ = {};
 }
 
 frame_buffer_t::frame_buffer_t(render_target_handle_t* renderTargets, uint32_t targetCount,
   VkImageLayout* initialLayouts, VkImageLayout* finalLayouts, renderer_t* renderer)
 {
   targetCount_ = targetCount;
+  hasDepthBuffer_ = false;
+  depthBuffer_ = {};
   renderTargets_ = new render_target_handle_t[targetCount];
   memcpy(renderTargets_, renderTargets, sizeof(render_target_handle_t)*targetCount);
 
@@ -61,6 +65,8 @@ frame_buffer_t::frame_buffer_t(render_target_handle_t* renderTargets, uint32_t t
 
       subpass.depthStencilAttachmentIndex_ = targetCount;
       imageViews.push_back(depthBuffer.imageView_);
+      hasDepthBuffer_ = true;
+      depthBuffer_ = depthBuffer;
     }
   }
   
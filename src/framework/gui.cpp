@@ -26,6 +26,7 @@
 
 #include "core/maths.h"
 #include "core/image.h"
+#include "core/cpu-profiler.h"
 
 using namespace bkk::core;
 using namespace bkk::framework;
@@ -206,8 +207,10 @@ void gui::endFrame()
 }
 
 
-void gui::draw(const render::context_t& context, render::command_buffer_t commandBuffer)
+void gui::draw(render::context_t& context, render::command_buffer_t commandBuffer)
 {
+  BKK_ZONE("gui::draw");
+
   ImDrawData* draw_data = ImGui::GetDrawData();
   size_t vertex_size = draw_data->TotalVtxCount * sizeof(ImDrawVert);
   size_t index_size = draw_data->TotalIdxCount * sizeof(ImDrawIdx);
@@ -217,18 +220,18 @@ void gui::draw(const render::context_t& context, render::command_buffer_t comman
 
   if(gGuiContext.vertexBuffer_.memory_.size_ < vertex_size)
   {
-    render::contextFlush(context);
+    //The old buffer may still be used by a frame in flight
     if (gGuiContext.vertexBuffer_.handle_ != VK_NULL_HANDLE)
-      render::gpuBufferDestroy(context, nullptr, &gGuiContext.vertexBuffer_);
+      render::gpuBufferDestroyDeferred(&context, nullptr, &gGuiContext.vertexBuffer_);
 
     render::gpuBufferCreate(context, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, nullptr, vertex_size, nullptr, &gGuiContext.vertexBuffer_);
   }
 
   if( gGuiContext.indexBuffer_.memory_.size_ < index_size)
   {
-    render::contextFlush(context);
+    //The old buffer may still be used by a frame in flight
     if (gGuiContext.indexBuffer_.handle_ != VK_NULL_HANDLE)
-      render::gpuBufferDestroy(context, nullptr, &gGuiContext.indexBuffer_);
+      render::gpuBufferDestroyDeferred(&context, nullptr, &gGuiContext.indexBuffer_);
 
     render::gpuBufferCreate(context, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, nullptr, index_size, nullptr, &gGuiContext.indexBuffer_);
   }
@@ -296,6 +299,7 @@ void gui::draw(const render::context_t& context, render::command_buffer_t comman
 
         // Draw
         vkCmdDrawIndexed(commandBuffer.handle_, pcmd->ElemCount, 1, indexOffset, vertexOffset, 0);
+        render::statsAddDraws(commandBuffer, 1u);
       }
       indexOffset += pcmd->ElemCount;
     }
@@ -303,6 +307,103 @@ void gui::draw(const render::context_t& context, render::command_buffer_t comman
   }
 }
 
+void gui::drawGpuProfiler(const render::gpu_profiler_t& profiler)
+{
+  if (!ImGui::Begin("GPU profiler"))
+  {
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Text("Frame: %.3f ms", profiler.frameTime_);
+
+  //Timeline. One row per nesting level
+  const std::vector<render::gpu_profiler_t::marker_t>& markers = profiler.results_;
+  uint32_t rowCount = 1u;
+  for (uint32_t i(0); i < markers.size(); ++i)
+    rowCount = maths::maxValue(rowCount, markers[i].depth_ + 1u);
+
+  const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+  const float width = maths::maxValue(ImGui::GetContentRegionAvailWidth(), 1.0f);
+  const float scale = profiler.frameTime_ > 0.0f ? width / profiler.frameTime_ : 0.0f;
+  ImVec2 origin = ImGui::GetCursorScreenPos();
+  ImGui::InvisibleButton("timeline", ImVec2(width, rowHeight * rowCount));
+  bool hovered = ImGui::IsItemHovered();
+  ImVec2 mousePosition = ImGui::GetIO().MousePos;
+
+  ImDrawList* drawList = ImGui::GetWindowDrawList();
+  for (uint32_t i(0); i < markers.size(); ++i)
+  {
+    ImVec2 min(origin.x + markers[i].begin_ * scale, origin.y + markers[i].depth_ * rowHeight);
+    ImVec2 max(maths::maxValue(origin.x + markers[i].end_ * scale, min.x + 1.0f), min.y + rowHeight - 1.0f);
+    drawList->AddRectFilled(min, max, ImColor::HSV(fmodf(i * 0.17f, 1.0f), 0.6f, 0.7f));
+    drawList->PushClipRect(min, max, true);
+    drawList->AddText(ImVec2(min.x + 2.0f, min.y), 0xFFFFFFFF, markers[i].name_);
+    drawList->PopClipRect();
+
+    if (hovered && mousePosition.x >= min.x && mousePosition.x < max.x && mousePosition.y >= min.y && mousePosition.y < max.y)
+      ImGui::SetTooltip("%s\n%.3f ms", markers[i].name_, markers[i].end_ - markers[i].begin_);
+  }
+
+  //Timings. Markers with the same name are added together
+  ImGui::Columns(6, "timings");
+  ImGui::Separator();
+  ImGui::Text("Marker"); ImGui::NextColumn();
+  ImGui::Text("Last"); ImGui::NextColumn();
+  ImGui::Text("Average"); ImGui::NextColumn();
+  ImGui::Text("P50"); ImGui::NextColumn();
+  ImGui::Text("P95"); ImGui::NextColumn();
+  ImGui::Text("P99"); ImGui::NextColumn();
+  ImGui::Separator();
+  for (uint32_t i(0); i < profiler.history_.size(); ++i)
+  {
+    const render::gpu_profiler_t::history_t& history = profiler.history_[i];
+    float average, p50, p95, p99;
+    if (!render::gpuProfilerGetTimings(profiler, history.name_, &average, &p50, &p95, &p99))
+      continue;
+
+    float last = history.time_[(history.next_ + render::gpu_profiler_t::HISTORY_SIZE - 1) % render::gpu_profiler_t::HISTORY_SIZE];
+    ImGui::Text("%s", history.name_); ImGui::NextColumn();
+    ImGui::Text("%.3f", last); ImGui::NextColumn();
+    ImGui::Text("%.3f", average); ImGui::NextColumn();
+    ImGui::Text("%.3f", p50); ImGui::NextColumn();
+    ImGui::Text("%.3f", p95); ImGui::NextColumn();
+    ImGui::Text("%.3f", p99); ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+  ImGui::Separator();
+
+  //Pipeline statistics of the last frame
+  if (ImGui::CollapsingHeader("Pipeline statistics"))
+  {
+    ImGui::Columns(7, "statistics");
+    ImGui::Separator();
+    ImGui::Text("Marker"); ImGui::NextColumn();
+    ImGui::Text("Vertices"); ImGui::NextColumn();
+    ImGui::Text("Primitives"); ImGui::NextColumn();
+    ImGui::Text("VS invocations"); ImGui::NextColumn();
+    ImGui::Text("Clipping primitives"); ImGui::NextColumn();
+    ImGui::Text("FS invocations"); ImGui::NextColumn();
+    ImGui::Text("CS invocations"); ImGui::NextColumn();
+    ImGui::Separator();
+    for (uint32_t i(0); i < markers.size(); ++i)
+    {
+      if (markers[i].statisticsQuery_ == -1)
+        continue;
+
+      ImGui::Text("%s", markers[i].name_); ImGui::NextColumn();
+      for (uint32_t j(0); j < render::gpu_profiler_t::STATISTIC_COUNT; ++j)
+      {
+        ImGui::Text("%llu", (unsigned long long)markers[i].statistics_[j]);
+        ImGui::NextColumn();
+      }
+    }
+    ImGui::Columns(1);
+  }
+
+  ImGui::End();
+}
+
 void gui::updateMousePosition(float x, float y)
 {
   ImGuiIO& io = ImGui::GetIO();
@@ -0,0 +1,232 @@
+#include "core/cpu-profiler.h"
+
+#include "framework/light-manager.h"
+#include "framework/camera.h"
+#include "framework/renderer.h"
+
+#include <float.h>
+#include <math.h>
+#include <xmmintrin.h>
+
+using namespace bkk::core;
+using namespace bkk::framework;
+
+struct cluster_buffer_header_t
+{
+  maths::uvec4 clusterCount_;
+  maths::vec4 depthParams_;   //Near plane, slices per log unit
+};
+
+static const uint32_t gClusterCount = light_manager_t::CLUSTER_COUNT_X * light_manager_t::CLUSTER_COUNT_Y * light_manager_t::CLUSTER_COUNT_Z;
+
+static maths::vec3 unproject(const maths::mat4& projectionInverse, float x, float y, float z)
+{
+  maths::vec4 p = maths::vec4(x, y, z, 1.0f) * projectionInverse;
+  return p.xyz() / p.w;
+}
+
+//Point with the given view space depth on the line through a and b
+static maths::vec3 pointAtDepth(const maths::vec3& a, const maths::vec3& b, float depth)
+{
+  float t = (depth + a.z) / (a.z - b.z);
+  return a + (b - a) * t;
+}
+
+light_manager_t::light_manager_t()
+:lightBuffer_(),
+ clusterBuffer_(),
+ lightIndexBuffer_()
+{
+}
+
+void light_manager_t::initialize(renderer_t* renderer)
+{
+  render::context_t& context = renderer->getContext();
+
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::gpu_memory_type_e::HOST_VISIBLE_COHERENT,
+    nullptr, MAX_LIGHT_COUNT * sizeof(light_t), nullptr, &lightBuffer_);
+
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::gpu_memory_type_e::HOST_VISIBLE_COHERENT,
+    nullptr, sizeof(cluster_buffer_header_t) + gClusterCount * 2 * sizeof(uint32_t), nullptr, &clusterBuffer_);
+
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::gpu_memory_type_e::HOST_VISIBLE_COHERENT,
+    nullptr, MAX_LIGHT_INDEX_COUNT * sizeof(uint32_t), nullptr, &lightIndexBuffer_);
+
+  clusterRanges_.resize(gClusterCount * 2);
+  lightIndices_.reserve(MAX_LIGHT_INDEX_COUNT);
+}
+
+void light_manager_t::destroy(renderer_t* renderer)
+{
+  render::context_t& context = renderer->getContext();
+  if (lightBuffer_.handle_ != VK_NULL_HANDLE)
+  {
+    render::gpuBufferDestroy(context, nullptr, &lightBuffer_);
+    render::gpuBufferDestroy(context, nullptr, &clusterBuffer_);
+    render::gpuBufferDestroy(context, nullptr, &lightIndexBuffer_);
+  }
+}
+
+light_handle_t light_manager_t::lightCreate(const maths::vec3& position, const maths::vec3& color, float radius)
+{
+  if (lights_.getElementCount() >= MAX_LIGHT_COUNT)
+    return NULL_HANDLE;
+
+  light_t light = { maths::vec4(position, 1.0f), color, radius };
+  return lights_.add(light);
+}
+
+light_t* light_manager_t::getLight(light_handle_t handle)
+{
+  return lights_.get(handle);
+}
+
+void light_manager_t::lightDestroy(light_handle_t handle)
+{
+  lights_.remove(handle);
+}
+
+void light_manager_t::update(const camera_t& camera, renderer_t* renderer)
+{
+  BKK_ZONE("light_manager_t::update");
+
+  //Lights to view space
+  light_t* lights;
+  uint32_t lightCount = lights_.getData(&lights);
+  lightX_.resize(lightCount);
+  lightY_.resize(lightCount);
+  lightZ_.resize(lightCount);
+  lightRadius_.resize(lightCount);
+  for (uint32_t i(0); i < lightCount; ++i)
+  {
+    maths::vec4 positionVS = lights[i].position_ * camera.uniforms_.worldToView_;
+    lightX_[i] = positionVS.x;
+    lightY_[i] = positionVS.y;
+    lightZ_[i] = positionVS.z;
+    lightRadius_[i] = lights[i].radius_;
+  }
+
+  //Lines through the corners of the tiles, from the near to the far plane
+  const uint32_t lineCountX = CLUSTER_COUNT_X + 1;
+  const uint32_t lineCountY = CLUSTER_COUNT_Y + 1;
+  maths::vec3 nearPoint[lineCountX * lineCountY];
+  maths::vec3 farPoint[lineCountX * lineCountY];
+  for (uint32_t y(0); y < lineCountY; ++y)
+  {
+    for (uint32_t x(0); x < lineCountX; ++x)
+    {
+      float ndcX = 2.0f * x / CLUSTER_COUNT_X - 1.0f;
+      float ndcY = 2.0f * y / CLUSTER_COUNT_Y - 1.0f;
+      nearPoint[y*lineCountX + x] = unproject(camera.uniforms_.projectionInverse_, ndcX, ndcY, -1.0f);
+      farPoint[y*lineCountX + x] = unproject(camera.uniforms_.projectionInverse_, ndcX, ndcY, 1.0f);
+    }
+  }
+
+  const float zNear = camera.nearPlane_;
+  const float zFar = camera.farPlane_;
+  const float depthRatio = zFar / zNear;
+
+  //View space lights overlapping the current slice, in SoA layout padded to a multiple of 4.
+  //Padding lights have a negative squared radius so they never pass the test
+  std::vector<float> sliceX, sliceY, sliceZ, sliceRadius2;
+
+  lightIndices_.clear();
+  for (uint32_t z(0); z < CLUSTER_COUNT_Z; ++z)
+  {
+    float sliceNear = zNear * powf(depthRatio, (float)z / CLUSTER_COUNT_Z);
+    float sliceFar = zNear * powf(depthRatio, (float)(z + 1) / CLUSTER_COUNT_Z);
+
+    sliceLights_.clear();
+    for (uint32_t i(0); i < lightCount; ++i)
+    {
+      float depth = -lightZ_[i];
+      if (depth + lightRadius_[i] >= sliceNear && depth - lightRadius_[i] <= sliceFar)
+        sliceLights_.push_back(i);
+    }
+
+    uint32_t sliceLightCount = (uint32_t)sliceLights_.size();
+    uint32_t paddedCount = (sliceLightCount + 3) & ~3u;
+    sliceX.resize(paddedCount);
+    sliceY.resize(paddedCount);
+    sliceZ.resize(paddedCount);
+    sliceRadius2.resize(paddedCount);
+    for (uint32_t i(0); i < paddedCount; ++i)
+    {
+      if (i < sliceLightCount)
+      {
+        uint32_t light = sliceLights_[i];
+        sliceX[i] = lightX_[light];
+        sliceY[i] = lightY_[light];
+        sliceZ[i] = lightZ_[light];
+        sliceRadius2[i] = lightRadius_[light] * lightRadius_[light];
+      }
+      else
+      {
+        sliceX[i] = sliceY[i] = sliceZ[i] = 0.0f;
+        sliceRadius2[i] = -1.0f;
+      }
+    }
+
+    for (uint32_t y(0); y < CLUSTER_COUNT_Y; ++y)
+    {
+      for (uint32_t x(0); x < CLUSTER_COUNT_X; ++x)
+      {
+        uint32_t cluster = x + y * CLUSTER_COUNT_X + z * CLUSTER_COUNT_X * CLUSTER_COUNT_Y;
+        uint32_t offset = (uint32_t)lightIndices_.size();
+        clusterRanges_[2 * cluster] = offset;
+
+        //Cluster bounding box
+        maths::vec3 aabbMin(FLT_MAX, FLT_MAX, FLT_MAX);
+        maths::vec3 aabbMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        uint32_t corners[4] = { y*lineCountX + x, y*lineCountX + x + 1, (y + 1)*lineCountX + x, (y + 1)*lineCountX + x + 1 };
+        for (uint32_t i(0); i < 4; ++i)
+        {
+          maths::vec3 p0 = pointAtDepth(nearPoint[corners[i]], farPoint[corners[i]], sliceNear);
+          maths::vec3 p1 = pointAtDepth(nearPoint[corners[i]], farPoint[corners[i]], sliceFar);
+          aabbMin = maths::vec3(maths::minValue(aabbMin.x, maths::minValue(p0.x, p1.x)), maths::minValue(aabbMin.y, maths::minValue(p0.y, p1.y)), maths::minValue(aabbMin.z, maths::minValue(p0.z, p1.z)));
+          aabbMax = maths::vec3(maths::maxValue(aabbMax.x, maths::maxValue(p0.x, p1.x)), maths::maxValue(aabbMax.y, maths::maxValue(p0.y, p1.y)), maths::maxValue(aabbMax.z, maths::maxValue(p0.z, p1.z)));
+        }
+
+        //Sphere-AABB test, four lights at a time
+        __m128 minX = _mm_set1_ps(aabbMin.x);
+        __m128 minY = _mm_set1_ps(aabbMin.y);
+        __m128 minZ = _mm_set1_ps(aabbMin.z);
+        __m128 maxX = _mm_set1_ps(aabbMax.x);
+        __m128 maxY = _mm_set1_ps(aabbMax.y);
+        __m128 maxZ = _mm_set1_ps(aabbMax.z);
+        for (uint32_t i(0); i < paddedCount; i += 4)
+        {
+          __m128 cx = _mm_loadu_ps(&sliceX[i]);
+          __m128 cy = _mm_loadu_ps(&sliceY[i]);
+          __m128 cz = _mm_loadu_ps(&sliceZ[i]);
+          __m128 dx = _mm_sub_ps(cx, _mm_min_ps(_mm_max_ps(cx, minX), maxX));
+          __m128 dy = _mm_sub_ps(cy, _mm_min_ps(_mm_max_ps(cy, minY), maxY));
+          __m128 dz = _mm_sub_ps(cz, _mm_min_ps(_mm_max_ps(cz, minZ), maxZ));
+          __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+          int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, _mm_loadu_ps(&sliceRadius2[i])));
+          for (uint32_t j(0); mask != 0 && j < 4; ++j, mask >>= 1)
+          {
+            if ((mask & 1) && lightIndices_.size() < MAX_LIGHT_INDEX_COUNT)
+              lightIndices_.push_back(sliceLights_[i + j]);
+          }
+        }
+
+        clusterRanges_[2 * cluster + 1] = (uint32_t)lightIndices_.size() - offset;
+      }
+    }
+  }
+
+  //Upload
+  render::context_t& context = renderer->getContext();
+  if (lightCount > 0)
+    render::gpuBufferUpdate(context, lights, 0u, lightCount * sizeof(light_t), &lightBuffer_);
+
+  cluster_buffer_header_t header;
+  header.clusterCount_ = maths::uvec4(CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z, 0u);
+  header.depthParams_ = maths::vec4(zNear, CLUSTER_COUNT_Z / logf(depthRatio), 0.0f, 0.0f);
+  render::gpuBufferUpdate(context, &header, 0u, sizeof(header), &clusterBuffer_);
+  render::gpuBufferUpdate(context, clusterRanges_.data(), sizeof(header), clusterRanges_.size() * sizeof(uint32_t), &clusterBuffer_);
+
+  if (!lightIndices_.empty())
+    render::gpuBufferUpdate(context, lightIndices_.data(), 0u, lightIndices_.size() * sizeof(uint32_t), &lightIndexBuffer_);
+}
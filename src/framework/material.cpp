@@ -1,4 +1,5 @@
 
+#include "core/cpu-profiler.h"
 #include "core/maths.h"
 #include "core/string-utils.h"
 
@@ -26,6 +27,8 @@ material_t::material_t(shader_handle_t shaderHandle, renderer_t* renderer)
     const std::vector<texture_desc_t>& textureDesc = shader->getTextureDescriptions();
     descriptors_.resize(bufferDesc.size() + textureDesc.size());
 
+    specialization_ = shader->getDefaultSpecialization();
+
     uint32_t passCount = shader->getPassCount();
     descriptorSet_.resize(passCount);
     updateDescriptorSet_.resize(passCount);
@@ -63,7 +66,7 @@ void material_t::destroy(renderer_t* renderer)
   render::context_t& context = renderer->getContext();
   for (uint32_t i(0); i < uniformBuffers_.size(); ++i)
   {
-    render::gpuBufferDestroy(context, nullptr, &uniformBuffers_[i]);
+    render::gpuBufferDestroyDeferred(&context, nullptr, &uniformBuffers_[i]);
     delete[] uniformData_[i];
   }
   
@@ -71,7 +74,7 @@ void material_t::destroy(renderer_t* renderer)
   {
     if (descriptorSet_[i].handle_ != VK_NULL_HANDLE)
     {
-      render::descriptorSetDestroy(context, &descriptorSet_[i]);
+      render::descriptorSetDestroyDeferred(&context, &descriptorSet_[i]);
     }
   }
 }
@@ -81,7 +84,19 @@ render::graphics_pipeline_t material_t::getPipeline(const char* name, frame_buff
   shader_t* shader = renderer->getShader(shader_);
   if (shader)
   {
-    return shader->getPipeline(name, framebuffer, renderer);
+    return shader->getPipeline(name, framebuffer, specialization_, renderer);
+  }
+
+  core::render::graphics_pipeline_t nullPipeline = {};
+  return nullPipeline;
+}
+
+render::graphics_pipeline_t material_t::getDepthOnlyPipeline(const char* name, frame_buffer_handle_t framebuffer, renderer_t* renderer)
+{
+  shader_t* shader = renderer->getShader(shader_);
+  if (shader)
+  {
+    return shader->getDepthOnlyPipeline(name, framebuffer, specialization_, renderer);
   }
 
   core::render::graphics_pipeline_t nullPipeline = {};
@@ -225,8 +240,39 @@ bool material_t::setTexture(const char* property, render::texture_t texture)
   return true;
 }
 
+bool material_t::setSpecializationConstant(const char* name, int32_t value)
+{
+  shader_t* shader = renderer_->getShader(shader_);
+  if (!shader) return false;
+
+  int32_t index = shader->getSpecializationConstantIndexFromName(name);
+  if (index < 0) return false;
+
+  specialization_[index] = (uint32_t)value;
+  return true;
+}
+
+bool material_t::setSpecializationConstant(const char* name, uint32_t value)
+{
+  return setSpecializationConstant(name, (int32_t)value);
+}
+
+bool material_t::setSpecializationConstant(const char* name, float value)
+{
+  int32_t bits;
+  memcpy(&bits, &value, sizeof(float));
+  return setSpecializationConstant(name, bits);
+}
+
+bool material_t::setSpecializationConstant(const char* name, bool value)
+{
+  return setSpecializationConstant(name, value ? 1 : 0);
+}
+
 render::descriptor_set_t material_t::getDescriptorSet(const char* pass)
 {
+  BKK_ZONE("material_t::getDescriptorSet");
+
   render::context_t& context = renderer_->getContext();
 
   shader_t* shader = renderer_->getShader(shader_);
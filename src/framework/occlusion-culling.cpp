@@ -0,0 +1,606 @@
+#include "framework/occlusion-culling.h"
+#include "framework/renderer.h"
+#include "framework/actor.h"
+
+#include "core/mesh.h"
+
+#include <float.h>
+#include <string>
+#include <vector>
+
+using namespace bkk::core;
+using namespace bkk::framework;
+
+static const char* gOcclusionCullingCommonGlsl = R"(
+  #version 440 core
+
+  layout(set = 0, binding = 0) uniform UNIFORMS
+  {
+    mat4 viewProjection;
+    mat4 prevViewProjection;
+    uvec4 hiZSize;      //xy: Rendered size, z: Level count, w: Actor capacity
+    uvec4 prevHiZSize;
+  }uniforms;
+
+  layout(set = 0, binding = 1) uniform sampler2D uDepth;
+
+  layout(std430, set = 0, binding = 2) buffer HIZ
+  {
+    float data[];
+  }hiZ;
+
+  struct actor_t
+  {
+    vec4 aabbMin;
+    vec4 aabbMax;
+    uvec4 indexCount;
+  };
+
+  layout(std430, set = 0, binding = 3) readonly buffer ACTORS
+  {
+    actor_t data[];
+  }actors;
+
+  struct draw_command_t
+  {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+  };
+
+  layout(std430, set = 0, binding = 4) buffer DRAW_COMMANDS
+  {
+    draw_command_t data[];
+  }drawCommands;
+
+  layout(std430, set = 0, binding = 5) buffer VISIBILITY
+  {
+    uint data[];
+  }visibility;
+
+  layout(push_constant) uniform PUSH_CONSTANTS
+  {
+    uint srcOffset;
+    uint dstOffset;
+    uvec2 srcSize;
+    uvec2 dstSize;
+    uint actorCount;
+    uint phase;
+  }pushConstants;
+
+  //Level l texel t covers pixels [t * 2^(l+1), (t+1) * 2^(l+1)) of the rendered region
+  uvec2 hiZLevelSize(uvec2 size, uint level)
+  {
+    return (size + (2u << level) - 1u) >> (level + 1u);
+  }
+
+  uint hiZLevelOffset(uvec2 size, uint level)
+  {
+    uint offset = 0u;
+    for (uint i = 0u; i < level; ++i)
+    {
+      uvec2 levelSize = hiZLevelSize(size, i);
+      offset += levelSize.x * levelSize.y;
+    }
+    return offset;
+  }
+)";
+
+static const char* gHiZFirstLevelShaderSource = R"(
+  layout (local_size_x = 8, local_size_y = 8) in;
+
+  void main()
+  {
+    uvec2 texel = gl_GlobalInvocationID.xy;
+    if (any(greaterThanEqual(texel, pushConstants.dstSize)))
+      return;
+
+    //Farthest depth of the 2x2 depth texels covered
+    ivec2 src = ivec2(texel * 2u);
+    ivec2 maxTexel = ivec2(pushConstants.srcSize) - 1;
+    float depth = max(max(texelFetch(uDepth, min(src, maxTexel), 0).r,
+                          texelFetch(uDepth, min(src + ivec2(1, 0), maxTexel), 0).r),
+                      max(texelFetch(uDepth, min(src + ivec2(0, 1), maxTexel), 0).r,
+                          texelFetch(uDepth, min(src + ivec2(1, 1), maxTexel), 0).r));
+
+    hiZ.data[pushConstants.dstOffset + texel.x + texel.y * pushConstants.dstSize.x] = depth;
+  }
+)";
+
+static const char* gHiZDownsampleShaderSource = R"(
+  layout (local_size_x = 8, local_size_y = 8) in;
+
+  float srcDepth(uvec2 texel)
+  {
+    texel = min(texel, pushConstants.srcSize - 1u);
+    return hiZ.data[pushConstants.srcOffset + texel.x + texel.y * pushConstants.srcSize.x];
+  }
+
+  void main()
+  {
+    uvec2 texel = gl_GlobalInvocationID.xy;
+    if (any(greaterThanEqual(texel, pushConstants.dstSize)))
+      return;
+
+    uvec2 src = texel * 2u;
+    float depth = max(max(srcDepth(src), srcDepth(src + uvec2(1u, 0u))),
+                      max(srcDepth(src + uvec2(0u, 1u)), srcDepth(src + uvec2(1u, 1u))));
+
+    hiZ.data[pushConstants.dstOffset + texel.x + texel.y * pushConstants.dstSize.x] = depth;
+  }
+)";
+
+static const char* gCullShaderSource = R"(
+  layout (local_size_x = 64) in;
+
+  const uint EARLY_DRAWS = 0u;
+  const uint LATE_DRAWS = 1u;
+  const uint ALL_DRAWS = 2u;
+
+  //Normalized device coordinates bounds of the box. Returns false if the box crosses the near plane
+  bool projectBounds(vec3 aabbMin, vec3 aabbMax, mat4 viewProjection, out vec3 ndcMin, out vec3 ndcMax)
+  {
+    ndcMin = vec3(1e20);
+    ndcMax = vec3(-1e20);
+    for (int i = 0; i < 8; ++i)
+    {
+      vec3 corner = vec3((i & 1) != 0 ? aabbMax.x : aabbMin.x,
+                         (i & 2) != 0 ? aabbMax.y : aabbMin.y,
+                         (i & 4) != 0 ? aabbMax.z : aabbMin.z);
+
+      vec4 positionCS = viewProjection * vec4(corner, 1.0);
+      if (positionCS.w <= 0.0)
+        return false;
+
+      vec3 ndc = positionCS.xyz / positionCS.w;
+      ndcMin = min(ndcMin, ndc);
+      ndcMax = max(ndcMax, ndc);
+    }
+
+    return true;
+  }
+
+  //Compares the closest depth of the box with the farthest depth in the 2x2 Hi-Z texels covering it
+  bool isOccluded(vec3 ndcMin, vec3 ndcMax, uvec4 hiZSize)
+  {
+    uvec2 size = hiZSize.xy;
+    vec2 pixelMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0) * vec2(size);
+    vec2 pixelMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0) * vec2(size);
+    float extent = max(pixelMax.x - pixelMin.x, pixelMax.y - pixelMin.y);
+    uint level = min(uint(max(ceil(log2(max(extent, 1.0))) - 1.0, 0.0)), hiZSize.z - 1u);
+
+    uvec2 levelSize = hiZLevelSize(size, level);
+    uvec2 texelMin = min(uvec2(pixelMin) >> (level + 1u), levelSize - 1u);
+    uvec2 texelMax = min(uvec2(pixelMax) >> (level + 1u), levelSize - 1u);
+    uint offset = hiZLevelOffset(size, level);
+
+    float maxDepth = 0.0;
+    for (uint y = texelMin.y; y <= texelMax.y; ++y)
+    {
+      for (uint x = texelMin.x; x <= texelMax.x; ++x)
+      {
+        maxDepth = max(maxDepth, hiZ.data[offset + x + y * levelSize.x]);
+      }
+    }
+
+    return ndcMin.z > maxDepth;
+  }
+
+  void writeDrawCommand(uint list, uint actor, bool visible)
+  {
+    uint index = list * uniforms.hiZSize.w + actor;
+    drawCommands.data[index].indexCount = actors.data[actor].indexCount.x;
+    drawCommands.data[index].instanceCount = visible ? 1u : 0u;
+    drawCommands.data[index].firstIndex = 0u;
+    drawCommands.data[index].vertexOffset = 0;
+    drawCommands.data[index].firstInstance = 0u;
+  }
+
+  void main()
+  {
+    uint actor = gl_GlobalInvocationID.x;
+    if (actor >= pushConstants.actorCount)
+      return;
+
+    vec3 aabbMin = actors.data[actor].aabbMin.xyz;
+    vec3 aabbMax = actors.data[actor].aabbMax.xyz;
+
+    //Frustum test. Boxes crossing the near plane are considered visible
+    vec3 ndcMin, ndcMax;
+    bool visible = true;
+    if (projectBounds(aabbMin, aabbMax, uniforms.viewProjection, ndcMin, ndcMax))
+    {
+      visible = all(lessThanEqual(ndcMin, vec3(1.0))) && all(greaterThanEqual(ndcMax, vec3(-1.0, -1.0, 0.0)));
+    }
+
+    if (pushConstants.phase == 0u)
+    {
+      //Previous frame pyramid, reprojected with the previous frame view projection
+      if (visible && uniforms.prevHiZSize.z > 0u && projectBounds(aabbMin, aabbMax, uniforms.prevViewProjection, ndcMin, ndcMax))
+      {
+        visible = !isOccluded(ndcMin, ndcMax, uniforms.prevHiZSize);
+      }
+
+      visibility.data[actor] = visible ? 1u : 0u;
+      writeDrawCommand(EARLY_DRAWS, actor, visible);
+      writeDrawCommand(LATE_DRAWS, actor, false);
+      writeDrawCommand(ALL_DRAWS, actor, visible);
+    }
+    else if (visibility.data[actor] == 0u)
+    {
+      //Current frame pyramid, built from the depth of the actors drawn in the first phase
+      if (visible && projectBounds(aabbMin, aabbMax, uniforms.viewProjection, ndcMin, ndcMax))
+      {
+        visible = !isOccluded(ndcMin, ndcMax, uniforms.hiZSize);
+      }
+
+      if (visible)
+      {
+        drawCommands.data[LATE_DRAWS * uniforms.hiZSize.w + actor].instanceCount = 1u;
+        drawCommands.data[ALL_DRAWS * uniforms.hiZSize.w + actor].instanceCount = 1u;
+      }
+    }
+  }
+)";
+
+//World space bounds of an actor as read by the culling shader
+struct actor_bounds_t
+{
+  maths::vec4 aabbMin_;
+  maths::vec4 aabbMax_;
+  maths::uvec4 indexCount_;
+};
+
+static maths::uvec2 hiZLevelSize(const maths::uvec2& size, uint32_t level)
+{
+  return maths::uvec2((size.x + (2u << level) - 1u) >> (level + 1u), (size.y + (2u << level) - 1u) >> (level + 1u));
+}
+
+static uint32_t hiZLevelCount(const maths::uvec2& size)
+{
+  uint32_t levelCount = 1u;
+  maths::uvec2 levelSize = hiZLevelSize(size, 0u);
+  while (levelSize.x > 1u || levelSize.y > 1u)
+  {
+    levelSize = hiZLevelSize(size, levelCount++);
+  }
+
+  return levelCount;
+}
+
+static uint32_t hiZLevelOffset(const maths::uvec2& size, uint32_t level)
+{
+  uint32_t offset = 0u;
+  for (uint32_t i(0); i < level; ++i)
+  {
+    maths::uvec2 levelSize = hiZLevelSize(size, i);
+    offset += levelSize.x * levelSize.y;
+  }
+
+  return offset;
+}
+
+static void memoryBarrier(render::command_buffer_t commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+  VkMemoryBarrier memoryBarrier = {};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memoryBarrier.srcAccessMask = srcAccess;
+  memoryBarrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer.handle_, srcStage, dstStage, 0, 1u, &memoryBarrier, 0u, nullptr, 0u, nullptr);
+}
+
+static void depthBufferBarrier(render::command_buffer_t commandBuffer, const render::depth_stencil_buffer_t& depthBuffer,
+                               VkImageLayout oldLayout, VkImageLayout newLayout,
+                               VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+  VkImageMemoryBarrier imageBarrier = {};
+  imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  imageBarrier.oldLayout = oldLayout;
+  imageBarrier.newLayout = newLayout;
+  imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.image = depthBuffer.image_;
+  imageBarrier.subresourceRange = { depthBuffer.aspectFlags_, 0u, 1u, 0u, 1u };
+  imageBarrier.srcAccessMask = srcAccess;
+  imageBarrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer.handle_, srcStage, dstStage, 0, 0u, nullptr, 0u, nullptr, 1u, &imageBarrier);
+}
+
+occlusion_culling_t::occlusion_culling_t()
+:cullingEnabled_(false),
+ depthPrepassEnabled_(false),
+ frameBuffer_(NULL_HANDLE),
+ uniforms_(),
+ pushConstants_(),
+ actorCapacity_(0u),
+ uniformBuffer_(),
+ hiZBuffer_(),
+ actorBuffer_(),
+ drawCommands_(),
+ visibilityBuffer_(),
+ descriptorSetLayout_(),
+ descriptorSet_(),
+ pipelineLayout_(),
+ hiZFirstLevelShader_(),
+ hiZDownsampleShader_(),
+ cullShader_(),
+ hiZFirstLevelPipeline_(),
+ hiZDownsamplePipeline_(),
+ cullPipeline_()
+{
+}
+
+void occlusion_culling_t::initialize(renderer_t* renderer)
+{
+  render::context_t& context = renderer->getContext();
+
+  uniforms_ = {};
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::UNIFORM_BUFFER,
+    (void*)&uniforms_, sizeof(uniforms_),
+    nullptr, &uniformBuffer_);
+
+  render::descriptor_binding_t bindings[6] = {
+    { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::COMPUTE },
+    { render::descriptor_t::type::COMBINED_IMAGE_SAMPLER, 1, render::descriptor_t::stage::COMPUTE },
+    { render::descriptor_t::type::STORAGE_BUFFER, 2, render::descriptor_t::stage::COMPUTE },
+    { render::descriptor_t::type::STORAGE_BUFFER, 3, render::descriptor_t::stage::COMPUTE },
+    { render::descriptor_t::type::STORAGE_BUFFER, 4, render::descriptor_t::stage::COMPUTE },
+    { render::descriptor_t::type::STORAGE_BUFFER, 5, render::descriptor_t::stage::COMPUTE }
+  };
+  render::descriptorSetLayoutCreate(context, bindings, 6u, &descriptorSetLayout_);
+
+  render::push_constant_range_t pushConstantRange = { render::descriptor_t::stage::COMPUTE, sizeof(push_constants_t), 0u };
+  render::pipelineLayoutCreate(context, &descriptorSetLayout_, 1u, &pushConstantRange, 1u, &pipelineLayout_);
+
+  std::string code = std::string(gOcclusionCullingCommonGlsl) + gHiZFirstLevelShaderSource;
+  render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, code.c_str(), &hiZFirstLevelShader_);
+  render::computePipelineCreate(context, pipelineLayout_, hiZFirstLevelShader_, &hiZFirstLevelPipeline_);
+
+  code = std::string(gOcclusionCullingCommonGlsl) + gHiZDownsampleShaderSource;
+  render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, code.c_str(), &hiZDownsampleShader_);
+  render::computePipelineCreate(context, pipelineLayout_, hiZDownsampleShader_, &hiZDownsamplePipeline_);
+
+  code = std::string(gOcclusionCullingCommonGlsl) + gCullShaderSource;
+  render::shaderCreateFromGLSLSource(context, render::shader_t::COMPUTE_SHADER, code.c_str(), &cullShader_);
+  render::computePipelineCreate(context, pipelineLayout_, cullShader_, &cullPipeline_);
+}
+
+void occlusion_culling_t::destroy(renderer_t* renderer)
+{
+  render::context_t& context = renderer->getContext();
+  if (uniformBuffer_.handle_ == VK_NULL_HANDLE)
+    return;
+
+  render::gpuBufferDestroy(context, nullptr, &uniformBuffer_);
+  if (hiZBuffer_.handle_ != VK_NULL_HANDLE)
+    render::gpuBufferDestroy(context, nullptr, &hiZBuffer_);
+
+  if (actorBuffer_.handle_ != VK_NULL_HANDLE)
+  {
+    render::gpuBufferDestroy(context, nullptr, &actorBuffer_);
+    render::gpuBufferDestroy(context, nullptr, &drawCommands_);
+    render::gpuBufferDestroy(context, nullptr, &visibilityBuffer_);
+  }
+
+  if (descriptorSet_.handle_ != VK_NULL_HANDLE)
+    render::descriptorSetDestroy(context, &descriptorSet_);
+
+  render::computePipelineDestroy(context, &hiZFirstLevelPipeline_);
+  render::computePipelineDestroy(context, &hiZDownsamplePipeline_);
+  render::computePipelineDestroy(context, &cullPipeline_);
+  render::shaderDestroy(context, &hiZFirstLevelShader_);
+  render::shaderDestroy(context, &hiZDownsampleShader_);
+  render::shaderDestroy(context, &cullShader_);
+  render::pipelineLayoutDestroy(context, &pipelineLayout_);
+  render::descriptorSetLayoutDestroy(context, &descriptorSetLayout_);
+}
+
+void occlusion_culling_t::setFrameBuffer(frame_buffer_handle_t frameBufferHandle, renderer_t* renderer)
+{
+  frame_buffer_t* frameBuffer = renderer->getFrameBuffer(frameBufferHandle);
+  if (frameBuffer == nullptr || !frameBuffer->hasDepthBuffer())
+  {
+    frameBuffer_ = NULL_HANDLE;
+    return;
+  }
+
+  render::context_t& context = renderer->getContext();
+  if (hiZBuffer_.handle_ != VK_NULL_HANDLE)
+    render::gpuBufferDestroyDeferred(&context, nullptr, &hiZBuffer_);
+
+  //Sized for the whole frame buffer. Dynamic resolution only uses part of it
+  maths::uvec2 size(frameBuffer->getWidth(), frameBuffer->getHeight());
+  uint32_t hiZSize = hiZLevelOffset(size, hiZLevelCount(size)) * sizeof(float);
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::DEVICE_LOCAL,
+    nullptr, hiZSize, nullptr, &hiZBuffer_);
+
+  //The previous pyramid belongs to a different frame buffer
+  frameBuffer_ = frameBufferHandle;
+  uniforms_.hiZSize_ = maths::uvec4(0u, 0u, 0u, 0u);
+  updateDescriptorSet(renderer);
+}
+
+void occlusion_culling_t::reserve(uint32_t actorCount, renderer_t* renderer)
+{
+  if (actorCount <= actorCapacity_)
+    return;
+
+  render::context_t& context = renderer->getContext();
+  if (actorBuffer_.handle_ != VK_NULL_HANDLE)
+  {
+    render::gpuBufferDestroyDeferred(&context, nullptr, &actorBuffer_);
+    render::gpuBufferDestroyDeferred(&context, nullptr, &drawCommands_);
+    render::gpuBufferDestroyDeferred(&context, nullptr, &visibilityBuffer_);
+  }
+
+  actorCapacity_ = maths::maxValue(64u, actorCapacity_);
+  while (actorCapacity_ < actorCount)
+    actorCapacity_ *= 2u;
+
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER,
+    nullptr, actorCapacity_ * sizeof(actor_bounds_t), nullptr, &actorBuffer_);
+
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER | render::gpu_buffer_t::usage::INDIRECT_BUFFER, render::DEVICE_LOCAL,
+    nullptr, 3u * actorCapacity_ * sizeof(VkDrawIndexedIndirectCommand), nullptr, &drawCommands_);
+
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::DEVICE_LOCAL,
+    nullptr, actorCapacity_ * sizeof(uint32_t), nullptr, &visibilityBuffer_);
+
+  updateDescriptorSet(renderer);
+}
+
+void occlusion_culling_t::updateDescriptorSet(renderer_t* renderer)
+{
+  frame_buffer_t* frameBuffer = renderer->getFrameBuffer(frameBuffer_);
+  if (frameBuffer == nullptr || actorBuffer_.handle_ == VK_NULL_HANDLE)
+    return;
+
+  //The old set may still be used by a frame in flight so a new one is allocated instead of updating it
+  render::context_t& context = renderer->getContext();
+  if (descriptorSet_.handle_ != VK_NULL_HANDLE)
+    render::descriptorSetDestroyDeferred(&context, &descriptorSet_);
+
+  render::descriptor_t descriptors[6] = {
+    render::getDescriptor(uniformBuffer_),
+    render::getDescriptor(frameBuffer->getDepthBuffer()),
+    render::getDescriptor(hiZBuffer_),
+    render::getDescriptor(actorBuffer_),
+    render::getDescriptor(drawCommands_),
+    render::getDescriptor(visibilityBuffer_)
+  };
+  render::descriptorSetCreate(context, renderer->getDescriptorPool(), descriptorSetLayout_, descriptors, &descriptorSet_);
+}
+
+void occlusion_culling_t::cullFirstPhase(render::command_buffer_t commandBuffer, actor_t* actors, uint32_t actorCount, renderer_t* renderer)
+{
+  reserve(actorCount, renderer);
+
+  //World space bounds
+  std::vector<actor_bounds_t> bounds(actorCount);
+  for (uint32_t i(0); i < actorCount; ++i)
+  {
+    bounds[i] = {};
+    mesh::mesh_t* mesh = renderer->getMesh(actors[i].getMesh());
+    maths::mat4* transform = renderer->getWorldTransform(actors[i].getTransform());
+    if (mesh == nullptr || transform == nullptr)
+      continue;
+
+    maths::vec3 aabbMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    maths::vec3 aabbMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (uint32_t corner(0); corner < 8u; ++corner)
+    {
+      maths::vec4 position((corner & 1u) ? mesh->aabb_.max_.x : mesh->aabb_.min_.x,
+                           (corner & 2u) ? mesh->aabb_.max_.y : mesh->aabb_.min_.y,
+                           (corner & 4u) ? mesh->aabb_.max_.z : mesh->aabb_.min_.z,
+                           1.0f);
+      position = position * (*transform);
+      aabbMin = maths::vec3(maths::minValue(aabbMin.x, position.x), maths::minValue(aabbMin.y, position.y), maths::minValue(aabbMin.z, position.z));
+      aabbMax = maths::vec3(maths::maxValue(aabbMax.x, position.x), maths::maxValue(aabbMax.y, position.y), maths::maxValue(aabbMax.z, position.z));
+    }
+
+    bounds[i].aabbMin_ = maths::vec4(aabbMin.x, aabbMin.y, aabbMin.z, 0.0f);
+    bounds[i].aabbMax_ = maths::vec4(aabbMax.x, aabbMax.y, aabbMax.z, 0.0f);
+    bounds[i].indexCount_ = maths::uvec4(mesh->indexCount_, 0u, 0u, 0u);
+  }
+
+  render::context_t& context = renderer->getContext();
+  if (actorCount > 0u)
+    render::gpuBufferUpdate(context, bounds.data(), 0u, actorCount * sizeof(actor_bounds_t), &actorBuffer_);
+
+  //The pyramid built on the previous frame is used by the first phase
+  frame_buffer_t* frameBuffer = renderer->getFrameBuffer(frameBuffer_);
+  float scale = renderer->getDynamicResolution()->getScale();
+  maths::uvec2 size(maths::maxValue(1u, (uint32_t)(frameBuffer->getWidth() * scale)),
+                    maths::maxValue(1u, (uint32_t)(frameBuffer->getHeight() * scale)));
+
+  camera_t* camera = renderer->getActiveCamera();
+  uniforms_.prevViewProjection_ = uniforms_.viewProjection_;
+  uniforms_.prevHiZSize_ = uniforms_.hiZSize_;
+  uniforms_.viewProjection_ = camera->uniforms_.worldToView_ * camera->uniforms_.projection_;
+  uniforms_.hiZSize_ = maths::uvec4(size.x, size.y, hiZLevelCount(size), actorCapacity_);
+  render::gpuBufferUpdate(context, &uniforms_, 0u, sizeof(uniforms_), &uniformBuffer_);
+
+  //Draw commands and the pyramid may still be in use by the previous frame
+  memoryBarrier(commandBuffer,
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  pushConstants_ = {};
+  pushConstants_.actorCount_ = actorCount;
+  pushConstants_.phase_ = 0u;
+  render::descriptorSetBind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0u, &descriptorSet_, 1u);
+  render::pushConstants(commandBuffer, pipelineLayout_, 0u, &pushConstants_);
+  render::computePipelineBind(commandBuffer, cullPipeline_);
+  render::computeDispatch(commandBuffer, (actorCount + 63u) / 64u, 1u, 1u);
+
+  memoryBarrier(commandBuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+void occlusion_culling_t::buildHiZ(render::command_buffer_t commandBuffer, renderer_t* renderer)
+{
+  render::depth_stencil_buffer_t depthBuffer = renderer->getFrameBuffer(frameBuffer_)->getDepthBuffer();
+  depthBufferBarrier(commandBuffer, depthBuffer,
+    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+  render::descriptorSetBind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0u, &descriptorSet_, 1u);
+
+  //First level reads the depth buffer, the rest downsample the previous level
+  maths::uvec2 size(uniforms_.hiZSize_.x, uniforms_.hiZSize_.y);
+  uint32_t levelCount = uniforms_.hiZSize_.z;
+  for (uint32_t level(0); level < levelCount; ++level)
+  {
+    maths::uvec2 srcSize = level == 0u ? size : hiZLevelSize(size, level - 1u);
+    maths::uvec2 dstSize = hiZLevelSize(size, level);
+    pushConstants_.srcOffset_ = level == 0u ? 0u : hiZLevelOffset(size, level - 1u);
+    pushConstants_.dstOffset_ = hiZLevelOffset(size, level);
+    pushConstants_.srcSize_[0] = srcSize.x;
+    pushConstants_.srcSize_[1] = srcSize.y;
+    pushConstants_.dstSize_[0] = dstSize.x;
+    pushConstants_.dstSize_[1] = dstSize.y;
+
+    if (level == 0u)
+    {
+      render::computePipelineBind(commandBuffer, hiZFirstLevelPipeline_);
+    }
+    else
+    {
+      memoryBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+      if (level == 1u)
+        render::computePipelineBind(commandBuffer, hiZDownsamplePipeline_);
+    }
+
+    render::pushConstants(commandBuffer, pipelineLayout_, 0u, &pushConstants_);
+    render::computeDispatch(commandBuffer, (dstSize.x + 7u) / 8u, (dstSize.y + 7u) / 8u, 1u);
+  }
+
+  depthBufferBarrier(commandBuffer, depthBuffer,
+    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+
+  memoryBarrier(commandBuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void occlusion_culling_t::cullSecondPhase(render::command_buffer_t commandBuffer)
+{
+  pushConstants_.phase_ = 1u;
+  render::descriptorSetBind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0u, &descriptorSet_, 1u);
+  render::pushConstants(commandBuffer, pipelineLayout_, 0u, &pushConstants_);
+  render::computePipelineBind(commandBuffer, cullPipeline_);
+  render::computeDispatch(commandBuffer, (pushConstants_.actorCount_ + 63u) / 64u, 1u, 1u);
+
+  memoryBarrier(commandBuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
@@ -28,7 +28,7 @@ render_target_t::render_target_t(uint32_t width, uint32_t height,
 
   target_ = {};
   depthStencilBuffer_ = {};
-  render::texture2DCreate(context, width, height, 1u, format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, core::render::texture_sampler_t(), &target_);
+  render::texture2DCreate(context, width, height, 1u, format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, core::render::texture_sampler_t(), &target_);
   render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &target_);
 
   if(depthBuffer)
@@ -39,8 +39,8 @@ render_target_t::render_target_t(uint32_t width, uint32_t height,
 void render_target_t::destroy(renderer_t* renderer)
 {
   render::context_t& context = renderer->getContext();
-  render::textureDestroy(context, &target_);
+  render::textureDestroyDeferred(&context, &target_);
 
   if (hasDepthBuffer_)
-    render::depthStencilBufferDestroy(context, &depthStencilBuffer_);
+    render::depthStencilBufferDestroyDeferred(&context, &depthStencilBuffer_);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 
+#include "core/cpu-profiler.h"
 #include "core/maths.h"
 #include "core/mesh.h"
 #include "core/render.h"
@@ -42,13 +43,17 @@ static const char* gTextureBlitFragmentShaderSource = R"(
 renderer_t::renderer_t()
 :context_(),
  backBuffer_(NULL_HANDLE),
- activeCamera_(NULL_HANDLE)
+ activeCamera_(NULL_HANDLE),
+ hdrFormat_(VK_FORMAT_R16G16B16A16_SFLOAT),
+ actorDescriptorSetCount_(0u)
 {}
 
 renderer_t::~renderer_t()
 {
   if (context_.instance_ != VK_NULL_HANDLE)
   {
+    render::contextFlush(context_);
+
     actor_t* actors;
     uint32_t count = actors_.getData(&actors);
     for (uint32_t i = 0; i < count; ++i)
@@ -84,6 +89,9 @@ renderer_t::~renderer_t()
     for (uint32_t i = 0; i < count; ++i)
       shaders[i].destroy(this);
 
+    //Materials and render targets queue their objects. The device is idle so they can be destroyed now
+    render::deferredDestructionFlush(&context_);
+
     for (uint32_t i(0); i < releasedCommandBuffers_.size(); ++i)
       releasedCommandBuffers_[i].cleanup();
 
@@ -99,19 +107,51 @@ renderer_t::~renderer_t()
       mesh::destroy(context_, &fullScreenQuad_);
     }
 
+    lightManager_.destroy(this);
+    occlusionCulling_.destroy(this);
+    render::gpuProfilerDestroy(context_, &gpuProfiler_);
     render::descriptorSetLayoutDestroy(context_, &globalsDescriptorSetLayout_);
     render::descriptorSetLayoutDestroy(context_, &objectDescriptorSetLayout_);
     render::descriptorPoolDestroy(context_, &globalDescriptorPool_);
+    for (uint32_t i(0); i < actorDescriptorPools_.size(); ++i)
+      render::descriptorPoolDestroy(context_, &actorDescriptorPools_[i]);
+
+    for (uint32_t i(0); i < actorAllocators_.size(); ++i)
+    {
+      render::gpuAllocatorDestroy(context_, actorAllocators_[i]);
+      delete actorAllocators_[i];
+    }
+
     render::contextDestroy(&context_);
   }
 }
 
-void renderer_t::initialize(const char* title, uint32_t imageCount, const window::window_t& window)
+void renderer_t::initialize(const char* title, uint32_t imageCount, const window::window_t& window, render::hdr_format_e hdrFormat)
 {
   render::contextCreate(title, "", window, imageCount, &context_);
+  initializeResources(hdrFormat);
+}
+
+void renderer_t::initializeHeadless(const char* title, uint32_t imageCount, uint32_t width, uint32_t height, render::hdr_format_e hdrFormat)
+{
+  render::contextCreateHeadless(title, "", width, height, imageCount, &context_);
+  initializeResources(hdrFormat);
+}
+
+void renderer_t::initializeResources(render::hdr_format_e hdrFormat)
+{
+  hdrFormat_ = render::getHDRFormat(context_, hdrFormat);
+
+  //Globals: camera uniforms, lights, cluster light ranges and light indices
+  render::descriptor_binding_t globalsBindings[4] = {
+    { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT },
+    { render::descriptor_t::type::STORAGE_BUFFER, 1, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT },
+    { render::descriptor_t::type::STORAGE_BUFFER, 2, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT },
+    { render::descriptor_t::type::STORAGE_BUFFER, 3, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT }
+  };
+  render::descriptorSetLayoutCreate(context_, globalsBindings, 4u, &globalsDescriptorSetLayout_);
 
   render::descriptor_binding_t binding = { render::descriptor_t::type::UNIFORM_BUFFER, 0, render::descriptor_t::stage::VERTEX | render::descriptor_t::stage::FRAGMENT };
-  render::descriptorSetLayoutCreate(context_, &binding, 1u, &globalsDescriptorSetLayout_);
   render::descriptorSetLayoutCreate(context_, &binding, 1u, &objectDescriptorSetLayout_);
 
   render::descriptorPoolCreate(context_, 1000u,
@@ -121,6 +161,11 @@ void renderer_t::initialize(const char* title, uint32_t imageCount, const window
     render::storage_image_count(1000u),
     &globalDescriptorPool_);
 
+  lightManager_.initialize(this);
+  occlusionCulling_.initialize(this);
+
+  //One set of queries more than images in the swapchain so results are usually available when read
+  render::gpuProfilerCreate(context_, context_.swapChain_.imageCount_ + 1u, 64u, &gpuProfiler_);
   
   shader_handle_t shader = shaderCreate("../../shaders/textureBlit.shader");
   textureBlit_ = materialCreate(shader);
@@ -154,6 +199,16 @@ material_t* renderer_t::getMaterial(material_handle_t handle)
   return materials_.get(handle);
 }
 
+void renderer_t::materialDestroy(material_handle_t handle)
+{
+  material_t* material = materials_.get(handle);
+  if (material)
+  {
+    material->destroy(this);
+    materials_.remove(handle);
+  }
+}
+
 
 render_target_handle_t renderer_t::renderTargetCreate(uint32_t width, uint32_t height,
   VkFormat format,
@@ -168,6 +223,16 @@ render_target_t* renderer_t::getRenderTarget(render_target_handle_t handle)
   return renderTargets_.get(handle);
 }
 
+void renderer_t::renderTargetDestroy(render_target_handle_t handle)
+{
+  render_target_t* renderTarget = renderTargets_.get(handle);
+  if (renderTarget)
+  {
+    renderTarget->destroy(this);
+    renderTargets_.remove(handle);
+  }
+}
+
 frame_buffer_handle_t renderer_t::frameBufferCreate(render_target_handle_t* renderTargets, uint32_t targetCount,
   VkImageLayout* initialLayouts, VkImageLayout* finalLayouts)
 {
@@ -191,6 +256,26 @@ mesh::mesh_t* renderer_t::getMesh(mesh_handle_t handle)
   return meshes_.get(handle);
 }
 
+void renderer_t::meshDestroy(mesh_handle_t handle)
+{
+  mesh::mesh_t* mesh = meshes_.get(handle);
+  if (mesh)
+  {
+    mesh::destroyDeferred(&context_, mesh);
+    meshes_.remove(handle);
+  }
+}
+
+occluder_handle_t renderer_t::addOccluder(const occlusion::occluder_t& occluder)
+{
+  return occluders_.add(occluder);
+}
+
+occlusion::occluder_t* renderer_t::getOccluder(occluder_handle_t handle)
+{
+  return occluders_.get(handle);
+}
+
 actor_handle_t renderer_t::actorCreate(const char* name, mesh_handle_t mesh, material_handle_t material, maths::mat4 transform)
 {
   bkk::core::handle_t transformHandle = transformManager_.createTransform(transform);
@@ -214,6 +299,16 @@ void renderer_t::actorSetTransform(actor_handle_t actor, const maths::mat4& newT
   transformManager_.setTransform(actors_.get(actor)->getTransform(), newTransform);
 }
 
+void renderer_t::actorSetOccluder(actor_handle_t actor, occluder_handle_t occluder)
+{
+  actors_.get(actor)->occluder_ = occluder;
+}
+
+maths::mat4* renderer_t::getWorldTransform(transform_handle_t transform)
+{
+  return transformManager_.getWorldMatrix(transform);
+}
+
 camera_handle_t renderer_t::addCamera(const camera_t& camera)
 {
   return cameras_.add(camera);
@@ -236,11 +331,12 @@ bool renderer_t::setupCamera(camera_handle_t handle)
     return false;
 
   camera->update(this);
+  lightManager_.update(*camera, this);
 
   ////Culling
   actor_t* allActors;
   uint32_t actorCount = actors_.getData(&allActors);
-  camera->cull(allActors, actorCount);
+  camera->cull(this, allActors, actorCount);
 
   activeCamera_ = handle;
 
@@ -259,7 +355,10 @@ int renderer_t::getVisibleActors(camera_handle_t cameraHandle, actor_t** actors)
 
 void renderer_t::presentFrame()
 {
+  BKK_ZONE("renderer_t::presentFrame");
+
   render::presentFrame(&context_, &renderComplete_, 1u);
+  render::gpuProfilerEndFrame(&gpuProfiler_);
 
   for (uint32_t i(0); i < releasedCommandBuffers_.size(); ++i)
     releasedCommandBuffers_[i].cleanup();
@@ -269,6 +368,12 @@ void renderer_t::presentFrame()
 
 void renderer_t::update()
 {
+  BKK_ZONE("renderer_t::update");
+
+  //Resolution scale used by the offscreen passes of this frame
+  if (render::gpuProfilerBeginFrame(context_, &gpuProfiler_))
+    dynamicResolution_.update(gpuProfiler_.frameTime_);
+
   //Update transform manager and uniform buffer
   transformManager_.update();
 
@@ -285,7 +390,7 @@ void renderer_t::update()
 
 void renderer_t::createTextureBlitResources()
 {
-  render_target_handle_t colorBufferHandle = renderTargetCreate(context_.swapChain_.imageWidth_, context_.swapChain_.imageHeight_, VK_FORMAT_R32G32B32A32_SFLOAT, false);
+  render_target_handle_t colorBufferHandle = renderTargetCreate(context_.swapChain_.imageWidth_, context_.swapChain_.imageHeight_, hdrFormat_, false);
   backBuffer_ = frameBufferCreate(&colorBufferHandle, 1u);
 
   fullScreenQuad_ = mesh::fullScreenQuad(context_);
@@ -360,6 +465,40 @@ render::descriptor_pool_t renderer_t::getDescriptorPool() {
   return globalDescriptorPool_;
 }
 
+render::gpu_memory_allocator_t* renderer_t::getActorAllocator()
+{
+  //Room for a mat4 at the largest uniform buffer offset alignment allowed by the spec
+  const VkDeviceSize slotSize = 256u + sizeof(maths::mat4);
+  if (actorAllocators_.empty() || actorAllocators_.back()->size_ - actorAllocators_.back()->head_ < slotSize)
+  {
+    render::gpu_memory_allocator_t* allocator = new render::gpu_memory_allocator_t;
+    render::gpuAllocatorCreate(context_, ACTOR_BLOCK_SIZE * 256u, 0xFFFF, render::gpu_memory_type_e::HOST_VISIBLE_COHERENT, allocator);
+    actorAllocators_.push_back(allocator);
+  }
+
+  return actorAllocators_.back();
+}
+
+render::descriptor_pool_t renderer_t::getActorDescriptorPool()
+{
+  if (actorDescriptorPools_.empty() || actorDescriptorSetCount_ == ACTOR_BLOCK_SIZE)
+  {
+    render::descriptor_pool_t pool;
+    render::descriptorPoolCreate(context_, ACTOR_BLOCK_SIZE,
+      render::combined_image_sampler_count(0u),
+      render::uniform_buffer_count(ACTOR_BLOCK_SIZE),
+      render::storage_buffer_count(0u),
+      render::storage_image_count(0u),
+      &pool);
+
+    actorDescriptorPools_.push_back(pool);
+    actorDescriptorSetCount_ = 0u;
+  }
+
+  ++actorDescriptorSetCount_;
+  return actorDescriptorPools_.back();
+}
+
 void renderer_t::releaseCommandBuffer(const command_buffer_t* cmdBuffer)
 {
   releasedCommandBuffers_.push_back(*cmdBuffer);
@@ -97,6 +97,34 @@ static void deserializeTextureDescription(pugi::xml_node resourceNode, uint32_t
   }
 }
 
+static void deserializeSpecializationConstantDescription(pugi::xml_node constantNode, uint32_t id, specialization_constant_desc_t* constantDesc)
+{
+  constantDesc->name_ = constantNode.attribute("Name").value();
+  constantDesc->id_ = id;
+  constantDesc->type_ = specialization_constant_desc_t::INT;
+  constantDesc->defaultValue_ = 0u;
+
+  const char* type = constantNode.attribute("Type").value();
+  pugi::xml_attribute value = constantNode.attribute("Value");
+  if (strcmp(type, "int") == 0) {
+    constantDesc->type_ = specialization_constant_desc_t::INT;
+    constantDesc->defaultValue_ = (uint32_t)value.as_int();
+  }
+  else if (strcmp(type, "uint") == 0) {
+    constantDesc->type_ = specialization_constant_desc_t::UINT;
+    constantDesc->defaultValue_ = value.as_uint();
+  }
+  else if (strcmp(type, "float") == 0) {
+    constantDesc->type_ = specialization_constant_desc_t::FLOAT;
+    float f = value.as_float();
+    memcpy(&constantDesc->defaultValue_, &f, sizeof(float));
+  }
+  else if (strcmp(type, "bool") == 0) {
+    constantDesc->type_ = specialization_constant_desc_t::BOOL;
+    constantDesc->defaultValue_ = value.as_bool() ? 1u : 0u;
+  }
+}
+
 static void fieldDescriptionToGLSL(const buffer_desc_t& bufferDesc, const buffer_desc_t::field_desc_t& fieldDesc, std::string& code )
 {
   if (fieldDesc.type_ == buffer_desc_t::field_desc_t::INT){
@@ -274,13 +302,57 @@ static std::string generateGlslCommon()
       mat4 projection;
       mat4 projectionInverse;
       vec4 imageSize;
+      vec4 resolutionScale;
     }camera;
 
+    //Offscreen render targets are rendered in a sub-rectangle when dynamic resolution is enabled.
+    //Full screen passes have to sample them with the scaled uvs
+    vec2 scaledUV(vec2 uv)
+    {
+      return uv * camera.resolutionScale.xy;
+    }
+
     layout(set = 1, binding = 0) uniform _model
     {
       mat4 transform;
     }model; 
 
+    struct light_t
+    {
+      vec4 position;
+      vec3 color;
+      float radius;
+    };
+
+    layout(std430, set = 0, binding = 1) readonly buffer _lights
+    {
+      light_t data[];
+    }lights;
+
+    layout(std430, set = 0, binding = 2) readonly buffer _clusters
+    {
+      uvec4 size;
+      vec4 depthParams;
+      uvec2 range[];
+    }clusters;
+
+    layout(std430, set = 0, binding = 3) readonly buffer _lightIndices
+    {
+      uint data[];
+    }lightIndices;
+
+    //Offset and count in lightIndices of the lights affecting a view space position
+    uvec2 getLightRange(vec3 positionVS)
+    {
+      vec4 positionCS = camera.projection * vec4(positionVS, 1.0);
+      vec2 ndc = positionCS.xy / positionCS.w;
+      uvec3 cluster;
+      cluster.xy = uvec2(clamp(ivec2((ndc * 0.5 + 0.5) * vec2(clusters.size.xy)), ivec2(0), ivec2(clusters.size.xy) - 1));
+      float slice = log(max(-positionVS.z, clusters.depthParams.x) / clusters.depthParams.x) * clusters.depthParams.y;
+      cluster.z = uint(clamp(int(slice), 0, int(clusters.size.z) - 1));
+      return clusters.range[cluster.x + cluster.y * clusters.size.x + cluster.z * clusters.size.x * clusters.size.y];
+    }
+
   )";
 
   return code;
@@ -289,13 +361,59 @@ static std::string generateGlslCommon()
 
 static void generateGlslHeader(const std::vector<texture_desc_t>& textures,
                                const std::vector<buffer_desc_t>& buffers,
+                               const std::vector<specialization_constant_desc_t>& constants,
                                const char* version,
+                               const char* multiviewHelpers,
                                std::string& generatedCode)
 {
   generatedCode = "#version ";
   generatedCode += version;
   generatedCode += "\n";
 
+  //VIEW_INDEX is the view being rendered in passes with a view mask and 0 otherwise
+  generatedCode += multiviewHelpers;
+
+  //Specialization constants
+  for (uint32_t i = 0; i < constants.size(); ++i)
+  {
+    generatedCode += "layout(constant_id = ";
+    generatedCode += intToString(constants[i].id_);
+    generatedCode += ") const ";
+
+    char value[32];
+    switch (constants[i].type_)
+    {
+    case specialization_constant_desc_t::INT:
+      generatedCode += "int ";
+      sprintf(value, "%d", (int32_t)constants[i].defaultValue_);
+      break;
+    case specialization_constant_desc_t::UINT:
+      generatedCode += "uint ";
+      sprintf(value, "%uu", constants[i].defaultValue_);
+      break;
+    case specialization_constant_desc_t::FLOAT:
+    {
+      generatedCode += "float ";
+      float f;
+      memcpy(&f, &constants[i].defaultValue_, sizeof(float));
+      sprintf(value, "%.9g", f);
+      if (strpbrk(value, ".eEn") == nullptr)
+        strcat(value, ".0");
+      break;
+    }
+    case specialization_constant_desc_t::BOOL:
+    default:
+      generatedCode += "bool ";
+      sprintf(value, "%s", constants[i].defaultValue_ != 0 ? "true" : "false");
+      break;
+    }
+
+    generatedCode += constants[i].name_;
+    generatedCode += " = ";
+    generatedCode += value;
+    generatedCode += ";\n";
+  }
+
   //Data structures declarations
   for (uint32_t i = 0; i < buffers.size(); ++i)
   {
@@ -386,7 +504,8 @@ buffers_()
 }
 
 shader_t::shader_t(const char* file, renderer_t* renderer)
-:descriptorSetLayout_()
+:descriptorSetLayout_(),
+ depthOnlyFragmentShader_()
 {
   initializeFromFile(file, renderer);
 }
@@ -420,9 +539,14 @@ void shader_t::destroy(renderer_t* renderer)
   if (descriptorSetLayout_.handle_ != VK_NULL_HANDLE )
     render::descriptorSetLayoutDestroy(renderer->getContext(), &descriptorSetLayout_);
 
+  if (depthOnlyFragmentShader_.handle_ != VK_NULL_HANDLE)
+    render::shaderDestroy(renderer->getContext(), &depthOnlyFragmentShader_);
+
   textures_.clear();
   buffers_.clear();
+  specializationConstants_.clear();
   pass_.clear();
+  depthOnlyVariant_.clear();
 }
 
 bool shader_t::initializeFromFile(const char* file, renderer_t* renderer)
@@ -475,11 +599,23 @@ bool shader_t::initializeFromFile(const char* file, renderer_t* renderer)
       }
     }
 
+    //Specialization constants. Ids are assigned in declaration order
+    pugi::xml_node specializationNode = shaderNode.child("Specialization");
+    if (specializationNode)
+    {
+      for (pugi::xml_node constantNode = specializationNode.child("Constant"); constantNode; constantNode = constantNode.next_sibling("Constant"))
+      {
+        specialization_constant_desc_t constantDesc;
+        deserializeSpecializationConstantDescription(constantNode, (uint32_t)specializationConstants_.size(), &constantDesc);
+        specializationConstants_.push_back(constantDesc);
+      }
+    }
+
+    render::context_t& context = renderer->getContext();
+
     //Generate glsl code that will be appended to every shader in the file
     std::string glslHeader;
-    generateGlslHeader(textures_, buffers_, shaderNode.attribute("Version").value(), glslHeader);
-        
-    render::context_t& context = renderer->getContext();
+    generateGlslHeader(textures_, buffers_, specializationConstants_, shaderNode.attribute("Version").value(), render::getMultiviewHelpersGLSL(context), glslHeader);
 
     //Descriptor set layout
     uint32_t descriptorCount = (uint32_t)(buffers_.size() + textures_.size());
@@ -599,6 +735,20 @@ bool shader_t::initializeFromFile(const char* file, renderer_t* renderer)
       pipelineDesc.vertexShader_ = vertexShader;
       pipelineDesc.fragmentShader_ = fragmentShader;
       graphicsPipelineDescriptions_.push_back(pipelineDesc);
+
+      //Depth only variant for depth pre-passes. Passes with custom depth output can opt out
+      bool depthOnly = depthWrite;
+      pugi::xml_node depthPrepass = passNode.child("DepthPrepass");
+      if (depthPrepass && strcmp(depthPrepass.attribute("Value").value(), "Off") == 0)
+        depthOnly = false;
+
+      depthOnlyVariant_.push_back(depthOnly);
+      if (depthOnly && depthOnlyFragmentShader_.handle_ == VK_NULL_HANDLE)
+      {
+        shaderCode = glslHeader;
+        shaderCode += "void main(){}\n";
+        render::shaderCreateFromGLSLSource(context, render::shader_t::FRAGMENT_SHADER, shaderCode.c_str(), &depthOnlyFragmentShader_);
+      }
     }
 
     return true;
@@ -608,29 +758,59 @@ bool shader_t::initializeFromFile(const char* file, renderer_t* renderer)
 }
 
 core::render::graphics_pipeline_t shader_t::getPipeline(const char* name, frame_buffer_handle_t framebuffer, renderer_t* renderer)
+{
+  return getPipeline(name, framebuffer, getDefaultSpecialization(), renderer);
+}
+
+core::render::graphics_pipeline_t shader_t::getPipeline(uint32_t pass, frame_buffer_handle_t fb, renderer_t* renderer)
+{
+  return getPipeline(pass, fb, getDefaultSpecialization(), renderer);
+}
+
+core::render::graphics_pipeline_t shader_t::getPipeline(const char* name, frame_buffer_handle_t framebuffer, const std::vector<uint32_t>& specialization, renderer_t* renderer)
 {
   uint64_t passName = hashString(name);
   for (uint32_t i(0); i < pass_.size(); ++i)
   {
     if (passName == pass_[i])
-      return getPipeline(i, framebuffer, renderer);
+      return getPipeline(i, framebuffer, specialization, renderer);
   }
 
   core::render::graphics_pipeline_t nullPipeline = {};
   return nullPipeline;
 }
 
-core::render::graphics_pipeline_t shader_t::getPipeline(uint32_t pass, frame_buffer_handle_t fb, renderer_t* renderer)
+core::render::graphics_pipeline_t shader_t::getPipeline(uint32_t pass, frame_buffer_handle_t fb, const std::vector<uint32_t>& specialization, renderer_t* renderer)
 {
-  std::vector<core::render::graphics_pipeline_t>* pipelines = graphicsPipelines_.get(fb);
+  return getPipelines(fb, specialization, renderer)[pass];
+}
+
+core::render::graphics_pipeline_t shader_t::getDepthOnlyPipeline(const char* name, frame_buffer_handle_t framebuffer, const std::vector<uint32_t>& specialization, renderer_t* renderer)
+{
+  uint64_t passName = hashString(name);
+  for (uint32_t i(0); i < pass_.size(); ++i)
+  {
+    if (passName == pass_[i])
+      return getPipelines(framebuffer, specialization, renderer)[pass_.size() + i];
+  }
+
+  core::render::graphics_pipeline_t nullPipeline = {};
+  return nullPipeline;
+}
+
+std::vector<core::render::graphics_pipeline_t>& shader_t::getPipelines(frame_buffer_handle_t fb, const std::vector<uint32_t>& specialization, renderer_t* renderer)
+{
+  assert(specialization.size() == specializationConstants_.size());
+
+  pipeline_key_t key = { fb, specialization };
+  std::vector<core::render::graphics_pipeline_t>* pipelines = graphicsPipelines_.get(key);
   if (pipelines)
   {
-    return pipelines->operator[](pass);
+    return *pipelines;
   }
   else
   {
-    //Create all the pipelines and return the pipeline for the selected pass
-    core::render::graphics_pipeline_t pipeline = {};
+    //Create all the pipelines
     uint32_t width = 0u;
     uint32_t height = 0u;
     VkRenderPass renderPass = {};
@@ -640,20 +820,43 @@ core::render::graphics_pipeline_t shader_t::getPipeline(uint32_t pass, frame_buf
     height = frameBuffer->getHeight();
     renderPass = frameBuffer->getRenderPass().handle_;
 
+    core::render::specialization_constants_t constants;
+    for (uint32_t i = 0; i < specializationConstants_.size(); ++i)
+    {
+      core::render::specializationConstantSet(specializationConstants_[i].id_, specialization[i], &constants);
+    }
+
     uint32_t count = (uint32_t)pass_.size();
-    std::vector<core::render::graphics_pipeline_t> pipelines(count);
+    std::vector<core::render::graphics_pipeline_t> newPipelines(2*count);
     for (uint32_t i = 0; i < count ; ++i)
     {
       graphicsPipelineDescriptions_[i].viewPort_ = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
       graphicsPipelineDescriptions_[i].scissorRect_ = { { 0,0 },{ width, height } };
-      bkk::core::render::graphics_pipeline_t pipeline;
+      graphicsPipelineDescriptions_[i].specialization_ = constants;
       bkk::core::render::graphicsPipelineCreate(renderer->getContext(), 
         renderPass, 0u, vertexFormats_[i], pipelineLayouts_[i], 
-        graphicsPipelineDescriptions_[i], &pipelines[i]);
+        graphicsPipelineDescriptions_[i], &newPipelines[i]);
+
+      newPipelines[count + i] = {};
+      if (depthOnlyVariant_[i] && frameBuffer->hasDepthBuffer())
+      {
+        core::render::graphics_pipeline_t::description_t depthOnlyDesc = graphicsPipelineDescriptions_[i];
+        depthOnlyDesc.fragmentShader_ = depthOnlyFragmentShader_;
+        depthOnlyDesc.blendState_.resize(frameBuffer->getTargetCount());
+        for (uint32_t j(0); j < depthOnlyDesc.blendState_.size(); ++j)
+        {
+          depthOnlyDesc.blendState_[j] = {};
+          depthOnlyDesc.blendState_[j].colorWriteMask = 0u;
+        }
 
+        bkk::core::render::graphicsPipelineCreate(renderer->getContext(),
+          renderPass, 0u, vertexFormats_[i], pipelineLayouts_[i],
+          depthOnlyDesc, &newPipelines[count + i]);
+      }
     }
-    graphicsPipelines_.add(fb, pipelines);
-    return pipelines[pass];
+
+    graphicsPipelines_.add(key, newPipelines);
+    return *graphicsPipelines_.get(key);
   }
 }
 
@@ -672,6 +875,33 @@ const std::vector<buffer_desc_t>& shader_t::getBufferDescriptions() const
   return buffers_;
 }
 
+const std::vector<specialization_constant_desc_t>& shader_t::getSpecializationConstantDescriptions() const
+{
+  return specializationConstants_;
+}
+
+std::vector<uint32_t> shader_t::getDefaultSpecialization() const
+{
+  std::vector<uint32_t> values(specializationConstants_.size());
+  for (uint32_t i(0); i < specializationConstants_.size(); ++i)
+  {
+    values[i] = specializationConstants_[i].defaultValue_;
+  }
+
+  return values;
+}
+
+int32_t shader_t::getSpecializationConstantIndexFromName(const char* name) const
+{
+  for (uint32_t i(0); i < specializationConstants_.size(); ++i)
+  {
+    if (specializationConstants_[i].name_.compare(name) == 0)
+      return (int32_t)i;
+  }
+
+  return -1;
+}
+
 uint32_t shader_t::getPassIndexFromName(const char* pass) const
 {
   if (pass != nullptr)
@@ -0,0 +1,388 @@
+#include "framework/shadow-atlas.h"
+
+#include <math.h>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb_rect_pack.h"
+
+using namespace bkk::core;
+using namespace bkk::framework;
+
+enum tile_state_e
+{
+  TILE_VALID = 0,
+  TILE_INVALIDATED = 1,   //Light or casters changed. Rendered when there is budget
+  TILE_REALLOCATED = 2    //Tile has been moved in the atlas. Contents are undefined so it is always rendered
+};
+
+static const maths::vec3 gFaceDirection[6] = { maths::vec3(1.0f, 0.0f, 0.0f), maths::vec3(-1.0f, 0.0f, 0.0f),
+                                               maths::vec3(0.0f, 1.0f, 0.0f), maths::vec3(0.0f, -1.0f, 0.0f),
+                                               maths::vec3(0.0f, 0.0f, 1.0f), maths::vec3(0.0f, 0.0f, -1.0f) };
+
+//Perspective projection with depth in the [0,1] range
+static maths::mat4 shadowProjection(float fov, float nearPlane, float farPlane)
+{
+  maths::mat4 depthRemap;
+  depthRemap[10] = 0.5f;
+  depthRemap[14] = 0.5f;
+  return maths::perspectiveProjectionMatrix(fov, 1.0f, nearPlane, farPlane) * depthRemap;
+}
+
+shadow_atlas_t::shadow_atlas_t()
+:size_(0u),
+ minTileSize_(0u),
+ maxTileSize_(0u),
+ tileUpdateBudget_(0u),
+ packingChanged_(false),
+ roundRobinTile_(0u),
+ texture_(),
+ renderPass_(),
+ frameBuffer_(),
+ tileBuffer_()
+{
+}
+
+void shadow_atlas_t::initialize(const render::context_t& context, uint32_t size, uint32_t minTileSize, uint32_t maxTileSize, uint32_t tileUpdateBudget)
+{
+  size_ = size;
+  minTileSize_ = minTileSize;
+  maxTileSize_ = maxTileSize;
+  tileUpdateBudget_ = tileUpdateBudget;
+
+  freeSlots_.resize(MAX_SHADOW_COUNT);
+  for (uint32_t i(0); i < MAX_SHADOW_COUNT; ++i)
+  {
+    freeSlots_[i] = MAX_SHADOW_COUNT - i - 1;
+  }
+
+  tiles_.resize(MAX_TILE_COUNT);
+  tileViewport_.resize(MAX_TILE_COUNT, maths::uvec4(0u, 0u, 0u, 0u));
+  tileShadow_.resize(MAX_TILE_COUNT, NULL_HANDLE);
+  tileInvalid_.resize(MAX_TILE_COUNT, TILE_VALID);
+  tilesToRender_.reserve(MAX_TILE_COUNT);
+
+  //Atlas texture
+  render::texture_sampler_t sampler = {};
+  sampler.wrapU_ = sampler.wrapV_ = sampler.wrapW_ = render::texture_sampler_t::wrap_mode::CLAMP_TO_EDGE;
+  sampler.mipmap_ = render::texture_sampler_t::filter_mode::NEAREST;
+  sampler.depthCompare_ = true;
+  render::texture2DCreate(context, size_, size_, 1u, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, sampler, &texture_);
+  render::textureChangeLayoutNow(context, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &texture_);
+
+  //Depth only render pass. Tiles not being rendered are preserved
+  render::render_pass_t::attachment_t attachment;
+  attachment.format_ = texture_.format_;
+  attachment.initialLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  attachment.finallLayout_ = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  attachment.storeOp_ = VK_ATTACHMENT_STORE_OP_STORE;
+  attachment.loadOp_ = VK_ATTACHMENT_LOAD_OP_LOAD;
+  attachment.samples_ = VK_SAMPLE_COUNT_1_BIT;
+  render::render_pass_t::subpass_t subpass;
+  subpass.depthStencilAttachmentIndex_ = 0;
+  render::renderPassCreate(context, &attachment, 1u, &subpass, 1u, nullptr, 0u, &renderPass_);
+  render::frameBufferCreate(context, size_, size_, renderPass_, &texture_.imageView_, &frameBuffer_);
+
+  render::gpuBufferCreate(context, render::gpu_buffer_t::usage::STORAGE_BUFFER, render::gpu_memory_type_e::HOST_VISIBLE_COHERENT,
+    tiles_.data(), MAX_TILE_COUNT * sizeof(shadow_tile_t), nullptr, &tileBuffer_);
+}
+
+void shadow_atlas_t::destroy(const render::context_t& context)
+{
+  if (tileBuffer_.handle_ != VK_NULL_HANDLE)
+  {
+    render::gpuBufferDestroy(context, nullptr, &tileBuffer_);
+    render::frameBufferDestroy(context, &frameBuffer_);
+    render::renderPassDestroy(context, &renderPass_);
+    render::textureDestroy(context, &texture_);
+  }
+}
+
+shadow_handle_t shadow_atlas_t::shadowCreate(const shadow_t& shadow)
+{
+  if (freeSlots_.empty())
+    return NULL_HANDLE;
+
+  shadow_t newShadow = shadow;
+  newShadow.firstTile_ = freeSlots_.back() * 6u;
+  newShadow.tileSize_ = minTileSize_;
+  freeSlots_.pop_back();
+
+  shadow_handle_t handle = shadows_.add(newShadow);
+  for (uint32_t i(0); i < newShadow.tileCount_; ++i)
+  {
+    tileShadow_[newShadow.firstTile_ + i] = handle;
+  }
+
+  packingChanged_ = true;
+  return handle;
+}
+
+shadow_handle_t shadow_atlas_t::spotShadowCreate(const maths::vec3& position, const maths::vec3& direction, float angle, float range)
+{
+  shadow_t shadow = {};
+  shadow.type_ = SPOT_LIGHT;
+  shadow.position_ = position;
+  shadow.direction_ = maths::normalize(direction);
+  shadow.angle_ = angle;
+  shadow.range_ = range;
+  shadow.tileCount_ = 1u;
+  return shadowCreate(shadow);
+}
+
+shadow_handle_t shadow_atlas_t::pointShadowCreate(const maths::vec3& position, float range)
+{
+  shadow_t shadow = {};
+  shadow.type_ = POINT_LIGHT;
+  shadow.position_ = position;
+  shadow.angle_ = (float)PI * 0.5f;
+  shadow.range_ = range;
+  shadow.tileCount_ = 6u;
+  return shadowCreate(shadow);
+}
+
+void shadow_atlas_t::shadowDestroy(shadow_handle_t handle)
+{
+  shadow_t* shadow = shadows_.get(handle);
+  if (shadow == nullptr)
+    return;
+
+  for (uint32_t i(0); i < shadow->tileCount_; ++i)
+  {
+    uint32_t tile = shadow->firstTile_ + i;
+    tileShadow_[tile] = NULL_HANDLE;
+    tileViewport_[tile] = maths::uvec4(0u, 0u, 0u, 0u);
+    tileInvalid_[tile] = TILE_VALID;
+    tiles_[tile].rect_ = maths::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+  }
+
+  freeSlots_.push_back(shadow->firstTile_ / 6u);
+  shadows_.remove(handle);
+  packingChanged_ = true;
+}
+
+void shadow_atlas_t::shadowSetTransform(shadow_handle_t handle, const maths::vec3& position, const maths::vec3& direction)
+{
+  shadow_t* shadow = shadows_.get(handle);
+  if (shadow != nullptr)
+  {
+    shadow->position_ = position;
+    shadow->direction_ = maths::normalize(direction);
+    shadowInvalidate(handle);
+  }
+}
+
+void shadow_atlas_t::shadowInvalidate(shadow_handle_t handle)
+{
+  shadow_t* shadow = shadows_.get(handle);
+  if (shadow != nullptr)
+  {
+    for (uint32_t i(0); i < shadow->tileCount_; ++i)
+    {
+      uint32_t tile = shadow->firstTile_ + i;
+      tileInvalid_[tile] = maths::maxValue(tileInvalid_[tile], (uint8_t)TILE_INVALIDATED);
+    }
+  }
+}
+
+uint32_t shadow_atlas_t::getFirstTile(shadow_handle_t handle)
+{
+  shadow_t* shadow = shadows_.get(handle);
+  return shadow ? shadow->firstTile_ : 0xFFFFFFFF;
+}
+
+void shadow_atlas_t::pack()
+{
+  shadow_t* shadows;
+  uint32_t shadowCount = shadows_.getData(&shadows);
+
+  //Pack all the tiles. If they don't fit, limit the maximum tile size and try again
+  std::vector<stbrp_rect> rects;
+  std::vector<stbrp_node> nodes(size_);
+  uint32_t sizeLimit = maxTileSize_;
+  while (true)
+  {
+    rects.clear();
+    for (uint32_t i(0); i < shadowCount; ++i)
+    {
+      uint32_t tileSize = maths::minValue(shadows[i].tileSize_, sizeLimit);
+      for (uint32_t face(0); face < shadows[i].tileCount_; ++face)
+      {
+        stbrp_rect rect = {};
+        rect.id = shadows[i].firstTile_ + face;
+        rect.w = rect.h = (stbrp_coord)tileSize;
+        rects.push_back(rect);
+      }
+    }
+
+    stbrp_context packContext;
+    stbrp_init_target(&packContext, size_, size_, nodes.data(), (int)nodes.size());
+    if (stbrp_pack_rects(&packContext, rects.data(), (int)rects.size()) == 1 || sizeLimit <= minTileSize_)
+      break;
+
+    sizeLimit /= 2;
+  }
+
+  //Tiles whose placement changed need to be rendered
+  float texelSize = 1.0f / (float)size_;
+  for (uint32_t i(0); i < rects.size(); ++i)
+  {
+    maths::uvec4 viewport(0u, 0u, 0u, 0u);
+    if (rects[i].was_packed)
+    {
+      viewport = maths::uvec4(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+    }
+
+    uint32_t tile = rects[i].id;
+    if (viewport.x != tileViewport_[tile].x || viewport.y != tileViewport_[tile].y || viewport.z != tileViewport_[tile].z)
+    {
+      tileViewport_[tile] = viewport;
+      tileInvalid_[tile] = TILE_REALLOCATED;
+      tiles_[tile].rect_ = maths::vec4(viewport.x * texelSize, viewport.y * texelSize, viewport.z * texelSize, viewport.w * texelSize);
+    }
+  }
+}
+
+void shadow_atlas_t::updateTileMatrix(const shadow_t& shadow, uint32_t face)
+{
+  maths::vec3 direction = shadow.type_ == POINT_LIGHT ? gFaceDirection[face] : shadow.direction_;
+  maths::vec3 up = fabsf(direction.y) > 0.99f ? maths::vec3(0.0f, 0.0f, 1.0f) : maths::vec3(0.0f, 1.0f, 0.0f);
+  maths::mat4 view = maths::lookAtMatrix(shadow.position_, shadow.position_ + direction, up);
+  tiles_[shadow.firstTile_ + face].worldToClip_ = view * shadowProjection(shadow.angle_, 0.01f * shadow.range_, shadow.range_);
+}
+
+void shadow_atlas_t::update(const render::context_t& context, const maths::mat4& worldToView, const maths::mat4& projection, uint32_t viewportHeight)
+{
+  //Tile size from the screen space radius of the light range. Tiles only shrink when they are four times bigger than needed
+  float projectionScale = 0.5f * fabsf(projection.data[5]) * viewportHeight;
+  shadow_t* shadows;
+  uint32_t shadowCount = shadows_.getData(&shadows);
+  for (uint32_t i(0); i < shadowCount; ++i)
+  {
+    maths::vec4 positionVS = maths::vec4(shadows[i].position_, 1.0f) * worldToView;
+    float distanceSq = maths::lengthSquared(positionVS.xyz());
+    float range = shadows[i].range_;
+
+    uint32_t tileSize = maxTileSize_;
+    if (distanceSq > range * range)
+    {
+      float screenRadius = positionVS.z > range ? 0.0f : projectionScale * range / sqrtf(distanceSq - range * range);
+      tileSize = minTileSize_;
+      while (tileSize < maxTileSize_ && (float)tileSize < 2.0f * screenRadius)
+      {
+        tileSize *= 2;
+      }
+    }
+
+    if (tileSize > shadows[i].tileSize_ || tileSize * 2 < shadows[i].tileSize_)
+    {
+      shadows[i].tileSize_ = tileSize;
+      packingChanged_ = true;
+    }
+  }
+
+  if (packingChanged_)
+  {
+    pack();
+    packingChanged_ = false;
+  }
+
+  //Reallocated tiles are always rendered
+  tilesToRender_.clear();
+  for (uint32_t tile(0); tile < MAX_TILE_COUNT; ++tile)
+  {
+    if (tileInvalid_[tile] == TILE_REALLOCATED && tileViewport_[tile].z > 0u)
+    {
+      tilesToRender_.push_back(tile);
+    }
+  }
+
+  //Invalidated tiles use the budget first, the rest is used to refresh valid tiles round-robin
+  uint32_t budget = tileUpdateBudget_;
+  for (uint32_t i(0); i < MAX_TILE_COUNT && budget > 0; ++i)
+  {
+    uint32_t tile = (roundRobinTile_ + i) % MAX_TILE_COUNT;
+    if (tileInvalid_[tile] == TILE_INVALIDATED && tileViewport_[tile].z > 0u)
+    {
+      tilesToRender_.push_back(tile);
+      --budget;
+    }
+  }
+
+  for (uint32_t i(0); i < MAX_TILE_COUNT && budget > 0; ++i)
+  {
+    uint32_t tile = (roundRobinTile_ + i) % MAX_TILE_COUNT;
+    if (tileInvalid_[tile] == TILE_VALID && tileShadow_[tile] != NULL_HANDLE && tileViewport_[tile].z > 0u)
+    {
+      tilesToRender_.push_back(tile);
+      roundRobinTile_ = (tile + 1) % MAX_TILE_COUNT;
+      --budget;
+    }
+  }
+
+  for (uint32_t i(0); i < tilesToRender_.size(); ++i)
+  {
+    uint32_t tile = tilesToRender_[i];
+    const shadow_t* shadow = shadows_.get(tileShadow_[tile]);
+    updateTileMatrix(*shadow, tile - shadow->firstTile_);
+    tileInvalid_[tile] = TILE_VALID;
+  }
+
+  render::gpuBufferUpdate(context, tiles_.data(), 0u, MAX_TILE_COUNT * sizeof(shadow_tile_t), &tileBuffer_);
+}
+
+uint32_t shadow_atlas_t::getTilesToRender(const uint32_t** tiles) const
+{
+  *tiles = tilesToRender_.data();
+  return (uint32_t)tilesToRender_.size();
+}
+
+bool shadow_atlas_t::isInTileRange(uint32_t tile, const maths::vec3& aabbMin, const maths::vec3& aabbMax)
+{
+  if (tile >= MAX_TILE_COUNT)
+    return false;
+
+  const shadow_t* shadow = shadows_.get(tileShadow_[tile]);
+  if (shadow == nullptr)
+    return false;
+
+  //Distance from the light to the box
+  float distanceSq = 0.0f;
+  for (uint32_t i(0); i < 3; ++i)
+  {
+    float d = maths::maxValue(maths::maxValue(aabbMin[i] - shadow->position_[i], 0.0f), shadow->position_[i] - aabbMax[i]);
+    distanceSq += d * d;
+  }
+
+  return distanceSq <= shadow->range_ * shadow->range_;
+}
+
+void shadow_atlas_t::renderPassBegin(const render::context_t& context, render::command_buffer_t commandBuffer)
+{
+  render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, &texture_);
+
+  //The atlas render pass already loads the depth, so it is used as is instead of the no-clear pass derived by the frame buffer.
+  //The clear value is ignored, tiles are cleared one at a time by setTile
+  VkClearValue clearValue = {};
+  clearValue.depthStencil = { 1.0f, 0 };
+  render::commandBufferRenderPassBegin(context, &frameBuffer_, &clearValue, 1u, commandBuffer);
+}
+
+void shadow_atlas_t::setTile(render::command_buffer_t commandBuffer, uint32_t tile)
+{
+  const maths::uvec4& viewport = tileViewport_[tile];
+
+  VkClearAttachment clearAttachment = {};
+  clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  clearAttachment.clearValue.depthStencil = { 1.0f, 0 };
+  VkClearRect clearRect = { { { (int32_t)viewport.x, (int32_t)viewport.y },{ viewport.z, viewport.w } }, 0u, 1u };
+  vkCmdClearAttachments(commandBuffer.handle_, 1u, &clearAttachment, 1u, &clearRect);
+
+  render::setViewport(commandBuffer, viewport.x, viewport.y, viewport.z, viewport.w);
+  render::setScissor(commandBuffer, viewport.x, viewport.y, viewport.z, viewport.w);
+}
+
+void shadow_atlas_t::renderPassEnd(render::command_buffer_t commandBuffer)
+{
+  render::commandBufferRenderPassEnd(commandBuffer);
+  render::textureChangeLayout(commandBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &texture_);
+}
@@ -0,0 +1,232 @@
+
+#include "core/cpu-profiler.h"
+#include "core/mesh.h"
+
+#include "framework/stress-scene.h"
+#include "framework/renderer.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+
+using namespace bkk::core;
+using namespace bkk::framework;
+
+//Scenes use their own generator (xorshift) so they only depend on the seed in the description
+static uint32_t randomNext(uint32_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+//Uniformly distributed in [min,max)
+static float randomRange(uint32_t* state, float min, float max)
+{
+  return min + (max - min) * ((randomNext(state) >> 8) / 16777216.0f);
+}
+
+//Unit diameter sphere with position, normal and uv per vertex
+static mesh::mesh_t createSphere(const render::context_t& context, uint32_t rings, uint32_t segments)
+{
+  struct vertex_t
+  {
+    float position[3];
+    float normal[3];
+    float uv[2];
+  };
+
+  std::vector<vertex_t> vertices;
+  vertices.reserve((rings + 1) * (segments + 1));
+  for (uint32_t ring(0); ring <= rings; ++ring)
+  {
+    float v = ring / (float)rings;
+    float phi = v * (float)PI;
+    for (uint32_t segment(0); segment <= segments; ++segment)
+    {
+      float u = segment / (float)segments;
+      float theta = u * 2.0f * (float)PI;
+      vertex_t vertex;
+      vertex.normal[0] = sinf(phi) * cosf(theta);
+      vertex.normal[1] = cosf(phi);
+      vertex.normal[2] = sinf(phi) * sinf(theta);
+      vertex.position[0] = 0.5f * vertex.normal[0];
+      vertex.position[1] = 0.5f * vertex.normal[1];
+      vertex.position[2] = 0.5f * vertex.normal[2];
+      vertex.uv[0] = u;
+      vertex.uv[1] = v;
+      vertices.push_back(vertex);
+    }
+  }
+
+  std::vector<uint32_t> indices;
+  indices.reserve(rings * segments * 6);
+  for (uint32_t ring(0); ring < rings; ++ring)
+  {
+    for (uint32_t segment(0); segment < segments; ++segment)
+    {
+      uint32_t i0 = ring * (segments + 1) + segment;
+      uint32_t i1 = i0 + segments + 1;
+      indices.push_back(i0); indices.push_back(i0 + 1); indices.push_back(i1);
+      indices.push_back(i1); indices.push_back(i0 + 1); indices.push_back(i1 + 1);
+    }
+  }
+
+  render::vertex_attribute_t attributes[3];
+  attributes[0].format_ = render::vertex_attribute_t::format::VEC3;
+  attributes[0].offset_ = 0;
+  attributes[0].stride_ = sizeof(vertex_t);
+  attributes[0].instanced_ = false;
+  attributes[1].format_ = render::vertex_attribute_t::format::VEC3;
+  attributes[1].offset_ = offsetof(vertex_t, normal);
+  attributes[1].stride_ = sizeof(vertex_t);
+  attributes[1].instanced_ = false;
+  attributes[2].format_ = render::vertex_attribute_t::format::VEC2;
+  attributes[2].offset_ = offsetof(vertex_t, uv);
+  attributes[2].stride_ = sizeof(vertex_t);
+  attributes[2].instanced_ = false;
+
+  mesh::mesh_t mesh;
+  mesh::create(context, indices.data(), (uint32_t)(indices.size() * sizeof(uint32_t)),
+               vertices.data(), vertices.size() * sizeof(vertex_t), attributes, 3u, nullptr, &mesh);
+  mesh.aabb_.min_ = maths::vec3(-0.5f, -0.5f, -0.5f);
+  mesh.aabb_.max_ = maths::vec3(0.5f, 0.5f, 0.5f);
+  return mesh;
+}
+
+stress_scene_desc_t::stress_scene_desc_t()
+:actorCount_(1000u),
+ meshCount_(4u),
+ materialCount_(16u),
+ hierarchyDepth_(1u),
+ lightCount_(64u),
+ dynamicFraction_(0.1f),
+ extent_(50.0f),
+ seed_(1u)
+{}
+
+stress_scene_t::stress_scene_t()
+:triangleCount_(0u)
+{}
+
+void stress_scene_t::create(const stress_scene_desc_t& desc, shader_handle_t shader, renderer_t* renderer)
+{
+  BKK_ZONE("stress_scene_t::create");
+
+  desc_ = desc;
+  desc_.meshCount_ = maths::maxValue(1u, desc_.meshCount_);
+  desc_.materialCount_ = maths::maxValue(1u, desc_.materialCount_);
+  desc_.hierarchyDepth_ = maths::clamp(1u, maths::maxValue(1u, desc_.actorCount_), desc_.hierarchyDepth_);
+  desc_.dynamicFraction_ = maths::clamp(0.0f, 1.0f, desc_.dynamicFraction_);
+  if (desc_.lightCount_ > light_manager_t::MAX_LIGHT_COUNT)
+  {
+    fprintf(stderr, "Stress scene: %u lights requested, the light manager supports %u\n", desc_.lightCount_, light_manager_t::MAX_LIGHT_COUNT);
+    desc_.lightCount_ = light_manager_t::MAX_LIGHT_COUNT;
+  }
+
+  uint32_t random = desc_.seed_ != 0u ? desc_.seed_ : 0x9E3779B9u;
+  render::context_t& context = renderer->getContext();
+
+  //Meshes, from 8x16 up to 64x128 segments
+  std::vector<mesh_handle_t> meshes(desc_.meshCount_);
+  std::vector<uint32_t> meshTriangles(desc_.meshCount_);
+  for (uint32_t i(0); i < desc_.meshCount_; ++i)
+  {
+    uint32_t rings = desc_.meshCount_ > 1u ? 8u + (56u * i) / (desc_.meshCount_ - 1u) : 8u;
+    mesh::mesh_t mesh = createSphere(context, rings, 2u * rings);
+    meshTriangles[i] = mesh.indexCount_ / 3u;
+    meshes[i] = renderer->addMesh(mesh);
+  }
+
+  //Materials
+  std::vector<material_handle_t> materials(desc_.materialCount_);
+  for (uint32_t i(0); i < desc_.materialCount_; ++i)
+  {
+    materials[i] = renderer->materialCreate(shader);
+    material_t* material = renderer->getMaterial(materials[i]);
+    material->setProperty("globals.diffuseColor", maths::vec4(randomRange(&random, 0.1f, 1.0f), randomRange(&random, 0.1f, 1.0f), randomRange(&random, 0.1f, 1.0f), 1.0f));
+    material->setProperty("globals.specularColor", maths::vec4(0.5f, 0.5f, 0.5f, 1.0f));
+    material->setProperty("globals.shininess", randomRange(&random, 4.0f, 64.0f));
+  }
+
+  //Actors. Each chain starts at a cell of the grid and climbs in a spiral, one unit per actor
+  uint32_t chainCount = (desc_.actorCount_ + desc_.hierarchyDepth_ - 1u) / desc_.hierarchyDepth_;
+  uint32_t gridSize = maths::maxValue(1u, (uint32_t)ceilf(sqrtf((float)chainCount)));
+  float cellSize = 2.0f * desc_.extent_ / gridSize;
+  const maths::vec3 yAxis(0.0f, 1.0f, 0.0f);
+
+  uint32_t dynamicThreshold = (uint32_t)(desc_.dynamicFraction_ * 16777216.0f);
+  dynamicActors_.clear();
+  dynamicActors_.reserve((size_t)(desc_.actorCount_ * desc_.dynamicFraction_) + 1u);
+  triangleCount_ = 0u;
+
+  actor_handle_t parent = NULL_HANDLE;
+  for (uint32_t i(0); i < desc_.actorCount_; ++i)
+  {
+    maths::vec3 position(0.25f, 1.0f, 0.0f);
+    if (i % desc_.hierarchyDepth_ == 0u)
+    {
+      uint32_t chain = i / desc_.hierarchyDepth_;
+      position = maths::vec3(-desc_.extent_ + ((chain % gridSize) + 0.5f) * cellSize, 0.5f,
+                             -desc_.extent_ + ((chain / gridSize) + 0.5f) * cellSize);
+      parent = NULL_HANDLE;
+    }
+
+    float angle = randomRange(&random, 0.0f, 2.0f * (float)PI);
+    uint32_t meshIndex = randomNext(&random) % desc_.meshCount_;
+    uint32_t materialIndex = randomNext(&random) % desc_.materialCount_;
+    maths::mat4 transform = maths::createTransform(position, maths::VEC3_ONE, maths::quaternionFromAxisAngle(yAxis, angle));
+    actor_handle_t actor = renderer->actorCreate("stress", meshes[meshIndex], materials[materialIndex], transform);
+    if (parent != NULL_HANDLE)
+      renderer->actorSetParent(actor, parent);
+
+    if ((randomNext(&random) >> 8) < dynamicThreshold)
+    {
+      dynamic_actor_t dynamicActor = { actor, position, angle, randomRange(&random, -2.0f, 2.0f) };
+      dynamicActors_.push_back(dynamicActor);
+    }
+
+    triangleCount_ += meshTriangles[meshIndex];
+    parent = actor;
+  }
+
+  //Lights, spread over the grid with a radius that covers a few cells
+  lights_.resize(desc_.lightCount_);
+  float lightRadius = maths::maxValue(4.0f, 3.0f * 2.0f * desc_.extent_ / maths::maxValue(1.0f, sqrtf((float)desc_.lightCount_)));
+  for (uint32_t i(0); i < desc_.lightCount_; ++i)
+  {
+    moving_light_t& light = lights_[i];
+    light.center_ = maths::vec3(randomRange(&random, -desc_.extent_, desc_.extent_), randomRange(&random, 1.0f, 4.0f), randomRange(&random, -desc_.extent_, desc_.extent_));
+    light.orbitRadius_ = randomRange(&random, 0.0f, 0.5f * lightRadius);
+    light.speed_ = randomRange(&random, -1.0f, 1.0f);
+    maths::vec3 color(randomRange(&random, 0.2f, 1.0f), randomRange(&random, 0.2f, 1.0f), randomRange(&random, 0.2f, 1.0f));
+    light.light_ = renderer->getLightManager()->lightCreate(light.center_, color, lightRadius);
+  }
+}
+
+void stress_scene_t::update(float time, renderer_t* renderer)
+{
+  BKK_ZONE("stress_scene_t::update");
+
+  const maths::vec3 yAxis(0.0f, 1.0f, 0.0f);
+  for (size_t i(0); i < dynamicActors_.size(); ++i)
+  {
+    const dynamic_actor_t& actor = dynamicActors_[i];
+    maths::quat rotation = maths::quaternionFromAxisAngle(yAxis, actor.angle_ + actor.speed_ * time);
+    renderer->actorSetTransform(actor.actor_, maths::createTransform(actor.position_, maths::VEC3_ONE, rotation));
+  }
+
+  light_manager_t* lightManager = renderer->getLightManager();
+  for (size_t i(0); i < lights_.size(); ++i)
+  {
+    const moving_light_t& light = lights_[i];
+    light_t* data = lightManager->getLight(light.light_);
+    if (data)
+    {
+      float angle = light.speed_ * time;
+      data->position_ = maths::vec4(light.center_.x + light.orbitRadius_ * cosf(angle), light.center_.y,
+                                    light.center_.z + light.orbitRadius_ * sinf(angle), 1.0f);
+    }
+  }
+}